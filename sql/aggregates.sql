@@ -14,6 +14,8 @@
 
 --This aggregate returns the "first" element of the first argument when ordered by the second argument.
 --Ex. first(temp, time) returns the temp value for the row with the lowest time
+--In window frames that move, it keeps the rows that can become the first one instead of
+--recomputing the frame for every row.
 CREATE AGGREGATE first(anyelement, "any") (
     SFUNC = _timescaledb_internal.first_sfunc,
     STYPE = internal,
@@ -22,7 +24,12 @@ CREATE AGGREGATE first(anyelement, "any") (
     DESERIALFUNC = _timescaledb_internal.bookend_deserializefunc,
     PARALLEL = SAFE,
     FINALFUNC = _timescaledb_internal.bookend_finalfunc,
-    FINALFUNC_EXTRA
+    FINALFUNC_EXTRA,
+    MSFUNC = _timescaledb_internal.first_msfunc,
+    MINVFUNC = _timescaledb_internal.bookend_minvfunc,
+    MSTYPE = internal,
+    MFINALFUNC = _timescaledb_internal.bookend_mfinalfunc,
+    MFINALFUNC_EXTRA
 );
 
 --This aggregate returns the "last" element of the first argument when ordered by the second argument.
@@ -35,7 +42,12 @@ CREATE AGGREGATE last(anyelement, "any") (
     DESERIALFUNC = _timescaledb_internal.bookend_deserializefunc,
     PARALLEL = SAFE,
     FINALFUNC = _timescaledb_internal.bookend_finalfunc,
-    FINALFUNC_EXTRA
+    FINALFUNC_EXTRA,
+    MSFUNC = _timescaledb_internal.last_msfunc,
+    MINVFUNC = _timescaledb_internal.bookend_minvfunc,
+    MSTYPE = internal,
+    MFINALFUNC = _timescaledb_internal.bookend_mfinalfunc,
+    MFINALFUNC_EXTRA
 );
 
 -- This aggregate partitions the dataset into a specified number of buckets (nbuckets) ranging
@@ -48,7 +60,168 @@ CREATE AGGREGATE histogram (DOUBLE PRECISION, DOUBLE PRECISION, DOUBLE PRECISION
     DESERIALFUNC = _timescaledb_internal.hist_deserializefunc,
     PARALLEL = SAFE,
     FINALFUNC = _timescaledb_internal.hist_finalfunc,
-    FINALFUNC_EXTRA
+    FINALFUNC_EXTRA,
+    MSFUNC = _timescaledb_internal.hist_msfunc,
+    MINVFUNC = _timescaledb_internal.hist_minvfunc,
+    MSTYPE = INTERNAL,
+    MFINALFUNC = _timescaledb_internal.hist_finalfunc,
+    MFINALFUNC_EXTRA
+);
+
+-- This aggregate is like histogram, but with logarithmically sized buckets ranging from the
+-- inputted min to max values, and bigint counts.
+CREATE AGGREGATE log_histogram (DOUBLE PRECISION, DOUBLE PRECISION, DOUBLE PRECISION, INTEGER) (
+    SFUNC = _timescaledb_internal.hist_log_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.hist_combinefunc,
+    SERIALFUNC = _timescaledb_internal.hist_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.hist_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.hist_log_finalfunc,
+    MSFUNC = _timescaledb_internal.hist_log_msfunc,
+    MINVFUNC = _timescaledb_internal.hist_log_minvfunc,
+    MSTYPE = INTERNAL,
+    MFINALFUNC = _timescaledb_internal.hist_log_finalfunc
+);
+
+-- These aggregates count the values in logarithmically sized buckets, so that approx_percentile
+-- is off by at most the relative error, 1% by default or between 0.0001 and 0.5 if given.
+CREATE AGGREGATE percentile_sketch (DOUBLE PRECISION) (
+    SFUNC = _timescaledb_internal.percentile_sketch_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.percentile_sketch_combinefunc,
+    SERIALFUNC = _timescaledb_internal.percentile_sketch_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.percentile_sketch_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.percentile_sketch_finalfunc
+);
+
+CREATE AGGREGATE percentile_sketch (DOUBLE PRECISION, DOUBLE PRECISION) (
+    SFUNC = _timescaledb_internal.percentile_sketch_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.percentile_sketch_combinefunc,
+    SERIALFUNC = _timescaledb_internal.percentile_sketch_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.percentile_sketch_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.percentile_sketch_finalfunc
+);
+
+-- Adds up the buckets of sketches with the same relative error, e.g. of hours into a day
+CREATE AGGREGATE percentile_sketch_rollup (BYTEA) (
+    SFUNC = _timescaledb_internal.percentile_sketch_rollup_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.percentile_sketch_combinefunc,
+    SERIALFUNC = _timescaledb_internal.percentile_sketch_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.percentile_sketch_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.percentile_sketch_finalfunc
+);
+
+-- These aggregates weight the values by the time they cover, interpolating linearly between
+-- them by default, or carrying every value forward until the next one with the 'locf' method.
+-- time_weighted_integral returns the area under the values in value * seconds. The values are
+-- summarized as rows arrive, so rows must arrive roughly in time order. Partials of overlapping
+-- time ranges cannot be combined, so continuous aggregates of hypertables with space partitions
+-- must group by the space partitioning columns.
+CREATE AGGREGATE time_weighted_average (DOUBLE PRECISION, TIMESTAMPTZ) (
+    SFUNC = _timescaledb_internal.time_weight_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.time_weight_combinefunc,
+    SERIALFUNC = _timescaledb_internal.time_weight_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.time_weight_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.time_weighted_average_finalfunc
+);
+
+CREATE AGGREGATE time_weighted_average (DOUBLE PRECISION, TIMESTAMPTZ, TEXT) (
+    SFUNC = _timescaledb_internal.time_weight_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.time_weight_combinefunc,
+    SERIALFUNC = _timescaledb_internal.time_weight_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.time_weight_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.time_weighted_average_finalfunc
+);
+
+CREATE AGGREGATE time_weighted_integral (DOUBLE PRECISION, TIMESTAMPTZ) (
+    SFUNC = _timescaledb_internal.time_weight_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.time_weight_combinefunc,
+    SERIALFUNC = _timescaledb_internal.time_weight_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.time_weight_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.time_weighted_integral_finalfunc
+);
+
+CREATE AGGREGATE time_weighted_integral (DOUBLE PRECISION, TIMESTAMPTZ, TEXT) (
+    SFUNC = _timescaledb_internal.time_weight_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.time_weight_combinefunc,
+    SERIALFUNC = _timescaledb_internal.time_weight_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.time_weight_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.time_weighted_integral_finalfunc
+);
+
+-- These aggregates summarize the samples of a counter, where a sample lower than the one before
+-- marks a reset to zero. counter_delta returns the increase, adding the samples before resets,
+-- counter_rate that per second between the first and last sample, and counter_extrapolated_rate
+-- that per second of the given range, extrapolating the samples to its bounds. Like for the
+-- time-weighted aggregates, rows must arrive roughly in time order, and continuous aggregates of
+-- hypertables with space partitions must group by the space partitioning columns.
+CREATE AGGREGATE counter_agg (DOUBLE PRECISION, TIMESTAMPTZ) (
+    SFUNC = _timescaledb_internal.counter_agg_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.counter_agg_combinefunc,
+    SERIALFUNC = _timescaledb_internal.counter_agg_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.counter_agg_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.counter_agg_finalfunc
+);
+
+-- Combines the summaries of adjacent time ranges, e.g. to roll up per-minute summaries into hourly ones
+CREATE AGGREGATE counter_agg_rollup (BYTEA) (
+    SFUNC = _timescaledb_internal.counter_agg_rollup_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.counter_agg_combinefunc,
+    SERIALFUNC = _timescaledb_internal.counter_agg_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.counter_agg_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.counter_agg_finalfunc
+);
+
+-- These aggregates hash the values into 2^precision registers, with a precision of 14 by default
+-- or between 4 and 16 if given. approx_count_distinct has a standard error of
+-- 1.04 / sqrt(2^precision), 0.8% at 14. Sketches of few values use four bytes per register set.
+CREATE AGGREGATE hyperloglog (ANYELEMENT) (
+    SFUNC = _timescaledb_internal.hyperloglog_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.hyperloglog_combinefunc,
+    SERIALFUNC = _timescaledb_internal.hyperloglog_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.hyperloglog_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.hyperloglog_finalfunc
+);
+
+CREATE AGGREGATE hyperloglog (ANYELEMENT, INTEGER) (
+    SFUNC = _timescaledb_internal.hyperloglog_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.hyperloglog_combinefunc,
+    SERIALFUNC = _timescaledb_internal.hyperloglog_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.hyperloglog_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.hyperloglog_finalfunc
+);
+
+-- Keeps the highest value of every register of sketches with the same precision
+CREATE AGGREGATE hyperloglog_union (BYTEA) (
+    SFUNC = _timescaledb_internal.hyperloglog_union_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.hyperloglog_combinefunc,
+    SERIALFUNC = _timescaledb_internal.hyperloglog_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.hyperloglog_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.hyperloglog_finalfunc
 );
 
 CREATE AGGREGATE _timescaledb_internal.finalize_agg(agg_name TEXT,  inner_agg_collation_schema NAME,  inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_serialized_state BYTEA, return_type_dummy_val anyelement) (
@@ -58,3 +231,19 @@ CREATE AGGREGATE _timescaledb_internal.finalize_agg(agg_name TEXT,  inner_agg_co
     FINALFUNC_EXTRA
 );
 
+-- Finalizes the partials of partialize_agg_native
+CREATE AGGREGATE _timescaledb_internal.finalize_agg(agg_name TEXT,  inner_agg_collation_schema NAME,  inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_partial anyelement, return_type_dummy_val anyelement) (
+    SFUNC = _timescaledb_internal.finalize_agg_sfunc,
+    STYPE = internal,
+    FINALFUNC = _timescaledb_internal.finalize_agg_ffunc,
+    FINALFUNC_EXTRA
+);
+
+-- Combines the partials of an aggregate into a partial of the same aggregate, used to
+-- materialize a continuous aggregate from the partials of another one
+CREATE AGGREGATE _timescaledb_internal.combine_agg(agg_name TEXT,  inner_agg_collation_schema NAME,  inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_serialized_state BYTEA, return_type_dummy_val anyelement) (
+    SFUNC = _timescaledb_internal.finalize_agg_sfunc,
+    STYPE = internal,
+    FINALFUNC = _timescaledb_internal.combine_agg_ffunc
+);
+
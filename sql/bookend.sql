@@ -36,3 +36,23 @@ CREATE OR REPLACE FUNCTION _timescaledb_internal.bookend_deserializefunc(bytea,
 RETURNS internal
 AS '@MODULE_PATHNAME@', 'ts_bookend_deserializefunc'
 LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.first_msfunc(internal, anyelement, "any")
+RETURNS internal
+AS '@MODULE_PATHNAME@', 'ts_first_msfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.last_msfunc(internal, anyelement, "any")
+RETURNS internal
+AS '@MODULE_PATHNAME@', 'ts_last_msfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.bookend_minvfunc(internal, anyelement, "any")
+RETURNS internal
+AS '@MODULE_PATHNAME@', 'ts_bookend_minvfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.bookend_mfinalfunc(internal, anyelement, "any")
+RETURNS anyelement
+AS '@MODULE_PATHNAME@', 'ts_bookend_mfinalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
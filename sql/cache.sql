@@ -25,3 +25,14 @@ SELECT pg_catalog.pg_extension_config_dump('_timescaledb_cache.cache_inval_bgw_j
 
 GRANT SELECT ON ALL TABLES IN SCHEMA _timescaledb_cache TO PUBLIC;
 
+
+-- The invalidation thresholds are cached in shared memory. Modifying the
+-- catalog table with SQL must reset the cache.
+CREATE OR REPLACE FUNCTION _timescaledb_internal.invalidation_threshold_cache_reset() RETURNS TRIGGER
+AS '@MODULE_PATHNAME@', 'ts_invalidation_threshold_cache_reset_trigger' LANGUAGE C;
+
+DROP TRIGGER IF EXISTS invalidation_threshold_cache_reset
+ON _timescaledb_catalog.continuous_aggs_invalidation_threshold;
+CREATE TRIGGER invalidation_threshold_cache_reset
+AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON _timescaledb_catalog.continuous_aggs_invalidation_threshold
+FOR EACH STATEMENT EXECUTE PROCEDURE _timescaledb_internal.invalidation_threshold_cache_reset();
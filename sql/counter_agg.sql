@@ -0,0 +1,52 @@
+-- This file and its contents are licensed under the Apache License 2.0.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-APACHE for a copy of the license.
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_sfunc(state INTERNAL, val DOUBLE PRECISION, "time" TIMESTAMPTZ)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_rollup_sfunc(state INTERNAL, summary BYTEA)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_rollup_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_combinefunc(state1 INTERNAL, state2 INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_combinefunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_serializefunc(INTERNAL)
+RETURNS bytea
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_serializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_deserializefunc(bytea, INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_deserializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_finalfunc(state INTERNAL)
+RETURNS BYTEA
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Returns the increase of the counter, accounting for resets
+CREATE OR REPLACE FUNCTION counter_delta(summary BYTEA)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_counter_delta'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Returns the increase of the counter per second between its first and last sample
+CREATE OR REPLACE FUNCTION counter_rate(summary BYTEA)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_counter_rate'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Returns the increase of the counter per second over the range, extrapolating the samples to
+-- its bounds like Prometheus' rate()
+CREATE OR REPLACE FUNCTION counter_extrapolated_rate(summary BYTEA, range_start TIMESTAMPTZ, range_end TIMESTAMPTZ)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_counter_extrapolated_rate'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
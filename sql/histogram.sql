@@ -7,6 +7,16 @@ RETURNS INTERNAL
 AS '@MODULE_PATHNAME@', 'ts_hist_sfunc'
 LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_msfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_msfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_minvfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_minvfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
 CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_combinefunc(state1 INTERNAL, state2 INTERNAL)
 RETURNS INTERNAL
 AS '@MODULE_PATHNAME@', 'ts_hist_combinefunc'
@@ -26,3 +36,23 @@ CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_finalfunc(state INTERNAL,
 RETURNS INTEGER[]
 AS '@MODULE_PATHNAME@', 'ts_hist_finalfunc'
 LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_log_sfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_log_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_log_msfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_log_msfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_log_minvfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_log_minvfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_log_finalfunc(state INTERNAL)
+RETURNS BIGINT[]
+AS '@MODULE_PATHNAME@', 'ts_hist_log_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
@@ -0,0 +1,44 @@
+-- This file and its contents are licensed under the Apache License 2.0.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-APACHE for a copy of the license.
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_sfunc(state INTERNAL, val ANYELEMENT)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_sfunc(state INTERNAL, val ANYELEMENT, precision INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_union_sfunc(state INTERNAL, sketch BYTEA)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_union_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_combinefunc(state1 INTERNAL, state2 INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_combinefunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_serializefunc(INTERNAL)
+RETURNS bytea
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_serializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_deserializefunc(bytea, INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_deserializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_finalfunc(state INTERNAL)
+RETURNS BYTEA
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Returns the approximate number of distinct values in the sketch
+CREATE OR REPLACE FUNCTION approx_count_distinct(sketch BYTEA)
+RETURNS BIGINT
+AS '@MODULE_PATHNAME@', 'ts_approx_count_distinct'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
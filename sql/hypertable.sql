@@ -9,3 +9,8 @@ AS '@MODULE_PATHNAME@', 'ts_hypertable_insert_blocker' LANGUAGE C;
 -- Records mutations or INSERTs which would invalidate a continuous aggregate
 CREATE OR REPLACE FUNCTION _timescaledb_internal.continuous_agg_invalidation_trigger() RETURNS TRIGGER
 AS '@MODULE_PATHNAME@', 'continuous_agg_invalidation_trigger' LANGUAGE C;
+
+-- Get the completed threshold (in internal time) of a continuous aggregate's
+-- materialization or NULL if nothing has been materialized yet
+CREATE OR REPLACE FUNCTION _timescaledb_internal.cagg_watermark(hypertable_id INTEGER) RETURNS INT8
+AS '@MODULE_PATHNAME@', 'ts_continuous_agg_watermark' LANGUAGE C STABLE STRICT PARALLEL SAFE;
@@ -5,6 +5,11 @@
 CREATE OR REPLACE FUNCTION _timescaledb_internal.partialize_agg(arg ANYELEMENT)
 RETURNS BYTEA AS '@MODULE_PATHNAME@', 'ts_partialize_agg' LANGUAGE C VOLATILE;
 
+-- The partial of an aggregate without a final function and with a non-internal
+-- transition type is its transition value, which is stored natively
+CREATE OR REPLACE FUNCTION _timescaledb_internal.partialize_agg_native(arg ANYELEMENT)
+RETURNS ANYELEMENT AS '@MODULE_PATHNAME@', 'ts_partialize_agg' LANGUAGE C VOLATILE;
+
 CREATE OR REPLACE FUNCTION _timescaledb_internal.finalize_agg_sfunc(
 tstate internal, aggfn TEXT, inner_agg_collation_schema NAME, inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_serialized_state BYTEA, return_type_dummy_val ANYELEMENT)
 RETURNS internal
@@ -17,3 +22,20 @@ RETURNS anyelement
 AS '@MODULE_PATHNAME@', 'ts_finalize_agg_ffunc'
 LANGUAGE C IMMUTABLE ;
 
+CREATE OR REPLACE FUNCTION _timescaledb_internal.finalize_agg_sfunc(
+tstate internal, aggfn TEXT, inner_agg_collation_schema NAME, inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_partial ANYELEMENT, return_type_dummy_val ANYELEMENT)
+RETURNS internal
+AS '@MODULE_PATHNAME@', 'ts_finalize_agg_sfunc'
+LANGUAGE C IMMUTABLE ;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.finalize_agg_ffunc(
+tstate internal, aggfn TEXT, inner_agg_collation_schema NAME, inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_partial ANYELEMENT, return_type_dummy_val ANYELEMENT)
+RETURNS anyelement
+AS '@MODULE_PATHNAME@', 'ts_finalize_agg_ffunc'
+LANGUAGE C IMMUTABLE ;
+
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.combine_agg_ffunc(tstate internal)
+RETURNS BYTEA
+AS '@MODULE_PATHNAME@', 'ts_combine_agg_ffunc'
+LANGUAGE C IMMUTABLE ;
@@ -0,0 +1,50 @@
+-- This file and its contents are licensed under the Apache License 2.0.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-APACHE for a copy of the license.
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_sfunc(state INTERNAL, val DOUBLE PRECISION)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_sfunc(state INTERNAL, val DOUBLE PRECISION, relative_error DOUBLE PRECISION)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_rollup_sfunc(state INTERNAL, sketch BYTEA)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_rollup_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_combinefunc(state1 INTERNAL, state2 INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_combinefunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_serializefunc(INTERNAL)
+RETURNS bytea
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_serializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_deserializefunc(bytea, INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_deserializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_finalfunc(state INTERNAL)
+RETURNS BYTEA
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Returns the approximate value at the percentile (between 0 and 1) of the values in the sketch
+CREATE OR REPLACE FUNCTION approx_percentile(percentile DOUBLE PRECISION, sketch BYTEA)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_approx_percentile'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Returns the approximate fraction of the values in the sketch that are lower than or equal to value
+CREATE OR REPLACE FUNCTION approx_percentile_rank(value DOUBLE PRECISION, sketch BYTEA)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_approx_percentile_rank'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
@@ -265,6 +265,41 @@ SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.continuous_aggs
 CREATE INDEX continuous_aggs_hypertable_invalidation_log_idx
     ON _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log (hypertable_id, lowest_modified_value ASC);
 
+CREATE TABLE IF NOT EXISTS _timescaledb_catalog.continuous_aggs_materialization_invalidation_log(
+    materialization_id INTEGER NOT NULL
+        REFERENCES _timescaledb_catalog.continuous_agg(mat_hypertable_id)
+        ON DELETE CASCADE,
+    lowest_modified_value BIGINT NOT NULL,
+    greatest_modified_value BIGINT NOT NULL
+);
+SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.continuous_aggs_materialization_invalidation_log', '');
+
+CREATE INDEX continuous_aggs_materialization_invalidation_log_idx
+    ON _timescaledb_catalog.continuous_aggs_materialization_invalidation_log (materialization_id, lowest_modified_value ASC);
+
+-- Statistics of the most recent materializations of each continuous aggregate,
+-- see timescaledb.materialization_stats_history. Like the job stats, they are
+-- not dumped by pg_dump.
+CREATE TABLE IF NOT EXISTS _timescaledb_internal.continuous_aggs_materialization_stats(
+    materialization_id INTEGER NOT NULL
+        REFERENCES _timescaledb_catalog.continuous_agg(mat_hypertable_id)
+        ON DELETE CASCADE,
+    run_id BIGINT NOT NULL,
+    start_time TIMESTAMPTZ NOT NULL,
+    finish_time TIMESTAMPTZ NOT NULL,
+    old_completed_threshold BIGINT NULL,
+    new_completed_threshold BIGINT NULL,
+    invalidation_threshold BIGINT NULL,
+    invalidated_ranges INTEGER NOT NULL,
+    invalidated_buckets BIGINT NOT NULL,
+    new_buckets BIGINT NOT NULL,
+    rows_deleted BIGINT NOT NULL,
+    rows_inserted BIGINT NOT NULL,
+    delete_duration INTERVAL NOT NULL,
+    insert_duration INTERVAL NOT NULL,
+    PRIMARY KEY (materialization_id, run_id)
+);
+
 -- Set table permissions
 -- We need to grant SELECT to PUBLIC for all tables even those not
 -- marked as being dumped because pg_dump will try to access all
@@ -0,0 +1,38 @@
+-- This file and its contents are licensed under the Apache License 2.0.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-APACHE for a copy of the license.
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_sfunc(state INTERNAL, val DOUBLE PRECISION, "time" TIMESTAMPTZ)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_time_weight_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_sfunc(state INTERNAL, val DOUBLE PRECISION, "time" TIMESTAMPTZ, method TEXT)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_time_weight_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_combinefunc(state1 INTERNAL, state2 INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_time_weight_combinefunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_serializefunc(INTERNAL)
+RETURNS bytea
+AS '@MODULE_PATHNAME@', 'ts_time_weight_serializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_deserializefunc(bytea, INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_time_weight_deserializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weighted_average_finalfunc(state INTERNAL)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_time_weighted_average_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weighted_integral_finalfunc(state INTERNAL)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_time_weighted_integral_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
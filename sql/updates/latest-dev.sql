@@ -76,6 +76,20 @@ CREATE INDEX continuous_aggs_hypertable_invalidation_log_idx
 
 GRANT SELECT ON _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log TO PUBLIC;
 
+CREATE TABLE IF NOT EXISTS _timescaledb_catalog.continuous_aggs_materialization_invalidation_log(
+    materialization_id INTEGER NOT NULL
+        REFERENCES _timescaledb_catalog.continuous_agg(mat_hypertable_id)
+        ON DELETE CASCADE,
+    lowest_modified_value BIGINT NOT NULL,
+    greatest_modified_value BIGINT NOT NULL
+);
+SELECT pg_catalog.pg_extension_config_dump('_timescaledb_catalog.continuous_aggs_materialization_invalidation_log', '');
+
+CREATE INDEX continuous_aggs_materialization_invalidation_log_idx
+    ON _timescaledb_catalog.continuous_aggs_materialization_invalidation_log (materialization_id, lowest_modified_value ASC);
+
+GRANT SELECT ON _timescaledb_catalog.continuous_aggs_materialization_invalidation_log TO PUBLIC;
+
 DROP FUNCTION IF EXISTS drop_chunks(
     older_than "any",
     table_name  NAME,
@@ -107,3 +121,443 @@ CREATE OR REPLACE FUNCTION add_drop_chunks_policy(hypertable REGCLASS, older_tha
 RETURNS INTEGER
 AS '@MODULE_PATHNAME@', 'ts_add_drop_chunks_policy'
 LANGUAGE C VOLATILE STRICT;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.combine_agg_ffunc(tstate internal)
+RETURNS BYTEA
+AS '@MODULE_PATHNAME@', 'ts_combine_agg_ffunc'
+LANGUAGE C IMMUTABLE ;
+
+CREATE AGGREGATE _timescaledb_internal.combine_agg(agg_name TEXT,  inner_agg_collation_schema NAME,  inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_serialized_state BYTEA, return_type_dummy_val anyelement) (
+    SFUNC = _timescaledb_internal.finalize_agg_sfunc,
+    STYPE = internal,
+    FINALFUNC = _timescaledb_internal.combine_agg_ffunc
+);
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.finalize_agg_sfunc(
+tstate internal, aggfn TEXT, inner_agg_collation_schema NAME, inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_partial ANYELEMENT, return_type_dummy_val ANYELEMENT)
+RETURNS internal
+AS '@MODULE_PATHNAME@', 'ts_finalize_agg_sfunc'
+LANGUAGE C IMMUTABLE ;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.finalize_agg_ffunc(
+tstate internal, aggfn TEXT, inner_agg_collation_schema NAME, inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_partial ANYELEMENT, return_type_dummy_val ANYELEMENT)
+RETURNS anyelement
+AS '@MODULE_PATHNAME@', 'ts_finalize_agg_ffunc'
+LANGUAGE C IMMUTABLE ;
+
+-- Finalizes the partials of partialize_agg_native
+CREATE AGGREGATE _timescaledb_internal.finalize_agg(agg_name TEXT,  inner_agg_collation_schema NAME,  inner_agg_collation_name NAME, inner_agg_input_types NAME[][], inner_agg_partial anyelement, return_type_dummy_val anyelement) (
+    SFUNC = _timescaledb_internal.finalize_agg_sfunc,
+    STYPE = internal,
+    FINALFUNC = _timescaledb_internal.finalize_agg_ffunc,
+    FINALFUNC_EXTRA
+);
+
+-- Statistics of the most recent materializations of each continuous aggregate,
+-- see timescaledb.materialization_stats_history. Like the job stats, they are
+-- not dumped by pg_dump.
+CREATE TABLE IF NOT EXISTS _timescaledb_internal.continuous_aggs_materialization_stats(
+    materialization_id INTEGER NOT NULL
+        REFERENCES _timescaledb_catalog.continuous_agg(mat_hypertable_id)
+        ON DELETE CASCADE,
+    run_id BIGINT NOT NULL,
+    start_time TIMESTAMPTZ NOT NULL,
+    finish_time TIMESTAMPTZ NOT NULL,
+    old_completed_threshold BIGINT NULL,
+    new_completed_threshold BIGINT NULL,
+    invalidation_threshold BIGINT NULL,
+    invalidated_ranges INTEGER NOT NULL,
+    invalidated_buckets BIGINT NOT NULL,
+    new_buckets BIGINT NOT NULL,
+    rows_deleted BIGINT NOT NULL,
+    rows_inserted BIGINT NOT NULL,
+    delete_duration INTERVAL NOT NULL,
+    insert_duration INTERVAL NOT NULL,
+    PRIMARY KEY (materialization_id, run_id)
+);
+
+GRANT SELECT ON _timescaledb_internal.continuous_aggs_materialization_stats TO PUBLIC;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_sfunc(state INTERNAL, val DOUBLE PRECISION)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_sfunc(state INTERNAL, val DOUBLE PRECISION, relative_error DOUBLE PRECISION)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_rollup_sfunc(state INTERNAL, sketch BYTEA)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_rollup_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_combinefunc(state1 INTERNAL, state2 INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_combinefunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_serializefunc(INTERNAL)
+RETURNS bytea
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_serializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_deserializefunc(bytea, INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_deserializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.percentile_sketch_finalfunc(state INTERNAL)
+RETURNS BYTEA
+AS '@MODULE_PATHNAME@', 'ts_percentile_sketch_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Returns the approximate value at the percentile (between 0 and 1) of the values in the sketch
+CREATE OR REPLACE FUNCTION approx_percentile(percentile DOUBLE PRECISION, sketch BYTEA)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_approx_percentile'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Returns the approximate fraction of the values in the sketch that are lower than or equal to value
+CREATE OR REPLACE FUNCTION approx_percentile_rank(value DOUBLE PRECISION, sketch BYTEA)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_approx_percentile_rank'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- These aggregates count the values in logarithmically sized buckets, so that approx_percentile
+-- is off by at most the relative error, 1% by default or between 0.0001 and 0.5 if given.
+CREATE AGGREGATE percentile_sketch (DOUBLE PRECISION) (
+    SFUNC = _timescaledb_internal.percentile_sketch_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.percentile_sketch_combinefunc,
+    SERIALFUNC = _timescaledb_internal.percentile_sketch_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.percentile_sketch_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.percentile_sketch_finalfunc
+);
+
+CREATE AGGREGATE percentile_sketch (DOUBLE PRECISION, DOUBLE PRECISION) (
+    SFUNC = _timescaledb_internal.percentile_sketch_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.percentile_sketch_combinefunc,
+    SERIALFUNC = _timescaledb_internal.percentile_sketch_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.percentile_sketch_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.percentile_sketch_finalfunc
+);
+
+-- Adds up the buckets of sketches with the same relative error, e.g. of hours into a day
+CREATE AGGREGATE percentile_sketch_rollup (BYTEA) (
+    SFUNC = _timescaledb_internal.percentile_sketch_rollup_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.percentile_sketch_combinefunc,
+    SERIALFUNC = _timescaledb_internal.percentile_sketch_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.percentile_sketch_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.percentile_sketch_finalfunc
+);
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_log_sfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_log_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_log_msfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_log_msfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_log_minvfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_log_minvfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_log_finalfunc(state INTERNAL)
+RETURNS BIGINT[]
+AS '@MODULE_PATHNAME@', 'ts_hist_log_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- This aggregate is like histogram, but with logarithmically sized buckets ranging from the
+-- inputted min to max values, and bigint counts.
+CREATE AGGREGATE log_histogram (DOUBLE PRECISION, DOUBLE PRECISION, DOUBLE PRECISION, INTEGER) (
+    SFUNC = _timescaledb_internal.hist_log_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.hist_combinefunc,
+    SERIALFUNC = _timescaledb_internal.hist_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.hist_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.hist_log_finalfunc,
+    MSFUNC = _timescaledb_internal.hist_log_msfunc,
+    MINVFUNC = _timescaledb_internal.hist_log_minvfunc,
+    MSTYPE = INTERNAL,
+    MFINALFUNC = _timescaledb_internal.hist_log_finalfunc
+);
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_sfunc(state INTERNAL, val DOUBLE PRECISION, "time" TIMESTAMPTZ)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_time_weight_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_sfunc(state INTERNAL, val DOUBLE PRECISION, "time" TIMESTAMPTZ, method TEXT)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_time_weight_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_combinefunc(state1 INTERNAL, state2 INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_time_weight_combinefunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_serializefunc(INTERNAL)
+RETURNS bytea
+AS '@MODULE_PATHNAME@', 'ts_time_weight_serializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weight_deserializefunc(bytea, INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_time_weight_deserializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weighted_average_finalfunc(state INTERNAL)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_time_weighted_average_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_weighted_integral_finalfunc(state INTERNAL)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_time_weighted_integral_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- These aggregates weight the values by the time they cover, interpolating linearly between
+-- them by default, or carrying every value forward until the next one with the 'locf' method.
+-- time_weighted_integral returns the area under the values in value * seconds. The values are
+-- summarized as rows arrive, so rows must arrive roughly in time order. Partials of overlapping
+-- time ranges cannot be combined, so continuous aggregates of hypertables with space partitions
+-- must group by the space partitioning columns.
+CREATE AGGREGATE time_weighted_average (DOUBLE PRECISION, TIMESTAMPTZ) (
+    SFUNC = _timescaledb_internal.time_weight_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.time_weight_combinefunc,
+    SERIALFUNC = _timescaledb_internal.time_weight_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.time_weight_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.time_weighted_average_finalfunc
+);
+
+CREATE AGGREGATE time_weighted_average (DOUBLE PRECISION, TIMESTAMPTZ, TEXT) (
+    SFUNC = _timescaledb_internal.time_weight_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.time_weight_combinefunc,
+    SERIALFUNC = _timescaledb_internal.time_weight_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.time_weight_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.time_weighted_average_finalfunc
+);
+
+CREATE AGGREGATE time_weighted_integral (DOUBLE PRECISION, TIMESTAMPTZ) (
+    SFUNC = _timescaledb_internal.time_weight_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.time_weight_combinefunc,
+    SERIALFUNC = _timescaledb_internal.time_weight_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.time_weight_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.time_weighted_integral_finalfunc
+);
+
+CREATE AGGREGATE time_weighted_integral (DOUBLE PRECISION, TIMESTAMPTZ, TEXT) (
+    SFUNC = _timescaledb_internal.time_weight_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.time_weight_combinefunc,
+    SERIALFUNC = _timescaledb_internal.time_weight_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.time_weight_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.time_weighted_integral_finalfunc
+);
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_sfunc(state INTERNAL, val DOUBLE PRECISION, "time" TIMESTAMPTZ)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_rollup_sfunc(state INTERNAL, summary BYTEA)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_rollup_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_combinefunc(state1 INTERNAL, state2 INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_combinefunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_serializefunc(INTERNAL)
+RETURNS bytea
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_serializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_deserializefunc(bytea, INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_deserializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.counter_agg_finalfunc(state INTERNAL)
+RETURNS BYTEA
+AS '@MODULE_PATHNAME@', 'ts_counter_agg_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Returns the increase of the counter, accounting for resets
+CREATE OR REPLACE FUNCTION counter_delta(summary BYTEA)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_counter_delta'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Returns the increase of the counter per second between its first and last sample
+CREATE OR REPLACE FUNCTION counter_rate(summary BYTEA)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_counter_rate'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Returns the increase of the counter per second over the range, extrapolating the samples to
+-- its bounds like Prometheus' rate()
+CREATE OR REPLACE FUNCTION counter_extrapolated_rate(summary BYTEA, range_start TIMESTAMPTZ, range_end TIMESTAMPTZ)
+RETURNS DOUBLE PRECISION
+AS '@MODULE_PATHNAME@', 'ts_counter_extrapolated_rate'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- These aggregates summarize the samples of a counter, where a sample lower than the one before
+-- marks a reset to zero. counter_delta returns the increase, adding the samples before resets,
+-- counter_rate that per second between the first and last sample, and counter_extrapolated_rate
+-- that per second of the given range, extrapolating the samples to its bounds. Like for the
+-- time-weighted aggregates, rows must arrive roughly in time order, and continuous aggregates of
+-- hypertables with space partitions must group by the space partitioning columns.
+CREATE AGGREGATE counter_agg (DOUBLE PRECISION, TIMESTAMPTZ) (
+    SFUNC = _timescaledb_internal.counter_agg_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.counter_agg_combinefunc,
+    SERIALFUNC = _timescaledb_internal.counter_agg_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.counter_agg_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.counter_agg_finalfunc
+);
+
+-- Combines the summaries of adjacent time ranges, e.g. to roll up per-minute summaries into hourly ones
+CREATE AGGREGATE counter_agg_rollup (BYTEA) (
+    SFUNC = _timescaledb_internal.counter_agg_rollup_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.counter_agg_combinefunc,
+    SERIALFUNC = _timescaledb_internal.counter_agg_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.counter_agg_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.counter_agg_finalfunc
+);
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_sfunc(state INTERNAL, val ANYELEMENT)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_sfunc(state INTERNAL, val ANYELEMENT, precision INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_union_sfunc(state INTERNAL, sketch BYTEA)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_union_sfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_combinefunc(state1 INTERNAL, state2 INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_combinefunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_serializefunc(INTERNAL)
+RETURNS bytea
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_serializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_deserializefunc(bytea, INTERNAL)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_deserializefunc'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hyperloglog_finalfunc(state INTERNAL)
+RETURNS BYTEA
+AS '@MODULE_PATHNAME@', 'ts_hyperloglog_finalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Returns the approximate number of distinct values in the sketch
+CREATE OR REPLACE FUNCTION approx_count_distinct(sketch BYTEA)
+RETURNS BIGINT
+AS '@MODULE_PATHNAME@', 'ts_approx_count_distinct'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- These aggregates hash the values into 2^precision registers, with a precision of 14 by default
+-- or between 4 and 16 if given. approx_count_distinct has a standard error of
+-- 1.04 / sqrt(2^precision), 0.8% at 14. Sketches of few values use four bytes per register set.
+CREATE AGGREGATE hyperloglog (ANYELEMENT) (
+    SFUNC = _timescaledb_internal.hyperloglog_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.hyperloglog_combinefunc,
+    SERIALFUNC = _timescaledb_internal.hyperloglog_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.hyperloglog_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.hyperloglog_finalfunc
+);
+
+CREATE AGGREGATE hyperloglog (ANYELEMENT, INTEGER) (
+    SFUNC = _timescaledb_internal.hyperloglog_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.hyperloglog_combinefunc,
+    SERIALFUNC = _timescaledb_internal.hyperloglog_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.hyperloglog_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.hyperloglog_finalfunc
+);
+
+-- Keeps the highest value of every register of sketches with the same precision
+CREATE AGGREGATE hyperloglog_union (BYTEA) (
+    SFUNC = _timescaledb_internal.hyperloglog_union_sfunc,
+    STYPE = INTERNAL,
+    COMBINEFUNC = _timescaledb_internal.hyperloglog_combinefunc,
+    SERIALFUNC = _timescaledb_internal.hyperloglog_serializefunc,
+    DESERIALFUNC = _timescaledb_internal.hyperloglog_deserializefunc,
+    PARALLEL = SAFE,
+    FINALFUNC = _timescaledb_internal.hyperloglog_finalfunc
+);
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.first_msfunc(internal, anyelement, "any")
+RETURNS internal
+AS '@MODULE_PATHNAME@', 'ts_first_msfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.last_msfunc(internal, anyelement, "any")
+RETURNS internal
+AS '@MODULE_PATHNAME@', 'ts_last_msfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.bookend_minvfunc(internal, anyelement, "any")
+RETURNS internal
+AS '@MODULE_PATHNAME@', 'ts_bookend_minvfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.bookend_mfinalfunc(internal, anyelement, "any")
+RETURNS anyelement
+AS '@MODULE_PATHNAME@', 'ts_bookend_mfinalfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_msfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_msfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION _timescaledb_internal.hist_minvfunc (state INTERNAL, val DOUBLE PRECISION, MIN DOUBLE PRECISION, MAX DOUBLE PRECISION, nbuckets INTEGER)
+RETURNS INTERNAL
+AS '@MODULE_PATHNAME@', 'ts_hist_minvfunc'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- first, last and histogram are moving aggregates only on fresh installs. Aggregates cannot be
+-- altered and recreating them would drop the views that use them, so updated installs keep the
+-- plain aggregates (window frames that do not start at UNBOUNDED PRECEDING re-aggregate the
+-- frame) until the extension is reinstalled. The moving-aggregate support functions above are
+-- created so that a reinstall from a dump picks them up.
@@ -58,6 +58,24 @@ BEGIN
 END
 $BODY$;
 
+-- Gets the text representation of the given time value (in the internal representation) as the column_type.
+CREATE OR REPLACE FUNCTION _timescaledb_internal.time_to_text(
+    time_value      BIGINT,
+    column_type     REGTYPE
+)
+    RETURNS text LANGUAGE SQL STABLE AS
+$BODY$
+    SELECT CASE column_type
+      WHEN 'TIMESTAMP'::regtype
+        THEN _timescaledb_internal.to_timestamp_without_timezone(time_value)::TEXT
+      WHEN 'TIMESTAMPTZ'::regtype
+        THEN _timescaledb_internal.to_timestamp(time_value)::TEXT
+      WHEN 'DATE'::regtype
+        THEN _timescaledb_internal.to_date(time_value)::TEXT
+      ELSE time_value::TEXT
+    END;
+$BODY$;
+
 CREATE OR REPLACE FUNCTION _timescaledb_internal.interval_to_usec(
        chunk_interval INTERVAL
 )
@@ -130,5 +130,28 @@ CREATE OR REPLACE VIEW timescaledb_information.continuous_aggregate_stats as
     LEFT JOIN _timescaledb_catalog.continuous_aggs_completed_threshold as ct
     ON ( cagg.mat_hypertable_id = ct.materialization_id);
 
+-- the most recent materializations of each continuous aggregate, the number
+-- of them kept is set by timescaledb.materialization_stats_history
+CREATE OR REPLACE VIEW timescaledb_information.materialization_stats as
+  SELECT format('%1$I.%2$I', cagg.user_view_schema, cagg.user_view_name)::regclass as view_name,
+    stats.run_id,
+    stats.start_time,
+    stats.finish_time - stats.start_time as duration,
+    _timescaledb_internal.time_to_text(stats.old_completed_threshold, ht.time_type) AS old_completed_threshold,
+    _timescaledb_internal.time_to_text(stats.new_completed_threshold, ht.time_type) AS new_completed_threshold,
+    _timescaledb_internal.time_to_text(stats.invalidation_threshold, ht.time_type) AS invalidation_threshold,
+    stats.invalidated_ranges,
+    stats.invalidated_buckets,
+    stats.new_buckets,
+    stats.rows_deleted,
+    stats.rows_inserted,
+    stats.delete_duration,
+    stats.insert_duration
+  FROM
+    _timescaledb_internal.continuous_aggs_materialization_stats as stats
+    INNER JOIN _timescaledb_catalog.continuous_agg as cagg
+    ON ( cagg.mat_hypertable_id = stats.materialization_id ),
+    LATERAL ( SELECT _timescaledb_internal.get_time_type(cagg.raw_hypertable_id) as time_type ) ht;
+
 GRANT USAGE ON SCHEMA timescaledb_information TO PUBLIC;
 GRANT SELECT ON ALL TABLES IN SCHEMA timescaledb_information TO PUBLIC;
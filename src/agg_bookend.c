@@ -5,6 +5,7 @@
  */
 #include <postgres.h>
 #include <fmgr.h>
+#include <access/transam.h>
 #include <catalog/namespace.h>
 #include <nodes/value.h>
 #include <utils/lsyscache.h>
@@ -14,6 +15,7 @@
 #include "catalog/pg_type.h"
 #include <utils/lsyscache.h>
 #include <utils/syscache.h>
+#include <utils/fmgroids.h>
 #include <access/htup_details.h>
 
 #include "compat.h"
@@ -24,6 +26,13 @@
  *
  * Usage:
  *	 SELECT first(metric, time), last(metric, time) FROM metric GROUP BY hostname.
+ *
+ * Used as window functions with a moving frame, the aggregates do not recompute the frame for
+ * every row. Rows leave the frame in the order they entered it, so the moving state keeps a
+ * deque of the rows that can still become the first (last) one once the rows before them have
+ * left: every row drops the rows before it that it beats from the back of the deque, so the
+ * cmp elements in the deque are increasing (decreasing) and its front is the result. Rows
+ * with a NULL cmp element are ignored.
  */
 
 TS_FUNCTION_INFO_V1(ts_first_sfunc);
@@ -33,6 +42,10 @@ TS_FUNCTION_INFO_V1(ts_last_combinefunc);
 TS_FUNCTION_INFO_V1(ts_bookend_finalfunc);
 TS_FUNCTION_INFO_V1(ts_bookend_serializefunc);
 TS_FUNCTION_INFO_V1(ts_bookend_deserializefunc);
+TS_FUNCTION_INFO_V1(ts_first_msfunc);
+TS_FUNCTION_INFO_V1(ts_last_msfunc);
+TS_FUNCTION_INFO_V1(ts_bookend_minvfunc);
+TS_FUNCTION_INFO_V1(ts_bookend_mfinalfunc);
 
 /* A  PolyDatum represents a polymorphic datum */
 typedef struct PolyDatum
@@ -66,6 +79,8 @@ polydatum_from_arg(int argno, FunctionCallInfo fcinfo)
 
 /* Serialize type as namespace name string + type name string.
  *  Don't simple send Oid since this state may be needed across pg_dumps.
+ *  The exception are the built-in types, whose Oids are the same in every database: they are
+ *  sent as a zero byte, which no namespace name starts with, followed by the Oid.
  */
 static void
 polydatum_serialize_type(StringInfo buf, Oid type_oid)
@@ -74,6 +89,13 @@ polydatum_serialize_type(StringInfo buf, Oid type_oid)
 	Form_pg_type type_tuple;
 	char *namespace_name;
 
+	if (type_oid < FirstBootstrapObjectId)
+	{
+		pq_sendbyte(buf, 0);
+		pq_sendint(buf, type_oid, 4);
+		return;
+	}
+
 	tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(type_oid));
 	if (!HeapTupleIsValid(tup))
 		elog(ERROR, "cache lookup failed for type %u", type_oid);
@@ -119,10 +141,26 @@ polydatum_serialize(PolyDatum *pd, StringInfo buf, PolyDatumIOState *state, Func
 static Oid
 polydatum_deserialize_type(StringInfo buf)
 {
-	const char *schema_name = pq_getmsgstring(buf);
-	const char *type_name = pq_getmsgstring(buf);
-	Oid schema_oid = LookupExplicitNamespace(schema_name, false);
-	Oid type_oid =
+	const char *schema_name;
+	const char *type_name;
+	Oid schema_oid;
+	Oid type_oid;
+
+	if (buf->cursor < buf->len && buf->data[buf->cursor] == '\0')
+	{
+		pq_getmsgbyte(buf);
+		type_oid = pq_getmsgint(buf, 4);
+		if (type_oid >= FirstBootstrapObjectId)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid built-in type %u in polydata", type_oid)));
+		return type_oid;
+	}
+
+	schema_name = pq_getmsgstring(buf);
+	type_name = pq_getmsgstring(buf);
+	schema_oid = LookupExplicitNamespace(schema_name, false);
+	type_oid =
 		GetSysCacheOid2(TYPENAMENSP, PointerGetDatum(type_name), ObjectIdGetDatum(schema_oid));
 	if (!OidIsValid(type_oid))
 		elog(ERROR, "cache lookup failed for type %s.%s", schema_name, type_name);
@@ -262,10 +300,47 @@ typeinfocache_polydatumcopy(TypeInfoCache *tic, PolyDatum input, PolyDatum *outp
 	}
 }
 
+/*
+ * Replace the datum of the state with a new first or last one. A fixed-width value passed by
+ * reference is copied over the value the state already has, so that replacing it does not
+ * allocate memory.
+ */
+inline static void
+typeinfocache_polydatumreplace(TypeInfoCache *tic, PolyDatum input, PolyDatum *output)
+{
+	if (tic->type_oid != input.type_oid)
+	{
+		tic->type_oid = input.type_oid;
+		get_typlenbyval(tic->type_oid, &tic->typelen, &tic->typebyval);
+	}
+
+	if (!input.is_null && !output->is_null && output->type_oid == input.type_oid &&
+		!tic->typebyval && tic->typelen > 0)
+	{
+		memcpy(DatumGetPointer(output->datum), DatumGetPointer(input.datum), tic->typelen);
+		return;
+	}
+
+	typeinfocache_polydatumcopy(tic, input, output);
+}
+
+/*
+ * Integer and timestamp comparison elements compared with their built-in operators, which is
+ * the common case, are compared directly instead of calling the operator.
+ */
+typedef enum CmpKind
+{
+	CMP_GENERIC,
+	CMP_INT16,
+	CMP_INT32,
+	CMP_INT64,
+} CmpKind;
+
 typedef struct CmpFuncCache
 {
 	Oid cmp_type;
 	char op;
+	CmpKind kind;
 	FmgrInfo proc;
 } CmpFuncCache;
 
@@ -275,6 +350,33 @@ cmpfunccache_init(CmpFuncCache *cache)
 	cache->cmp_type = InvalidOid;
 }
 
+static CmpKind
+cmp_kind_of_proc(Oid cmp_regproc)
+{
+	switch (cmp_regproc)
+	{
+		case F_INT2LT:
+		case F_INT2GT:
+			return CMP_INT16;
+		case F_INT4LT:
+		case F_INT4GT:
+		case F_DATE_LT:
+		case F_DATE_GT:
+			return CMP_INT32;
+		case F_INT8LT:
+		case F_INT8GT:
+		case F_TIMESTAMP_LT:
+		case F_TIMESTAMP_GT:
+		case F_TIMESTAMPTZ_LT:
+		case F_TIMESTAMPTZ_GT:
+			return CMP_INT64;
+		default:
+			return CMP_GENERIC;
+	}
+}
+
+#define CMP_INTEGERS(op, left, right) ((op) == '<' ? (left) < (right) : (left) > (right))
+
 inline static bool
 cmpfunccache_cmp(CmpFuncCache *cache, FunctionCallInfo fcinfo, char *opname, PolyDatum left,
 				 PolyDatum right)
@@ -298,7 +400,23 @@ cmpfunccache_cmp(CmpFuncCache *cache, FunctionCallInfo fcinfo, char *opname, Pol
 				 opname,
 				 left.type_oid);
 		fmgr_info_cxt(cmp_regproc, &cache->proc, fcinfo->flinfo->fn_mcxt);
+		cache->kind = cmp_kind_of_proc(cmp_regproc);
+		cache->cmp_type = left.type_oid;
+		cache->op = opname[0];
 	}
+
+	switch (cache->kind)
+	{
+		case CMP_INT16:
+			return CMP_INTEGERS(cache->op, DatumGetInt16(left.datum), DatumGetInt16(right.datum));
+		case CMP_INT32:
+			return CMP_INTEGERS(cache->op, DatumGetInt32(left.datum), DatumGetInt32(right.datum));
+		case CMP_INT64:
+			return CMP_INTEGERS(cache->op, DatumGetInt64(left.datum), DatumGetInt64(right.datum));
+		case CMP_GENERIC:
+			break;
+	}
+
 	return DatumGetBool(
 		FunctionCall2Coll(&cache->proc, fcinfo->fncollation, left.datum, right.datum));
 }
@@ -334,8 +452,17 @@ bookend_sfunc(MemoryContext aggcontext, InternalCmpAggStore *state, PolyDatum va
 			  char *opname, FunctionCallInfo fcinfo)
 {
 	MemoryContext old_context;
-	TransCache *cache = transcache_get(fcinfo);
+	TransCache *cache;
+
+	/* rows with a NULL cmp element are ignored, as by the moving transition function */
+	if (cmp.is_null)
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
 
+	cache = transcache_get(fcinfo);
 	old_context = MemoryContextSwitchTo(aggcontext);
 
 	if (state == NULL)
@@ -344,15 +471,10 @@ bookend_sfunc(MemoryContext aggcontext, InternalCmpAggStore *state, PolyDatum va
 		typeinfocache_polydatumcopy(&cache->value_type_cache, value, &state->value);
 		typeinfocache_polydatumcopy(&cache->cmp_type_cache, cmp, &state->cmp);
 	}
-	else
+	else if (cmpfunccache_cmp(&cache->cmp_func_cache, fcinfo, opname, cmp, state->cmp))
 	{
-		/* only do comparison if cmp is not NULL */
-		if (!cmp.is_null &&
-			cmpfunccache_cmp(&cache->cmp_func_cache, fcinfo, opname, cmp, state->cmp))
-		{
-			typeinfocache_polydatumcopy(&cache->value_type_cache, value, &state->value);
-			typeinfocache_polydatumcopy(&cache->cmp_type_cache, cmp, &state->cmp);
-		}
+		typeinfocache_polydatumreplace(&cache->value_type_cache, value, &state->value);
+		typeinfocache_polydatumreplace(&cache->cmp_type_cache, cmp, &state->cmp);
 	}
 	MemoryContextSwitchTo(old_context);
 
@@ -405,8 +527,8 @@ bookend_combinefunc(MemoryContext aggcontext, InternalCmpAggStore *state1,
 	else if (cmpfunccache_cmp(&cache->cmp_func_cache, fcinfo, opname, state2->cmp, state1->cmp))
 	{
 		old_context = MemoryContextSwitchTo(aggcontext);
-		typeinfocache_polydatumcopy(&cache->value_type_cache, state2->value, &state1->value);
-		typeinfocache_polydatumcopy(&cache->cmp_type_cache, state2->cmp, &state1->cmp);
+		typeinfocache_polydatumreplace(&cache->value_type_cache, state2->value, &state1->value);
+		typeinfocache_polydatumreplace(&cache->cmp_type_cache, state2->cmp, &state1->cmp);
 		MemoryContextSwitchTo(old_context);
 	}
 
@@ -487,6 +609,215 @@ ts_last_combinefunc(PG_FUNCTION_ARGS)
 	return bookend_combinefunc(aggcontext, state1, state2, ">", fcinfo);
 }
 
+/* A row in the deque of the moving state, numbered in the order the rows entered the frame */
+typedef struct BookendWindowRow
+{
+	int64 rowno;
+	PolyDatum value;
+	PolyDatum cmp;
+} BookendWindowRow;
+
+/* Moving state for bookend aggregates, with a deque of rows kept in a ring buffer */
+typedef struct BookendWindowStore
+{
+	int64 nadded;
+	int64 nremoved;
+	int32 head;
+	int32 nrows;
+	int32 maxrows;
+	BookendWindowRow *rows;
+	/* whether the values and cmp elements are passed by value, so need not be freed */
+	bool value_typebyval;
+	bool cmp_typebyval;
+} BookendWindowStore;
+
+#define BOOKEND_WINDOW_INITIAL_ROWS 16
+#define BOOKEND_WINDOW_ROW(store, i) (&(store)->rows[((store)->head + (i)) % (store)->maxrows])
+
+static void
+bookend_window_row_free(BookendWindowStore *store, BookendWindowRow *row)
+{
+	if (!row->value.is_null && !store->value_typebyval)
+		pfree(DatumGetPointer(row->value.datum));
+	if (!store->cmp_typebyval)
+		pfree(DatumGetPointer(row->cmp.datum));
+}
+
+static void
+bookend_window_grow(BookendWindowStore *store, MemoryContext aggcontext)
+{
+	BookendWindowRow *rows =
+		MemoryContextAlloc(aggcontext, 2 * store->maxrows * sizeof(BookendWindowRow));
+	int32 i;
+
+	for (i = 0; i < store->nrows; i++)
+		rows[i] = *BOOKEND_WINDOW_ROW(store, i);
+
+	pfree(store->rows);
+	store->rows = rows;
+	store->head = 0;
+	store->maxrows *= 2;
+}
+
+/*
+ * bookend_msfunc - internal function called by ts_first_msfunc and ts_last_msfunc
+ */
+static inline Datum
+bookend_msfunc(MemoryContext aggcontext, BookendWindowStore *store, PolyDatum value,
+			   PolyDatum cmp, char *opname, FunctionCallInfo fcinfo)
+{
+	MemoryContext old_context;
+	TransCache *cache = transcache_get(fcinfo);
+	BookendWindowRow *row;
+
+	old_context = MemoryContextSwitchTo(aggcontext);
+
+	if (store == NULL)
+	{
+		store = (BookendWindowStore *) palloc0(sizeof(BookendWindowStore));
+		store->maxrows = BOOKEND_WINDOW_INITIAL_ROWS;
+		store->rows = palloc(store->maxrows * sizeof(BookendWindowRow));
+	}
+
+	store->nadded++;
+
+	if (cmp.is_null)
+	{
+		MemoryContextSwitchTo(old_context);
+		PG_RETURN_POINTER(store);
+	}
+
+	/* the rows at the back that the new row beats can never become the result */
+	while (store->nrows > 0)
+	{
+		row = BOOKEND_WINDOW_ROW(store, store->nrows - 1);
+
+		if (!cmpfunccache_cmp(&cache->cmp_func_cache, fcinfo, opname, cmp, row->cmp))
+			break;
+
+		bookend_window_row_free(store, row);
+		store->nrows--;
+	}
+
+	if (store->nrows == store->maxrows)
+		bookend_window_grow(store, aggcontext);
+
+	row = BOOKEND_WINDOW_ROW(store, store->nrows);
+	row->rowno = store->nadded - 1;
+	typeinfocache_polydatumcopy(&cache->value_type_cache, value, &row->value);
+	typeinfocache_polydatumcopy(&cache->cmp_type_cache, cmp, &row->cmp);
+	store->value_typebyval = cache->value_type_cache.typebyval;
+	store->cmp_typebyval = cache->cmp_type_cache.typebyval;
+	store->nrows++;
+
+	MemoryContextSwitchTo(old_context);
+
+	PG_RETURN_POINTER(store);
+}
+
+/* first moving transition function (internal internal_state, anyelement value, "any" cmp) */
+Datum
+ts_first_msfunc(PG_FUNCTION_ARGS)
+{
+	BookendWindowStore *store =
+		PG_ARGISNULL(0) ? NULL : (BookendWindowStore *) PG_GETARG_POINTER(0);
+	PolyDatum value = polydatum_from_arg(1, fcinfo);
+	PolyDatum cmp = polydatum_from_arg(2, fcinfo);
+	MemoryContext aggcontext;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_first_msfunc called in non-aggregate context");
+	}
+
+	return bookend_msfunc(aggcontext, store, value, cmp, "<", fcinfo);
+}
+
+/* last moving transition function (internal internal_state, anyelement value, "any" cmp) */
+Datum
+ts_last_msfunc(PG_FUNCTION_ARGS)
+{
+	BookendWindowStore *store =
+		PG_ARGISNULL(0) ? NULL : (BookendWindowStore *) PG_GETARG_POINTER(0);
+	PolyDatum value = polydatum_from_arg(1, fcinfo);
+	PolyDatum cmp = polydatum_from_arg(2, fcinfo);
+	MemoryContext aggcontext;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_last_msfunc called in non-aggregate context");
+	}
+
+	return bookend_msfunc(aggcontext, store, value, cmp, ">", fcinfo);
+}
+
+/*
+ * bookend inverse transition function (internal internal_state, anyelement value, "any" cmp)
+ *
+ * The row leaving the frame is the oldest one, so it is only in the deque if it is at the front.
+ */
+Datum
+ts_bookend_minvfunc(PG_FUNCTION_ARGS)
+{
+	BookendWindowStore *store =
+		PG_ARGISNULL(0) ? NULL : (BookendWindowStore *) PG_GETARG_POINTER(0);
+	BookendWindowRow *row;
+
+	if (!AggCheckCallContext(fcinfo, NULL))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_bookend_minvfunc called in non-aggregate context");
+	}
+
+	/* the window restarts the aggregate if there is no state to remove the row from */
+	if (store == NULL)
+		PG_RETURN_NULL();
+
+	store->nremoved++;
+
+	if (store->nrows == 0)
+		PG_RETURN_POINTER(store);
+
+	row = BOOKEND_WINDOW_ROW(store, 0);
+
+	if (row->rowno == store->nremoved - 1)
+	{
+		bookend_window_row_free(store, row);
+		store->head = (store->head + 1) % store->maxrows;
+		store->nrows--;
+	}
+
+	PG_RETURN_POINTER(store);
+}
+
+/* ts_bookend_mfinalfunc(internal, anyelement, "any") => anyelement */
+Datum
+ts_bookend_mfinalfunc(PG_FUNCTION_ARGS)
+{
+	BookendWindowStore *store;
+	BookendWindowRow *row;
+
+	if (!AggCheckCallContext(fcinfo, NULL))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_bookend_mfinalfunc called in non-aggregate context");
+	}
+
+	store = PG_ARGISNULL(0) ? NULL : (BookendWindowStore *) PG_GETARG_POINTER(0);
+
+	if (store == NULL || store->nrows == 0)
+		PG_RETURN_NULL();
+
+	row = BOOKEND_WINDOW_ROW(store, 0);
+
+	if (row->value.is_null)
+		PG_RETURN_NULL();
+
+	PG_RETURN_DATUM(row->value.datum);
+}
+
 /* ts_bookend_serializefunc(internal) => bytea */
 Datum
 ts_bookend_serializefunc(PG_FUNCTION_ARGS)
@@ -10,6 +10,7 @@
 #include <pgstat.h>
 #include <utils/memutils.h>
 #include <miscadmin.h>
+#include <storage/dsm.h>
 #include <storage/ipc.h>
 #include <tcop/tcopprot.h>
 
@@ -40,7 +41,7 @@ static const char *job_type_names[_MAX_JOB_TYPE] = {
 static unknown_job_type_hook_type unknown_job_type_hook = NULL;
 static char *job_entrypoint_function_name = "ts_bgw_job_entrypoint";
 
-BackgroundWorkerHandle *
+TSDLLEXPORT BackgroundWorkerHandle *
 ts_bgw_start_worker(const char *function, const char *name, const char *extra)
 {
 	BackgroundWorker worker = {
@@ -469,6 +470,38 @@ ts_bgw_job_entrypoint(PG_FUNCTION_ARGS)
 	PG_RETURN_VOID();
 }
 
+TS_FUNCTION_INFO_V1(ts_bgw_materialization_worker_entrypoint);
+
+/*
+ * Entrypoint of the workers materializing a continuous aggregate in parallel. The
+ * extra argument holds the handle of the dynamic shared memory segment describing
+ * the work, and the user to run it as.
+ */
+extern Datum
+ts_bgw_materialization_worker_entrypoint(PG_FUNCTION_ARGS)
+{
+	Oid db_oid = DatumGetObjectId(MyBgworkerEntry->bgw_main_arg);
+	dsm_handle handle;
+	Oid user_oid;
+
+	BackgroundWorkerBlockSignals();
+	pqsignal(SIGTERM, handle_sigterm);
+	BackgroundWorkerUnblockSignals();
+
+	if (sscanf(MyBgworkerEntry->bgw_extra, "%u %u", &handle, &user_oid) != 2)
+		elog(ERROR,
+			 "invalid arguments for materialization worker: \"%s\"",
+			 MyBgworkerEntry->bgw_extra);
+
+	BackgroundWorkerInitializeConnectionByOidCompat(db_oid, user_oid);
+
+	ts_license_enable_module_loading();
+
+	ts_cm_functions->continuous_agg_materialize_worker(handle);
+
+	PG_RETURN_VOID();
+}
+
 void
 ts_bgw_job_set_unknown_job_type_hook(unknown_job_type_hook_type hook)
 {
@@ -31,8 +31,9 @@ typedef struct BgwJob
 typedef bool job_main_func(void);
 typedef bool (*unknown_job_type_hook_type)(BgwJob *job);
 
-extern BackgroundWorkerHandle *ts_bgw_start_worker(const char *function, const char *name,
-												   const char *extra);
+extern TSDLLEXPORT BackgroundWorkerHandle *ts_bgw_start_worker(const char *function,
+															   const char *name,
+															   const char *extra);
 
 extern BackgroundWorkerHandle *ts_bgw_job_start(BgwJob *job);
 
@@ -53,6 +54,7 @@ extern TSDLLEXPORT void ts_bgw_job_update_by_id(int32 job_id, BgwJob *updated_jo
 extern bool ts_bgw_job_execute(BgwJob *job);
 
 extern TSDLLEXPORT Datum ts_bgw_job_entrypoint(PG_FUNCTION_ARGS);
+extern TSDLLEXPORT Datum ts_bgw_materialization_worker_entrypoint(PG_FUNCTION_ARGS);
 extern void ts_bgw_job_set_unknown_job_type_hook(unknown_job_type_hook_type hook);
 extern void ts_bgw_job_set_job_entrypoint_function_name(char *func_name);
 extern bool ts_bgw_job_run_and_set_next_start(BgwJob *job, job_main_func func, int64 initial_runs,
@@ -13,7 +13,7 @@
 
 #define MIN_LOADER_API_VERSION 2
 
-extern bool
+extern TSDLLEXPORT bool
 ts_bgw_worker_reserve(void)
 {
 	PGFunction reserve = load_external_function(EXTENSION_SO, "ts_bgw_worker_reserve", true, NULL);
@@ -22,7 +22,7 @@ ts_bgw_worker_reserve(void)
 		DirectFunctionCall1(reserve, BoolGetDatum(false))); /* no function call zero */
 }
 
-extern void
+extern TSDLLEXPORT void
 ts_bgw_worker_release(void)
 {
 	PGFunction release = load_external_function(EXTENSION_SO, "ts_bgw_worker_release", true, NULL);
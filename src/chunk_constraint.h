@@ -41,8 +41,9 @@ extern ChunkConstraints *ts_chunk_constraint_scan_by_chunk_id(int32 chunk_id, Si
 extern ChunkConstraints *ts_chunk_constraints_copy(ChunkConstraints *constraints);
 extern int ts_chunk_constraint_scan_by_dimension_slice(DimensionSlice *slice, ChunkScanCtx *ctx,
 													   MemoryContext mctx);
-extern int ts_chunk_constraint_scan_by_dimension_slice_to_list(DimensionSlice *slice, List **list,
-															   MemoryContext mctx);
+extern TSDLLEXPORT int ts_chunk_constraint_scan_by_dimension_slice_to_list(DimensionSlice *slice,
+																		   List **list,
+																		   MemoryContext mctx);
 extern int ts_chunk_constraint_scan_by_dimension_slice_id(int32 dimension_slice_id,
 														  ChunkConstraints *ccs,
 														  MemoryContext mctx);
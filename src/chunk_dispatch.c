@@ -83,6 +83,18 @@ ts_chunk_dispatch_get_chunk_insert_state(ChunkDispatch *dispatch, Point *point,
 		ts_chunk_insert_state_switch(cis);
 
 	Assert(cis != NULL);
+
+	/* record the inserted time value for the continuous aggregates on the hypertable */
+	if (cis->cagg_inval_hypertable_id != INVALID_HYPERTABLE_ID)
+	{
+		int64 time_value = point->coordinates[cis->cagg_inval_time_coordinate];
+
+		if (time_value < cis->cagg_inval_lowest_value)
+			cis->cagg_inval_lowest_value = time_value;
+		if (time_value > cis->cagg_inval_greatest_value)
+			cis->cagg_inval_greatest_value = time_value;
+	}
+
 	dispatch->prev_cis = cis;
 	dispatch->prev_cis_oid = cis->rel->rd_id;
 	return cis;
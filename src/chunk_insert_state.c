@@ -21,6 +21,7 @@
 #include <rewrite/rewriteManip.h>
 #include <nodes/makefuncs.h>
 #include <catalog/pg_type.h>
+#include <commands/trigger.h>
 
 #include "errors.h"
 #include "chunk_insert_state.h"
@@ -28,6 +29,9 @@
 #include "chunk_dispatch_state.h"
 #include "compat.h"
 #include "chunk_index.h"
+#include "continuous_agg.h"
+#include "cross_module_fn.h"
+#include "dimension.h"
 
 /*
  * Create a new RangeTblEntry for the chunk in the executor's range table and
@@ -486,6 +490,81 @@ chunk_insert_state_set_arbiter_indexes(ChunkInsertState *state, ChunkDispatch *d
 #endif
 }
 
+/*
+ * Continuous aggregates use a per-row AFTER trigger on the chunks to record the
+ * range of modified time values. Inserts through the hypertable already
+ * compute the time value of every tuple to route it to its chunk, so we record
+ * the inserted range here instead, and remove the trigger from the chunk's
+ * ResultRelInfo to avoid queuing an after-trigger event for every row.
+ *
+ * We keep the trigger if the inserted range could differ from the range we
+ * see: if a BEFORE ROW trigger may change the tuple after it was routed, or if
+ * ON CONFLICT DO UPDATE may update an existing tuple.
+ */
+static void
+chunk_insert_state_set_cagg_invalidation(ChunkInsertState *state, ChunkDispatch *dispatch)
+{
+	ResultRelInfo *resrelinfo = state->result_relation_info;
+	TriggerDesc *trigdesc = resrelinfo->ri_TrigDesc;
+	Dimension *time_dim;
+	int i;
+	int cagg_trigger = -1;
+
+	state->cagg_inval_hypertable_id = INVALID_HYPERTABLE_ID;
+
+	if (trigdesc == NULL || trigdesc->trig_insert_before_row ||
+		dispatch->on_conflict == ONCONFLICT_UPDATE)
+		return;
+
+	for (i = 0; i < trigdesc->numtriggers; i++)
+	{
+		Trigger *trigger = &trigdesc->triggers[i];
+
+		if (strcmp(trigger->tgname, CAGGINVAL_TRIGGER_NAME) == 0 &&
+			TRIGGER_FOR_ROW(trigger->tgtype) && TRIGGER_FOR_AFTER(trigger->tgtype) &&
+			trigger->tgnargs == 1)
+		{
+			cagg_trigger = i;
+			break;
+		}
+	}
+
+	if (cagg_trigger < 0)
+		return;
+
+	time_dim = hyperspace_get_open_dimension(dispatch->hypertable->space, 0);
+	state->cagg_inval_hypertable_id = atoi(trigdesc->triggers[cagg_trigger].tgargs[0]);
+	state->cagg_inval_time_coordinate = time_dim - dispatch->hypertable->space->dimensions;
+	state->cagg_inval_lowest_value = PG_INT64_MAX;
+	state->cagg_inval_greatest_value = PG_INT64_MIN;
+
+	/* The trigger descriptor belongs to the relcache entry, so modify a copy. The trigger
+	 * function caches of the ResultRelInfo are still unused, so shifting the triggers does not
+	 * affect them. */
+	trigdesc = CopyTriggerDesc(trigdesc);
+	memmove(&trigdesc->triggers[cagg_trigger],
+			&trigdesc->triggers[cagg_trigger + 1],
+			sizeof(Trigger) * (trigdesc->numtriggers - cagg_trigger - 1));
+	trigdesc->numtriggers--;
+
+	trigdesc->trig_insert_after_row = false;
+	trigdesc->trig_update_after_row = false;
+	trigdesc->trig_delete_after_row = false;
+	for (i = 0; i < trigdesc->numtriggers; i++)
+	{
+		int16 tgtype = trigdesc->triggers[i].tgtype;
+
+		if (!TRIGGER_FOR_ROW(tgtype) || !TRIGGER_FOR_AFTER(tgtype))
+			continue;
+
+		trigdesc->trig_insert_after_row |= TRIGGER_FOR_INSERT(tgtype);
+		trigdesc->trig_update_after_row |= TRIGGER_FOR_UPDATE(tgtype);
+		trigdesc->trig_delete_after_row |= TRIGGER_FOR_DELETE(tgtype);
+	}
+
+	resrelinfo->ri_TrigDesc = trigdesc;
+}
+
 /*
  * Create new insert chunk state.
  *
@@ -545,6 +624,8 @@ ts_chunk_insert_state_create(Chunk *chunk, ChunkDispatch *dispatch)
 			elog(ERROR, "insert trigger on chunk table not supported");
 	}
 
+	chunk_insert_state_set_cagg_invalidation(state, dispatch);
+
 	/* Set the chunk's arbiter indexes for ON CONFLICT statements */
 	if (dispatch->on_conflict != ONCONFLICT_NONE)
 		chunk_insert_state_set_arbiter_indexes(state, dispatch, rel);
@@ -609,6 +690,12 @@ ts_chunk_insert_state_destroy(ChunkInsertState *state)
 	if (state == NULL)
 		return;
 
+	if (state->cagg_inval_hypertable_id != INVALID_HYPERTABLE_ID &&
+		state->cagg_inval_lowest_value <= state->cagg_inval_greatest_value)
+		ts_cm_functions->continuous_agg_invalidate(state->cagg_inval_hypertable_id,
+												   state->cagg_inval_lowest_value,
+												   state->cagg_inval_greatest_value);
+
 	ExecCloseIndices(state->result_relation_info);
 	heap_close(state->rel, NoLock);
 
@@ -26,6 +26,17 @@ typedef struct ChunkInsertState
 	MemoryContext mctx;
 
 	EState *estate;
+
+	/*
+	 * The range of time values inserted into the chunk, recorded as an
+	 * invalidation of the continuous aggregates on the hypertable when the
+	 * insert state is destroyed. Only tracked when
+	 * cagg_inval_hypertable_id is valid.
+	 */
+	int32 cagg_inval_hypertable_id;
+	int cagg_inval_time_coordinate;
+	int64 cagg_inval_lowest_value;
+	int64 cagg_inval_greatest_value;
 } ChunkInsertState;
 
 typedef struct ChunkDispatch ChunkDispatch;
@@ -4,6 +4,7 @@
  * LICENSE-APACHE for a copy of the license.
  */
 #include <postgres.h>
+#include <access/parallel.h>
 #include <catalog/pg_cast.h>
 #include <catalog/pg_class.h>
 #include <catalog/pg_namespace.h>
@@ -19,14 +20,49 @@
 #include <optimizer/plancat.h>
 #include <optimizer/prep.h>
 #include <parser/parsetree.h>
+#include <storage/spin.h>
 #include <utils/lsyscache.h>
 #include <utils/memutils.h>
 #include <utils/syscache.h>
 
 #include "constraint_aware_append.h"
 #include "hypertable.h"
+#include "guc.h"
 #include "compat.h"
 
+#define INVALID_SUBPLAN_INDEX -1
+
+/*
+ * Shared state for parallel-aware execution.
+ *
+ * The leader performs chunk exclusion and publishes the surviving chunks so
+ * that workers neither repeat the exclusion nor risk ending up with a
+ * different set of chunks. Participants grab chunks from the shared list in
+ * a round-robin fashion and move on to the next unfinished chunk whenever
+ * they run out of tuples. Partial chunk plans (e.g., Parallel Seq Scan) can be
+ * joined by several participants, which then share the chunk's block ranges,
+ * while non-partial plans are handed to exactly one participant.
+ *
+ * The flexible array holds, in order, the position of every surviving chunk
+ * in the original Append, a finished and a started flag per surviving chunk
+ * and the number of chunks each participant started scanning (leader
+ * first). A chunk counts only for the participant that started it, even if
+ * others join it later, so that the counts add up to the surviving chunks.
+ */
+typedef struct ParallelChunkAppendShared
+{
+	slock_t mutex;
+	int next_plan;
+	int num_subplans;
+	int num_participants;
+	int data[FLEXIBLE_ARRAY_MEMBER];
+} ParallelChunkAppendShared;
+
+#define PCA_SUBPLAN_INDEX(pstate) ((pstate)->data)
+#define PCA_FINISHED(pstate) ((pstate)->data + (pstate)->num_subplans)
+#define PCA_STARTED(pstate) ((pstate)->data + 2 * (pstate)->num_subplans)
+#define PCA_PARTICIPANT_CHUNKS(pstate) ((pstate)->data + 3 * (pstate)->num_subplans)
+
 /*
  * Exclude child relations (chunks) at execution time based on constraints.
  *
@@ -211,6 +247,45 @@ constify_restrictinfos(PlannerInfo *root, List *restrictinfos)
 	return restrictinfos;
 }
 
+static List *
+get_append_children(Plan *plan)
+{
+	switch (nodeTag(plan))
+	{
+		case T_Append:
+			return castNode(Append, plan)->appendplans;
+		case T_MergeAppend:
+			return castNode(MergeAppend, plan)->mergeplans;
+		default:
+			elog(ERROR, "invalid child of constraint-aware append: %u", nodeTag(plan));
+			pg_unreachable();
+	}
+}
+
+/*
+ * Initialize the chunk plans directly, without the Append node on top, for
+ * parallel-aware execution.
+ */
+static void
+ca_append_init_subplans(ConstraintAwareAppendState *state, List *plans, EState *estate,
+						int eflags)
+{
+	ListCell *lc;
+	int i = 0;
+
+	state->subplanstates = palloc(sizeof(PlanState *) * list_length(plans));
+
+	foreach (lc, plans)
+	{
+		state->subplanstates[i] = ExecInitNode(lfirst(lc), estate, eflags);
+		state->csstate.custom_ps = lappend(state->csstate.custom_ps, state->subplanstates[i]);
+		i++;
+	}
+
+	state->current = INVALID_SUBPLAN_INDEX;
+	state->next_plan = 0;
+}
+
 /*
  * Initialize the scan state and prune any subplans from the Append node below
  * us in the plan tree. Pruning happens by evaluating the subplan's table
@@ -221,11 +296,13 @@ ca_append_begin(CustomScanState *node, EState *estate, int eflags)
 {
 	ConstraintAwareAppendState *state = (ConstraintAwareAppendState *) node;
 	CustomScan *cscan = (CustomScan *) node->ss.ps.plan;
-	Plan *subplan = copyObject(state->subplan);
+	Plan *subplan;
 	List *chunk_ri_clauses = lsecond(cscan->custom_private);
 	List **appendplans, *old_appendplans;
+	List *subplan_index = NIL;
 	ListCell *lc_plan;
 	ListCell *lc_clauses;
+	int plan_index = 0;
 
 	/*
 	 * create skeleton plannerinfo to reuse some PostgreSQL planner functions
@@ -241,6 +318,18 @@ ca_append_begin(CustomScanState *node, EState *estate, int eflags)
 		.parse = &parse,
 	};
 
+	state->first_partial_plan = linitial_int(lthird(cscan->custom_private));
+	state->eflags = eflags;
+
+	/*
+	 * Parallel workers get the chunks left after exclusion from the leader
+	 * (see ca_append_initialize_worker), so there is nothing to do here.
+	 */
+	if (node->ss.ps.plan->parallel_aware && IsParallelWorker())
+		return;
+
+	subplan = copyObject(state->subplan);
+
 	switch (nodeTag(subplan))
 	{
 		case T_Append:
@@ -321,23 +410,141 @@ ca_append_begin(CustomScanState *node, EState *estate, int eflags)
 				}
 				restrictinfos = constify_restrictinfos(&root, restrictinfos);
 
-				if (can_exclude_chunk(&root, (Scan *) plan, estate, scanrelid, restrictinfos))
-					continue;
-
-				*appendplans = lappend(*appendplans, plan);
+				if (!can_exclude_chunk(&root, (Scan *) plan, estate, scanrelid, restrictinfos))
+				{
+					*appendplans = lappend(*appendplans, plan);
+					subplan_index = lappend_int(subplan_index, plan_index);
+				}
 				break;
 			}
 			default:
 				elog(ERROR, "invalid child of constraint-aware append: %u", nodeTag(plan));
 				break;
 		}
+		plan_index++;
 	}
 
 	state->num_append_subplans = list_length(*appendplans);
-	if (state->num_append_subplans > 0)
+
+	if (state->num_append_subplans == 0)
+		return;
+
+	if (node->ss.ps.plan->parallel_aware)
+	{
+		ListCell *lc;
+		int i = 0;
+
+		state->subplan_index = palloc(sizeof(int) * state->num_append_subplans);
+		foreach (lc, subplan_index)
+			state->subplan_index[i++] = lfirst_int(lc);
+
+		ca_append_init_subplans(state, *appendplans, estate, eflags);
+	}
+	else
 		node->custom_ps = list_make1(ExecInitNode(subplan, estate, eflags));
 }
 
+static inline bool
+ca_append_subplan_is_partial(ConstraintAwareAppendState *state, int subplan)
+{
+	return state->subplan_index[subplan] >= state->first_partial_plan;
+}
+
+/*
+ * Pick the next chunk to scan. When running in parallel, the current chunk
+ * is marked as finished and the next unfinished chunk is taken from the
+ * shared state, starting at the chunk following the one most recently handed
+ * out so that participants spread out over the chunks.
+ */
+static bool
+ca_append_choose_next_subplan(ConstraintAwareAppendState *state)
+{
+	ParallelChunkAppendShared *pstate = state->pstate;
+	int num_subplans = state->num_append_subplans;
+	int next = INVALID_SUBPLAN_INDEX;
+	int *finished;
+	int *started;
+	int participant;
+	int i;
+
+	if (pstate == NULL)
+	{
+		if (state->next_plan < num_subplans)
+			next = state->next_plan++;
+
+		state->current = next;
+		return next != INVALID_SUBPLAN_INDEX;
+	}
+
+	finished = PCA_FINISHED(pstate);
+	started = PCA_STARTED(pstate);
+	participant = ParallelWorkerNumber + 1;
+
+	SpinLockAcquire(&pstate->mutex);
+
+	/*
+	 * Running out of tuples in a partial plan means all of its blocks have
+	 * been handed out, so nobody else needs to join it anymore.
+	 */
+	if (state->current != INVALID_SUBPLAN_INDEX)
+		finished[state->current] = true;
+
+	for (i = 0; i < num_subplans; i++)
+	{
+		int candidate = (pstate->next_plan + i) % num_subplans;
+
+		if (!finished[candidate])
+		{
+			next = candidate;
+			break;
+		}
+	}
+
+	if (next != INVALID_SUBPLAN_INDEX)
+	{
+		/* non-partial plans must only be executed by a single participant */
+		if (!ca_append_subplan_is_partial(state, next))
+			finished[next] = true;
+
+		pstate->next_plan = (next + 1) % num_subplans;
+
+		if (!started[next])
+		{
+			started[next] = true;
+
+			if (participant < pstate->num_participants)
+				PCA_PARTICIPANT_CHUNKS(pstate)[participant]++;
+		}
+	}
+
+	SpinLockRelease(&pstate->mutex);
+
+	state->current = next;
+	return next != INVALID_SUBPLAN_INDEX;
+}
+
+static TupleTableSlot *
+ca_append_next_subslot(ConstraintAwareAppendState *state)
+{
+	TupleTableSlot *subslot;
+
+	if (!state->csstate.ss.ps.plan->parallel_aware)
+		return ExecProcNode(linitial(state->csstate.custom_ps));
+
+	while (state->current != INVALID_SUBPLAN_INDEX || ca_append_choose_next_subplan(state))
+	{
+		subslot = ExecProcNode(state->subplanstates[state->current]);
+
+		if (!TupIsNull(subslot))
+			return subslot;
+
+		if (!ca_append_choose_next_subplan(state))
+			break;
+	}
+
+	return NULL;
+}
+
 static TupleTableSlot *
 ca_append_exec(CustomScanState *node)
 {
@@ -372,7 +579,7 @@ ca_append_exec(CustomScanState *node)
 
 	while (true)
 	{
-		subslot = ExecProcNode(linitial(node->custom_ps));
+		subslot = ca_append_next_subslot(state);
 
 		if (TupIsNull(subslot))
 			return NULL;
@@ -399,49 +606,175 @@ ca_append_exec(CustomScanState *node)
 static void
 ca_append_end(CustomScanState *node)
 {
-	if (node->custom_ps != NIL)
-	{
-		ExecEndNode(linitial(node->custom_ps));
-	}
+	ListCell *lc;
+
+	foreach (lc, node->custom_ps)
+		ExecEndNode(lfirst(lc));
 }
 
 static void
 ca_append_rescan(CustomScanState *node)
 {
+	ConstraintAwareAppendState *state = (ConstraintAwareAppendState *) node;
+	ListCell *lc;
+
 #if PG96
 	node->ss.ps.ps_TupFromTlist = false;
 #endif
-	if (node->custom_ps != NIL)
-	{
-		ExecReScan(linitial(node->custom_ps));
-	}
+	foreach (lc, node->custom_ps)
+		ExecReScan(lfirst(lc));
+
+	state->current = INVALID_SUBPLAN_INDEX;
+	state->next_plan = 0;
+}
+
+static Size
+ca_append_estimate_dsm(CustomScanState *node, ParallelContext *pcxt)
+{
+	ConstraintAwareAppendState *state = (ConstraintAwareAppendState *) node;
+
+	return add_size(offsetof(ParallelChunkAppendShared, data),
+					mul_size(sizeof(int), 3 * state->num_append_subplans + pcxt->nworkers + 1));
 }
 
 static void
-ca_append_explain(CustomScanState *node, List *ancestors, ExplainState *es)
+ca_append_reset_dsm(ParallelChunkAppendShared *pstate)
+{
+	pstate->next_plan = 0;
+	memset(PCA_FINISHED(pstate), 0, sizeof(int) * pstate->num_subplans);
+	memset(PCA_STARTED(pstate), 0, sizeof(int) * pstate->num_subplans);
+	memset(PCA_PARTICIPANT_CHUNKS(pstate), 0, sizeof(int) * pstate->num_participants);
+}
+
+static void
+ca_append_initialize_dsm(CustomScanState *node, ParallelContext *pcxt, void *coordinate)
 {
-	CustomScan *cscan = (CustomScan *) node->ss.ps.plan;
 	ConstraintAwareAppendState *state = (ConstraintAwareAppendState *) node;
-	Oid relid = linitial_oid(linitial(cscan->custom_private));
+	ParallelChunkAppendShared *pstate = coordinate;
 
-	ExplainPropertyText("Hypertable", get_rel_name(relid), es);
+	SpinLockInit(&pstate->mutex);
+	pstate->num_subplans = state->num_append_subplans;
+	pstate->num_participants = pcxt->nworkers + 1;
+
+	if (state->num_append_subplans > 0)
+		memcpy(PCA_SUBPLAN_INDEX(pstate),
+			   state->subplan_index,
+			   sizeof(int) * state->num_append_subplans);
+
+	ca_append_reset_dsm(pstate);
+	state->pstate = pstate;
+}
+
+#if !PG96
+static void
+ca_append_reinitialize_dsm(CustomScanState *node, ParallelContext *pcxt, void *coordinate)
+{
+	ca_append_reset_dsm((ParallelChunkAppendShared *) coordinate);
+}
+#endif
+
+/*
+ * Workers skip chunk exclusion and initialize the chunk plans the leader
+ * left in shared memory instead.
+ */
+static void
+ca_append_initialize_worker(CustomScanState *node, shm_toc *toc, void *coordinate)
+{
+	ConstraintAwareAppendState *state = (ConstraintAwareAppendState *) node;
+	ParallelChunkAppendShared *pstate = coordinate;
+	List *children;
+	List *plans = NIL;
+	int i;
+
+	state->pstate = pstate;
+	state->num_append_subplans = pstate->num_subplans;
+	state->subplan_index = PCA_SUBPLAN_INDEX(pstate);
+
+	if (state->num_append_subplans == 0)
+		return;
+
+	children = get_append_children(state->subplan);
+
+	for (i = 0; i < pstate->num_subplans; i++)
+		plans = lappend(plans,
+						get_plans_for_exclusion(list_nth(children, state->subplan_index[i])));
+
+	ca_append_init_subplans(state, plans, node->ss.ps.state, state->eflags);
+}
+
+#if !PG96
+/*
+ * Copy the per-participant chunk counts out of shared memory before it goes
+ * away so they can be shown by EXPLAIN ANALYZE.
+ */
+static void
+ca_append_shutdown(CustomScanState *node)
+{
+	ConstraintAwareAppendState *state = (ConstraintAwareAppendState *) node;
+
+	if (state->pstate == NULL || IsParallelWorker())
+		return;
+
+	if (state->participant_chunks == NULL)
+		state->participant_chunks = palloc(sizeof(int) * state->pstate->num_participants);
+
+	state->num_participants = state->pstate->num_participants;
+	memcpy(state->participant_chunks,
+		   PCA_PARTICIPANT_CHUNKS(state->pstate),
+		   sizeof(int) * state->num_participants);
+	state->pstate = NULL;
+}
+#endif
+
+static void
+explain_property_integer(const char *qlabel, int64 value, ExplainState *es)
+{
 #if PG96 || PG10
-	ExplainPropertyInteger("Chunks left after exclusion", state->num_append_subplans, es);
+	ExplainPropertyLong(qlabel, value, es);
 #else
 
 	/*
 	 * PG 11 adds a uint field for certain cases. (See:
 	 * https://github.com/postgres/postgres/commit/7a50bb690b4837d29e715293c156cff2fc72885c).
 	 */
-	ExplainPropertyInteger("Chunks left after exclusion", NULL, state->num_append_subplans, es);
+	ExplainPropertyInteger(qlabel, NULL, value, es);
 #endif
 }
 
+static void
+ca_append_explain(CustomScanState *node, List *ancestors, ExplainState *es)
+{
+	CustomScan *cscan = (CustomScan *) node->ss.ps.plan;
+	ConstraintAwareAppendState *state = (ConstraintAwareAppendState *) node;
+	Oid relid = linitial_oid(linitial(cscan->custom_private));
+	int i;
+
+	ExplainPropertyText("Hypertable", get_rel_name(relid), es);
+	explain_property_integer("Chunks left after exclusion", state->num_append_subplans, es);
+
+	if (!es->analyze || state->participant_chunks == NULL)
+		return;
+
+	explain_property_integer("Chunks scanned by leader", state->participant_chunks[0], es);
+
+	for (i = 1; i < state->num_participants; i++)
+		explain_property_integer(psprintf("Chunks scanned by worker %d", i - 1),
+								 state->participant_chunks[i],
+								 es);
+}
+
 static CustomExecMethods constraint_aware_append_state_methods = {
 	.BeginCustomScan = ca_append_begin,
 	.ExecCustomScan = ca_append_exec,
 	.EndCustomScan = ca_append_end,
 	.ReScanCustomScan = ca_append_rescan,
+	.EstimateDSMCustomScan = ca_append_estimate_dsm,
+	.InitializeDSMCustomScan = ca_append_initialize_dsm,
+#if !PG96
+	.ReInitializeDSMCustomScan = ca_append_reinitialize_dsm,
+	.ShutdownCustomScan = ca_append_shutdown,
+#endif
+	.InitializeWorkerCustomScan = ca_append_initialize_worker,
 	.ExplainCustomScan = ca_append_explain,
 };
 
@@ -455,6 +788,7 @@ constraint_aware_append_state_create(CustomScan *cscan)
 												   T_CustomScanState);
 	state->csstate.methods = &constraint_aware_append_state_methods;
 	state->subplan = &append->plan;
+	state->current = INVALID_SUBPLAN_INDEX;
 
 	return (Node *) state;
 }
@@ -474,6 +808,7 @@ constraint_aware_append_plan_create(PlannerInfo *root, RelOptInfo *rel, struct C
 	List *chunk_ri_clauses = NIL;
 	List *children = NIL;
 	ListCell *lc_child;
+	int first_partial_plan = 0;
 
 	cscan->scan.scanrelid = 0;			 /* Not a real relation we are scanning */
 	cscan->scan.plan.targetlist = tlist; /* Target list we expect as output */
@@ -493,6 +828,9 @@ constraint_aware_append_plan_create(PlannerInfo *root, RelOptInfo *rel, struct C
 			break;
 		case T_Append:
 			children = castNode(Append, linitial(custom_plans))->appendplans;
+#if !(PG96 || PG10)
+			first_partial_plan = castNode(Append, linitial(custom_plans))->first_partial_plan;
+#endif
 			break;
 		default:
 			elog(ERROR,
@@ -548,7 +886,14 @@ constraint_aware_append_plan_create(PlannerInfo *root, RelOptInfo *rel, struct C
 		}
 	}
 
-	cscan->custom_private = list_make2(list_make1_oid(rte->relid), chunk_ri_clauses);
+	/*
+	 * Chunk plans at or beyond first_partial_plan may be executed by several
+	 * participants at once in parallel-aware mode. Before PG11 an Append in a
+	 * partial path only has partial children.
+	 */
+	cscan->custom_private = list_make3(list_make1_oid(rte->relid),
+									   chunk_ri_clauses,
+									   list_make1_int(first_partial_plan));
 	cscan->custom_scan_tlist = subplan->targetlist; /* Target list of tuples
 													 * we expect as input */
 	cscan->flags = path->flags;
@@ -577,7 +922,13 @@ ts_constraint_aware_append_path_create(PlannerInfo *root, Hypertable *ht, Path *
 	path->cpath.path.param_info = subpath->param_info;
 	path->cpath.path.pathtarget = subpath->pathtarget;
 
-	path->cpath.path.parallel_aware = false;
+	/*
+	 * Partial Append paths (i.e., those meant to run below a Gather) get a
+	 * parallel-aware ConstraintAwareAppend that distributes the chunks left
+	 * after exclusion across the participants itself.
+	 */
+	path->cpath.path.parallel_aware = ts_guc_enable_parallel_chunk_append &&
+									  IsA(subpath, AppendPath) && subpath->parallel_workers > 0;
 	path->cpath.path.parallel_safe = subpath->parallel_safe;
 	path->cpath.path.parallel_workers = subpath->parallel_workers;
 
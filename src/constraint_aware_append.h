@@ -15,11 +15,30 @@ typedef struct ConstraintAwareAppendPath
 	CustomPath cpath;
 } ConstraintAwareAppendPath;
 
+typedef struct ParallelChunkAppendShared ParallelChunkAppendShared;
+
 typedef struct ConstraintAwareAppendState
 {
 	CustomScanState csstate;
 	Plan *subplan;
 	Size num_append_subplans;
+
+	/*
+	 * Parallel-aware execution. Instead of running the Append node the
+	 * surviving chunk plans are executed directly and handed out to the
+	 * participants through shared memory.
+	 */
+	int eflags;
+	int first_partial_plan;
+	int *subplan_index; /* surviving plan -> position in original Append */
+	PlanState **subplanstates;
+	int current;
+	int next_plan; /* next plan when running without shared state */
+	ParallelChunkAppendShared *pstate;
+
+	/* per-participant chunk counts retrieved at shutdown for EXPLAIN */
+	int num_participants;
+	int *participant_chunks;
 } ConstraintAwareAppendState;
 
 typedef struct Hypertable Hypertable;
@@ -18,12 +18,14 @@
 #include <commands/trigger.h>
 #include <utils/builtins.h>
 #include <utils/lsyscache.h>
+#include <utils/snapmgr.h>
 
 #include "compat.h"
 
 #include "bgw/job.h"
 #include "continuous_agg.h"
 #include "hypertable.h"
+#include "invalidation_threshold_cache.h"
 #include "scan_iterator.h"
 
 #if !PG96
@@ -55,6 +57,15 @@ static const WithClauseDefinition continuous_aggregate_with_clause_def[] = {
 			.type_id = BOOLOID,
 			.default_val = BoolGetDatum(true),
 		},
+		[ContinuousViewOptionMaterializedOnly] = {
+			.arg_name = "materialized_only",
+			.type_id = BOOLOID,
+			.default_val = BoolGetDatum(true),
+		},
+		[ContinuousViewOptionMaterializeFrom] = {
+			.arg_name = "materialize_from",
+			.type_id = REGCLASSOID,
+		},
 };
 
 WithClauseResult *
@@ -121,6 +132,38 @@ init_hypertable_invalidation_log_scan_by_hypertable_id(ScanIterator *iterator,
 		Int32GetDatum(raw_hypertable_id));
 }
 
+static void
+init_materialization_invalidation_log_scan_by_materialization_id(ScanIterator *iterator,
+																 const int32 materialization_id)
+{
+	iterator->ctx.index = catalog_get_index(ts_catalog_get(),
+											CONTINUOUS_AGGS_MATERIALIZATION_INVALIDATION_LOG,
+											CONTINUOUS_AGGS_MATERIALIZATION_INVALIDATION_LOG_IDX);
+
+	ts_scan_iterator_scan_key_init(
+		iterator,
+		Anum_continuous_aggs_materialization_invalidation_log_idx_materialization_id,
+		BTEqualStrategyNumber,
+		F_INT4EQ,
+		Int32GetDatum(materialization_id));
+}
+
+static void
+init_materialization_stats_scan_by_materialization_id(ScanIterator *iterator,
+													  const int32 materialization_id)
+{
+	iterator->ctx.index = catalog_get_index(ts_catalog_get(),
+											CONTINUOUS_AGGS_MATERIALIZATION_STATS,
+											CONTINUOUS_AGGS_MATERIALIZATION_STATS_PKEY);
+
+	ts_scan_iterator_scan_key_init(
+		iterator,
+		Anum_continuous_aggs_materialization_stats_pkey_materialization_id,
+		BTEqualStrategyNumber,
+		F_INT4EQ,
+		Int32GetDatum(materialization_id));
+}
+
 static int32
 number_of_continuous_aggs_attached(int32 raw_hypertable_id)
 {
@@ -168,6 +211,8 @@ invalidation_threshold_delete(int32 raw_hypertable_id)
 		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
 		ts_catalog_delete(ti->scanrel, ti->tuple);
 	}
+
+	ts_invalidation_threshold_cache_reset(raw_hypertable_id);
 }
 
 static void
@@ -186,6 +231,40 @@ hypertable_invalidation_log_delete(int32 raw_hypertable_id)
 	}
 }
 
+static void
+materialization_invalidation_log_delete(int32 materialization_id)
+{
+	ScanIterator iterator =
+		ts_scan_iterator_create(CONTINUOUS_AGGS_MATERIALIZATION_INVALIDATION_LOG,
+								RowExclusiveLock,
+								CurrentMemoryContext);
+
+	init_materialization_invalidation_log_scan_by_materialization_id(&iterator,
+																	 materialization_id);
+
+	ts_scanner_foreach(&iterator)
+	{
+		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
+		ts_catalog_delete(ti->scanrel, ti->tuple);
+	}
+}
+
+static void
+materialization_stats_delete(int32 materialization_id)
+{
+	ScanIterator iterator = ts_scan_iterator_create(CONTINUOUS_AGGS_MATERIALIZATION_STATS,
+													RowExclusiveLock,
+													CurrentMemoryContext);
+
+	init_materialization_stats_scan_by_materialization_id(&iterator, materialization_id);
+
+	ts_scanner_foreach(&iterator)
+	{
+		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
+		ts_catalog_delete(ti->scanrel, ti->tuple);
+	}
+}
+
 static void
 continuous_agg_init(ContinuousAgg *cagg, FormData_continuous_agg *fd)
 {
@@ -276,6 +355,9 @@ ts_continuous_agg_find_by_view_name(const char *schema, const char *name)
  * copy of the user view query (aka the direct view)
  * NOTE: The order in which the objects are dropped should be EXACTLY the same as in materialize.c"
  *
+ * Continuous aggs materialized from this one are dropped first, since their raw
+ * hypertable is our materialization hypertable.
+ *
  * drop_user_view indicates whether to drop the user view.
  *                (should be false if called as part of the drop-user-view callback)
  */
@@ -291,6 +373,18 @@ drop_continuous_agg(ContinuousAgg *agg, bool drop_user_view)
 	int32 count = 0;
 	bool raw_hypertable_has_other_caggs = true;
 	bool raw_hypertable_exists;
+	ListCell *lc;
+
+	foreach (lc, ts_continuous_aggs_find_by_raw_table_id(agg->data.mat_hypertable_id))
+	{
+		ContinuousAgg *dependent = lfirst(lc);
+
+		ereport(NOTICE,
+				(errmsg("drop cascades to continuous aggregate %s.%s",
+						NameStr(dependent->data.user_view_schema),
+						NameStr(dependent->data.user_view_name))));
+		drop_continuous_agg(dependent, true);
+	}
 
 	/* NOTE: the lock order matters, see tsl/src/materialization.c. Perform all locking upfront */
 
@@ -324,8 +418,12 @@ drop_continuous_agg(ContinuousAgg *agg, bool drop_user_view)
 	if (!raw_hypertable_has_other_caggs)
 		LockRelationOid(catalog_get_table_id(catalog, CONTINUOUS_AGGS_HYPERTABLE_INVALIDATION_LOG),
 						RowExclusiveLock);
+	LockRelationOid(catalog_get_table_id(catalog, CONTINUOUS_AGGS_MATERIALIZATION_INVALIDATION_LOG),
+					RowExclusiveLock);
 	LockRelationOid(catalog_get_table_id(catalog, CONTINUOUS_AGGS_COMPLETED_THRESHOLD),
 					RowExclusiveLock);
+	LockRelationOid(catalog_get_table_id(catalog, CONTINUOUS_AGGS_MATERIALIZATION_STATS),
+					RowExclusiveLock);
 	if (!raw_hypertable_has_other_caggs)
 		LockRelationOid(catalog_get_table_id(catalog, CONTINUOUS_AGGS_INVALIDATION_THRESHOLD),
 						RowExclusiveLock);
@@ -382,8 +480,12 @@ drop_continuous_agg(ContinuousAgg *agg, bool drop_user_view)
 		if (!raw_hypertable_has_other_caggs)
 			hypertable_invalidation_log_delete(form->raw_hypertable_id);
 
+		materialization_invalidation_log_delete(form->mat_hypertable_id);
+
 		completed_threshold_delete(form->mat_hypertable_id);
 
+		materialization_stats_delete(form->mat_hypertable_id);
+
 		if (!raw_hypertable_has_other_caggs)
 			invalidation_threshold_delete(form->raw_hypertable_id);
 		count++;
@@ -611,3 +713,63 @@ ts_number_of_continuous_aggs()
 
 	return count;
 }
+
+typedef struct WatermarkCache
+{
+	int32 mat_hypertable_id;
+	bool isnull;
+	int64 value;
+} WatermarkCache;
+
+/*
+ * Get the completed threshold of a continuous aggregate, i.e., the point in
+ * internal time up to which the materialization is complete. Returns NULL if
+ * nothing has been materialized yet.
+ *
+ * Real-time continuous aggregate views call this function to split the query
+ * between the materialization and the raw hypertable. The threshold is read
+ * with the snapshot of the calling query, so that it is consistent with the
+ * materialized rows the query sees, and cached for the rest of the execution.
+ */
+TS_FUNCTION_INFO_V1(ts_continuous_agg_watermark);
+
+Datum
+ts_continuous_agg_watermark(PG_FUNCTION_ARGS)
+{
+	int32 mat_hypertable_id = PG_GETARG_INT32(0);
+	WatermarkCache *cache = fcinfo->flinfo->fn_extra;
+
+	if (cache == NULL || cache->mat_hypertable_id != mat_hypertable_id)
+	{
+		ScanIterator iterator = ts_scan_iterator_create(CONTINUOUS_AGGS_COMPLETED_THRESHOLD,
+														AccessShareLock,
+														CurrentMemoryContext);
+
+		if (cache == NULL)
+			cache = MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, sizeof(WatermarkCache));
+
+		cache->mat_hypertable_id = mat_hypertable_id;
+		cache->isnull = true;
+		cache->value = 0;
+
+		iterator.ctx.snapshot = GetActiveSnapshot();
+		init_completed_threshold_scan_by_mat_id(&iterator, mat_hypertable_id);
+
+		ts_scanner_foreach(&iterator)
+		{
+			Form_continuous_aggs_completed_threshold form =
+				(Form_continuous_aggs_completed_threshold) GETSTRUCT(
+					ts_scan_iterator_tuple(&iterator));
+
+			cache->isnull = false;
+			cache->value = form->watermark;
+		}
+
+		fcinfo->flinfo->fn_extra = cache;
+	}
+
+	if (cache->isnull)
+		PG_RETURN_NULL();
+
+	PG_RETURN_INT64(cache->value);
+}
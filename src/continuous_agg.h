@@ -23,6 +23,8 @@ typedef enum ContinuousAggViewOption
 	ContinuousViewOptionRefreshInterval,
 	ContinuousViewOptionMaxIntervalPerRun,
 	ContinuousViewOptionCreateGroupIndex,
+	ContinuousViewOptionMaterializedOnly,
+	ContinuousViewOptionMaterializeFrom,
 } ContinuousAggViewOption;
 
 typedef enum ContinuousAggViewType
@@ -0,0 +1,614 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#include <postgres.h>
+#include <math.h>
+#include <fmgr.h>
+#include <access/xact.h>
+#include <lib/stringinfo.h>
+#include <libpq/pqformat.h>
+#include <utils/timestamp.h>
+
+#include "compat.h"
+#include "time_series_samples.h"
+
+/* aggregate counter_agg:
+ *	 counter_agg(value, time) returns a summary of the samples of a monotonic counter
+ *	 counter_agg_rollup(summary) combines the summaries of adjacent time ranges
+ *	 counter_delta(summary) returns the increase of the counter
+ *	 counter_rate(summary) returns the increase of the counter per second between its samples
+ *	 counter_extrapolated_rate(summary, start, end) returns the increase of the counter per
+ *	 second over [start, end], extrapolating the samples to the bounds
+ *
+ * Usage:
+ *	 SELECT device, counter_rate(counter_agg(bytes_sent, time)) FROM metrics GROUP BY device;
+ *
+ * Description:
+ * A counter only increases, except when it is reset to zero, e.g. when the device counting
+ * restarts. A sample lower than its predecessor marks a reset, and the counter increased by the
+ * value of the sample since. The increase over a time range is thus the difference between its
+ * last and first sample, plus the values of the samples preceding the resets.
+ *
+ * The summary of a time range keeps its first and last sample, the sum of the values preceding
+ * resets, and the number of samples. The summaries of two disjoint time ranges are combined by
+ * adding up their reset sums, plus the last sample of the earlier range if the first sample of
+ * the later one is lower. Summaries of overlapping time ranges cannot be combined. Like for the
+ * time-weighted aggregates, the transition function keeps the most recent samples and summarizes
+ * the older ones as rows arrive, rows among the summarized samples are an error, all samples are
+ * kept and serialized in parallel mode, and continuous aggregates of space-partitioned
+ * hypertables must group by the space partitioning columns.
+ */
+
+TS_FUNCTION_INFO_V1(ts_counter_agg_sfunc);
+TS_FUNCTION_INFO_V1(ts_counter_agg_rollup_sfunc);
+TS_FUNCTION_INFO_V1(ts_counter_agg_combinefunc);
+TS_FUNCTION_INFO_V1(ts_counter_agg_serializefunc);
+TS_FUNCTION_INFO_V1(ts_counter_agg_deserializefunc);
+TS_FUNCTION_INFO_V1(ts_counter_agg_finalfunc);
+TS_FUNCTION_INFO_V1(ts_counter_delta);
+TS_FUNCTION_INFO_V1(ts_counter_rate);
+TS_FUNCTION_INFO_V1(ts_counter_extrapolated_rate);
+
+#define COUNTER_FORMAT_VERSION 1
+
+typedef struct CounterSummary
+{
+	TimeSeriesSample first;
+	TimeSeriesSample last;
+	/* the sum of the values of the samples preceding resets */
+	double reset_sum;
+	int64 count;
+} CounterSummary;
+
+typedef struct CounterState
+{
+	/* the summary of the samples summarized as they arrived, all before the samples kept */
+	bool summarized;
+	CounterSummary summary;
+	/* the most recent samples, not summarized yet */
+	TimeSeriesSamples samples;
+	/* the summaries of partials, in no particular order */
+	int32 nsummaries;
+	int32 maxsummaries;
+	CounterSummary *summaries;
+} CounterState;
+
+static CounterState *
+counter_state_create(MemoryContext mcxt)
+{
+	CounterState *state = MemoryContextAllocZero(mcxt, sizeof(CounterState));
+
+	ts_time_series_samples_init(&state->samples);
+
+	return state;
+}
+
+static void
+counter_add_summaries(CounterState *state, CounterSummary *summaries, int32 nsummaries,
+					  MemoryContext mcxt)
+{
+	if (nsummaries == 0)
+		return;
+
+	if (state->nsummaries + nsummaries > state->maxsummaries)
+	{
+		int32 maxsummaries = Max(state->maxsummaries * 2, state->nsummaries + nsummaries);
+
+		if (state->summaries == NULL)
+			state->summaries = MemoryContextAlloc(mcxt, sizeof(CounterSummary) * maxsummaries);
+		else
+			state->summaries = repalloc(state->summaries, sizeof(CounterSummary) * maxsummaries);
+		state->maxsummaries = maxsummaries;
+	}
+
+	memcpy(state->summaries + state->nsummaries, summaries, sizeof(CounterSummary) * nsummaries);
+	state->nsummaries += nsummaries;
+}
+
+static int
+counter_summary_cmp(const void *a, const void *b)
+{
+	const CounterSummary *summary_a = a;
+	const CounterSummary *summary_b = b;
+
+	int cmp = ts_time_series_sample_cmp(&summary_a->first, &summary_b->first);
+
+	if (cmp != 0)
+		return cmp;
+
+	return ts_time_series_sample_cmp(&summary_a->last, &summary_b->last);
+}
+
+/* extend the summary by a later sample */
+static void
+counter_summary_extend(CounterSummary *summary, TimeSeriesSample *sample)
+{
+	if (sample->value < summary->last.value)
+		summary->reset_sum += summary->last.value;
+
+	summary->last = *sample;
+	summary->count++;
+}
+
+/* extend the summary by an earlier sample */
+static void
+counter_summary_extend_before(CounterSummary *summary, TimeSeriesSample *sample)
+{
+	if (summary->first.value < sample->value)
+		summary->reset_sum += sample->value;
+
+	summary->first = *sample;
+	summary->count++;
+}
+
+/* combine the summary with the summary of a later time range */
+static void
+counter_summary_combine(CounterSummary *summary, CounterSummary *later)
+{
+	if (later->first.time < summary->last.time)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("cannot combine counter aggregates of overlapping time ranges"),
+				 errdetail("The time range of a partial ends after the start of another.")));
+
+	counter_summary_extend(summary, &later->first);
+	summary->reset_sum += later->reset_sum;
+	summary->count += later->count - 1;
+	summary->last = later->last;
+}
+
+/* summarize the oldest samples of the sorted samples of the state */
+static void
+counter_summarize_samples(CounterState *state, int32 nsamples)
+{
+	TimeSeriesSample *samples = state->samples.samples;
+	int32 i = 0;
+
+	if (nsamples == 0)
+		return;
+
+	if (!state->summarized)
+	{
+		memset(&state->summary, 0, sizeof(CounterSummary));
+		state->summary.first = samples[0];
+		state->summary.last = samples[0];
+		state->summary.count = 1;
+		state->summarized = true;
+		i++;
+	}
+
+	for (; i < nsamples; i++)
+		counter_summary_extend(&state->summary, &samples[i]);
+
+	ts_time_series_samples_remove_first(&state->samples, nsamples);
+}
+
+/* add the summary of the samples summarized as they arrived to the summaries of the state */
+static void
+counter_close_summary(CounterState *state, MemoryContext mcxt)
+{
+	if (!state->summarized)
+		return;
+
+	counter_add_summaries(state, &state->summary, 1, mcxt);
+	state->summarized = false;
+}
+
+/*
+ * Add a sample to the state. Once too many samples are kept, the oldest ones
+ * are summarized.
+ */
+static void
+counter_add_sample(CounterState *state, TimeSeriesSample *sample, MemoryContext mcxt)
+{
+	if (state->summarized && ts_time_series_sample_cmp(sample, &state->summary.last) < 0)
+	{
+		if (ts_time_series_sample_cmp(sample, &state->summary.first) > 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("counter aggregate rows too far out of time order"),
+					 errdetail("A row arrived after later and earlier rows were summarized."),
+					 errhint("Order the rows by time.")));
+
+		counter_summary_extend_before(&state->summary, sample);
+		return;
+	}
+
+	ts_time_series_samples_add(&state->samples, sample, 1, true, mcxt);
+	counter_summarize_samples(state, ts_time_series_samples_overflow(&state->samples));
+}
+
+/* summarize the samples and the summaries of the state into a single summary */
+static void
+counter_summarize(CounterState *state, MemoryContext mcxt)
+{
+	int32 i;
+
+	ts_time_series_samples_sort(&state->samples);
+	counter_summarize_samples(state, state->samples.nsamples);
+	counter_close_summary(state, mcxt);
+
+	if (state->nsummaries > 1)
+	{
+		qsort(state->summaries, state->nsummaries, sizeof(CounterSummary), counter_summary_cmp);
+
+		for (i = 1; i < state->nsummaries; i++)
+			counter_summary_combine(&state->summaries[0], &state->summaries[i]);
+
+		state->nsummaries = 1;
+	}
+}
+
+static bytea *
+counter_serialize(CounterState *state)
+{
+	StringInfoData buf;
+	int32 i;
+
+	pq_begintypsend(&buf);
+	pq_sendbyte(&buf, COUNTER_FORMAT_VERSION);
+
+	pq_sendint(&buf, state->nsummaries, 4);
+	for (i = 0; i < state->nsummaries; i++)
+	{
+		CounterSummary *summary = &state->summaries[i];
+
+		pq_sendint64(&buf, summary->first.time);
+		pq_sendfloat8(&buf, summary->first.value);
+		pq_sendint64(&buf, summary->last.time);
+		pq_sendfloat8(&buf, summary->last.value);
+		pq_sendfloat8(&buf, summary->reset_sum);
+		pq_sendint64(&buf, summary->count);
+	}
+
+	ts_time_series_samples_serialize(&buf, &state->samples);
+
+	return pq_endtypsend(&buf);
+}
+
+/*
+ * Summaries are also passed to the accessor functions as plain bytea, so the
+ * serialized form is checked for consistency.
+ */
+static CounterState *
+counter_deserialize(bytea *serialized, MemoryContext mcxt)
+{
+	StringInfoData buf;
+	CounterState *state;
+	int32 nsummaries;
+	int32 i;
+
+	buf.data = VARDATA_ANY(serialized);
+	buf.len = VARSIZE_ANY_EXHDR(serialized);
+	buf.maxlen = buf.len;
+	buf.cursor = 0;
+
+	if (pq_getmsgbyte(&buf) != COUNTER_FORMAT_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid counter aggregate version")));
+
+	state = counter_state_create(mcxt);
+
+	nsummaries = pq_getmsgint(&buf, 4);
+	if (nsummaries < 0 || nsummaries > (buf.len - buf.cursor) / (6 * 8))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid counter aggregate")));
+
+	for (i = 0; i < nsummaries; i++)
+	{
+		CounterSummary summary;
+
+		summary.first.time = pq_getmsgint64(&buf);
+		summary.first.value = pq_getmsgfloat8(&buf);
+		summary.last.time = pq_getmsgint64(&buf);
+		summary.last.value = pq_getmsgfloat8(&buf);
+		summary.reset_sum = pq_getmsgfloat8(&buf);
+		summary.count = pq_getmsgint64(&buf);
+
+		if (summary.count < 1 || summary.first.time > summary.last.time)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid counter aggregate")));
+
+		counter_add_summaries(state, &summary, 1, mcxt);
+	}
+
+	ts_time_series_samples_deserialize(&buf, &state->samples, mcxt);
+
+	pq_getmsgend(&buf);
+
+	return state;
+}
+
+/* the summary of the samples passed to an accessor function */
+static CounterSummary *
+counter_summary_from_arg(bytea *serialized)
+{
+	CounterState *state = counter_deserialize(serialized, CurrentMemoryContext);
+
+	counter_summarize(state, CurrentMemoryContext);
+
+	if (state->nsummaries == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid counter aggregate")));
+
+	return &state->summaries[0];
+}
+
+static double
+counter_summary_delta(CounterSummary *summary)
+{
+	return summary->last.value - summary->first.value + summary->reset_sum;
+}
+
+/* counter_agg(state, value, time) */
+Datum
+ts_counter_agg_sfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	CounterState *state = (CounterState *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	TimeSeriesSample sample;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_counter_agg_sfunc called in non-aggregate context");
+	}
+
+	/* samples without a value or time are ignored */
+	if (PG_ARGISNULL(1) || PG_ARGISNULL(2))
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	sample.value = PG_GETARG_FLOAT8(1);
+	sample.time = PG_GETARG_TIMESTAMPTZ(2);
+
+	if (TIMESTAMP_NOT_FINITE(sample.time))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+				 errmsg("counter aggregates do not support infinite timestamps")));
+
+	if (isnan(sample.value) || isinf(sample.value))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot add non-finite value to counter aggregate")));
+
+	if (state == NULL)
+		state = counter_state_create(aggcontext);
+
+	counter_add_sample(state, &sample, aggcontext);
+
+	PG_RETURN_POINTER(state);
+}
+
+/* counter_agg_rollup(state, summary) */
+Datum
+ts_counter_agg_rollup_sfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	CounterState *state = (CounterState *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	CounterState *summary;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_counter_agg_rollup_sfunc called in non-aggregate context");
+	}
+
+	if (PG_ARGISNULL(1))
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	summary = counter_deserialize(PG_GETARG_BYTEA_PP(1), aggcontext);
+
+	if (state == NULL)
+		PG_RETURN_POINTER(summary);
+
+	counter_close_summary(state, aggcontext);
+	ts_time_series_samples_add(&state->samples,
+							   summary->samples.samples,
+							   summary->samples.nsamples,
+							   summary->samples.sorted,
+							   aggcontext);
+	counter_add_summaries(state, summary->summaries, summary->nsummaries, aggcontext);
+
+	PG_RETURN_POINTER(state);
+}
+
+/* ts_counter_agg_combinefunc(internal, internal) => internal */
+Datum
+ts_counter_agg_combinefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	CounterState *state1 = (CounterState *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	CounterState *state2 = (CounterState *) (PG_ARGISNULL(1) ? NULL : PG_GETARG_POINTER(1));
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_counter_agg_combinefunc called in non-aggregate context");
+	}
+
+	if (state2 == NULL)
+	{
+		if (state1 == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state1);
+	}
+
+	/* the first state belongs to the aggregate, so it is updated in place */
+	if (state1 == NULL)
+		state1 = counter_state_create(aggcontext);
+
+	/* the samples of the second state need not be after the summary of the first */
+	counter_close_summary(state1, aggcontext);
+	if (state2->summarized)
+		counter_add_summaries(state1, &state2->summary, 1, aggcontext);
+
+	ts_time_series_samples_add(&state1->samples,
+							   state2->samples.samples,
+							   state2->samples.nsamples,
+							   state2->samples.sorted,
+							   aggcontext);
+	counter_add_summaries(state1, state2->summaries, state2->nsummaries, aggcontext);
+
+	PG_RETURN_POINTER(state1);
+}
+
+/* ts_counter_agg_serializefunc(internal) => bytea */
+Datum
+ts_counter_agg_serializefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	CounterState *state;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "ts_counter_agg_serializefunc called in non-aggregate context");
+
+	Assert(!PG_ARGISNULL(0));
+	state = (CounterState *) PG_GETARG_POINTER(0);
+
+	/*
+	 * The partials of a parallel aggregation may cover overlapping time
+	 * ranges, so their samples cannot be summarized yet.
+	 */
+	if (!IsInParallelMode())
+		counter_summarize(state, aggcontext);
+	else
+		counter_close_summary(state, aggcontext);
+
+	PG_RETURN_BYTEA_P(counter_serialize(state));
+}
+
+/* ts_counter_agg_deserializefunc(bytea, internal) => internal */
+Datum
+ts_counter_agg_deserializefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "ts_counter_agg_deserializefunc called in non-aggregate context");
+
+	Assert(!PG_ARGISNULL(0));
+
+	PG_RETURN_POINTER(counter_deserialize(PG_GETARG_BYTEA_PP(0), aggcontext));
+}
+
+/* ts_counter_agg_finalfunc(internal) => bytea */
+Datum
+ts_counter_agg_finalfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	CounterState *state;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_counter_agg_finalfunc called in non-aggregate context");
+	}
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	state = (CounterState *) PG_GETARG_POINTER(0);
+	counter_summarize(state, aggcontext);
+
+	PG_RETURN_BYTEA_P(counter_serialize(state));
+}
+
+/* counter_delta(summary BYTEA) => DOUBLE PRECISION */
+Datum
+ts_counter_delta(PG_FUNCTION_ARGS)
+{
+	CounterSummary *summary = counter_summary_from_arg(PG_GETARG_BYTEA_PP(0));
+
+	PG_RETURN_FLOAT8(counter_summary_delta(summary));
+}
+
+/* counter_rate(summary BYTEA) => DOUBLE PRECISION */
+Datum
+ts_counter_rate(PG_FUNCTION_ARGS)
+{
+	CounterSummary *summary = counter_summary_from_arg(PG_GETARG_BYTEA_PP(0));
+
+	/* the samples cover no time, so there is no rate */
+	if (summary->last.time == summary->first.time)
+		PG_RETURN_NULL();
+
+	PG_RETURN_FLOAT8(counter_summary_delta(summary) /
+					 ((double) (summary->last.time - summary->first.time) / USECS_PER_SEC));
+}
+
+/*
+ * counter_extrapolated_rate(summary BYTEA, range_start TIMESTAMPTZ, range_end TIMESTAMPTZ)
+ *	 => DOUBLE PRECISION
+ *
+ * The samples rarely fall on the bounds of the range, e.g. the time bucket they
+ * were aggregated in, so the increase between the samples is extrapolated to
+ * the bounds, as Prometheus does. The increase is extrapolated to a bound if it
+ * is within 1.1 times the average interval between the samples, else by half
+ * of the average interval. It is never extrapolated before the point where
+ * the counter would have been zero.
+ */
+Datum
+ts_counter_extrapolated_rate(PG_FUNCTION_ARGS)
+{
+	CounterSummary *summary = counter_summary_from_arg(PG_GETARG_BYTEA_PP(0));
+	TimestampTz range_start = PG_GETARG_TIMESTAMPTZ(1);
+	TimestampTz range_end = PG_GETARG_TIMESTAMPTZ(2);
+	double delta = counter_summary_delta(summary);
+	double sampled_interval;
+	double average_interval;
+	double extrapolation_threshold;
+	double to_start;
+	double to_end;
+	double extrapolated_interval;
+
+	if (TIMESTAMP_NOT_FINITE(range_start) || TIMESTAMP_NOT_FINITE(range_end) ||
+		range_start >= range_end)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid range for extrapolated counter rate"),
+				 errdetail("The range must be finite and end after its start.")));
+
+	if (summary->first.time < range_start || summary->last.time > range_end)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("counter samples outside of the range of the extrapolated rate")));
+
+	if (summary->count < 2 || summary->last.time == summary->first.time)
+		PG_RETURN_NULL();
+
+	sampled_interval = (double) (summary->last.time - summary->first.time) / USECS_PER_SEC;
+	average_interval = sampled_interval / (summary->count - 1);
+	extrapolation_threshold = average_interval * 1.1;
+	to_start = (double) (summary->first.time - range_start) / USECS_PER_SEC;
+	to_end = (double) (range_end - summary->last.time) / USECS_PER_SEC;
+
+	/* the counter cannot have been lower than zero before the first sample */
+	if (delta > 0 && summary->first.value >= 0)
+	{
+		double to_zero = sampled_interval * (summary->first.value / delta);
+
+		if (to_zero < to_start)
+			to_start = to_zero;
+	}
+
+	extrapolated_interval = sampled_interval;
+	extrapolated_interval += to_start < extrapolation_threshold ? to_start : average_interval / 2;
+	extrapolated_interval += to_end < extrapolation_threshold ? to_end : average_interval / 2;
+
+	PG_RETURN_FLOAT8(delta * (extrapolated_interval / sampled_interval) /
+					 ((double) (range_end - range_start) / USECS_PER_SEC));
+}
@@ -22,6 +22,7 @@ TS_FUNCTION_INFO_V1(ts_reorder_chunk);
 TS_FUNCTION_INFO_V1(ts_partialize_agg);
 TS_FUNCTION_INFO_V1(ts_finalize_agg_sfunc);
 TS_FUNCTION_INFO_V1(ts_finalize_agg_ffunc);
+TS_FUNCTION_INFO_V1(ts_combine_agg_ffunc);
 TS_FUNCTION_INFO_V1(continuous_agg_invalidation_trigger);
 
 Datum
@@ -87,6 +88,12 @@ ts_finalize_agg_ffunc(PG_FUNCTION_ARGS)
 	PG_RETURN_DATUM(ts_cm_functions->finalize_agg_ffunc(fcinfo));
 }
 
+Datum
+ts_combine_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_DATUM(ts_cm_functions->combine_agg_ffunc(fcinfo));
+}
+
 /*
  * casting a function pointer to a pointer of another type is undefined
  * behavior, so we need one of these for every function type we have
@@ -161,6 +168,12 @@ cagg_materialize_default_fn(int32 materialization_id, bool verbose)
 	pg_unreachable();
 }
 
+static void
+cagg_materialize_worker_default_fn(dsm_handle handle)
+{
+	error_no_default_fn_community();
+}
+
 static Datum
 error_no_default_fn_pg_community(PG_FUNCTION_ARGS)
 {
@@ -207,6 +220,25 @@ continuous_agg_drop_chunks_by_chunk_id_default(int32 raw_hypertable_id, Chunk **
 	error_no_default_fn_community();
 }
 
+static void
+continuous_agg_invalidate_default(int32 hypertable_id, int64 lowest_modified_value,
+								  int64 greatest_modified_value)
+{
+	error_no_default_fn_community();
+}
+
+/* without the submodule, queries are planned as they are */
+static Query *
+continuous_agg_rewrite_query_default(Query *parse)
+{
+	return parse;
+}
+
+static void
+gapfill_restrict_query_default(Query *parse)
+{
+}
+
 /*
  * Define cross-module functions' default values:
  * If the submodule isn't activated, using one of the cm functions will throw an
@@ -222,6 +254,7 @@ TSDLLEXPORT CrossModuleFunctions ts_cm_functions_default = {
 	.add_tsl_license_info_telemetry = add_telemetry_default,
 	.bgw_policy_job_execute = bgw_policy_job_execute_default_fn,
 	.continuous_agg_materialize = cagg_materialize_default_fn,
+	.continuous_agg_materialize_worker = cagg_materialize_worker_default_fn,
 	.add_drop_chunks_policy = error_no_default_fn_pg_enterprise,
 	.add_reorder_policy = error_no_default_fn_pg_enterprise,
 	.remove_drop_chunks_policy = error_no_default_fn_pg_enterprise,
@@ -242,10 +275,14 @@ TSDLLEXPORT CrossModuleFunctions ts_cm_functions_default = {
 	.partialize_agg = error_no_default_fn_pg_community,
 	.finalize_agg_sfunc = error_no_default_fn_pg_community,
 	.finalize_agg_ffunc = error_no_default_fn_pg_community,
+	.combine_agg_ffunc = error_no_default_fn_pg_community,
 	.process_cagg_viewstmt = process_cagg_viewstmt_default,
 	.continuous_agg_drop_chunks_by_chunk_id = continuous_agg_drop_chunks_by_chunk_id_default,
 	.continuous_agg_trigfn = error_no_default_fn_pg_community,
+	.continuous_agg_invalidate = continuous_agg_invalidate_default,
 	.continuous_agg_update_options = continuous_agg_update_options_default,
+	.continuous_agg_rewrite_query = continuous_agg_rewrite_query_default,
+	.gapfill_restrict_query = gapfill_restrict_query_default,
 };
 
 TSDLLEXPORT CrossModuleFunctions *ts_cm_functions = &ts_cm_functions_default;
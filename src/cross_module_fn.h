@@ -16,6 +16,7 @@
 #include <utils/jsonb.h>
 
 #include <optimizer/planner.h>
+#include <storage/dsm.h>
 
 #include "export.h"
 #include "bgw/job.h"
@@ -42,6 +43,7 @@ typedef struct CrossModuleFunctions
 	void (*add_tsl_license_info_telemetry)(JsonbParseState *parseState);
 	bool (*bgw_policy_job_execute)(BgwJob *job);
 	bool (*continuous_agg_materialize)(int32 materialization_id, bool verbose);
+	void (*continuous_agg_materialize_worker)(dsm_handle handle);
 	Datum (*add_drop_chunks_policy)(PG_FUNCTION_ARGS);
 	Datum (*add_reorder_policy)(PG_FUNCTION_ARGS);
 	Datum (*remove_drop_chunks_policy)(PG_FUNCTION_ARGS);
@@ -62,13 +64,18 @@ typedef struct CrossModuleFunctions
 	PGFunction partialize_agg;
 	PGFunction finalize_agg_sfunc;
 	PGFunction finalize_agg_ffunc;
+	PGFunction combine_agg_ffunc;
 	bool (*process_cagg_viewstmt)(ViewStmt *stmt, const char *query_string, void *pstmt,
 								  WithClauseResult *with_clause_options);
 	void (*continuous_agg_drop_chunks_by_chunk_id)(int32 raw_hypertable_id, Chunk **chunks,
 												   Size num_chunks);
 	PGFunction continuous_agg_trigfn;
+	void (*continuous_agg_invalidate)(int32 hypertable_id, int64 lowest_modified_value,
+									  int64 greatest_modified_value);
 	void (*continuous_agg_update_options)(ContinuousAgg *cagg,
 										  WithClauseResult *with_clause_options);
+	Query *(*continuous_agg_rewrite_query)(Query *parse);
+	void (*gapfill_restrict_query)(Query *parse);
 } CrossModuleFunctions;
 
 extern TSDLLEXPORT CrossModuleFunctions *ts_cm_functions;
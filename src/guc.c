@@ -38,9 +38,15 @@ bool ts_guc_optimize_non_hypertables = false;
 bool ts_guc_restoring = false;
 bool ts_guc_constraint_aware_append = true;
 bool ts_guc_enable_ordered_append = true;
+bool ts_guc_enable_parallel_chunk_append = true;
 bool ts_guc_enable_constraint_exclusion = true;
+bool ts_guc_enable_cagg_rewrite = false;
+TSDLLEXPORT bool ts_guc_enable_gapfill_hash = false;
+bool ts_guc_enable_gapfill_restriction = false;
 int ts_guc_max_open_chunks_per_insert = 10;
 int ts_guc_max_cached_chunks_per_hypertable = 10;
+TSDLLEXPORT int ts_guc_max_parallel_materialization_workers = 0;
+TSDLLEXPORT int ts_guc_materialization_stats_history = 100;
 int ts_guc_telemetry_level = TELEMETRY_BASIC;
 
 TSDLLEXPORT char *ts_guc_license_key = TS_DEFAULT_LICENSE;
@@ -119,6 +125,18 @@ _guc_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("timescaledb.enable_parallel_chunk_append",
+							 "Enable parallel chunk append",
+							 "Distribute the chunks left after execution time exclusion across "
+							 "parallel workers",
+							 &ts_guc_enable_parallel_chunk_append,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("timescaledb.enable_constraint_exclusion",
 							 "Enable constraint exclusion",
 							 "Enable planner constraint exclusion",
@@ -130,6 +148,43 @@ _guc_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("timescaledb.enable_cagg_rewrite",
+							 "Enable continuous aggregate query rewrite",
+							 "Answer aggregate queries on a hypertable from a matching continuous "
+							 "aggregate",
+							 &ts_guc_enable_cagg_rewrite,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("timescaledb.enable_gapfill_hash",
+							 "Enable hashed gap filling",
+							 "Gather the rows of each group in a hash table for gap filling instead "
+							 "of sorting the aggregated rows",
+							 &ts_guc_enable_gapfill_hash,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("timescaledb.enable_gapfill_restriction",
+							 "Enable restricting gap filled queries to the gapfill range",
+							 "Treat the start and finish arguments of time_bucket_gapfill like "
+							 "restrictions on the time column, so chunks outside of the range "
+							 "are excluded and rows outside of the range are not returned",
+							 &ts_guc_enable_gapfill_restriction,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomIntVariable("timescaledb.max_open_chunks_per_insert",
 							"Maximum open chunks per insert",
 							"Maximum number of open chunk tables per insert",
@@ -162,6 +217,32 @@ _guc_init(void)
 							NULL,
 							assign_max_cached_chunks_per_hypertable_hook,
 							NULL);
+	DefineCustomIntVariable("timescaledb.max_parallel_materialization_workers",
+							"Maximum parallel materialization workers",
+							"Maximum number of background workers materializing the new range of "
+							"a continuous aggregate in parallel",
+							&ts_guc_max_parallel_materialization_workers,
+							0,
+							0,
+							MAX_BACKENDS,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+	DefineCustomIntVariable("timescaledb.materialization_stats_history",
+							"Number of materializations kept in the statistics",
+							"Number of the most recent materializations of each continuous "
+							"aggregate kept in the materialization statistics, 0 disables them",
+							&ts_guc_materialization_stats_history,
+							100,
+							0,
+							PG_INT32_MAX,
+							PGC_SUSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
 	DefineCustomEnumVariable("timescaledb.telemetry_level",
 							 "Telemetry settings level",
 							 "Level used to determine which telemetry to send",
@@ -15,10 +15,16 @@ extern bool ts_guc_disable_optimizations;
 extern bool ts_guc_optimize_non_hypertables;
 extern bool ts_guc_constraint_aware_append;
 extern bool ts_guc_enable_ordered_append;
+extern bool ts_guc_enable_parallel_chunk_append;
 extern bool ts_guc_enable_constraint_exclusion;
+extern bool ts_guc_enable_cagg_rewrite;
+extern TSDLLEXPORT bool ts_guc_enable_gapfill_hash;
+extern bool ts_guc_enable_gapfill_restriction;
 extern bool ts_guc_restoring;
 extern int ts_guc_max_open_chunks_per_insert;
 extern int ts_guc_max_cached_chunks_per_hypertable;
+extern TSDLLEXPORT int ts_guc_max_parallel_materialization_workers;
+extern TSDLLEXPORT int ts_guc_materialization_stats_history;
 extern int ts_guc_telemetry_level;
 extern TSDLLEXPORT char *ts_guc_license_key;
 extern char *ts_last_tune_time;
@@ -4,6 +4,7 @@
  * LICENSE-APACHE for a copy of the license.
  */
 #include <postgres.h>
+#include <math.h>
 #include <catalog/pg_type.h>
 #include <utils/builtins.h>
 #include <utils/array.h>
@@ -27,37 +28,195 @@
  * Values falling outside of this range are bucketed into the 0 or nbucket+1 buckets depending on
  * if they are below or above the range, respectively. The resultant histogram therefore contains
  * nbucket+2 buckets accounting for buckets outside the range.
+ *
+ * log_histogram(val, min, max, nbuckets) is the same, except that the buckets are logarithmically
+ * sized, each one being (max / min)^(1 / nbuckets) times as wide as the one before it, and that
+ * it returns bigint counts. It is meant for data like latencies, where the interesting values
+ * span several orders of magnitude. Its lower bound must be positive.
+ *
+ * The bounds are only checked, and the scale of the buckets only computed, when the bounds
+ * differ from the ones of the previous value of the group, which they usually do not. The counts
+ * are int64, and the partials only use 64 bits per count if a count does not fit in 32, so that
+ * the partials of existing continuous aggregates do not change.
+ *
+ * Both are moving aggregates: in a window frame that moves, the value of a row leaving the frame
+ * is subtracted from its bucket, instead of recounting the whole frame for every row.
  */
 
 TS_FUNCTION_INFO_V1(ts_hist_sfunc);
+TS_FUNCTION_INFO_V1(ts_hist_log_sfunc);
+TS_FUNCTION_INFO_V1(ts_hist_msfunc);
+TS_FUNCTION_INFO_V1(ts_hist_log_msfunc);
+TS_FUNCTION_INFO_V1(ts_hist_minvfunc);
+TS_FUNCTION_INFO_V1(ts_hist_log_minvfunc);
 TS_FUNCTION_INFO_V1(ts_hist_combinefunc);
 TS_FUNCTION_INFO_V1(ts_hist_serializefunc);
 TS_FUNCTION_INFO_V1(ts_hist_deserializefunc);
 TS_FUNCTION_INFO_V1(ts_hist_finalfunc);
+TS_FUNCTION_INFO_V1(ts_hist_log_finalfunc);
 
 #define HISTOGRAM_SIZE(state, nbuckets) (sizeof(*state) + nbuckets * sizeof(*state->buckets))
 
+/*
+ * Multiplying by the precomputed scale can round differently from the exact bucketing formula, so
+ * values whose position is this close to a bucket boundary, relative to the position, are bucketed
+ * exactly instead.
+ */
+#define HISTOGRAM_BOUNDARY_EPSILON 1e-12
+
 typedef struct Histogram
 {
+	/*
+	 * The bounds the buckets are computed for, along with the offset and the scale that map a
+	 * value to its position within the buckets. Only the transition function uses them, they are
+	 * not serialized.
+	 */
+	double min;
+	double max;
+	double offset;
+	double scale;
+	/* the rounding error of the positions of logarithmic histograms */
+	double epsilon;
+	/* the number of values counted, which is zero for the empty frames of moving aggregates */
+	int64 nvalues;
 	int32 nbuckets;
-	Datum buckets[FLEXIBLE_ARRAY_MEMBER];
+	int64 buckets[FLEXIBLE_ARRAY_MEMBER];
 } Histogram;
 
-/* histogram(state, val, min, max, nbuckets) */
-Datum
-ts_hist_sfunc(PG_FUNCTION_ARGS)
+static Histogram *
+histogram_create(MemoryContext aggcontext, int32 nbuckets)
+{
+	Histogram *state = MemoryContextAllocZero(aggcontext, HISTOGRAM_SIZE(state, nbuckets));
+
+	state->nbuckets = nbuckets;
+	state->min = get_float8_nan();
+	state->max = get_float8_nan();
+
+	return state;
+}
+
+/* Check the bounds like width_bucket_float8() does, and compute the scale of the buckets */
+static void
+histogram_set_bounds(Histogram *state, double min, double max, int32 nbuckets, bool logarithmic)
+{
+	if (nbuckets <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_ARGUMENT_FOR_WIDTH_BUCKET_FUNCTION),
+				 errmsg("count must be greater than zero")));
+
+	if (isnan(min) || isnan(max))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_ARGUMENT_FOR_WIDTH_BUCKET_FUNCTION),
+				 errmsg("operand, lower bound, and upper bound cannot be NaN")));
+
+	if (isinf(min) || isinf(max))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_ARGUMENT_FOR_WIDTH_BUCKET_FUNCTION),
+				 errmsg("lower and upper bounds must be finite")));
+
+	if (min == max)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_ARGUMENT_FOR_WIDTH_BUCKET_FUNCTION),
+				 errmsg("lower bound cannot equal upper bound")));
+
+	if (min > max)
+	{
+		/* cannot generate a histogram with incompatible bounds */
+		elog(ERROR, "lower bound cannot exceed upper bound");
+	}
+
+	if (logarithmic && min <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_ARGUMENT_FOR_WIDTH_BUCKET_FUNCTION),
+				 errmsg("lower bound of logarithmic histogram must be greater than zero")));
+
+	if (state->nbuckets != nbuckets + 2)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of buckets of histogram cannot change")));
+
+	state->min = min;
+	state->max = max;
+
+	if (logarithmic)
+	{
+		state->offset = log(min);
+		state->scale = nbuckets / (log(max) - state->offset);
+		state->epsilon =
+			HISTOGRAM_BOUNDARY_EPSILON * (fabs(state->offset) + fabs(log(max)) + 1) * state->scale;
+	}
+	else
+	{
+		state->offset = min;
+		state->scale = nbuckets / (max - min);
+	}
+}
+
+/* The bucket of a value within the bounds of a linear histogram */
+static inline int32
+histogram_linear_bucket(Histogram *state, double val)
+{
+	double position = (val - state->offset) * state->scale;
+	int32 bucket = (int32) position;
+	double fraction = position - bucket;
+
+	/* values next to a boundary are bucketed by width_bucket_float8() itself, since the
+	 * precomputed scale can round them to the other side */
+	if (fraction < position * HISTOGRAM_BOUNDARY_EPSILON ||
+		1 - fraction < position * HISTOGRAM_BOUNDARY_EPSILON)
+		return DatumGetInt32(DirectFunctionCall4(width_bucket_float8,
+												 Float8GetDatum(val),
+												 Float8GetDatum(state->min),
+												 Float8GetDatum(state->max),
+												 Int32GetDatum(state->nbuckets - 2)));
+
+	return bucket + 1;
+}
+
+/*
+ * The bucket of a value within the bounds of a logarithmic histogram. The boundaries of the
+ * buckets are min * (max / min)^(i / nbuckets), which the logarithm of a value next to one does
+ * not necessarily end up on the right side of, so such values are compared to the boundary.
+ */
+static inline int32
+histogram_logarithmic_bucket(Histogram *state, double val)
+{
+	int32 nbuckets = state->nbuckets - 2;
+	double position = (log(val) - state->offset) * state->scale;
+	double nearest = rint(position);
+
+	if (fabs(position - nearest) < state->epsilon)
+	{
+		double boundary = state->min * pow(state->max / state->min, nearest / nbuckets);
+
+		position = val >= boundary ? nearest : nearest - 1;
+	}
+
+	return Max(1, Min((int32) position + 1, nbuckets));
+}
+
+/*
+ * The moving aggregate used in window frames cannot have a NULL state, so its transition function
+ * creates the state for a NULL value too, and its inverse transition function uncounts the value
+ * of a row leaving the frame.
+ */
+typedef enum HistogramTransition
+{
+	HISTOGRAM_ADD,
+	HISTOGRAM_MOVING_ADD,
+	HISTOGRAM_MOVING_REMOVE,
+} HistogramTransition;
+
+static Datum
+histogram_transition(FunctionCallInfo fcinfo, bool logarithmic, HistogramTransition transition)
 {
 	MemoryContext aggcontext;
 	Histogram *state = (Histogram *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
-	Datum val_datum = PG_GETARG_DATUM(1);
-	Datum min_datum = PG_GETARG_DATUM(2);
-	Datum max_datum = PG_GETARG_DATUM(3);
-	Datum nbuckets_datum = PG_GETARG_DATUM(4);
-	double min = DatumGetFloat8(min_datum);
-	double max = DatumGetFloat8(max_datum);
-	int nbuckets = DatumGetInt32(nbuckets_datum);
-	int32 bucket = DatumGetInt32(
-		DirectFunctionCall4(width_bucket_float8, val_datum, min_datum, max_datum, nbuckets_datum));
+	double val;
+	double min = PG_GETARG_FLOAT8(2);
+	double max = PG_GETARG_FLOAT8(3);
+	int32 nbuckets = PG_GETARG_INT32(4);
+	int32 bucket;
 
 	if (!AggCheckCallContext(fcinfo, &aggcontext))
 	{
@@ -65,40 +224,109 @@ ts_hist_sfunc(PG_FUNCTION_ARGS)
 		elog(ERROR, "ts_hist_sfunc called in non-aggregate context");
 	}
 
-	if (min > max)
+	if (PG_ARGISNULL(1) && (state != NULL || transition == HISTOGRAM_ADD))
 	{
-		/* cannot generate a histogram with incompatible bounds */
-		elog(ERROR, "lower bound cannot exceed upper bound");
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
 	}
 
 	if (state == NULL)
 	{
 		/* Allocate memory to a new histogram state array */
-		nbuckets += 2;
-		state = MemoryContextAllocZero(aggcontext, HISTOGRAM_SIZE(state, nbuckets));
-		state->nbuckets = nbuckets;
+		state = histogram_create(aggcontext, Max(nbuckets, 0) + 2);
+		histogram_set_bounds(state, min, max, nbuckets, logarithmic);
 	}
+	else if (min != state->min || max != state->max || nbuckets != state->nbuckets - 2)
+		histogram_set_bounds(state, min, max, nbuckets, logarithmic);
 
-	/* Increment the proper histogram bucket */
-	Assert(bucket < state->nbuckets);
-	if (DatumGetInt32(state->buckets[bucket]) >= PG_INT32_MAX - 1)
-		elog(ERROR, "overflow in histogram");
+	if (PG_ARGISNULL(1))
+		PG_RETURN_POINTER(state);
+
+	val = PG_GETARG_FLOAT8(1);
 
-	state->buckets[bucket] = Int32GetDatum(DatumGetInt32(state->buckets[bucket]) + 1);
+	if (isnan(val))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_ARGUMENT_FOR_WIDTH_BUCKET_FUNCTION),
+				 errmsg("operand, lower bound, and upper bound cannot be NaN")));
+
+	if (val < state->min)
+		bucket = 0;
+	else if (val >= state->max)
+		bucket = state->nbuckets - 1;
+	else if (logarithmic)
+		bucket = histogram_logarithmic_bucket(state, val);
+	else
+		bucket = histogram_linear_bucket(state, val);
+
+	/* Count the value in its bucket, or remove it when it leaves a moving window frame */
+	Assert(bucket < state->nbuckets);
+	if (transition == HISTOGRAM_MOVING_REMOVE)
+	{
+		Assert(state->buckets[bucket] > 0);
+		state->buckets[bucket]--;
+		state->nvalues--;
+	}
+	else
+	{
+		state->buckets[bucket]++;
+		state->nvalues++;
+	}
 
 	PG_RETURN_POINTER(state);
 }
 
+/* histogram(state, val, min, max, nbuckets) */
+Datum
+ts_hist_sfunc(PG_FUNCTION_ARGS)
+{
+	return histogram_transition(fcinfo, false, HISTOGRAM_ADD);
+}
+
+/* log_histogram(state, val, min, max, nbuckets) */
+Datum
+ts_hist_log_sfunc(PG_FUNCTION_ARGS)
+{
+	return histogram_transition(fcinfo, true, HISTOGRAM_ADD);
+}
+
+/* moving histogram(state, val, min, max, nbuckets) */
+Datum
+ts_hist_msfunc(PG_FUNCTION_ARGS)
+{
+	return histogram_transition(fcinfo, false, HISTOGRAM_MOVING_ADD);
+}
+
+/* moving log_histogram(state, val, min, max, nbuckets) */
+Datum
+ts_hist_log_msfunc(PG_FUNCTION_ARGS)
+{
+	return histogram_transition(fcinfo, true, HISTOGRAM_MOVING_ADD);
+}
+
+/* inverse of moving histogram(state, val, min, max, nbuckets) */
+Datum
+ts_hist_minvfunc(PG_FUNCTION_ARGS)
+{
+	return histogram_transition(fcinfo, false, HISTOGRAM_MOVING_REMOVE);
+}
+
+/* inverse of moving log_histogram(state, val, min, max, nbuckets) */
+Datum
+ts_hist_log_minvfunc(PG_FUNCTION_ARGS)
+{
+	return histogram_transition(fcinfo, true, HISTOGRAM_MOVING_REMOVE);
+}
+
 /* Make a copy of the histogram state */
 static inline Histogram *
 copy_state(MemoryContext aggcontext, Histogram *state)
 {
 	Histogram *copy;
-	Size bucket_bytes = state->nbuckets * sizeof(*copy->buckets);
+	Size size = HISTOGRAM_SIZE(state, state->nbuckets);
 
-	copy = MemoryContextAlloc(aggcontext, sizeof(*copy) + bucket_bytes);
-	copy->nbuckets = state->nbuckets;
-	memcpy(copy->buckets, state->buckets, bucket_bytes);
+	copy = MemoryContextAlloc(aggcontext, size);
+	memcpy(copy, state, size);
 
 	return copy;
 }
@@ -111,7 +339,7 @@ ts_hist_combinefunc(PG_FUNCTION_ARGS)
 
 	Histogram *state1 = (Histogram *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
 	Histogram *state2 = (Histogram *) (PG_ARGISNULL(1) ? NULL : PG_GETARG_POINTER(1));
-	Histogram *result;
+	int32 i;
 
 	if (!AggCheckCallContext(fcinfo, &aggcontext))
 	{
@@ -121,53 +349,62 @@ ts_hist_combinefunc(PG_FUNCTION_ARGS)
 
 	if (state2 == NULL)
 	{
-		result = copy_state(aggcontext, state1);
+		if (state1 == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state1);
 	}
 
-	else if (state1 == NULL)
-	{
-		result = copy_state(aggcontext, state2);
-	}
+	if (state1 == NULL)
+		PG_RETURN_POINTER(copy_state(aggcontext, state2));
 
-	else
-	{
-		Size i;
+	if (state1->nbuckets != state2->nbuckets)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot combine histograms with different numbers of buckets")));
 
-		Assert(state1->nbuckets == state2->nbuckets);
-		result = copy_state(aggcontext, state1);
+	/* the first state belongs to the aggregate, so it is updated in place */
+	for (i = 0; i < state1->nbuckets; i++)
+		state1->buckets[i] += state2->buckets[i];
+	state1->nvalues += state2->nvalues;
 
-		/* Combine values from state1 and state2 when both states are non-null */
-		for (i = 0; i < state1->nbuckets; i++)
-		{
-			/* Perform addition using int64 to check for overflow */
-			int64 val = (int64) DatumGetInt32(result->buckets[i]);
-			int64 other = (int64) DatumGetInt32(state2->buckets[i]);
-			if (val + other >= PG_INT32_MAX)
-				elog(ERROR, "overflow in histogram combine");
-
-			result->buckets[i] = Int32GetDatum((int32)(val + other));
-		}
-	}
-
-	PG_RETURN_POINTER(result);
+	PG_RETURN_POINTER(state1);
 }
 
-/* ts_hist_serializefunc(internal) => bytea */
+/*
+ * ts_hist_serializefunc(internal) => bytea
+ *
+ * The counts are serialized as int32 unless one of them does not fit, in which case the number
+ * of buckets is serialized negated and followed by int64 counts.
+ */
 Datum
 ts_hist_serializefunc(PG_FUNCTION_ARGS)
 {
 	Histogram *state;
-	Size i;
+	int32 i;
+	bool wide = false;
 	StringInfoData buf;
 
 	Assert(!PG_ARGISNULL(0));
 	state = (Histogram *) PG_GETARG_POINTER(0);
 
+	for (i = 0; i < state->nbuckets; i++)
+		if (state->buckets[i] > PG_INT32_MAX)
+			wide = true;
+
 	pq_begintypsend(&buf);
-	pq_sendint(&buf, state->nbuckets, 4);
 
-	for (i = 0; i < state->nbuckets; i++)
-		pq_sendint(&buf, DatumGetInt32(state->buckets[i]), 4);
+	if (wide)
+	{
+		pq_sendint(&buf, -state->nbuckets, 4);
+		for (i = 0; i < state->nbuckets; i++)
+			pq_sendint64(&buf, state->buckets[i]);
+	}
+	else
+	{
+		pq_sendint(&buf, state->nbuckets, 4);
+		for (i = 0; i < state->nbuckets; i++)
+			pq_sendint(&buf, (int32) state->buckets[i], 4);
+	}
 
 	PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
 }
@@ -179,6 +416,7 @@ ts_hist_deserializefunc(PG_FUNCTION_ARGS)
 	MemoryContext aggcontext;
 	bytea *serialized;
 	int32 nbuckets;
+	bool wide;
 	int32 i;
 	StringInfoData buf;
 	Histogram *state;
@@ -195,12 +433,17 @@ ts_hist_deserializefunc(PG_FUNCTION_ARGS)
 	buf.cursor = 0; /* used by pq_getmsgint*/
 
 	nbuckets = pq_getmsgint(&buf, 4);
+	wide = nbuckets < 0;
+	if (wide)
+		nbuckets = -nbuckets;
 
-	state = MemoryContextAllocZero(aggcontext, HISTOGRAM_SIZE(state, nbuckets));
-	state->nbuckets = nbuckets;
+	state = histogram_create(aggcontext, nbuckets);
 
 	for (i = 0; i < state->nbuckets; i++)
-		state->buckets[i] = Int32GetDatum(pq_getmsgint(&buf, 4));
+	{
+		state->buckets[i] = wide ? pq_getmsgint64(&buf) : (int32) pq_getmsgint(&buf, 4);
+		state->nvalues += state->buckets[i];
+	}
 
 	PG_RETURN_POINTER(state);
 }
@@ -210,8 +453,10 @@ Datum
 ts_hist_finalfunc(PG_FUNCTION_ARGS)
 {
 	Histogram *state;
+	Datum *counts;
 	int dims[1];
 	int lbs[1];
+	int32 i;
 
 	if (!AggCheckCallContext(fcinfo, NULL))
 	{
@@ -221,12 +466,49 @@ ts_hist_finalfunc(PG_FUNCTION_ARGS)
 
 	state = (Histogram *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
 
-	if (state == NULL)
+	if (state == NULL || state->nvalues == 0)
 		PG_RETURN_NULL();
 
+	counts = palloc(state->nbuckets * sizeof(*counts));
+
+	for (i = 0; i < state->nbuckets; i++)
+	{
+		if (state->buckets[i] > PG_INT32_MAX)
+			elog(ERROR, "overflow in histogram");
+
+		counts[i] = Int32GetDatum((int32) state->buckets[i]);
+	}
+
 	dims[0] = state->nbuckets;
 	lbs[0] = 1;
 
+	PG_RETURN_ARRAYTYPE_P(construct_md_array(counts, NULL, 1, dims, lbs, INT4OID, 4, true, 'i'));
+}
+
+/* hist_log_finalfunc(internal) => BIGINT[] */
+Datum
+ts_hist_log_finalfunc(PG_FUNCTION_ARGS)
+{
+	Histogram *state;
+	Datum *counts;
+	int32 i;
+
+	if (!AggCheckCallContext(fcinfo, NULL))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_hist_log_finalfunc called in non-aggregate context");
+	}
+
+	state = (Histogram *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+
+	if (state == NULL || state->nvalues == 0)
+		PG_RETURN_NULL();
+
+	counts = palloc(state->nbuckets * sizeof(*counts));
+
+	for (i = 0; i < state->nbuckets; i++)
+		counts[i] = Int64GetDatum(state->buckets[i]);
+
 	PG_RETURN_ARRAYTYPE_P(
-		construct_md_array(state->buckets, NULL, 1, dims, lbs, INT4OID, 4, true, 'i'));
+		construct_array(counts, state->nbuckets, INT8OID, 8, FLOAT8PASSBYVAL, 'd'));
 }
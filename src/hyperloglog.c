@@ -0,0 +1,606 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#include <postgres.h>
+#include <math.h>
+#include <fmgr.h>
+#include <lib/stringinfo.h>
+#include <libpq/pqformat.h>
+#include <utils/builtins.h>
+#include <utils/lsyscache.h>
+#include <utils/typcache.h>
+
+#include "compat.h"
+
+/* aggregate hyperloglog:
+ *	 hyperloglog(value [, precision]) returns a sketch of the distinct values
+ *	 hyperloglog_union(sketch) merges sketches into one
+ *	 approx_count_distinct(sketch) returns the approximate number of distinct values
+ *
+ * Usage:
+ *	 SELECT approx_count_distinct(hyperloglog(device_id)) FROM metrics;
+ *	 SELECT approx_count_distinct(hyperloglog_union(devices)) FROM hourly_devices;
+ *
+ * Description:
+ * The values are hashed with the hash function of their type, so values that are equal are
+ * counted once, like with count(DISTINCT). The first precision bits of a hash select one of
+ * 2^precision registers, and the register keeps the highest position of the first set bit in the
+ * remaining bits of the hashes it was selected by. The number of distinct values is estimated
+ * from the harmonic mean of the registers, with a standard error of about
+ * 1.04 / sqrt(2^precision), i.e., 0.8% at the default precision of 14. Since the hashes are
+ * 32 bits wide, the estimate is corrected for hash collisions above about 10^8 distinct values.
+ *
+ * Unlike count(DISTINCT), sketches are combined by taking the maximum of every register, which
+ * gives the same sketch as aggregating all of the values at once. The aggregate therefore
+ * supports parallel aggregation and continuous aggregates, and sketches of smaller time buckets
+ * can be unioned into sketches of larger ones.
+ *
+ * A sketch of few distinct values is kept sparse, as a sorted list of its non-empty registers,
+ * and only becomes dense, with one byte per register, when that would take less space.
+ */
+
+TS_FUNCTION_INFO_V1(ts_hyperloglog_sfunc);
+TS_FUNCTION_INFO_V1(ts_hyperloglog_union_sfunc);
+TS_FUNCTION_INFO_V1(ts_hyperloglog_combinefunc);
+TS_FUNCTION_INFO_V1(ts_hyperloglog_serializefunc);
+TS_FUNCTION_INFO_V1(ts_hyperloglog_deserializefunc);
+TS_FUNCTION_INFO_V1(ts_hyperloglog_finalfunc);
+TS_FUNCTION_INFO_V1(ts_approx_count_distinct);
+
+#define HLL_FORMAT_VERSION 1
+#define HLL_FORMAT_SPARSE 0
+#define HLL_FORMAT_DENSE 1
+#define HLL_DEFAULT_PRECISION 14
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 16
+#define HLL_HASH_BITS 32
+#define HLL_INITIAL_SPARSE 16
+
+/* sparse entries hold the register index in the upper bits and its value in the lowest byte */
+#define HLL_ENTRY(index, value) (((uint32)(index) << 8) | (uint32)(value))
+#define HLL_ENTRY_INDEX(entry) ((entry) >> 8)
+#define HLL_ENTRY_VALUE(entry) ((uint8)((entry) & 0xFF))
+
+typedef struct HyperLogLog
+{
+	int32 precision;
+	int32 nregisters;
+	/* the registers if the sketch is dense, NULL while it is sparse */
+	uint8 *registers;
+	/* the sparse entries, the first nsorted of which are sorted and have distinct indexes */
+	int32 nsparse;
+	int32 nsorted;
+	int32 maxsparse;
+	uint32 *sparse;
+} HyperLogLog;
+
+/* a sparse sketch takes four bytes per register, so it stops paying off at a quarter of them */
+static inline int32
+hll_max_sparse(HyperLogLog *hll)
+{
+	return hll->nregisters / 4;
+}
+
+static HyperLogLog *
+hll_create(MemoryContext mcxt, int32 precision)
+{
+	HyperLogLog *hll;
+
+	if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("precision of hyperloglog must be between %d and %d",
+						HLL_MIN_PRECISION,
+						HLL_MAX_PRECISION)));
+
+	hll = MemoryContextAllocZero(mcxt, sizeof(*hll));
+	hll->precision = precision;
+	hll->nregisters = 1 << precision;
+	hll->maxsparse = Min(HLL_INITIAL_SPARSE, hll_max_sparse(hll));
+	hll->sparse = MemoryContextAlloc(mcxt, hll->maxsparse * sizeof(*hll->sparse));
+
+	return hll;
+}
+
+/* the highest register value, for the hash bits left after the index */
+static inline uint8
+hll_max_value(HyperLogLog *hll)
+{
+	return HLL_HASH_BITS - hll->precision + 1;
+}
+
+static int
+sparse_entry_cmp(const void *left, const void *right)
+{
+	uint32 l = *((const uint32 *) left);
+	uint32 r = *((const uint32 *) right);
+
+	return (l > r) - (l < r);
+}
+
+/* sort the sparse entries and keep the highest value of every register */
+static void
+hll_compact(HyperLogLog *hll)
+{
+	int32 n = 0;
+	int32 i;
+
+	if (hll->nsorted == hll->nsparse)
+		return;
+
+	qsort(hll->sparse, hll->nsparse, sizeof(*hll->sparse), sparse_entry_cmp);
+
+	for (i = 0; i < hll->nsparse; i++)
+	{
+		/* entries of the same register are sorted by value, so the last one is kept */
+		if (n > 0 && HLL_ENTRY_INDEX(hll->sparse[n - 1]) == HLL_ENTRY_INDEX(hll->sparse[i]))
+			n--;
+		hll->sparse[n++] = hll->sparse[i];
+	}
+
+	hll->nsparse = n;
+	hll->nsorted = n;
+}
+
+static void
+hll_densify(HyperLogLog *hll, MemoryContext mcxt)
+{
+	int32 i;
+
+	hll->registers = MemoryContextAllocZero(mcxt, hll->nregisters);
+
+	for (i = 0; i < hll->nsparse; i++)
+	{
+		uint32 index = HLL_ENTRY_INDEX(hll->sparse[i]);
+
+		hll->registers[index] = Max(hll->registers[index], HLL_ENTRY_VALUE(hll->sparse[i]));
+	}
+
+	pfree(hll->sparse);
+	hll->sparse = NULL;
+	hll->nsparse = hll->nsorted = hll->maxsparse = 0;
+}
+
+static void
+hll_set_register(HyperLogLog *hll, uint32 index, uint8 value, MemoryContext mcxt)
+{
+	if (hll->registers != NULL)
+	{
+		hll->registers[index] = Max(hll->registers[index], value);
+		return;
+	}
+
+	if (hll->nsparse == hll->maxsparse)
+	{
+		hll_compact(hll);
+
+		if (hll->nsparse == hll_max_sparse(hll))
+		{
+			hll_densify(hll, mcxt);
+			hll->registers[index] = Max(hll->registers[index], value);
+			return;
+		}
+
+		/* grow the list if compacting it did not free enough room */
+		if (hll->nsparse > hll->maxsparse / 2 && hll->maxsparse < hll_max_sparse(hll))
+		{
+			hll->maxsparse = Min(hll->maxsparse * 2, hll_max_sparse(hll));
+			hll->sparse = repalloc(hll->sparse, hll->maxsparse * sizeof(*hll->sparse));
+		}
+	}
+
+	hll->sparse[hll->nsparse++] = HLL_ENTRY(index, value);
+}
+
+static inline void
+hll_add_hash(HyperLogLog *hll, uint32 hash, MemoryContext mcxt)
+{
+	uint32 index = hash >> (HLL_HASH_BITS - hll->precision);
+	uint32 remaining = hash << hll->precision;
+	uint8 value = 1;
+
+	/* the position of the first set bit, or one past the last bit if none is set */
+	while (value < hll_max_value(hll) && (remaining & 0x80000000) == 0)
+	{
+		remaining <<= 1;
+		value++;
+	}
+
+	hll_set_register(hll, index, value, mcxt);
+}
+
+static void
+hll_merge(HyperLogLog *hll, HyperLogLog *other, MemoryContext mcxt)
+{
+	int32 i;
+
+	if (hll->precision != other->precision)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot combine hyperloglogs with different precisions")));
+
+	if (other->registers != NULL)
+	{
+		if (hll->registers == NULL)
+			hll_densify(hll, mcxt);
+
+		for (i = 0; i < hll->nregisters; i++)
+			hll->registers[i] = Max(hll->registers[i], other->registers[i]);
+	}
+	else
+	{
+		for (i = 0; i < other->nsparse; i++)
+			hll_set_register(hll,
+							 HLL_ENTRY_INDEX(other->sparse[i]),
+							 HLL_ENTRY_VALUE(other->sparse[i]),
+							 mcxt);
+	}
+}
+
+static HyperLogLog *
+hll_copy(MemoryContext mcxt, HyperLogLog *hll)
+{
+	HyperLogLog *copy = hll_create(mcxt, hll->precision);
+
+	hll_merge(copy, hll, mcxt);
+
+	return copy;
+}
+
+static inline double
+hll_alpha(int32 nregisters)
+{
+	switch (nregisters)
+	{
+		case 16:
+			return 0.673;
+		case 32:
+			return 0.697;
+		case 64:
+			return 0.709;
+		default:
+			return 0.7213 / (1.0 + 1.079 / nregisters);
+	}
+}
+
+static double
+hll_estimate(HyperLogLog *hll)
+{
+	double m = hll->nregisters;
+	double sum = 0;
+	int32 zeros = 0;
+	double estimate;
+	const double two_to_32 = 4294967296.0;
+	int32 i;
+
+	if (hll->registers != NULL)
+	{
+		for (i = 0; i < hll->nregisters; i++)
+		{
+			sum += ldexp(1.0, -hll->registers[i]);
+			if (hll->registers[i] == 0)
+				zeros++;
+		}
+	}
+	else
+	{
+		hll_compact(hll);
+
+		zeros = hll->nregisters - hll->nsparse;
+		sum = zeros;
+		for (i = 0; i < hll->nsparse; i++)
+			sum += ldexp(1.0, -HLL_ENTRY_VALUE(hll->sparse[i]));
+	}
+
+	estimate = hll_alpha(hll->nregisters) * m * m / sum;
+
+	/* small cardinalities are estimated better from the number of empty registers */
+	if (estimate <= 2.5 * m && zeros > 0)
+		return m * log(m / zeros);
+
+	/* large cardinalities are corrected for collisions of the 32-bit hashes */
+	if (estimate > two_to_32 / 30.0)
+		return -two_to_32 * log(1.0 - estimate / two_to_32);
+
+	return estimate;
+}
+
+static bytea *
+hll_serialize(HyperLogLog *hll)
+{
+	StringInfoData buf;
+	int32 i;
+
+	pq_begintypsend(&buf);
+	pq_sendbyte(&buf, HLL_FORMAT_VERSION);
+	pq_sendbyte(&buf, hll->precision);
+
+	if (hll->registers == NULL)
+		hll_compact(hll);
+
+	if (hll->registers == NULL && hll->nsparse < hll_max_sparse(hll))
+	{
+		pq_sendbyte(&buf, HLL_FORMAT_SPARSE);
+		pq_sendint(&buf, hll->nsparse, 4);
+		for (i = 0; i < hll->nsparse; i++)
+			pq_sendint(&buf, hll->sparse[i], 4);
+	}
+	else if (hll->registers == NULL)
+	{
+		/*
+		 * A full sparse list is serialized like the dense sketch it would turn into, so that equal
+		 * sketches serialize the same no matter the order their values were added in.
+		 */
+		uint8 *registers = palloc0(hll->nregisters);
+
+		for (i = 0; i < hll->nsparse; i++)
+			registers[HLL_ENTRY_INDEX(hll->sparse[i])] = HLL_ENTRY_VALUE(hll->sparse[i]);
+
+		pq_sendbyte(&buf, HLL_FORMAT_DENSE);
+		pq_sendbytes(&buf, (char *) registers, hll->nregisters);
+		pfree(registers);
+	}
+	else
+	{
+		pq_sendbyte(&buf, HLL_FORMAT_DENSE);
+		pq_sendbytes(&buf, (char *) hll->registers, hll->nregisters);
+	}
+
+	return pq_endtypsend(&buf);
+}
+
+/*
+ * Sketches are also passed to approx_count_distinct as plain bytea, so the serialized form is
+ * checked for consistency.
+ */
+static HyperLogLog *
+hll_deserialize(bytea *serialized, MemoryContext mcxt)
+{
+	StringInfoData buf;
+	HyperLogLog *hll;
+	int32 precision;
+	int32 i;
+
+	buf.data = VARDATA_ANY(serialized);
+	buf.len = VARSIZE_ANY_EXHDR(serialized);
+	buf.maxlen = buf.len;
+	buf.cursor = 0;
+
+	if (pq_getmsgbyte(&buf) != HLL_FORMAT_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid hyperloglog version")));
+
+	precision = pq_getmsgbyte(&buf);
+
+	if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid hyperloglog")));
+
+	hll = hll_create(mcxt, precision);
+
+	switch (pq_getmsgbyte(&buf))
+	{
+		case HLL_FORMAT_DENSE:
+			hll_densify(hll, mcxt);
+			memcpy(hll->registers, pq_getmsgbytes(&buf, hll->nregisters), hll->nregisters);
+
+			for (i = 0; i < hll->nregisters; i++)
+				if (hll->registers[i] > hll_max_value(hll))
+					ereport(ERROR,
+							(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+							 errmsg("invalid hyperloglog")));
+			break;
+		case HLL_FORMAT_SPARSE:
+		{
+			int32 nsparse = pq_getmsgint(&buf, 4);
+
+			if (nsparse < 0 || nsparse > hll_max_sparse(hll))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						 errmsg("invalid hyperloglog")));
+
+			if (nsparse > hll->maxsparse)
+			{
+				hll->maxsparse = nsparse;
+				hll->sparse = repalloc(hll->sparse, hll->maxsparse * sizeof(*hll->sparse));
+			}
+
+			for (i = 0; i < nsparse; i++)
+			{
+				uint32 entry = pq_getmsgint(&buf, 4);
+
+				if (HLL_ENTRY_INDEX(entry) >= (uint32) hll->nregisters ||
+					HLL_ENTRY_VALUE(entry) == 0 || HLL_ENTRY_VALUE(entry) > hll_max_value(hll) ||
+					(i > 0 && HLL_ENTRY_INDEX(entry) <= HLL_ENTRY_INDEX(hll->sparse[i - 1])))
+					ereport(ERROR,
+							(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+							 errmsg("invalid hyperloglog")));
+
+				hll->sparse[i] = entry;
+			}
+
+			hll->nsparse = hll->nsorted = nsparse;
+			break;
+		}
+		default:
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid hyperloglog")));
+	}
+
+	pq_getmsgend(&buf);
+
+	return hll;
+}
+
+/* hyperloglog(state, value [, precision]) */
+Datum
+ts_hyperloglog_sfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	HyperLogLog *state = (HyperLogLog *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	TypeCacheEntry *tce = fcinfo->flinfo->fn_extra;
+	Datum hash;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_hyperloglog_sfunc called in non-aggregate context");
+	}
+
+	if (PG_ARGISNULL(1))
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	if (tce == NULL)
+	{
+		Oid argtype = get_fn_expr_argtype(fcinfo->flinfo, 1);
+
+		tce = lookup_type_cache(argtype, TYPECACHE_HASH_PROC_FINFO);
+
+		if (!OidIsValid(tce->hash_proc))
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_FUNCTION),
+					 errmsg("could not identify a hash function for type %s",
+							format_type_be(argtype))));
+
+		fcinfo->flinfo->fn_extra = tce;
+	}
+
+	if (state == NULL)
+	{
+		int32 precision = HLL_DEFAULT_PRECISION;
+
+		if (PG_NARGS() > 2)
+		{
+			if (PG_ARGISNULL(2))
+				ereport(ERROR,
+						(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+						 errmsg("precision of hyperloglog cannot be NULL")));
+			precision = PG_GETARG_INT32(2);
+		}
+
+		state = hll_create(aggcontext, precision);
+	}
+
+	hash = FunctionCall1Coll(&tce->hash_proc_finfo, PG_GET_COLLATION(), PG_GETARG_DATUM(1));
+	hll_add_hash(state, DatumGetUInt32(hash), aggcontext);
+
+	PG_RETURN_POINTER(state);
+}
+
+/* hyperloglog_union(state, sketch) */
+Datum
+ts_hyperloglog_union_sfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	HyperLogLog *state = (HyperLogLog *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	HyperLogLog *sketch;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_hyperloglog_union_sfunc called in non-aggregate context");
+	}
+
+	if (PG_ARGISNULL(1))
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	sketch = hll_deserialize(PG_GETARG_BYTEA_PP(1), aggcontext);
+
+	if (state == NULL)
+		PG_RETURN_POINTER(sketch);
+
+	hll_merge(state, sketch, aggcontext);
+
+	PG_RETURN_POINTER(state);
+}
+
+/* ts_hyperloglog_combinefunc(internal, internal) => internal */
+Datum
+ts_hyperloglog_combinefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	HyperLogLog *state1 = (HyperLogLog *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	HyperLogLog *state2 = (HyperLogLog *) (PG_ARGISNULL(1) ? NULL : PG_GETARG_POINTER(1));
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_hyperloglog_combinefunc called in non-aggregate context");
+	}
+
+	if (state2 == NULL)
+	{
+		if (state1 == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state1);
+	}
+
+	if (state1 == NULL)
+		PG_RETURN_POINTER(hll_copy(aggcontext, state2));
+
+	/* the first state belongs to the aggregate, so it is updated in place */
+	hll_merge(state1, state2, aggcontext);
+
+	PG_RETURN_POINTER(state1);
+}
+
+/* ts_hyperloglog_serializefunc(internal) => bytea */
+Datum
+ts_hyperloglog_serializefunc(PG_FUNCTION_ARGS)
+{
+	Assert(!PG_ARGISNULL(0));
+
+	PG_RETURN_BYTEA_P(hll_serialize((HyperLogLog *) PG_GETARG_POINTER(0)));
+}
+
+/* ts_hyperloglog_deserializefunc(bytea, internal) => internal */
+Datum
+ts_hyperloglog_deserializefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "ts_hyperloglog_deserializefunc called in non-aggregate context");
+
+	Assert(!PG_ARGISNULL(0));
+
+	PG_RETURN_POINTER(hll_deserialize(PG_GETARG_BYTEA_PP(0), aggcontext));
+}
+
+/* ts_hyperloglog_finalfunc(internal) => bytea */
+Datum
+ts_hyperloglog_finalfunc(PG_FUNCTION_ARGS)
+{
+	if (!AggCheckCallContext(fcinfo, NULL))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_hyperloglog_finalfunc called in non-aggregate context");
+	}
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	PG_RETURN_BYTEA_P(hll_serialize((HyperLogLog *) PG_GETARG_POINTER(0)));
+}
+
+/* approx_count_distinct(sketch BYTEA) => BIGINT */
+Datum
+ts_approx_count_distinct(PG_FUNCTION_ARGS)
+{
+	HyperLogLog *hll = hll_deserialize(PG_GETARG_BYTEA_PP(0), CurrentMemoryContext);
+
+	PG_RETURN_INT64((int64) rint(hll_estimate(hll)));
+}
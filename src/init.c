@@ -20,6 +20,7 @@
 #include "config.h"
 #include "license_guc.h"
 #include "constraint_aware_append.h"
+#include "skip_scan.h"
 
 #ifdef PG_MODULE_MAGIC
 PG_MODULE_MAGIC;
@@ -31,6 +32,9 @@ extern void _hypertable_cache_fini(void);
 extern void _cache_invalidate_init(void);
 extern void _cache_invalidate_fini(void);
 
+extern void _invalidation_threshold_cache_init(void);
+extern void _invalidation_threshold_cache_fini(void);
+
 extern void _cache_init(void);
 extern void _cache_fini(void);
 
@@ -75,8 +79,10 @@ _PG_init(void)
 	_cache_init();
 	_hypertable_cache_init();
 	_cache_invalidate_init();
+	_invalidation_threshold_cache_init();
 	_planner_init();
 	_constraint_aware_append_init();
+	_skip_scan_init();
 	_event_trigger_init();
 	_process_utility_init();
 	_guc_init();
@@ -107,6 +113,7 @@ _PG_fini(void)
 	_process_utility_fini();
 	_event_trigger_fini();
 	_planner_fini();
+	_invalidation_threshold_cache_fini();
 	_cache_invalidate_fini();
 	_hypertable_cache_fini();
 	_cache_fini();
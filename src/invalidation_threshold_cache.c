@@ -0,0 +1,202 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#include <postgres.h>
+#include <access/xact.h>
+#include <commands/trigger.h>
+#include <fmgr.h>
+#include <miscadmin.h>
+#include <utils/memutils.h>
+#include <utils/rel.h>
+
+#include "catalog.h"
+#include "compat.h"
+#include "invalidation_threshold_cache.h"
+
+/*
+ * Access to the cache of invalidation thresholds in shared memory. The cache only exists if the
+ * loader was in shared_preload_libraries; without it every lookup misses and the catalog is read
+ * instead. See src/loader/invalidation_threshold_cache.c for how the cache works.
+ *
+ * Entries are reset once the transaction changing their threshold commits, since a reader could
+ * otherwise add the old threshold again before then. A backend reading the cache stays registered
+ * as reader until the end of its transaction.
+ */
+static InvalidationThresholdCacheInterface *threshold_cache = NULL;
+
+/* the hypertables whose entries are reset at commit, in TopTransactionContext */
+static List *pending_resets = NIL;
+static Oid pending_resets_relid = InvalidOid;
+/* the catalog table whose entries are all reset at commit, if any */
+static Oid pending_reset_all_relid = InvalidOid;
+
+static bool reader_registered = false;
+static uint32 reader_epoch;
+
+static InvalidationThresholdCacheInterface *
+threshold_cache_get_interface(void)
+{
+	if (threshold_cache == NULL)
+	{
+		InvalidationThresholdCacheInterface **interfaceptr =
+			(InvalidationThresholdCacheInterface **) find_rendezvous_variable(
+				RENDEZVOUS_INVALIDATION_THRESHOLD_CACHE);
+
+		if (*interfaceptr != NULL &&
+			(*interfaceptr)->version == INVALIDATION_THRESHOLD_CACHE_INTERFACE_VERSION)
+			threshold_cache = *interfaceptr;
+	}
+
+	return threshold_cache;
+}
+
+static Oid
+threshold_catalog_relid(void)
+{
+	return catalog_get_table_id(ts_catalog_get(), CONTINUOUS_AGGS_INVALIDATION_THRESHOLD);
+}
+
+/* our own uncommitted changes of the threshold are only in the catalog */
+static bool
+threshold_reset_pending(int32 hypertable_id)
+{
+	return OidIsValid(pending_reset_all_relid) || list_member_int(pending_resets, hypertable_id);
+}
+
+/*
+ * Get the cached invalidation threshold of the hypertable, without taking any lock. On a miss,
+ * the generation is to be passed to ts_invalidation_threshold_cache_set with the threshold read
+ * from the catalog.
+ */
+TSDLLEXPORT bool
+ts_invalidation_threshold_cache_get(int32 hypertable_id, int64 *threshold, uint32 *generation)
+{
+	InvalidationThresholdCacheInterface *cache = threshold_cache_get_interface();
+
+	*generation = 0;
+
+	if (cache == NULL || threshold_reset_pending(hypertable_id))
+		return false;
+
+	if (!reader_registered)
+	{
+		reader_epoch = cache->reader_enter();
+		reader_registered = true;
+	}
+
+	return cache->get(MyDatabaseId, threshold_catalog_relid(), hypertable_id, threshold, generation);
+}
+
+/* Cache the invalidation threshold of the hypertable, as read from the catalog */
+TSDLLEXPORT void
+ts_invalidation_threshold_cache_set(int32 hypertable_id, int64 threshold, uint32 generation)
+{
+	InvalidationThresholdCacheInterface *cache = threshold_cache_get_interface();
+
+	if (cache != NULL && reader_registered && !threshold_reset_pending(hypertable_id))
+		cache->set(MyDatabaseId, threshold_catalog_relid(), hypertable_id, threshold, generation);
+}
+
+/*
+ * Reset the cached invalidation threshold of the hypertable once the transaction commits. This
+ * must be called whenever its threshold changes in the catalog.
+ */
+TSDLLEXPORT void
+ts_invalidation_threshold_cache_reset(int32 hypertable_id)
+{
+	MemoryContext old;
+
+	if (threshold_cache_get_interface() == NULL || list_member_int(pending_resets, hypertable_id))
+		return;
+
+	/* the catalog cannot be read once the transaction commits */
+	pending_resets_relid = threshold_catalog_relid();
+	old = MemoryContextSwitchTo(TopTransactionContext);
+	pending_resets = lappend_int(pending_resets, hypertable_id);
+	MemoryContextSwitchTo(old);
+}
+
+/*
+ * Wait until every transaction which may have read a threshold from the cache before the last
+ * committed reset has ended. Must be called without a transaction, since the readers may need
+ * the locks it would hold.
+ */
+TSDLLEXPORT void
+ts_invalidation_threshold_cache_wait_for_readers(void)
+{
+	InvalidationThresholdCacheInterface *cache = threshold_cache_get_interface();
+
+	Assert(!IsTransactionState());
+
+	if (cache != NULL)
+		cache->wait_for_readers();
+}
+
+TS_FUNCTION_INFO_V1(ts_invalidation_threshold_cache_reset_trigger);
+
+/*
+ * Statement trigger on the invalidation threshold table, so that modifying the catalog with SQL
+ * resets the cache as well. Our own catalog updates do not fire triggers, and reset the entries
+ * they change themselves.
+ */
+Datum
+ts_invalidation_threshold_cache_reset_trigger(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "invalidation threshold cache reset: not called by trigger manager");
+
+	if (threshold_cache_get_interface() != NULL)
+		pending_reset_all_relid = RelationGetRelid(trigdata->tg_relation);
+
+	PG_RETURN_NULL();
+}
+
+static void
+threshold_cache_xact_end(XactEvent event, void *arg)
+{
+	/* there is nothing to do unless the cache was used, so it was found already */
+	InvalidationThresholdCacheInterface *cache = threshold_cache;
+	ListCell *lc;
+
+	if (cache == NULL)
+		return;
+
+	switch (event)
+	{
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+		/* prepared transactions commit elsewhere, so this is as late as they can reset */
+		case XACT_EVENT_PREPARE:
+			if (OidIsValid(pending_reset_all_relid))
+				cache->reset_all(MyDatabaseId, pending_reset_all_relid);
+			foreach (lc, pending_resets)
+				cache->reset(MyDatabaseId, pending_resets_relid, lfirst_int(lc));
+			/* FALLTHROUGH */
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+			if (reader_registered)
+				cache->reader_exit(reader_epoch);
+			reader_registered = false;
+			pending_resets = NIL;
+			pending_reset_all_relid = InvalidOid;
+			break;
+		default:
+			break;
+	}
+}
+
+void
+_invalidation_threshold_cache_init(void)
+{
+	RegisterXactCallback(threshold_cache_xact_end, NULL);
+}
+
+void
+_invalidation_threshold_cache_fini(void)
+{
+	UnregisterXactCallback(threshold_cache_xact_end, NULL);
+}
@@ -0,0 +1,44 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_INVALIDATION_THRESHOLD_CACHE_H
+#define TIMESCALEDB_INVALIDATION_THRESHOLD_CACHE_H
+
+#include <postgres.h>
+
+#include "export.h"
+
+/*
+ * The invalidation thresholds of the hypertables with continuous aggregates are cached in shared
+ * memory, which is allocated by the loader. The loader publishes the functions operating on the
+ * cache in a rendezvous variable, so that the versioned extension does not depend on the layout
+ * of the cache. Entries are keyed by database, the relid of the invalidation threshold catalog
+ * table (which changes when the extension is recreated), and hypertable.
+ */
+#define RENDEZVOUS_INVALIDATION_THRESHOLD_CACHE "timescaledb.invalidation_threshold_cache"
+#define INVALIDATION_THRESHOLD_CACHE_INTERFACE_VERSION 2
+
+typedef struct InvalidationThresholdCacheInterface
+{
+	int32 version;
+	bool (*get)(Oid database_id, Oid catalog_relid, int32 hypertable_id, int64 *threshold,
+				uint32 *generation);
+	void (*set)(Oid database_id, Oid catalog_relid, int32 hypertable_id, int64 threshold,
+				uint32 generation);
+	void (*reset)(Oid database_id, Oid catalog_relid, int32 hypertable_id);
+	void (*reset_all)(Oid database_id, Oid catalog_relid);
+	uint32 (*reader_enter)(void);
+	void (*reader_exit)(uint32 epoch);
+	void (*wait_for_readers)(void);
+} InvalidationThresholdCacheInterface;
+
+extern TSDLLEXPORT bool ts_invalidation_threshold_cache_get(int32 hypertable_id, int64 *threshold,
+															uint32 *generation);
+extern TSDLLEXPORT void ts_invalidation_threshold_cache_set(int32 hypertable_id, int64 threshold,
+															uint32 generation);
+extern TSDLLEXPORT void ts_invalidation_threshold_cache_reset(int32 hypertable_id);
+extern TSDLLEXPORT void ts_invalidation_threshold_cache_wait_for_readers(void);
+
+#endif /* TIMESCALEDB_INVALIDATION_THRESHOLD_CACHE_H */
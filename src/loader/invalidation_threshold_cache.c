@@ -0,0 +1,366 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#include <postgres.h>
+
+#include <access/hash.h>
+#include <fmgr.h>
+#include <miscadmin.h>
+#include <port/atomics.h>
+#include <storage/ipc.h>
+#include <storage/lwlock.h>
+#include <storage/shmem.h>
+
+#include "invalidation_threshold_cache.h"
+#include "../invalidation_threshold_cache.h"
+
+#define INVALIDATION_THRESHOLD_CACHE_NAME "ts_invalidation_threshold_cache"
+#define INVALIDATION_THRESHOLD_CACHE_TRANCHE_NAME "ts_invalidation_threshold_cache_tranche"
+
+/* the cache is an open addressing hash table with linear probing */
+#define INVALIDATION_THRESHOLD_CACHE_SIZE 1024
+#define INVALIDATION_THRESHOLD_CACHE_MAX_PROBES 32
+
+/*
+ * Committing transactions read the invalidation threshold of every hypertable with continuous
+ * aggregates they modified. Instead of scanning the catalog each time, they read the threshold
+ * from this cache without taking any lock, and only scan the catalog on a miss, adding what they
+ * found to the cache. The catalog stays authoritative: whoever changes a threshold in the catalog
+ * resets its entry once the change is committed.
+ *
+ * The entries are written under the lock, and read lock-free: the change count of an entry is
+ * odd while it is being written, and readers retry until they read the same even change count
+ * before and after reading the entry. Resetting an entry leaves a tombstone, which a later entry
+ * can reuse, so that lookups can still stop at the first entry which was never used. If none of
+ * the INVALIDATION_THRESHOLD_CACHE_MAX_PROBES entries after the hash of a key is free, the first
+ * one is evicted.
+ *
+ * A threshold read from the catalog is only added if no entry was reset since the reader
+ * started its lookup, as it may have read the catalog before the change causing the reset was
+ * committed. Every reset bumps the generation of the cache for this.
+ *
+ * Committers must not miss a threshold being moved while they still have to log their
+ * invalidations below it. They register as readers in the current epoch before reading the
+ * cache, and stay registered until the end of their transaction. Once the materializer has
+ * committed a new threshold, and its entry was reset, it starts a new epoch and waits until all
+ * readers of the previous epoch are gone. The readers of the new epoch find the new threshold.
+ */
+typedef struct ThresholdCacheKey
+{
+	Oid database_id;
+	Oid catalog_relid;
+	int32 hypertable_id;
+} ThresholdCacheKey;
+
+typedef struct ThresholdCacheEntry
+{
+	pg_atomic_uint32 changecount;
+	/* the database_id is InvalidOid if the entry was never used */
+	ThresholdCacheKey key;
+	/* the entry is a tombstone if not valid */
+	bool valid;
+	int64 threshold;
+} ThresholdCacheEntry;
+
+typedef struct ThresholdCache
+{
+	LWLock *lock;
+	pg_atomic_uint32 generation;
+	pg_atomic_uint32 epoch;
+	/* the number of readers registered in even and odd epochs */
+	pg_atomic_uint32 readers[2];
+	ThresholdCacheEntry entries[INVALIDATION_THRESHOLD_CACHE_SIZE];
+} ThresholdCache;
+
+static ThresholdCache *tc = NULL;
+
+static inline uint32
+key_hash(ThresholdCacheKey *key)
+{
+	return DatumGetUInt32(hash_any((unsigned char *) key, sizeof(*key)));
+}
+
+static inline bool
+key_equal(ThresholdCacheKey *key1, ThresholdCacheKey *key2)
+{
+	return key1->database_id == key2->database_id && key1->catalog_relid == key2->catalog_relid &&
+		   key1->hypertable_id == key2->hypertable_id;
+}
+
+static inline ThresholdCacheEntry *
+entry_at(uint32 hash, int probe)
+{
+	return &tc->entries[(hash + probe) % INVALIDATION_THRESHOLD_CACHE_SIZE];
+}
+
+/* read a consistent copy of an entry, without the lock */
+static void
+entry_read(ThresholdCacheEntry *entry, ThresholdCacheEntry *copy)
+{
+	for (;;)
+	{
+		uint32 before = pg_atomic_read_u32(&entry->changecount);
+		uint32 after;
+
+		if (before & 1)
+		{
+			pg_spin_delay();
+			continue;
+		}
+
+		pg_read_barrier();
+		copy->key = entry->key;
+		copy->valid = entry->valid;
+		copy->threshold = entry->threshold;
+		pg_read_barrier();
+
+		after = pg_atomic_read_u32(&entry->changecount);
+		if (before == after)
+			return;
+	}
+}
+
+/* must hold the lock exclusively */
+static void
+entry_write(ThresholdCacheEntry *entry, ThresholdCacheKey *key, bool valid, int64 threshold)
+{
+	/* the atomic increments are full barriers */
+	pg_atomic_fetch_add_u32(&entry->changecount, 1);
+	entry->key = *key;
+	entry->valid = valid;
+	entry->threshold = threshold;
+	pg_atomic_fetch_add_u32(&entry->changecount, 1);
+}
+
+/* find the entry of the key, or NULL if it is not cached; must hold the lock */
+static ThresholdCacheEntry *
+entry_find(ThresholdCacheKey *key)
+{
+	uint32 hash = key_hash(key);
+	int probe;
+
+	for (probe = 0; probe < INVALIDATION_THRESHOLD_CACHE_MAX_PROBES; probe++)
+	{
+		ThresholdCacheEntry *entry = entry_at(hash, probe);
+
+		if (!OidIsValid(entry->key.database_id))
+			return NULL;
+
+		if (key_equal(&entry->key, key))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+ * Find the entry of the key, or the entry it should be added to: the first tombstone or unused
+ * entry, or else the one to evict; must hold the lock
+ */
+static ThresholdCacheEntry *
+entry_find_free(ThresholdCacheKey *key)
+{
+	uint32 hash = key_hash(key);
+	ThresholdCacheEntry *free_entry = NULL;
+	int probe;
+
+	for (probe = 0; probe < INVALIDATION_THRESHOLD_CACHE_MAX_PROBES; probe++)
+	{
+		ThresholdCacheEntry *entry = entry_at(hash, probe);
+
+		if (!OidIsValid(entry->key.database_id))
+			return free_entry != NULL ? free_entry : entry;
+
+		if (key_equal(&entry->key, key))
+			return entry;
+
+		if (!entry->valid && free_entry == NULL)
+			free_entry = entry;
+	}
+
+	return free_entry != NULL ? free_entry : entry_at(hash, 0);
+}
+
+/*
+ * Register as reader until threshold_cache_reader_exit is called with the returned epoch. The
+ * epoch is checked again after registering, since a reader counted in an epoch that already
+ * ended would not be waited for.
+ */
+static uint32
+threshold_cache_reader_enter(void)
+{
+	for (;;)
+	{
+		uint32 epoch = pg_atomic_read_u32(&tc->epoch);
+
+		pg_atomic_fetch_add_u32(&tc->readers[epoch % 2], 1);
+		if (pg_atomic_read_u32(&tc->epoch) == epoch)
+			return epoch;
+		pg_atomic_fetch_sub_u32(&tc->readers[epoch % 2], 1);
+	}
+}
+
+static void
+threshold_cache_reader_exit(uint32 epoch)
+{
+	pg_atomic_fetch_sub_u32(&tc->readers[epoch % 2], 1);
+}
+
+/* start a new epoch and wait until the readers of the previous one are gone */
+static void
+threshold_cache_wait_for_readers(void)
+{
+	uint32 epoch = pg_atomic_fetch_add_u32(&tc->epoch, 1);
+
+	while (pg_atomic_read_u32(&tc->readers[epoch % 2]) != 0)
+	{
+		CHECK_FOR_INTERRUPTS();
+		pg_usleep(1000L);
+	}
+}
+
+/*
+ * Look up the cached threshold. The generation is that of the cache before the lookup, to add
+ * what the caller then reads from the catalog with.
+ */
+static bool
+threshold_cache_get(Oid database_id, Oid catalog_relid, int32 hypertable_id, int64 *threshold,
+					uint32 *generation)
+{
+	ThresholdCacheKey key = {
+		.database_id = database_id,
+		.catalog_relid = catalog_relid,
+		.hypertable_id = hypertable_id,
+	};
+	uint32 hash = key_hash(&key);
+	int probe;
+
+	*generation = pg_atomic_read_u32(&tc->generation);
+	pg_read_barrier();
+
+	for (probe = 0; probe < INVALIDATION_THRESHOLD_CACHE_MAX_PROBES; probe++)
+	{
+		ThresholdCacheEntry entry;
+
+		entry_read(entry_at(hash, probe), &entry);
+
+		if (!OidIsValid(entry.key.database_id))
+			return false;
+
+		if (entry.valid && key_equal(&entry.key, &key))
+		{
+			*threshold = entry.threshold;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void
+threshold_cache_set(Oid database_id, Oid catalog_relid, int32 hypertable_id, int64 threshold,
+					uint32 generation)
+{
+	ThresholdCacheKey key = {
+		.database_id = database_id,
+		.catalog_relid = catalog_relid,
+		.hypertable_id = hypertable_id,
+	};
+
+	LWLockAcquire(tc->lock, LW_EXCLUSIVE);
+	if (pg_atomic_read_u32(&tc->generation) == generation)
+		entry_write(entry_find_free(&key), &key, true, threshold);
+	LWLockRelease(tc->lock);
+}
+
+static void
+threshold_cache_reset(Oid database_id, Oid catalog_relid, int32 hypertable_id)
+{
+	ThresholdCacheKey key = {
+		.database_id = database_id,
+		.catalog_relid = catalog_relid,
+		.hypertable_id = hypertable_id,
+	};
+	ThresholdCacheEntry *entry;
+
+	LWLockAcquire(tc->lock, LW_EXCLUSIVE);
+	pg_atomic_fetch_add_u32(&tc->generation, 1);
+	entry = entry_find(&key);
+	if (entry != NULL && entry->valid)
+		entry_write(entry, &key, false, 0);
+	LWLockRelease(tc->lock);
+}
+
+static void
+threshold_cache_reset_all(Oid database_id, Oid catalog_relid)
+{
+	int i;
+
+	LWLockAcquire(tc->lock, LW_EXCLUSIVE);
+	pg_atomic_fetch_add_u32(&tc->generation, 1);
+	for (i = 0; i < INVALIDATION_THRESHOLD_CACHE_SIZE; i++)
+	{
+		ThresholdCacheEntry *entry = &tc->entries[i];
+
+		if (entry->valid && entry->key.database_id == database_id &&
+			entry->key.catalog_relid == catalog_relid)
+			entry_write(entry, &entry->key, false, 0);
+	}
+	LWLockRelease(tc->lock);
+}
+
+static const InvalidationThresholdCacheInterface threshold_cache_interface = {
+	.version = INVALIDATION_THRESHOLD_CACHE_INTERFACE_VERSION,
+	.get = threshold_cache_get,
+	.set = threshold_cache_set,
+	.reset = threshold_cache_reset,
+	.reset_all = threshold_cache_reset_all,
+	.reader_enter = threshold_cache_reader_enter,
+	.reader_exit = threshold_cache_reader_exit,
+	.wait_for_readers = threshold_cache_wait_for_readers,
+};
+
+/*
+ * This gets called by the loader (and therefore the postmaster) at
+ * shared_preload_libraries time
+ */
+extern void
+ts_invalidation_threshold_cache_shmem_alloc(void)
+{
+	RequestAddinShmemSpace(sizeof(ThresholdCache));
+	RequestNamedLWLockTranche(INVALIDATION_THRESHOLD_CACHE_TRANCHE_NAME, 1);
+}
+
+/*
+ * Called in the shmem_startup_hook. The interface is only published once the cache exists, so
+ * that without the loader in shared_preload_libraries the versioned extension always reads the
+ * catalog.
+ */
+extern void
+ts_invalidation_threshold_cache_shmem_startup(void)
+{
+	void **interfaceptr = find_rendezvous_variable(RENDEZVOUS_INVALIDATION_THRESHOLD_CACHE);
+	bool found;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	tc = ShmemInitStruct(INVALIDATION_THRESHOLD_CACHE_NAME, sizeof(ThresholdCache), &found);
+	if (!found)
+	{
+		int i;
+
+		memset(tc, 0, sizeof(ThresholdCache));
+		tc->lock = &(GetNamedLWLockTranche(INVALIDATION_THRESHOLD_CACHE_TRANCHE_NAME))->lock;
+		pg_atomic_init_u32(&tc->generation, 0);
+		pg_atomic_init_u32(&tc->epoch, 0);
+		pg_atomic_init_u32(&tc->readers[0], 0);
+		pg_atomic_init_u32(&tc->readers[1], 0);
+		for (i = 0; i < INVALIDATION_THRESHOLD_CACHE_SIZE; i++)
+			pg_atomic_init_u32(&tc->entries[i].changecount, 0);
+	}
+	LWLockRelease(AddinShmemInitLock);
+
+	/* Cast away the const to store in the rendezvous variable */
+	*interfaceptr = (void *) &threshold_cache_interface;
+}
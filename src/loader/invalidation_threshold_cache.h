@@ -0,0 +1,17 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_LOADER_INVALIDATION_THRESHOLD_CACHE_H
+#define TIMESCALEDB_LOADER_INVALIDATION_THRESHOLD_CACHE_H
+
+#include <postgres.h>
+
+/* called at server startup */
+extern void ts_invalidation_threshold_cache_shmem_alloc(void);
+
+/* called in every backend during shmem startup hook */
+extern void ts_invalidation_threshold_cache_shmem_startup(void);
+
+#endif /* TIMESCALEDB_LOADER_INVALIDATION_THRESHOLD_CACHE_H */
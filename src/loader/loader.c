@@ -31,6 +31,7 @@
 #include "bgw_launcher.h"
 #include "bgw_message_queue.h"
 #include "bgw_interface.h"
+#include "invalidation_threshold_cache.h"
 
 /*
  * Loading process:
@@ -470,6 +471,7 @@ timescale_shmem_startup_hook(void)
 		prev_shmem_startup_hook();
 	ts_bgw_counter_shmem_startup();
 	ts_bgw_message_queue_shmem_startup();
+	ts_invalidation_threshold_cache_shmem_startup();
 }
 
 static void
@@ -493,6 +495,7 @@ _PG_init(void)
 
 	ts_bgw_counter_shmem_alloc();
 	ts_bgw_message_queue_alloc();
+	ts_invalidation_threshold_cache_shmem_alloc();
 	ts_bgw_cluster_launcher_register();
 	ts_bgw_counter_setup_gucs();
 	ts_bgw_interface_register_api_version();
@@ -0,0 +1,615 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#include <postgres.h>
+#include <math.h>
+#include <fmgr.h>
+#include <lib/stringinfo.h>
+#include <libpq/pqformat.h>
+#include <utils/builtins.h>
+
+#include "compat.h"
+
+/* aggregate percentile_sketch:
+ *	 percentile_sketch(value [, relative_error]) returns a sketch of the distribution of value
+ *	 percentile_sketch_rollup(sketch) merges sketches into one
+ *	 approx_percentile(percentile, sketch) returns the approximate value at percentile
+ *	 approx_percentile_rank(value, sketch) returns the approximate fraction of values <= value
+ *
+ * Usage:
+ *	 SELECT approx_percentile(0.99, percentile_sketch(latency)) FROM requests;
+ *	 SELECT approx_percentile(0.99, percentile_sketch_rollup(sketch)) FROM hourly_latencies;
+ *
+ * Description:
+ * The sketch is a relative error sketch: values are counted in logarithmically sized buckets,
+ * such that every value within a bucket is within relative_error of the bucket's representative
+ * value. Percentiles computed from the sketch therefore have a relative error of at most
+ * relative_error, no matter the distribution of the values. Unlike percentile_cont, sketches can
+ * be combined by adding up the counts of their buckets, so the aggregate supports parallel
+ * aggregation and continuous aggregates, and sketches of smaller time buckets can be rolled up
+ * into sketches of larger ones.
+ *
+ * Positive and negative values are counted in separate stores, keyed by the bucket of their
+ * absolute value, and zeros are counted separately. Every store keeps the SKETCH_MAX_BINS
+ * buckets up to the one of its largest absolute value, which is a ratio of about 6e17 between
+ * the largest and smallest absolute value at the default relative error of 1%. The buckets of
+ * smaller absolute values are collapsed into the lowest one kept, which loses accuracy only for
+ * those values. Since the buckets kept only depend on the largest value, the counts do not depend
+ * on the order in which values are added and sketches are combined.
+ */
+
+TS_FUNCTION_INFO_V1(ts_percentile_sketch_sfunc);
+TS_FUNCTION_INFO_V1(ts_percentile_sketch_rollup_sfunc);
+TS_FUNCTION_INFO_V1(ts_percentile_sketch_combinefunc);
+TS_FUNCTION_INFO_V1(ts_percentile_sketch_serializefunc);
+TS_FUNCTION_INFO_V1(ts_percentile_sketch_deserializefunc);
+TS_FUNCTION_INFO_V1(ts_percentile_sketch_finalfunc);
+TS_FUNCTION_INFO_V1(ts_approx_percentile);
+TS_FUNCTION_INFO_V1(ts_approx_percentile_rank);
+
+#define SKETCH_FORMAT_VERSION 1
+#define SKETCH_DEFAULT_RELATIVE_ERROR 0.01
+#define SKETCH_MIN_RELATIVE_ERROR 0.0001
+#define SKETCH_MAX_RELATIVE_ERROR 0.5
+#define SKETCH_MAX_BINS 2048
+/* keys of finite values are well within this bound for the smallest relative error */
+#define SKETCH_MAX_KEY (1 << 24)
+/* bins added beyond the new key when a store grows, to amortize growing it */
+#define SKETCH_STORE_GROWTH 64
+
+typedef struct SketchStore
+{
+	int32 offset; /* key of bins[0] */
+	int32 nbins;
+	int32 max_key; /* the largest key added, the bins above it are empty */
+	int64 *bins;
+} SketchStore;
+
+typedef struct PercentileSketch
+{
+	double relative_error;
+	double gamma;
+	double log_gamma;
+	int64 count;
+	int64 zero_count;
+	double min;
+	double max;
+	SketchStore positive;
+	SketchStore negative;
+} PercentileSketch;
+
+static PercentileSketch *
+sketch_create(MemoryContext mcxt, double relative_error)
+{
+	PercentileSketch *sketch;
+
+	if (isnan(relative_error) || relative_error < SKETCH_MIN_RELATIVE_ERROR ||
+		relative_error > SKETCH_MAX_RELATIVE_ERROR)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("relative error of percentile sketch must be between %g and %g",
+						SKETCH_MIN_RELATIVE_ERROR,
+						SKETCH_MAX_RELATIVE_ERROR)));
+
+	sketch = MemoryContextAllocZero(mcxt, sizeof(*sketch));
+	sketch->relative_error = relative_error;
+	sketch->gamma = (1.0 + relative_error) / (1.0 - relative_error);
+	sketch->log_gamma = log(sketch->gamma);
+	sketch->min = get_float8_infinity();
+	sketch->max = -get_float8_infinity();
+
+	return sketch;
+}
+
+/* the key of the bucket containing the positive value */
+static inline int32
+sketch_key(PercentileSketch *sketch, double value)
+{
+	return (int32) ceil(log(value) / sketch->log_gamma);
+}
+
+/* the representative value of a bucket, within relative_error of every value in the bucket */
+static inline double
+sketch_bucket_value(PercentileSketch *sketch, int32 key)
+{
+	return 2.0 * exp(key * sketch->log_gamma) / (sketch->gamma + 1.0);
+}
+
+static inline int32
+store_high(SketchStore *store)
+{
+	return store->offset + store->nbins - 1;
+}
+
+/*
+ * Make the store cover the keys from low to high, where high is the largest key being added. The
+ * buckets more than SKETCH_MAX_BINS below the largest key of the store are collapsed into the
+ * lowest one kept.
+ */
+static void
+store_extend(SketchStore *store, int32 low, int32 high, MemoryContext mcxt)
+{
+	int64 new_low = low;
+	int64 new_high = high;
+	int64 max_key = high;
+	int64 limit;
+	int64 *bins;
+	int32 i;
+
+	if (store->nbins > 0)
+	{
+		new_low = Min(new_low, store->offset);
+		new_high = Max(new_high, store_high(store));
+		max_key = Max(max_key, store->max_key);
+	}
+
+	limit = max_key - SKETCH_MAX_BINS + 1;
+
+	if (new_low < limit)
+		new_low = limit;
+	else if (store->nbins > 0 && new_low < store->offset)
+		new_low = Max(new_low - SKETCH_STORE_GROWTH, limit);
+	else if (store->nbins == 0 || new_high > store_high(store))
+		new_high += SKETCH_STORE_GROWTH;
+
+	if (store->nbins > 0 && new_low == store->offset && new_high == store_high(store))
+	{
+		store->max_key = (int32) max_key;
+		return;
+	}
+
+	bins = MemoryContextAllocZero(mcxt, (new_high - new_low + 1) * sizeof(*bins));
+
+	for (i = 0; i < store->nbins; i++)
+	{
+		int64 key = Max(store->offset + i, new_low);
+
+		bins[key - new_low] += store->bins[i];
+	}
+
+	if (store->bins != NULL)
+		pfree(store->bins);
+
+	store->bins = bins;
+	store->offset = (int32) new_low;
+	store->nbins = (int32)(new_high - new_low + 1);
+	store->max_key = (int32) max_key;
+}
+
+static inline void
+store_add(SketchStore *store, int32 key, int64 count, MemoryContext mcxt)
+{
+	store_extend(store, key, key, mcxt);
+	store->bins[Max(key, store->offset) - store->offset] += count;
+}
+
+static void
+store_merge(SketchStore *store, SketchStore *other, MemoryContext mcxt)
+{
+	int32 i;
+
+	if (other->nbins == 0)
+		return;
+
+	store_extend(store, other->offset, other->max_key, mcxt);
+
+	for (i = 0; other->offset + i <= other->max_key; i++)
+	{
+		int32 key = Max(other->offset + i, store->offset);
+
+		store->bins[key - store->offset] += other->bins[i];
+	}
+}
+
+static void
+sketch_add(PercentileSketch *sketch, double value, MemoryContext mcxt)
+{
+	if (isnan(value) || isinf(value))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot add non-finite value to percentile sketch")));
+
+	if (value > 0)
+		store_add(&sketch->positive, sketch_key(sketch, value), 1, mcxt);
+	else if (value < 0)
+		store_add(&sketch->negative, sketch_key(sketch, -value), 1, mcxt);
+	else
+		sketch->zero_count++;
+
+	sketch->count++;
+	sketch->min = Min(sketch->min, value);
+	sketch->max = Max(sketch->max, value);
+}
+
+static void
+sketch_merge(PercentileSketch *sketch, PercentileSketch *other, MemoryContext mcxt)
+{
+	if (sketch->relative_error != other->relative_error)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot combine percentile sketches with different relative errors")));
+
+	store_merge(&sketch->positive, &other->positive, mcxt);
+	store_merge(&sketch->negative, &other->negative, mcxt);
+	sketch->zero_count += other->zero_count;
+	sketch->count += other->count;
+	sketch->min = Min(sketch->min, other->min);
+	sketch->max = Max(sketch->max, other->max);
+}
+
+static PercentileSketch *
+sketch_copy(MemoryContext mcxt, PercentileSketch *sketch)
+{
+	PercentileSketch *copy = sketch_create(mcxt, sketch->relative_error);
+
+	sketch_merge(copy, sketch, mcxt);
+
+	return copy;
+}
+
+/* only the non-empty buckets are serialized, as (key, count) pairs */
+static void
+store_serialize(StringInfo buf, SketchStore *store)
+{
+	int32 nonempty = 0;
+	int32 i;
+
+	for (i = 0; i < store->nbins; i++)
+		if (store->bins[i] != 0)
+			nonempty++;
+
+	pq_sendint(buf, nonempty, 4);
+
+	for (i = 0; i < store->nbins; i++)
+	{
+		if (store->bins[i] == 0)
+			continue;
+
+		pq_sendint(buf, store->offset + i, 4);
+		pq_sendint64(buf, store->bins[i]);
+	}
+}
+
+static int64
+store_deserialize(StringInfo buf, SketchStore *store, MemoryContext mcxt)
+{
+	int32 nonempty = pq_getmsgint(buf, 4);
+	int64 total = 0;
+	int32 low = 0;
+	int32 i;
+
+	if (nonempty < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid percentile sketch")));
+
+	for (i = 0; i < nonempty; i++)
+	{
+		int32 key = pq_getmsgint(buf, 4);
+		int64 count = pq_getmsgint64(buf);
+
+		if ((i > 0 && key <= low) || key > SKETCH_MAX_KEY || key < -SKETCH_MAX_KEY || count <= 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid percentile sketch")));
+
+		store_add(store, key, count, mcxt);
+		low = key;
+		total += count;
+	}
+
+	return total;
+}
+
+static bytea *
+sketch_serialize(PercentileSketch *sketch)
+{
+	StringInfoData buf;
+
+	pq_begintypsend(&buf);
+	pq_sendbyte(&buf, SKETCH_FORMAT_VERSION);
+	pq_sendfloat8(&buf, sketch->relative_error);
+	pq_sendint64(&buf, sketch->count);
+	pq_sendint64(&buf, sketch->zero_count);
+	pq_sendfloat8(&buf, sketch->min);
+	pq_sendfloat8(&buf, sketch->max);
+	store_serialize(&buf, &sketch->positive);
+	store_serialize(&buf, &sketch->negative);
+
+	return pq_endtypsend(&buf);
+}
+
+/*
+ * Sketches are also passed to the accessor functions as plain bytea, so the serialized form is
+ * checked for consistency.
+ */
+static PercentileSketch *
+sketch_deserialize(bytea *serialized, MemoryContext mcxt)
+{
+	StringInfoData buf;
+	PercentileSketch *sketch;
+	int64 count;
+	int64 total;
+
+	buf.data = VARDATA_ANY(serialized);
+	buf.len = VARSIZE_ANY_EXHDR(serialized);
+	buf.maxlen = buf.len;
+	buf.cursor = 0;
+
+	if (pq_getmsgbyte(&buf) != SKETCH_FORMAT_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid percentile sketch version")));
+
+	sketch = sketch_create(mcxt, pq_getmsgfloat8(&buf));
+	count = pq_getmsgint64(&buf);
+	sketch->zero_count = pq_getmsgint64(&buf);
+	sketch->min = pq_getmsgfloat8(&buf);
+	sketch->max = pq_getmsgfloat8(&buf);
+	total = sketch->zero_count;
+	total += store_deserialize(&buf, &sketch->positive, mcxt);
+	total += store_deserialize(&buf, &sketch->negative, mcxt);
+	pq_getmsgend(&buf);
+
+	if (count <= 0 || sketch->zero_count < 0 || total != count || !(sketch->min <= sketch->max))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid percentile sketch")));
+
+	sketch->count = count;
+
+	return sketch;
+}
+
+/* the value of the rank-th (0-based) smallest value, in ascending order of the buckets */
+static double
+sketch_value_at_rank(PercentileSketch *sketch, double rank)
+{
+	double cumulative = 0;
+	int32 i;
+
+	for (i = sketch->negative.nbins - 1; i >= 0; i--)
+	{
+		cumulative += sketch->negative.bins[i];
+		if (cumulative > rank)
+			return -sketch_bucket_value(sketch, sketch->negative.offset + i);
+	}
+
+	cumulative += sketch->zero_count;
+	if (cumulative > rank)
+		return 0;
+
+	for (i = 0; i < sketch->positive.nbins; i++)
+	{
+		cumulative += sketch->positive.bins[i];
+		if (cumulative > rank)
+			return sketch_bucket_value(sketch, sketch->positive.offset + i);
+	}
+
+	return sketch->max;
+}
+
+/* the number of values in the buckets up to and including the bucket of value */
+static int64
+sketch_count_up_to(PercentileSketch *sketch, double value)
+{
+	int64 count = 0;
+	int32 i;
+
+	if (value < 0)
+	{
+		int32 key = sketch_key(sketch, -value);
+
+		for (i = 0; i < sketch->negative.nbins; i++)
+			if (sketch->negative.offset + i >= key)
+				count += sketch->negative.bins[i];
+
+		return count;
+	}
+
+	for (i = 0; i < sketch->negative.nbins; i++)
+		count += sketch->negative.bins[i];
+
+	count += sketch->zero_count;
+
+	if (value > 0)
+	{
+		int32 key = sketch_key(sketch, value);
+
+		for (i = 0; i < sketch->positive.nbins && sketch->positive.offset + i <= key; i++)
+			count += sketch->positive.bins[i];
+	}
+
+	return count;
+}
+
+/* percentile_sketch(state, value [, relative_error]) */
+Datum
+ts_percentile_sketch_sfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	PercentileSketch *state = (PercentileSketch *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_percentile_sketch_sfunc called in non-aggregate context");
+	}
+
+	if (PG_ARGISNULL(1))
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	if (state == NULL)
+	{
+		double relative_error = SKETCH_DEFAULT_RELATIVE_ERROR;
+
+		if (PG_NARGS() > 2)
+		{
+			if (PG_ARGISNULL(2))
+				ereport(ERROR,
+						(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+						 errmsg("relative error of percentile sketch cannot be NULL")));
+			relative_error = PG_GETARG_FLOAT8(2);
+		}
+
+		state = sketch_create(aggcontext, relative_error);
+	}
+
+	sketch_add(state, PG_GETARG_FLOAT8(1), aggcontext);
+
+	PG_RETURN_POINTER(state);
+}
+
+/* percentile_sketch_rollup(state, sketch) */
+Datum
+ts_percentile_sketch_rollup_sfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	PercentileSketch *state = (PercentileSketch *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	PercentileSketch *sketch;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_percentile_sketch_rollup_sfunc called in non-aggregate context");
+	}
+
+	if (PG_ARGISNULL(1))
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	sketch = sketch_deserialize(PG_GETARG_BYTEA_PP(1), aggcontext);
+
+	if (state == NULL)
+		PG_RETURN_POINTER(sketch);
+
+	sketch_merge(state, sketch, aggcontext);
+
+	PG_RETURN_POINTER(state);
+}
+
+/* ts_percentile_sketch_combinefunc(internal, internal) => internal */
+Datum
+ts_percentile_sketch_combinefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	PercentileSketch *state1 = (PercentileSketch *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	PercentileSketch *state2 = (PercentileSketch *) (PG_ARGISNULL(1) ? NULL : PG_GETARG_POINTER(1));
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_percentile_sketch_combinefunc called in non-aggregate context");
+	}
+
+	if (state2 == NULL)
+	{
+		if (state1 == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state1);
+	}
+
+	if (state1 == NULL)
+		PG_RETURN_POINTER(sketch_copy(aggcontext, state2));
+
+	/* the first state belongs to the aggregate, so it is updated in place */
+	sketch_merge(state1, state2, aggcontext);
+
+	PG_RETURN_POINTER(state1);
+}
+
+/* ts_percentile_sketch_serializefunc(internal) => bytea */
+Datum
+ts_percentile_sketch_serializefunc(PG_FUNCTION_ARGS)
+{
+	Assert(!PG_ARGISNULL(0));
+
+	PG_RETURN_BYTEA_P(sketch_serialize((PercentileSketch *) PG_GETARG_POINTER(0)));
+}
+
+/* ts_percentile_sketch_deserializefunc(bytea, internal) => internal */
+Datum
+ts_percentile_sketch_deserializefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "ts_percentile_sketch_deserializefunc called in non-aggregate context");
+
+	Assert(!PG_ARGISNULL(0));
+
+	PG_RETURN_POINTER(sketch_deserialize(PG_GETARG_BYTEA_PP(0), aggcontext));
+}
+
+/* ts_percentile_sketch_finalfunc(internal) => bytea */
+Datum
+ts_percentile_sketch_finalfunc(PG_FUNCTION_ARGS)
+{
+	if (!AggCheckCallContext(fcinfo, NULL))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_percentile_sketch_finalfunc called in non-aggregate context");
+	}
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	PG_RETURN_BYTEA_P(sketch_serialize((PercentileSketch *) PG_GETARG_POINTER(0)));
+}
+
+/* approx_percentile(percentile DOUBLE PRECISION, sketch BYTEA) => DOUBLE PRECISION */
+Datum
+ts_approx_percentile(PG_FUNCTION_ARGS)
+{
+	double percentile = PG_GETARG_FLOAT8(0);
+	PercentileSketch *sketch;
+	double value;
+
+	if (isnan(percentile) || percentile < 0 || percentile > 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("percentile %g is not between 0 and 1", percentile)));
+
+	sketch = sketch_deserialize(PG_GETARG_BYTEA_PP(1), CurrentMemoryContext);
+
+	if (percentile == 0)
+		PG_RETURN_FLOAT8(sketch->min);
+	if (percentile == 1)
+		PG_RETURN_FLOAT8(sketch->max);
+
+	value = sketch_value_at_rank(sketch, percentile * (sketch->count - 1));
+
+	/* the representative value of a bucket may lie outside of the values seen */
+	PG_RETURN_FLOAT8(Max(sketch->min, Min(value, sketch->max)));
+}
+
+/* approx_percentile_rank(value DOUBLE PRECISION, sketch BYTEA) => DOUBLE PRECISION */
+Datum
+ts_approx_percentile_rank(PG_FUNCTION_ARGS)
+{
+	double value = PG_GETARG_FLOAT8(0);
+	PercentileSketch *sketch;
+
+	if (isnan(value))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot compute the rank of NaN")));
+
+	sketch = sketch_deserialize(PG_GETARG_BYTEA_PP(1), CurrentMemoryContext);
+
+	if (value < sketch->min)
+		PG_RETURN_FLOAT8(0);
+	if (value >= sketch->max)
+		PG_RETURN_FLOAT8(1);
+
+	PG_RETURN_FLOAT8((double) sketch_count_up_to(sketch, value) / sketch->count);
+}
@@ -4,6 +4,7 @@
  * LICENSE-APACHE for a copy of the license.
  */
 #include <postgres.h>
+#include <access/stratnum.h>
 #include <nodes/plannodes.h>
 #include <parser/parsetree.h>
 #include <parser/parse_oper.h>
@@ -18,6 +19,7 @@
 #include <utils/timestamp.h>
 #include <utils/lsyscache.h>
 #include <utils/selfuncs.h>
+#include <utils/typcache.h>
 
 #include "compat-msvc-enter.h"
 #include <optimizer/cost.h>
@@ -144,6 +146,48 @@ static CustomEstimateForFunctionInfo custom_estimate_func_info[] = {
 		.arg_types = { INT8OID, INT8OID, INT8OID },
 		.custom_group_estimate_func = custom_group_estimate_time_bucket,
 	},
+	{
+		.extension_function = true,
+		.function_name = "time_bucket_gapfill",
+		.nargs = 4,
+		.arg_types = { INT2OID, INT2OID, INT2OID, INT2OID },
+		.custom_group_estimate_func = custom_group_estimate_time_bucket_gapfill,
+	},
+	{
+		.extension_function = true,
+		.function_name = "time_bucket_gapfill",
+		.nargs = 4,
+		.arg_types = { INT4OID, INT4OID, INT4OID, INT4OID },
+		.custom_group_estimate_func = custom_group_estimate_time_bucket_gapfill,
+	},
+	{
+		.extension_function = true,
+		.function_name = "time_bucket_gapfill",
+		.nargs = 4,
+		.arg_types = { INT8OID, INT8OID, INT8OID, INT8OID },
+		.custom_group_estimate_func = custom_group_estimate_time_bucket_gapfill,
+	},
+	{
+		.extension_function = true,
+		.function_name = "time_bucket_gapfill",
+		.nargs = 4,
+		.arg_types = { INTERVALOID, DATEOID, DATEOID, DATEOID },
+		.custom_group_estimate_func = custom_group_estimate_time_bucket_gapfill,
+	},
+	{
+		.extension_function = true,
+		.function_name = "time_bucket_gapfill",
+		.nargs = 4,
+		.arg_types = { INTERVALOID, TIMESTAMPOID, TIMESTAMPOID, TIMESTAMPOID },
+		.custom_group_estimate_func = custom_group_estimate_time_bucket_gapfill,
+	},
+	{
+		.extension_function = true,
+		.function_name = "time_bucket_gapfill",
+		.nargs = 4,
+		.arg_types = { INTERVALOID, TIMESTAMPTZOID, TIMESTAMPTZOID, TIMESTAMPTZOID },
+		.custom_group_estimate_func = custom_group_estimate_time_bucket_gapfill,
+	},
 	{
 		.function_name = "date_trunc",
 		.nargs = 2,
@@ -339,40 +383,142 @@ custom_group_estimate_expr_interval(PlannerInfo *root, Expr *expr, double interv
 	return clamp_row_est(max_period / interval_period);
 }
 
-/* For time_bucket this estimate currently works by seeing how many possible
- * buckets there will be if the data spans the entire hypertable. Note that
- * this is an overestimate.
- * */
+/* the bucket width of time_bucket in the internal time unit */
 static double
-custom_group_estimate_time_bucket(PlannerInfo *root, FuncExpr *expr, double path_rows)
+estimate_bucket_width(PlannerInfo *root, Node *width)
 {
-	Node *first_arg = eval_const_expressions(root, linitial(expr->args));
-	Expr *second_arg = lsecond(expr->args);
 	Const *c;
-	double period;
 
-	if (!IsA(first_arg, Const))
+	width = eval_const_expressions(root, width);
+	if (!IsA(width, Const) || castNode(Const, width)->constisnull)
 		return INVALID_ESTIMATE;
 
-	c = (Const *) first_arg;
+	c = (Const *) width;
 	switch (c->consttype)
 	{
 		case INT2OID:
-			period = (double) DatumGetInt16(c->constvalue);
-			break;
+			return (double) DatumGetInt16(c->constvalue);
 		case INT4OID:
-			period = (double) DatumGetInt32(c->constvalue);
-			break;
+			return (double) DatumGetInt32(c->constvalue);
 		case INT8OID:
-			period = (double) DatumGetInt64(c->constvalue);
-			break;
+			return (double) DatumGetInt64(c->constvalue);
 		case INTERVALOID:
-			period = (double) ts_get_interval_period_approx(DatumGetIntervalP(c->constvalue));
-			break;
+			return (double) ts_get_interval_period_approx(DatumGetIntervalP(c->constvalue));
 		default:
 			return INVALID_ESTIMATE;
 	}
-	return custom_group_estimate_expr_interval(root, second_arg, period);
+}
+
+/* For time_bucket this estimate currently works by seeing how many possible
+ * buckets there will be if the data spans the entire hypertable. Note that
+ * this is an overestimate.
+ * */
+static double
+custom_group_estimate_time_bucket(PlannerInfo *root, FuncExpr *expr, double path_rows)
+{
+	return custom_group_estimate_expr_interval(root,
+											   lsecond(expr->args),
+											   estimate_bucket_width(root, linitial(expr->args)));
+}
+
+/* Check that the relation of the time column is restricted by "var <op> bound",
+ * where <op> is the btree operator of the strategy for the type of the column.
+ * */
+static bool
+time_column_is_restricted(PlannerInfo *root, Var *var, Const *bound, int16 strategy)
+{
+	TypeCacheEntry *tce;
+	RelOptInfo *rel;
+	Oid opno;
+	ListCell *lc;
+
+	if (var->varlevelsup != 0 || var->varno >= (Index) root->simple_rel_array_size ||
+		bound->consttype != var->vartype)
+		return false;
+
+	rel = root->simple_rel_array[var->varno];
+	if (rel == NULL || rel->reloptkind != RELOPT_BASEREL)
+		return false;
+
+	tce = lookup_type_cache(var->vartype, TYPECACHE_BTREE_OPFAMILY);
+	if (!OidIsValid(tce->btree_opf))
+		return false;
+
+	opno = get_opfamily_member(tce->btree_opf, var->vartype, var->vartype, strategy);
+	if (!OidIsValid(opno))
+		return false;
+
+	foreach (lc, rel->baserestrictinfo)
+	{
+		OpExpr *op = (OpExpr *) ((RestrictInfo *) lfirst(lc))->clause;
+
+		if (IsA(op, OpExpr) && op->opno == opno && list_length(op->args) == 2 &&
+			equal(linitial(op->args), var) && equal(lsecond(op->args), bound))
+			return true;
+	}
+	return false;
+}
+
+/* For time_bucket_gapfill the number of buckets between start and finish is
+ * known when the relation of the time column is restricted to the gapfill
+ * range, e.g. by timescaledb.enable_gapfill_restriction. Without the
+ * restriction rows outside of the range form additional groups, so no
+ * estimate is given. The restriction quals of the relation are checked since
+ * the gapfill range is not added as restriction if the time argument is not
+ * a column, the relation is on the nullable side of an outer join or a bound
+ * has a different type than the column.
+ * */
+static double
+custom_group_estimate_time_bucket_gapfill(PlannerInfo *root, FuncExpr *expr, double path_rows)
+{
+	Node *ts;
+	Node *start;
+	Node *finish;
+	TimevalInfinity start_infinite = TimevalFinite;
+	TimevalInfinity finish_infinite = TimevalFinite;
+	int64 start_value;
+	int64 finish_value;
+	double period;
+
+	if (list_length(expr->args) != 4)
+		return INVALID_ESTIMATE;
+
+	ts = lsecond(expr->args);
+	if (!IsA(ts, Var))
+		return INVALID_ESTIMATE;
+
+	period = estimate_bucket_width(root, linitial(expr->args));
+	if (!IS_VALID_ESTIMATE(period) || period <= 0)
+		return INVALID_ESTIMATE;
+
+	start = eval_const_expressions(root, lthird(expr->args));
+	finish = eval_const_expressions(root, lfourth(expr->args));
+	if (!IsA(start, Const) || castNode(Const, start)->constisnull || !IsA(finish, Const) ||
+		castNode(Const, finish)->constisnull)
+		return INVALID_ESTIMATE;
+
+	start_value = ts_time_value_to_internal_or_infinite(castNode(Const, start)->constvalue,
+														castNode(Const, start)->consttype,
+														&start_infinite);
+	finish_value = ts_time_value_to_internal_or_infinite(castNode(Const, finish)->constvalue,
+														 castNode(Const, finish)->consttype,
+														 &finish_infinite);
+	if (start_infinite != TimevalFinite || finish_infinite != TimevalFinite ||
+		finish_value < start_value)
+		return INVALID_ESTIMATE;
+
+	if (!time_column_is_restricted(root,
+								   castNode(Var, ts),
+								   castNode(Const, start),
+								   BTGreaterEqualStrategyNumber) ||
+		!time_column_is_restricted(root,
+								   castNode(Var, ts),
+								   castNode(Const, finish),
+								   BTLessStrategyNumber))
+		return INVALID_ESTIMATE;
+
+	/* start gets aligned to the bucket width, which can add another bucket */
+	return clamp_row_est(((double) finish_value - (double) start_value) / period + 1);
 }
 
 /* For date_trunc this estimate currently works by seeing how many possible
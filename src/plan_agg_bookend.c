@@ -34,8 +34,12 @@
  */
 #include "postgres.h"
 
+#include <math.h>
+
 #include "access/htup_details.h"
 #include "catalog/pg_aggregate.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_attribute.h"
 #include "catalog/pg_type.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
@@ -44,20 +48,27 @@
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
 #include "optimizer/planmain.h"
+#include "optimizer/prep.h"
 #include "optimizer/subselect.h"
 #include "optimizer/tlist.h"
+#include "optimizer/var.h"
 #include "parser/parsetree.h"
 #include "parser/parse_clause.h"
 #include "rewrite/rewriteManip.h"
 #include "utils/lsyscache.h"
+#include "utils/selfuncs.h"
 #include "utils/syscache.h"
 #include "catalog/pg_proc.h"
 #include <catalog/namespace.h>
 #include "utils/typcache.h"
 #include "access/stratnum.h"
+#include "miscadmin.h"
 #include "plan_agg_bookend.h"
+#include "planner_import.h"
+#include "skip_scan.h"
 #include "utils.h"
 #include "extension.h"
+#include "compat.h"
 
 typedef struct FirstLastAggInfo
 {
@@ -437,6 +448,10 @@ find_first_last_aggs_walker(Node *node, List **context)
 		if (list_length(aggref->args) != 2)
 			return true; /* it couldn't be first/last */
 
+		/* a partialized aggregate must produce its partial, not its result */
+		if (aggref->aggsplit != AGGSPLIT_SIMPLE)
+			return true;
+
 		/*
 		 * ORDER BY is usually irrelevant for FIRST/LAST, but it can change
 		 * the outcome if the aggsortop's operator class recognizes
@@ -718,3 +733,392 @@ first_last_qp_callback(PlannerInfo *root, void *extra)
 
 	root->query_pathkeys = root->sort_pathkeys;
 }
+
+/*
+ * Grouped FIRST/LAST aggregates.
+ *
+ * With a GROUP BY on a single column, FIRST/LAST only need the first row of
+ * each group in the order of the sort column. Given an index on (group, sort)
+ * on every chunk, a skip scan finds these rows with one index descent per
+ * group and chunk (see skip_scan.c). The aggregates are then computed as usual
+ * over the rows found, which also merges the groups found in several chunks.
+ */
+
+static bool
+column_is_not_null(Oid relid, AttrNumber attno)
+{
+	HeapTuple tuple = SearchSysCacheAttNum(relid, attno);
+	bool notnull;
+
+	if (!HeapTupleIsValid(tuple))
+		return false;
+
+	notnull = ((Form_pg_attribute) GETSTRUCT(tuple))->attnotnull;
+	ReleaseSysCache(tuple);
+
+	return notnull;
+}
+
+/*
+ * Check if the clause compares the given index column to something not
+ * referencing the relation, so that it can be used as an index qual.
+ */
+static bool
+clause_matches_index_column(RelOptInfo *rel, IndexOptInfo *index, int column,
+							RestrictInfo *rinfo)
+{
+	OpExpr *op;
+	Node *left;
+	Node *right;
+	Node *other;
+	Oid opno;
+
+	if (rinfo->pseudoconstant || !IsA(rinfo->clause, OpExpr))
+		return false;
+
+	op = (OpExpr *) rinfo->clause;
+
+	if (list_length(op->args) != 2 || op->inputcollid != index->indexcollations[column])
+		return false;
+
+	left = linitial(op->args);
+	right = lsecond(op->args);
+
+	if (IsA(left, Var) && ((Var *) left)->varno == rel->relid &&
+		((Var *) left)->varattno == index->indexkeys[column])
+	{
+		other = right;
+		opno = op->opno;
+	}
+	else if (IsA(right, Var) && ((Var *) right)->varno == rel->relid &&
+			 ((Var *) right)->varattno == index->indexkeys[column])
+	{
+		other = left;
+		opno = get_commutator(op->opno);
+	}
+	else
+		return false;
+
+	return OidIsValid(opno) && op_in_opfamily(opno, index->opfamily[column]) &&
+		   !bms_is_member(rel->relid, pull_varnos(other)) && !contain_volatile_functions(other);
+}
+
+/*
+ * Find an index on (group, sort) of the relation and create an index path
+ * scanning it in the order FIRST/LAST need within each group. The restriction
+ * clauses on the group and sort columns become index quals, the others are
+ * checked on the rows of the index scan.
+ *
+ * The skip strategy is the strategy of the operator skipping past a group in
+ * the order of the scan.
+ */
+static IndexPath *
+build_skip_scan_index_path(PlannerInfo *root, RelOptInfo *rel, Var *group, Var *sort,
+						   bool sort_not_null, Oid group_eqop, Oid sortop,
+						   StrategyNumber strategy, StrategyNumber *skip_strategy)
+{
+	ListCell *lc;
+
+	foreach (lc, rel->indexlist)
+	{
+		IndexOptInfo *index = lfirst(lc);
+		bool sort_descending = (strategy == BTGreaterStrategyNumber);
+		List *clauses = NIL;
+		List *clausecols = NIL;
+		ScanDirection direction;
+		ListCell *lc_clause;
+		int column;
+
+#if PG96 || PG10
+		if (index->ncolumns < 2)
+#else
+		if (index->nkeycolumns < 2)
+#endif
+			continue;
+
+		if (index->relam != BTREE_AM_OID || (index->indpred != NIL && !index->predOK) ||
+			index->indexkeys[0] != group->varattno || index->indexkeys[1] != sort->varattno ||
+			index->indexcollations[0] != group->varcollid ||
+			index->indexcollations[1] != sort->varcollid ||
+			!op_in_opfamily(group_eqop, index->opfamily[0]) ||
+			!op_in_opfamily(sortop, index->opfamily[1]))
+			continue;
+
+		/* the first row of a group in the scan must have the FIRST/LAST sort value */
+		direction = (index->reverse_sort[1] == sort_descending) ? ForwardScanDirection :
+																   BackwardScanDirection;
+
+		/*
+		 * NULLs of the sort column are ignored by FIRST/LAST, so they must not
+		 * come before the other rows of a group.
+		 */
+		if (!sort_not_null &&
+			index->nulls_first[1] == ScanDirectionIsForward(direction))
+			continue;
+
+		/* the groups come in ascending order if we scan an ascending index forward */
+		if (ScanDirectionIsForward(direction) != index->reverse_sort[0])
+			*skip_strategy = BTGreaterStrategyNumber;
+		else
+			*skip_strategy = BTLessStrategyNumber;
+
+		foreach (lc_clause, rel->baserestrictinfo)
+		{
+			RestrictInfo *rinfo = lfirst(lc_clause);
+
+			for (column = 0; column < 2; column++)
+			{
+				if (clause_matches_index_column(rel, index, column, rinfo))
+				{
+					clauses = lappend(clauses, rinfo);
+					clausecols = lappend_int(clausecols, column);
+					break;
+				}
+			}
+		}
+
+		return create_index_path(root,
+								 index,
+								 clauses,
+								 clausecols,
+								 NIL,
+								 NIL,
+								 NIL,
+								 direction,
+								 false,
+								 NULL,
+								 1.0,
+								 false);
+	}
+
+	return NULL;
+}
+
+/*
+ * Cost of fetching the first row of each group from an index path. Every
+ * group takes a descent of the index, like btcostestimate charges it, and a
+ * leaf page fetch. Add the descent looking for the NULL group and the one
+ * finding no more groups.
+ */
+static void
+skip_scan_index_path_cost(PlannerInfo *root, IndexPath *path, Var *group, double *rows,
+						  Cost *startup_cost, Cost *total_cost)
+{
+	IndexOptInfo *index = path->indexinfo;
+	Path *p = &path->path;
+	double groups =
+		estimate_num_groups(root, list_make1(group), Max(p->parent->rows, 1.0), NULL);
+	Cost descent;
+
+	descent = ceil(log(Max(index->tuples, 2.0)) / log(2.0)) * cpu_operator_cost +
+			  (Max(index->tree_height, 0) + 1) * 50.0 * cpu_operator_cost + random_page_cost +
+			  p->startup_cost + (p->total_cost - p->startup_cost) / Max(p->rows, 1.0);
+
+	if (*rows == 0)
+		*startup_cost = descent;
+
+	*rows += groups;
+	*total_cost += (groups + 2) * descent;
+}
+
+/*
+ * Add an aggregate path over a skip scan for a query with FIRST/LAST
+ * aggregates grouped by a single column.
+ *
+ * This is called from create_upper_paths_hook in the UPPERREL_GROUP_AGG
+ * stage. All the aggregates must be either FIRST or LAST, on the same sort
+ * column, and every chunk must have a suitable index.
+ */
+void
+ts_plan_add_grouped_first_last(PlannerInfo *root, RelOptInfo *input_rel, RelOptInfo *output_rel)
+{
+	Query *parse = root->parse;
+	PathTarget *target = root->upper_targets[UPPERREL_GROUP_AGG];
+	List *first_last_aggs = NIL;
+	FirstLastAggInfo *fl_info;
+	FuncStrategy *func_strategy;
+	SortGroupClause *group_clause;
+	Node *group_expr;
+	Var *group;
+	Var *sort;
+	RangeTblEntry *rte;
+	bool sort_not_null;
+	AttrNumber group_attno = InvalidAttrNumber;
+	AttrNumber attno = 1;
+	List *index_paths = NIL;
+	List *skip_strategies = NIL;
+	double rows = 0;
+	Cost startup_cost = 0;
+	Cost total_cost = 0;
+	double num_groups;
+	AggClauseCosts agg_costs;
+	Path *path;
+	ListCell *lc;
+
+	if (!parse->hasAggs || list_length(parse->groupClause) != 1 || parse->groupingSets != NIL)
+		return;
+
+	if (input_rel->reloptkind != RELOPT_BASEREL || input_rel->rtekind != RTE_RELATION)
+		return;
+
+	if (find_first_last_aggs_walker((Node *) root->processed_tlist, &first_last_aggs) ||
+		find_first_last_aggs_walker(parse->havingQual, &first_last_aggs) ||
+		first_last_aggs == NIL)
+		return;
+
+	/* a single skip scan can only find the first rows in one order */
+	fl_info = linitial(first_last_aggs);
+	foreach (lc, first_last_aggs)
+	{
+		FirstLastAggInfo *other = lfirst(lc);
+
+		if (other->m_agg_info->aggfnoid != fl_info->m_agg_info->aggfnoid ||
+			!equal(other->sort, fl_info->sort))
+			return;
+	}
+	func_strategy = get_func_strategy(fl_info->m_agg_info->aggfnoid);
+
+	group_clause = linitial(parse->groupClause);
+	group_expr = get_sortgroupclause_expr(group_clause, parse->targetList);
+
+	if (!IsA(group_expr, Var) || !IsA(fl_info->sort, Var))
+		return;
+
+	group = (Var *) group_expr;
+	sort = (Var *) fl_info->sort;
+
+	if (group->varno != input_rel->relid || group->varlevelsup != 0 || group->varattno <= 0 ||
+		sort->varno != input_rel->relid || sort->varlevelsup != 0 || sort->varattno <= 0 ||
+		group->varattno == sort->varattno)
+		return;
+
+	/* the skip scan finds the group value of a row in the target of the relation */
+	foreach (lc, input_rel->reltarget->exprs)
+	{
+		if (equal(lfirst(lc), group))
+			group_attno = attno;
+		attno++;
+	}
+	if (group_attno == InvalidAttrNumber)
+		return;
+
+	rte = planner_rt_fetch(input_rel->relid, root);
+	sort_not_null = column_is_not_null(rte->relid, sort->varattno);
+
+	if (rte->inh)
+	{
+		foreach (lc, root->append_rel_list)
+		{
+			AppendRelInfo *appinfo = lfirst(lc);
+			RelOptInfo *child;
+			IndexPath *index_path;
+			StrategyNumber skip_strategy;
+			Var *child_group;
+
+			if (appinfo->parent_relid != input_rel->relid)
+				continue;
+
+			child = root->simple_rel_array[appinfo->child_relid];
+
+			if (child == NULL || planner_rt_fetch(child->relid, root)->inh)
+				return;
+
+			if (IS_DUMMY_REL(child))
+				continue;
+
+			child_group =
+				(Var *) adjust_appendrel_attrs_compat(root, (Node *) group, appinfo);
+			index_path = build_skip_scan_index_path(
+				root,
+				child,
+				child_group,
+				(Var *) adjust_appendrel_attrs_compat(root, (Node *) sort, appinfo),
+				sort_not_null,
+				group_clause->eqop,
+				fl_info->m_agg_info->aggsortop,
+				func_strategy->strategy,
+				&skip_strategy);
+
+			if (index_path == NULL)
+				return;
+
+			skip_scan_index_path_cost(root,
+									  index_path,
+									  child_group,
+									  &rows,
+									  &startup_cost,
+									  &total_cost);
+			index_paths = lappend(index_paths, index_path);
+			skip_strategies = lappend_int(skip_strategies, skip_strategy);
+		}
+	}
+	else
+	{
+		StrategyNumber skip_strategy;
+		IndexPath *index_path = build_skip_scan_index_path(root,
+														   input_rel,
+														   group,
+														   sort,
+														   sort_not_null,
+														   group_clause->eqop,
+														   fl_info->m_agg_info->aggsortop,
+														   func_strategy->strategy,
+														   &skip_strategy);
+
+		if (index_path == NULL)
+			return;
+
+		skip_scan_index_path_cost(root, index_path, group, &rows, &startup_cost, &total_cost);
+		index_paths = list_make1(index_path);
+		skip_strategies = list_make1_int(skip_strategy);
+	}
+
+	if (index_paths == NIL)
+		return;
+
+	path = ts_skip_scan_path_create(root,
+									input_rel,
+									index_paths,
+									skip_strategies,
+									group_attno,
+									group->vartype,
+									rows,
+									startup_cost,
+									total_cost);
+
+	MemSet(&agg_costs, 0, sizeof(AggClauseCosts));
+	get_agg_clause_costs(root, (Node *) root->processed_tlist, AGGSPLIT_SIMPLE, &agg_costs);
+	get_agg_clause_costs(root, parse->havingQual, AGGSPLIT_SIMPLE, &agg_costs);
+
+	num_groups = estimate_num_groups(root, list_make1(group), input_rel->rows, NULL);
+
+	if (grouping_is_hashable(parse->groupClause) &&
+		ts_estimate_hashagg_tablesize(path, &agg_costs, num_groups) < work_mem * 1024L)
+		add_path(output_rel,
+				 (Path *) create_agg_path(root,
+										  output_rel,
+										  path,
+										  target,
+										  AGG_HASHED,
+										  AGGSPLIT_SIMPLE,
+										  parse->groupClause,
+										  (List *) parse->havingQual,
+										  &agg_costs,
+										  num_groups));
+	else if (grouping_is_sortable(parse->groupClause))
+		add_path(output_rel,
+				 (Path *) create_agg_path(root,
+										  output_rel,
+										  (Path *) create_sort_path(root,
+																	output_rel,
+																	path,
+																	root->group_pathkeys,
+																	-1.0),
+										  target,
+										  AGG_SORTED,
+										  AGGSPLIT_SIMPLE,
+										  parse->groupClause,
+										  (List *) parse->havingQual,
+										  &agg_costs,
+										  num_groups));
+}
@@ -10,4 +10,6 @@
 #include <nodes/pg_list.h>
 
 extern void ts_preprocess_first_last_aggregates(PlannerInfo *root, List *tlist);
+extern void ts_plan_add_grouped_first_last(PlannerInfo *root, RelOptInfo *input_rel,
+										   RelOptInfo *output_rel);
 #endif /* TIMESCALEDB_PLAN_AGG_BOOKEND_H */
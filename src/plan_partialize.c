@@ -13,11 +13,13 @@
 #include "utils.h"
 
 #define TS_PARTIALFN "partialize_agg"
+#define TS_PARTIALFN_NATIVE "partialize_agg_native"
 typedef struct PartializeWalkerState
 {
 	bool found_partialize;
 	bool looking_for_agg;
 	Oid fnoid;
+	Oid native_fnoid;
 } PartializeWalkerState;
 
 static bool
@@ -46,7 +48,8 @@ partialize_function_call_walker(Node *node, PartializeWalkerState *state)
 
 		state->looking_for_agg = false;
 	}
-	else if (IsA(node, FuncExpr) && ((FuncExpr *) node)->funcid == state->fnoid)
+	else if (IsA(node, FuncExpr) && (((FuncExpr *) node)->funcid == state->fnoid ||
+									  ((FuncExpr *) node)->funcid == state->native_fnoid))
 	{
 		state->found_partialize = true;
 		state->looking_for_agg = true;
@@ -80,7 +83,8 @@ plan_process_partialize_agg(PlannerInfo *root, RelOptInfo *input_rel, RelOptInfo
 	Query *parse = root->parse;
 	PartializeWalkerState state = { .found_partialize = false,
 									.looking_for_agg = false,
-									.fnoid = InvalidOid };
+									.fnoid = InvalidOid,
+									.native_fnoid = InvalidOid };
 	ListCell *lc;
 
 	if (CMD_SELECT != parse->commandType)
@@ -89,6 +93,8 @@ plan_process_partialize_agg(PlannerInfo *root, RelOptInfo *input_rel, RelOptInfo
 	Assert(partialfnoid != InvalidOid);
 
 	state.fnoid = partialfnoid;
+	state.native_fnoid =
+		get_function_oid(TS_PARTIALFN_NATIVE, INTERNAL_SCHEMA_NAME, lengthof(argtyp), argtyp);
 	partialize_function_call_walker((Node *) parse->targetList, &state);
 
 	if (state.found_partialize)
@@ -128,6 +128,23 @@ timescaledb_planner(Query *parse, int cursor_opts, ParamListInfo bound_params)
 	PlannedStmt *stmt;
 	ListCell *lc;
 
+	/*
+	 * Answer aggregate queries from a continuous aggregate if possible. This
+	 * has to happen before we turn off inheritance, since the rewritten
+	 * query references the materialization hypertable.
+	 */
+	if (ts_extension_is_loaded() && !ts_guc_disable_optimizations && ts_guc_enable_cagg_rewrite &&
+		parse->commandType == CMD_SELECT)
+		parse = ts_cm_functions->continuous_agg_rewrite_query(parse);
+
+	/*
+	 * Turn explicit time_bucket_gapfill bounds into restrictions on the time
+	 * column, so chunk exclusion can make use of them.
+	 */
+	if (ts_extension_is_loaded() && !ts_guc_disable_optimizations &&
+		ts_guc_enable_gapfill_restriction && parse->commandType == CMD_SELECT)
+		ts_cm_functions->gapfill_restrict_query(parse);
+
 	if (ts_extension_is_loaded() && !ts_guc_disable_optimizations &&
 		ts_guc_enable_constraint_exclusion &&
 		(parse->commandType == CMD_INSERT || parse->commandType == CMD_SELECT))
@@ -547,9 +564,6 @@ timescale_create_upper_paths_hook(PlannerInfo *root, UpperRelationKind stage, Re
 	if (!ts_extension_is_loaded())
 		return;
 
-	if (ts_cm_functions->create_upper_paths_hook != NULL)
-		ts_cm_functions->create_upper_paths_hook(root, stage, input_rel, output_rel);
-
 	if (output_rel != NULL)
 	{
 		/* Modify for INSERTs on a hypertable */
@@ -560,18 +574,24 @@ timescale_create_upper_paths_hook(PlannerInfo *root, UpperRelationKind stage, Re
 		plan_process_partialize_agg(root, input_rel, output_rel);
 	}
 
-	if (ts_guc_disable_optimizations || input_rel == NULL || IS_DUMMY_REL(input_rel))
-		return;
-
-	if (!ts_guc_optimize_non_hypertables && !involves_hypertable(root, input_rel))
-		return;
-
-	if (UPPERREL_GROUP_AGG == stage && output_rel != NULL)
+	if (!ts_guc_disable_optimizations && input_rel != NULL && !IS_DUMMY_REL(input_rel) &&
+		(ts_guc_optimize_non_hypertables || involves_hypertable(root, input_rel)) &&
+		UPPERREL_GROUP_AGG == stage && output_rel != NULL)
 	{
 		ts_plan_add_hashagg(root, input_rel, output_rel);
 		if (parse->hasAggs)
+		{
 			ts_preprocess_first_last_aggregates(root, root->processed_tlist);
+			ts_plan_add_grouped_first_last(root, input_rel, output_rel);
+		}
 	}
+
+	/*
+	 * The tsl module gets called last, so the gapfill node is placed on top of
+	 * the aggregation paths added above as well.
+	 */
+	if (ts_cm_functions->create_upper_paths_hook != NULL)
+		ts_cm_functions->create_upper_paths_hook(root, stage, input_rel, output_rel);
 }
 
 void
@@ -44,7 +44,7 @@ heap_scanner_beginscan(InternalScannerCtx *ctx)
 {
 	ScannerCtx *sctx = ctx->sctx;
 
-	ctx->scan.heap_scan = heap_beginscan(ctx->tablerel, SnapshotSelf, sctx->nkeys, sctx->scankey);
+	ctx->scan.heap_scan = heap_beginscan(ctx->tablerel, sctx->snapshot, sctx->nkeys, sctx->scankey);
 	return ctx->scan;
 }
 
@@ -82,7 +82,7 @@ index_scanner_beginscan(InternalScannerCtx *ctx)
 	ScannerCtx *sctx = ctx->sctx;
 
 	ctx->scan.index_scan =
-		index_beginscan(ctx->tablerel, ctx->indexrel, SnapshotSelf, sctx->nkeys, sctx->norderbys);
+		index_beginscan(ctx->tablerel, ctx->indexrel, sctx->snapshot, sctx->nkeys, sctx->norderbys);
 	ctx->scan.index_scan->xs_want_itup = ctx->sctx->want_itup;
 	index_rescan(ctx->scan.index_scan, sctx->scankey, sctx->nkeys, NULL, sctx->norderbys);
 	return ctx->scan;
@@ -155,6 +155,9 @@ ts_scanner_start_scan(ScannerCtx *ctx, InternalScannerCtx *ictx)
 	ictx->sctx = ctx;
 	ictx->closed = false;
 
+	if (ctx->snapshot == NULL)
+		ctx->snapshot = SnapshotSelf;
+
 	scanner = scanner_ctx_get_scanner(ctx);
 
 	scanner->openheap(ictx);
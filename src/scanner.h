@@ -74,6 +74,8 @@ typedef struct ScannerCtx
 		bool enabled;
 	} tuplock;
 	ScanDirection scandirection;
+	/* Snapshot to scan with. SnapshotSelf if not set */
+	Snapshot snapshot;
 	void *data; /* User-provided data passed on to filter()
 				 * and tuple_found() */
 
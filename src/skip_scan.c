@@ -0,0 +1,433 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#include <postgres.h>
+#include <access/genam.h>
+#include <access/skey.h>
+#include <access/stratnum.h>
+#include <executor/executor.h>
+#include <nodes/execnodes.h>
+#include <nodes/extensible.h>
+#include <nodes/makefuncs.h>
+#include <nodes/pg_list.h>
+#include <utils/datum.h>
+#include <utils/lsyscache.h>
+#include <utils/memutils.h>
+#include <utils/rel.h>
+
+#include "skip_scan.h"
+#include "compat.h"
+
+/*
+ * Skip scan over the chunks of a relation.
+ *
+ * The children are index scans on an index whose first column is the group
+ * column. Instead of returning every row of the index, we return the first
+ * row of each group in the order of the scan: once a row is returned, the scan
+ * is restarted with an additional scan key on the group column that skips past
+ * the group of that row, so that every group takes one descent of the index.
+ * Since a scan key comparing the group column never matches NULLs, the NULL
+ * group is looked up first with an IS NULL scan key, followed by the first
+ * group with an IS NOT NULL scan key.
+ *
+ * The chunks are scanned one after the other, so a group present in several
+ * chunks is returned once per chunk; it is up to the aggregate above us to
+ * merge them.
+ */
+typedef enum SkipScanStage
+{
+	SKIP_SCAN_NULL_GROUP,  /* looking for the NULL group */
+	SKIP_SCAN_FIRST_GROUP, /* looking for the first non-NULL group */
+	SKIP_SCAN_NEXT_GROUP,  /* looking for the group after the previous one */
+} SkipScanStage;
+
+typedef struct SkipScanState
+{
+	CustomScanState csstate;
+	int num_children;
+	IndexScanState **children;
+	ScanKey *skip_keys;		/* the extra scan key of each child */
+	ScanKeyData *next_keys; /* the scan key skipping past a group, per child */
+	int current;
+	SkipScanStage stage;
+	bool needs_rescan;
+	AttrNumber group_attno;
+	int16 group_typlen;
+	bool group_typbyval;
+	MemoryContext group_context; /* holds the group value of the skip keys */
+} SkipScanState;
+
+/*
+ * Add the skip key to the scan keys of an index scan. The scan keys are
+ * copied into a larger array, so the runtime keys, which point into the scan
+ * keys, must be moved along. The scan descriptor, if it already exists, was
+ * created for the old number of scan keys and must be recreated.
+ */
+static void
+skip_scan_add_skip_key(SkipScanState *state, int child_index, StrategyNumber strategy,
+					   EState *estate)
+{
+	IndexScanState *child = state->children[child_index];
+	Relation index = child->iss_RelationDesc;
+	Oid opfamily = index->rd_opfamily[0];
+	Oid opcintype = index->rd_opcintype[0];
+	Oid opno = get_opfamily_member(opfamily, opcintype, opcintype, strategy);
+	int nkeys = child->iss_NumScanKeys + 1;
+	ScanKey keys = palloc0(sizeof(ScanKeyData) * nkeys);
+	int i;
+
+	if (!OidIsValid(opno))
+		elog(ERROR,
+			 "missing operator %d(%u,%u) in opfamily %u",
+			 strategy,
+			 opcintype,
+			 opcintype,
+			 opfamily);
+
+	if (child->iss_NumScanKeys > 0)
+		memcpy(keys, child->iss_ScanKeys, sizeof(ScanKeyData) * child->iss_NumScanKeys);
+
+	for (i = 0; i < child->iss_NumRuntimeKeys; i++)
+		child->iss_RuntimeKeys[i].scan_key =
+			keys + (child->iss_RuntimeKeys[i].scan_key - child->iss_ScanKeys);
+
+	ScanKeyEntryInitialize(&state->next_keys[child_index],
+						   0,
+						   1,
+						   strategy,
+						   opcintype,
+						   index->rd_indcollation[0],
+						   get_opcode(opno),
+						   (Datum) 0);
+
+	child->iss_ScanKeys = keys;
+	child->iss_NumScanKeys = nkeys;
+	state->skip_keys[child_index] = &keys[nkeys - 1];
+
+	if (child->iss_ScanDesc != NULL)
+	{
+		index_endscan(child->iss_ScanDesc);
+		child->iss_ScanDesc = index_beginscan(child->ss.ss_currentRelation,
+											  index,
+											  estate->es_snapshot,
+											  child->iss_NumScanKeys,
+											  child->iss_NumOrderByKeys);
+	}
+}
+
+/*
+ * Set the skip key of the current child for the given stage. The child is
+ * rescanned with the new key before it is asked for the next row, which must
+ * not happen before the row we got from it was returned.
+ */
+static void
+skip_scan_set_stage(SkipScanState *state, SkipScanStage stage, Datum group_value)
+{
+	ScanKey key = state->skip_keys[state->current];
+
+	switch (stage)
+	{
+		case SKIP_SCAN_NULL_GROUP:
+			ScanKeyEntryInitialize(key,
+								   SK_ISNULL | SK_SEARCHNULL,
+								   1,
+								   InvalidStrategy,
+								   InvalidOid,
+								   InvalidOid,
+								   InvalidOid,
+								   (Datum) 0);
+			break;
+		case SKIP_SCAN_FIRST_GROUP:
+			ScanKeyEntryInitialize(key,
+								   SK_ISNULL | SK_SEARCHNOTNULL,
+								   1,
+								   InvalidStrategy,
+								   InvalidOid,
+								   InvalidOid,
+								   InvalidOid,
+								   (Datum) 0);
+			break;
+		case SKIP_SCAN_NEXT_GROUP:
+			*key = state->next_keys[state->current];
+			key->sk_argument = group_value;
+			break;
+	}
+
+	state->stage = stage;
+	state->needs_rescan = true;
+}
+
+static void
+skip_scan_start(SkipScanState *state)
+{
+	MemoryContextReset(state->group_context);
+	state->current = 0;
+	if (state->num_children > 0)
+		skip_scan_set_stage(state, SKIP_SCAN_NULL_GROUP, (Datum) 0);
+}
+
+static void
+skip_scan_begin(CustomScanState *node, EState *estate, int eflags)
+{
+	SkipScanState *state = (SkipScanState *) node;
+	CustomScan *cscan = (CustomScan *) node->ss.ps.plan;
+	List *group_info = linitial(cscan->custom_private);
+	List *skip_strategies = lsecond(cscan->custom_private);
+	ListCell *lc_plan;
+	ListCell *lc_strategy;
+	int i = 0;
+
+	state->group_attno = linitial_int(group_info);
+	state->group_typlen = lsecond_int(group_info);
+	state->group_typbyval = lthird_int(group_info);
+	state->num_children = list_length(cscan->custom_plans);
+	state->children = palloc(sizeof(IndexScanState *) * state->num_children);
+	state->skip_keys = palloc(sizeof(ScanKey) * state->num_children);
+	state->next_keys = palloc(sizeof(ScanKeyData) * state->num_children);
+	state->group_context =
+		AllocSetContextCreate(CurrentMemoryContext, "SkipScan group", ALLOCSET_SMALL_SIZES);
+
+	forboth (lc_plan, cscan->custom_plans, lc_strategy, skip_strategies)
+	{
+		PlanState *child = ExecInitNode(lfirst(lc_plan), estate, eflags);
+
+		state->children[i] = castNode(IndexScanState, child);
+		node->custom_ps = lappend(node->custom_ps, child);
+
+		/* the index scan does not even open the index for EXPLAIN */
+		if (!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+			skip_scan_add_skip_key(state, i, lfirst_int(lc_strategy), estate);
+		i++;
+	}
+
+	if (!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+		skip_scan_start(state);
+}
+
+static TupleTableSlot *
+skip_scan_next_row(SkipScanState *state)
+{
+	while (state->current < state->num_children)
+	{
+		PlanState *child = &state->children[state->current]->ss.ps;
+		TupleTableSlot *slot;
+
+		if (state->needs_rescan)
+		{
+			ExecReScan(child);
+			state->needs_rescan = false;
+		}
+
+		slot = ExecProcNode(child);
+
+		if (TupIsNull(slot))
+		{
+			/* there need not be a NULL group, but no other group means we are done */
+			if (state->stage == SKIP_SCAN_NULL_GROUP)
+				skip_scan_set_stage(state, SKIP_SCAN_FIRST_GROUP, (Datum) 0);
+			else if (++state->current < state->num_children)
+				skip_scan_set_stage(state, SKIP_SCAN_NULL_GROUP, (Datum) 0);
+			continue;
+		}
+
+		if (state->stage == SKIP_SCAN_NULL_GROUP)
+			skip_scan_set_stage(state, SKIP_SCAN_FIRST_GROUP, (Datum) 0);
+		else
+		{
+			MemoryContext oldcontext;
+			bool isnull;
+			Datum value = slot_getattr(slot, state->group_attno, &isnull);
+
+			Assert(!isnull);
+
+			/*
+			 * The previous group value is only referenced by the scan key we
+			 * are about to replace.
+			 */
+			MemoryContextReset(state->group_context);
+			oldcontext = MemoryContextSwitchTo(state->group_context);
+			value = datumCopy(value, state->group_typbyval, state->group_typlen);
+			MemoryContextSwitchTo(oldcontext);
+
+			skip_scan_set_stage(state, SKIP_SCAN_NEXT_GROUP, value);
+		}
+
+		return slot;
+	}
+
+	return NULL;
+}
+
+static TupleTableSlot *
+skip_scan_exec(CustomScanState *node)
+{
+	SkipScanState *state = (SkipScanState *) node;
+	TupleTableSlot *subslot;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+#if PG96
+	TupleTableSlot *resultslot;
+	ExprDoneCond isDone;
+
+	if (node->ss.ps.ps_TupFromTlist)
+	{
+		resultslot = ExecProject(node->ss.ps.ps_ProjInfo, &isDone);
+
+		if (isDone == ExprMultipleResult)
+			return resultslot;
+
+		node->ss.ps.ps_TupFromTlist = false;
+	}
+#endif
+
+	ResetExprContext(econtext);
+
+	while (true)
+	{
+		subslot = skip_scan_next_row(state);
+
+		if (TupIsNull(subslot))
+			return NULL;
+
+		if (!node->ss.ps.ps_ProjInfo)
+			return subslot;
+
+		econtext->ecxt_scantuple = subslot;
+
+#if PG96
+		resultslot = ExecProject(node->ss.ps.ps_ProjInfo, &isDone);
+
+		if (isDone != ExprEndResult)
+		{
+			node->ss.ps.ps_TupFromTlist = (isDone == ExprMultipleResult);
+			return resultslot;
+		}
+#else
+		return ExecProject(node->ss.ps.ps_ProjInfo);
+#endif
+	}
+}
+
+static void
+skip_scan_end(CustomScanState *node)
+{
+	ListCell *lc;
+
+	foreach (lc, node->custom_ps)
+		ExecEndNode(lfirst(lc));
+}
+
+static void
+skip_scan_rescan(CustomScanState *node)
+{
+#if PG96
+	node->ss.ps.ps_TupFromTlist = false;
+#endif
+	/* the children are rescanned before they are used */
+	skip_scan_start((SkipScanState *) node);
+}
+
+static CustomExecMethods skip_scan_state_methods = {
+	.BeginCustomScan = skip_scan_begin,
+	.ExecCustomScan = skip_scan_exec,
+	.EndCustomScan = skip_scan_end,
+	.ReScanCustomScan = skip_scan_rescan,
+};
+
+static Node *
+skip_scan_state_create(CustomScan *cscan)
+{
+	SkipScanState *state;
+
+	state = (SkipScanState *) newNode(sizeof(SkipScanState), T_CustomScanState);
+	state->csstate.methods = &skip_scan_state_methods;
+
+	return (Node *) state;
+}
+
+static CustomScanMethods skip_scan_plan_methods = {
+	.CustomName = "SkipScan",
+	.CreateCustomScanState = skip_scan_state_create,
+};
+
+static Plan *
+skip_scan_plan_create(PlannerInfo *root, RelOptInfo *rel, struct CustomPath *path, List *tlist,
+					  List *clauses, List *custom_plans)
+{
+	CustomScan *cscan = makeNode(CustomScan);
+	List *scan_tlist = NIL;
+	AttrNumber resno = 1;
+	ListCell *lc;
+
+	/*
+	 * Every index scan returns the target of the relation, translated to its
+	 * chunk. The restriction clauses are checked by the index scans.
+	 */
+	foreach (lc, rel->reltarget->exprs)
+		scan_tlist =
+			lappend(scan_tlist, makeTargetEntry(copyObject(lfirst(lc)), resno++, NULL, false));
+
+	cscan->scan.scanrelid = 0;			 /* Not a real relation we are scanning */
+	cscan->scan.plan.targetlist = tlist; /* Target list we expect as output */
+	cscan->custom_scan_tlist = scan_tlist;
+	cscan->custom_plans = custom_plans;
+	cscan->custom_private = path->custom_private;
+	cscan->flags = path->flags;
+	cscan->methods = &skip_scan_plan_methods;
+
+	return &cscan->scan.plan;
+}
+
+static CustomPathMethods skip_scan_path_methods = {
+	.CustomName = "SkipScan",
+	.PlanCustomPath = skip_scan_plan_create,
+};
+
+/*
+ * Create a skip scan over the given index scans, one for each chunk of the
+ * relation. The skip strategy of each index scan is the strategy of the
+ * operator comparing the group column to the previous group in the order of
+ * the scan. The group column is at group_attno in the target of the relation.
+ */
+Path *
+ts_skip_scan_path_create(PlannerInfo *root, RelOptInfo *rel, List *index_paths,
+						 List *skip_strategies, AttrNumber group_attno, Oid group_type, double rows,
+						 Cost startup_cost, Cost total_cost)
+{
+	CustomPath *path = (CustomPath *) newNode(sizeof(CustomPath), T_CustomPath);
+	int16 typlen;
+	bool typbyval;
+
+	Assert(list_length(index_paths) == list_length(skip_strategies));
+
+	get_typlenbyval(group_type, &typlen, &typbyval);
+
+	path->path.pathtype = T_CustomScan;
+	path->path.parent = rel;
+	path->path.pathtarget = rel->reltarget;
+	path->path.param_info = NULL;
+	path->path.parallel_aware = false;
+	path->path.parallel_safe = false;
+	path->path.parallel_workers = 0;
+	path->path.rows = rows;
+	path->path.startup_cost = startup_cost;
+	path->path.total_cost = total_cost;
+
+	/* the groups of different chunks are not merged, so there is no order */
+	path->path.pathkeys = NIL;
+
+	path->flags = 0;
+	path->custom_paths = index_paths;
+	path->custom_private =
+		list_make2(list_make3_int(group_attno, typlen, typbyval), skip_strategies);
+	path->methods = &skip_scan_path_methods;
+
+	return &path->path;
+}
+
+void
+_skip_scan_init(void)
+{
+	RegisterCustomScanMethods(&skip_scan_plan_methods);
+}
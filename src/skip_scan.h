@@ -0,0 +1,19 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_SKIP_SCAN_H
+#define TIMESCALEDB_SKIP_SCAN_H
+
+#include <postgres.h>
+#include <nodes/relation.h>
+#include <nodes/extensible.h>
+
+Path *ts_skip_scan_path_create(PlannerInfo *root, RelOptInfo *rel, List *index_paths,
+							   List *skip_strategies, AttrNumber group_attno, Oid group_type,
+							   double rows, Cost startup_cost, Cost total_cost);
+
+void _skip_scan_init(void);
+
+#endif /* TIMESCALEDB_SKIP_SCAN_H */
@@ -0,0 +1,162 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#include <postgres.h>
+#include <math.h>
+#include <access/xact.h>
+#include <libpq/pqformat.h>
+
+#include "time_series_samples.h"
+
+#define TIME_SERIES_SAMPLES_INITIAL_SIZE 64
+
+/*
+ * The number of most recent samples kept when summarizing as rows arrive, so
+ * that rows arriving slightly out of time order are still summarized in order
+ */
+#define TIME_SERIES_SAMPLES_WINDOW 64
+
+void
+ts_time_series_samples_init(TimeSeriesSamples *samples)
+{
+	memset(samples, 0, sizeof(TimeSeriesSamples));
+	samples->sorted = true;
+}
+
+void
+ts_time_series_samples_add(TimeSeriesSamples *samples, TimeSeriesSample *new_samples,
+						   int32 nsamples, bool sorted, MemoryContext mcxt)
+{
+	if (nsamples == 0)
+		return;
+
+	if (samples->nsamples + nsamples > samples->maxsamples)
+	{
+		int32 maxsamples = Max(samples->maxsamples * 2, TIME_SERIES_SAMPLES_INITIAL_SIZE);
+
+		while (maxsamples < samples->nsamples + nsamples)
+			maxsamples *= 2;
+
+		if (samples->samples == NULL)
+			samples->samples =
+				MemoryContextAllocHuge(mcxt, sizeof(TimeSeriesSample) * (Size) maxsamples);
+		else
+			samples->samples =
+				repalloc_huge(samples->samples, sizeof(TimeSeriesSample) * (Size) maxsamples);
+		samples->maxsamples = maxsamples;
+	}
+
+	samples->sorted =
+		samples->sorted && sorted &&
+		(samples->nsamples == 0 ||
+		 ts_time_series_sample_cmp(&samples->samples[samples->nsamples - 1], &new_samples[0]) <= 0);
+	memcpy(samples->samples + samples->nsamples, new_samples, sizeof(TimeSeriesSample) * nsamples);
+	samples->nsamples += nsamples;
+}
+
+/*
+ * Order samples by time, and samples of the same time by value, with NaN last, so that the
+ * summary of the samples does not depend on the order they were added in.
+ */
+int
+ts_time_series_sample_cmp(const void *a, const void *b)
+{
+	const TimeSeriesSample *sample_a = a;
+	const TimeSeriesSample *sample_b = b;
+
+	if (sample_a->time != sample_b->time)
+		return sample_a->time < sample_b->time ? -1 : 1;
+
+	if (isnan(sample_a->value))
+		return isnan(sample_b->value) ? 0 : 1;
+	if (isnan(sample_b->value))
+		return -1;
+
+	return (sample_a->value > sample_b->value) - (sample_a->value < sample_b->value);
+}
+
+/* sort the samples, unless they were added in order */
+void
+ts_time_series_samples_sort(TimeSeriesSamples *samples)
+{
+	if (!samples->sorted)
+		qsort(samples->samples,
+			  samples->nsamples,
+			  sizeof(TimeSeriesSample),
+			  ts_time_series_sample_cmp);
+
+	samples->sorted = true;
+}
+
+/*
+ * The number of oldest samples that should be summarized, after sorting the
+ * samples, to keep the state small. The partials of a parallel aggregation
+ * cover overlapping time ranges and cannot be combined once summarized, so in
+ * parallel mode all samples are kept.
+ */
+int32
+ts_time_series_samples_overflow(TimeSeriesSamples *samples)
+{
+	if (IsInParallelMode() || samples->nsamples < 2 * TIME_SERIES_SAMPLES_WINDOW)
+		return 0;
+
+	ts_time_series_samples_sort(samples);
+
+	return samples->nsamples - TIME_SERIES_SAMPLES_WINDOW;
+}
+
+/* forget the oldest samples of sorted samples once they are summarized */
+void
+ts_time_series_samples_remove_first(TimeSeriesSamples *samples, int32 nsamples)
+{
+	Assert(samples->sorted && nsamples <= samples->nsamples);
+
+	memmove(samples->samples,
+			samples->samples + nsamples,
+			sizeof(TimeSeriesSample) * (samples->nsamples - nsamples));
+	samples->nsamples -= nsamples;
+}
+
+/* forget the samples, e.g. once they are summarized, but keep their memory */
+void
+ts_time_series_samples_reset(TimeSeriesSamples *samples)
+{
+	samples->nsamples = 0;
+	samples->sorted = true;
+}
+
+void
+ts_time_series_samples_serialize(StringInfo buf, TimeSeriesSamples *samples)
+{
+	int32 i;
+
+	pq_sendint(buf, samples->nsamples, 4);
+	for (i = 0; i < samples->nsamples; i++)
+	{
+		pq_sendint64(buf, samples->samples[i].time);
+		pq_sendfloat8(buf, samples->samples[i].value);
+	}
+}
+
+void
+ts_time_series_samples_deserialize(StringInfo buf, TimeSeriesSamples *samples, MemoryContext mcxt)
+{
+	int32 nsamples = pq_getmsgint(buf, 4);
+	int32 i;
+
+	if (nsamples < 0 || nsamples > (buf->len - buf->cursor) / (int32) (2 * sizeof(int64)))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid number of samples %d", nsamples)));
+
+	for (i = 0; i < nsamples; i++)
+	{
+		TimeSeriesSample sample;
+
+		sample.time = pq_getmsgint64(buf);
+		sample.value = pq_getmsgfloat8(buf);
+		ts_time_series_samples_add(samples, &sample, 1, true, mcxt);
+	}
+}
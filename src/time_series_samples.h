@@ -0,0 +1,47 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_TIME_SERIES_SAMPLES_H
+#define TIMESCALEDB_TIME_SERIES_SAMPLES_H
+
+#include <postgres.h>
+#include <lib/stringinfo.h>
+#include <utils/timestamp.h>
+
+/*
+ * The samples collected by the transition function of an aggregate that needs
+ * its rows in time order, like the time-weighted and counter aggregates. Rows
+ * are not aggregated in time order, so the samples are sorted before they are
+ * summarized. Outside of parallel mode, only the most recent samples are kept
+ * and the older ones are summarized as rows arrive.
+ */
+typedef struct TimeSeriesSample
+{
+	TimestampTz time;
+	double value;
+} TimeSeriesSample;
+
+typedef struct TimeSeriesSamples
+{
+	int32 nsamples;
+	int32 maxsamples;
+	/* whether the samples were added in the order of ts_time_series_sample_cmp */
+	bool sorted;
+	TimeSeriesSample *samples;
+} TimeSeriesSamples;
+
+extern int ts_time_series_sample_cmp(const void *a, const void *b);
+extern void ts_time_series_samples_init(TimeSeriesSamples *samples);
+extern void ts_time_series_samples_add(TimeSeriesSamples *samples, TimeSeriesSample *new_samples,
+									   int32 nsamples, bool sorted, MemoryContext mcxt);
+extern void ts_time_series_samples_sort(TimeSeriesSamples *samples);
+extern int32 ts_time_series_samples_overflow(TimeSeriesSamples *samples);
+extern void ts_time_series_samples_remove_first(TimeSeriesSamples *samples, int32 nsamples);
+extern void ts_time_series_samples_reset(TimeSeriesSamples *samples);
+extern void ts_time_series_samples_serialize(StringInfo buf, TimeSeriesSamples *samples);
+extern void ts_time_series_samples_deserialize(StringInfo buf, TimeSeriesSamples *samples,
+											   MemoryContext mcxt);
+
+#endif /* TIMESCALEDB_TIME_SERIES_SAMPLES_H */
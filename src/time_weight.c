@@ -0,0 +1,544 @@
+/*
+ * This file and its contents are licensed under the Apache License 2.0.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-APACHE for a copy of the license.
+ */
+#include <postgres.h>
+#include <fmgr.h>
+#include <access/xact.h>
+#include <lib/stringinfo.h>
+#include <libpq/pqformat.h>
+#include <utils/builtins.h>
+#include <utils/timestamp.h>
+
+#include "compat.h"
+#include "time_series_samples.h"
+
+/* time-weighted aggregates:
+ *	 time_weighted_average(value, time [, method]) returns the average of value over time
+ *	 time_weighted_integral(value, time [, method]) returns the integral of value over time,
+ *	 in value * seconds
+ *
+ * Usage:
+ *	 SELECT device, time_weighted_average(temperature, time, 'locf') FROM metrics GROUP BY device;
+ *
+ * Description:
+ * Every sample is weighted by the time it covers, so irregularly sampled values are averaged
+ * correctly. With the 'linear' method (the default), the value is interpolated linearly between
+ * two samples; with 'locf', a sample's value is carried forward until the next sample.
+ *
+ * The time range of a set of samples is summarized by its first and last sample and the area
+ * under the samples according to both methods. The summaries of two disjoint time ranges are
+ * combined by adding up their areas and the area between the last sample of the earlier range
+ * and the first sample of the later one. Partials are summaries, so that continuous aggregates,
+ * whose partials cover the disjoint time ranges of chunks, can combine them. Summaries of
+ * overlapping time ranges cannot be combined.
+ *
+ * Rows are not aggregated in time order, so the transition function keeps the most recent
+ * samples and summarizes the older ones as rows arrive, which keeps the state small. A row
+ * arriving before all summarized samples extends the summary to the front, but a row among them
+ * cannot be put in order anymore and is an error. The partials of a parallel aggregation cover
+ * overlapping time ranges, so in parallel mode all samples are kept and serialized instead of
+ * their summary. Continuous aggregates of space-partitioned hypertables must group by the space
+ * partitioning columns, so that the partials of a group do not overlap.
+ */
+
+TS_FUNCTION_INFO_V1(ts_time_weight_sfunc);
+TS_FUNCTION_INFO_V1(ts_time_weight_combinefunc);
+TS_FUNCTION_INFO_V1(ts_time_weight_serializefunc);
+TS_FUNCTION_INFO_V1(ts_time_weight_deserializefunc);
+TS_FUNCTION_INFO_V1(ts_time_weighted_average_finalfunc);
+TS_FUNCTION_INFO_V1(ts_time_weighted_integral_finalfunc);
+
+#define TIME_WEIGHT_FORMAT_VERSION 1
+
+typedef enum TimeWeightMethod
+{
+	TIME_WEIGHT_LINEAR = 'L',
+	TIME_WEIGHT_LOCF = 'C',
+} TimeWeightMethod;
+
+typedef struct TimeWeightSummary
+{
+	TimeSeriesSample first;
+	TimeSeriesSample last;
+	/* areas under the samples, in value * seconds */
+	double linear_area;
+	double locf_area;
+} TimeWeightSummary;
+
+typedef struct TimeWeightState
+{
+	TimeWeightMethod method;
+	/* the summary of the samples summarized as they arrived, all before the samples kept */
+	bool summarized;
+	TimeWeightSummary summary;
+	/* the most recent samples, not summarized yet */
+	TimeSeriesSamples samples;
+	/* the summaries of partials, in no particular order */
+	int32 nsummaries;
+	int32 maxsummaries;
+	TimeWeightSummary *summaries;
+} TimeWeightState;
+
+static TimeWeightMethod
+time_weight_method_from_text(text *method_text)
+{
+	char *method = text_to_cstring(method_text);
+
+	if (pg_strcasecmp(method, "linear") == 0)
+		return TIME_WEIGHT_LINEAR;
+	if (pg_strcasecmp(method, "locf") == 0)
+		return TIME_WEIGHT_LOCF;
+
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("invalid time weighting method \"%s\"", method),
+			 errhint("The method must be \"linear\" or \"locf\".")));
+	pg_unreachable();
+}
+
+static TimeWeightState *
+time_weight_state_create(MemoryContext mcxt, TimeWeightMethod method)
+{
+	TimeWeightState *state = MemoryContextAllocZero(mcxt, sizeof(TimeWeightState));
+
+	state->method = method;
+	ts_time_series_samples_init(&state->samples);
+
+	return state;
+}
+
+static void
+time_weight_add_summaries(TimeWeightState *state, TimeWeightSummary *summaries,
+						  int32 nsummaries, MemoryContext mcxt)
+{
+	if (nsummaries == 0)
+		return;
+
+	if (state->nsummaries + nsummaries > state->maxsummaries)
+	{
+		int32 maxsummaries = Max(state->maxsummaries * 2, state->nsummaries + nsummaries);
+
+		if (state->summaries == NULL)
+			state->summaries = MemoryContextAlloc(mcxt, sizeof(TimeWeightSummary) * maxsummaries);
+		else
+			state->summaries =
+				repalloc(state->summaries, sizeof(TimeWeightSummary) * maxsummaries);
+		state->maxsummaries = maxsummaries;
+	}
+
+	memcpy(state->summaries + state->nsummaries,
+		   summaries,
+		   sizeof(TimeWeightSummary) * nsummaries);
+	state->nsummaries += nsummaries;
+}
+
+static int
+time_weight_summary_cmp(const void *a, const void *b)
+{
+	const TimeWeightSummary *summary_a = a;
+	const TimeWeightSummary *summary_b = b;
+
+	int cmp = ts_time_series_sample_cmp(&summary_a->first, &summary_b->first);
+
+	if (cmp != 0)
+		return cmp;
+
+	return ts_time_series_sample_cmp(&summary_a->last, &summary_b->last);
+}
+
+/* extend the summary by a later sample */
+static void
+time_weight_summary_extend(TimeWeightSummary *summary, TimeSeriesSample *sample)
+{
+	double seconds = (double) (sample->time - summary->last.time) / USECS_PER_SEC;
+
+	summary->linear_area += (summary->last.value + sample->value) / 2 * seconds;
+	summary->locf_area += summary->last.value * seconds;
+	summary->last = *sample;
+}
+
+/* extend the summary by an earlier sample */
+static void
+time_weight_summary_extend_before(TimeWeightSummary *summary, TimeSeriesSample *sample)
+{
+	double seconds = (double) (summary->first.time - sample->time) / USECS_PER_SEC;
+
+	summary->linear_area += (sample->value + summary->first.value) / 2 * seconds;
+	summary->locf_area += sample->value * seconds;
+	summary->first = *sample;
+}
+
+/* combine the summary with the summary of a later time range */
+static void
+time_weight_summary_combine(TimeWeightSummary *summary, TimeWeightSummary *later)
+{
+	if (later->first.time < summary->last.time)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("cannot combine time-weighted aggregates of overlapping time ranges"),
+				 errdetail("The time range of a partial ends after the start of another.")));
+
+	time_weight_summary_extend(summary, &later->first);
+	summary->linear_area += later->linear_area;
+	summary->locf_area += later->locf_area;
+	summary->last = later->last;
+}
+
+/* summarize the oldest samples of the sorted samples of the state */
+static void
+time_weight_summarize_samples(TimeWeightState *state, int32 nsamples)
+{
+	TimeSeriesSample *samples = state->samples.samples;
+	int32 i = 0;
+
+	if (nsamples == 0)
+		return;
+
+	if (!state->summarized)
+	{
+		memset(&state->summary, 0, sizeof(TimeWeightSummary));
+		state->summary.first = samples[0];
+		state->summary.last = samples[0];
+		state->summarized = true;
+		i++;
+	}
+
+	for (; i < nsamples; i++)
+		time_weight_summary_extend(&state->summary, &samples[i]);
+
+	ts_time_series_samples_remove_first(&state->samples, nsamples);
+}
+
+/* add the summary of the samples summarized as they arrived to the summaries of the state */
+static void
+time_weight_close_summary(TimeWeightState *state, MemoryContext mcxt)
+{
+	if (!state->summarized)
+		return;
+
+	time_weight_add_summaries(state, &state->summary, 1, mcxt);
+	state->summarized = false;
+}
+
+/*
+ * Add a sample to the state. Once too many samples are kept, the oldest ones
+ * are summarized.
+ */
+static void
+time_weight_add_sample(TimeWeightState *state, TimeSeriesSample *sample, MemoryContext mcxt)
+{
+	if (state->summarized && ts_time_series_sample_cmp(sample, &state->summary.last) < 0)
+	{
+		if (ts_time_series_sample_cmp(sample, &state->summary.first) > 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("time-weighted aggregate rows too far out of time order"),
+					 errdetail("A row arrived after later and earlier rows were summarized."),
+					 errhint("Order the rows by time.")));
+
+		time_weight_summary_extend_before(&state->summary, sample);
+		return;
+	}
+
+	ts_time_series_samples_add(&state->samples, sample, 1, true, mcxt);
+	time_weight_summarize_samples(state, ts_time_series_samples_overflow(&state->samples));
+}
+
+/* summarize the samples and the summaries of the state into a single summary */
+static void
+time_weight_summarize(TimeWeightState *state, MemoryContext mcxt)
+{
+	int32 i;
+
+	ts_time_series_samples_sort(&state->samples);
+	time_weight_summarize_samples(state, state->samples.nsamples);
+	time_weight_close_summary(state, mcxt);
+
+	if (state->nsummaries > 1)
+	{
+		qsort(state->summaries,
+			  state->nsummaries,
+			  sizeof(TimeWeightSummary),
+			  time_weight_summary_cmp);
+
+		for (i = 1; i < state->nsummaries; i++)
+			time_weight_summary_combine(&state->summaries[0], &state->summaries[i]);
+
+		state->nsummaries = 1;
+	}
+}
+
+static bytea *
+time_weight_serialize(TimeWeightState *state)
+{
+	StringInfoData buf;
+	int32 i;
+
+	pq_begintypsend(&buf);
+	pq_sendbyte(&buf, TIME_WEIGHT_FORMAT_VERSION);
+	pq_sendbyte(&buf, state->method);
+
+	pq_sendint(&buf, state->nsummaries, 4);
+	for (i = 0; i < state->nsummaries; i++)
+	{
+		TimeWeightSummary *summary = &state->summaries[i];
+
+		pq_sendint64(&buf, summary->first.time);
+		pq_sendfloat8(&buf, summary->first.value);
+		pq_sendint64(&buf, summary->last.time);
+		pq_sendfloat8(&buf, summary->last.value);
+		pq_sendfloat8(&buf, summary->linear_area);
+		pq_sendfloat8(&buf, summary->locf_area);
+	}
+
+	ts_time_series_samples_serialize(&buf, &state->samples);
+
+	return pq_endtypsend(&buf);
+}
+
+static TimeWeightState *
+time_weight_deserialize(bytea *serialized, MemoryContext mcxt)
+{
+	StringInfoData buf;
+	TimeWeightState *state;
+	char method;
+	int32 nsummaries;
+	int32 i;
+
+	buf.data = VARDATA_ANY(serialized);
+	buf.len = VARSIZE_ANY_EXHDR(serialized);
+	buf.maxlen = buf.len;
+	buf.cursor = 0;
+
+	if (pq_getmsgbyte(&buf) != TIME_WEIGHT_FORMAT_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid time-weighted aggregate state version")));
+
+	method = pq_getmsgbyte(&buf);
+	if (method != TIME_WEIGHT_LINEAR && method != TIME_WEIGHT_LOCF)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid time-weighted aggregate state")));
+
+	state = time_weight_state_create(mcxt, (TimeWeightMethod) method);
+
+	nsummaries = pq_getmsgint(&buf, 4);
+	if (nsummaries < 0 || nsummaries > (buf.len - buf.cursor) / (6 * 8))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid time-weighted aggregate state")));
+
+	for (i = 0; i < nsummaries; i++)
+	{
+		TimeWeightSummary summary;
+
+		summary.first.time = pq_getmsgint64(&buf);
+		summary.first.value = pq_getmsgfloat8(&buf);
+		summary.last.time = pq_getmsgint64(&buf);
+		summary.last.value = pq_getmsgfloat8(&buf);
+		summary.linear_area = pq_getmsgfloat8(&buf);
+		summary.locf_area = pq_getmsgfloat8(&buf);
+		time_weight_add_summaries(state, &summary, 1, mcxt);
+	}
+
+	ts_time_series_samples_deserialize(&buf, &state->samples, mcxt);
+
+	pq_getmsgend(&buf);
+
+	return state;
+}
+
+/* time_weighted_average(state, value, time [, method]) and time_weighted_integral(...) */
+Datum
+ts_time_weight_sfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	TimeWeightState *state = (TimeWeightState *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	TimeSeriesSample sample;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_time_weight_sfunc called in non-aggregate context");
+	}
+
+	/* samples without a value or time are ignored */
+	if (PG_ARGISNULL(1) || PG_ARGISNULL(2))
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	sample.value = PG_GETARG_FLOAT8(1);
+	sample.time = PG_GETARG_TIMESTAMPTZ(2);
+
+	if (TIMESTAMP_NOT_FINITE(sample.time))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+				 errmsg("time-weighted aggregates do not support infinite timestamps")));
+
+	if (state == NULL)
+	{
+		TimeWeightMethod method = TIME_WEIGHT_LINEAR;
+
+		if (PG_NARGS() > 3)
+		{
+			if (PG_ARGISNULL(3))
+				ereport(ERROR,
+						(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+						 errmsg("time weighting method cannot be NULL")));
+			method = time_weight_method_from_text(PG_GETARG_TEXT_PP(3));
+		}
+
+		state = time_weight_state_create(aggcontext, method);
+	}
+
+	time_weight_add_sample(state, &sample, aggcontext);
+
+	PG_RETURN_POINTER(state);
+}
+
+/* ts_time_weight_combinefunc(internal, internal) => internal */
+Datum
+ts_time_weight_combinefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	TimeWeightState *state1 = (TimeWeightState *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	TimeWeightState *state2 = (TimeWeightState *) (PG_ARGISNULL(1) ? NULL : PG_GETARG_POINTER(1));
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "ts_time_weight_combinefunc called in non-aggregate context");
+	}
+
+	if (state2 == NULL)
+	{
+		if (state1 == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state1);
+	}
+
+	/* the first state belongs to the aggregate, so it is updated in place */
+	if (state1 == NULL)
+		state1 = time_weight_state_create(aggcontext, state2->method);
+
+	/* the samples of the second state need not be after the summary of the first */
+	time_weight_close_summary(state1, aggcontext);
+	if (state2->summarized)
+		time_weight_add_summaries(state1, &state2->summary, 1, aggcontext);
+
+	ts_time_series_samples_add(&state1->samples,
+							   state2->samples.samples,
+							   state2->samples.nsamples,
+							   state2->samples.sorted,
+							   aggcontext);
+	time_weight_add_summaries(state1, state2->summaries, state2->nsummaries, aggcontext);
+
+	PG_RETURN_POINTER(state1);
+}
+
+/* ts_time_weight_serializefunc(internal) => bytea */
+Datum
+ts_time_weight_serializefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	TimeWeightState *state;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "ts_time_weight_serializefunc called in non-aggregate context");
+
+	Assert(!PG_ARGISNULL(0));
+	state = (TimeWeightState *) PG_GETARG_POINTER(0);
+
+	/*
+	 * The partials of a parallel aggregation may cover overlapping time
+	 * ranges, so their samples cannot be summarized yet.
+	 */
+	if (!IsInParallelMode())
+		time_weight_summarize(state, aggcontext);
+	else
+		time_weight_close_summary(state, aggcontext);
+
+	PG_RETURN_BYTEA_P(time_weight_serialize(state));
+}
+
+/* ts_time_weight_deserializefunc(bytea, internal) => internal */
+Datum
+ts_time_weight_deserializefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "ts_time_weight_deserializefunc called in non-aggregate context");
+
+	Assert(!PG_ARGISNULL(0));
+
+	PG_RETURN_POINTER(time_weight_deserialize(PG_GETARG_BYTEA_PP(0), aggcontext));
+}
+
+/* the state summarized into a single summary, or NULL if there were no samples */
+static TimeWeightState *
+time_weight_final_state(FunctionCallInfo fcinfo)
+{
+	MemoryContext aggcontext;
+	TimeWeightState *state;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "time-weighted aggregate final function called in non-aggregate context");
+	}
+
+	if (PG_ARGISNULL(0))
+		return NULL;
+
+	state = (TimeWeightState *) PG_GETARG_POINTER(0);
+	time_weight_summarize(state, aggcontext);
+
+	return state;
+}
+
+static double
+time_weight_area(TimeWeightState *state)
+{
+	TimeWeightSummary *summary = &state->summaries[0];
+
+	return state->method == TIME_WEIGHT_LOCF ? summary->locf_area : summary->linear_area;
+}
+
+/* ts_time_weighted_average_finalfunc(internal) => double precision */
+Datum
+ts_time_weighted_average_finalfunc(PG_FUNCTION_ARGS)
+{
+	TimeWeightState *state = time_weight_final_state(fcinfo);
+	TimeWeightSummary *summary;
+
+	if (state == NULL)
+		PG_RETURN_NULL();
+
+	summary = &state->summaries[0];
+
+	/* the samples cover no time, so they are not weighted */
+	if (summary->last.time == summary->first.time)
+		PG_RETURN_FLOAT8(summary->last.value);
+
+	PG_RETURN_FLOAT8(time_weight_area(state) /
+					 ((double) (summary->last.time - summary->first.time) / USECS_PER_SEC));
+}
+
+/* ts_time_weighted_integral_finalfunc(internal) => double precision */
+Datum
+ts_time_weighted_integral_finalfunc(PG_FUNCTION_ARGS)
+{
+	TimeWeightState *state = time_weight_final_state(fcinfo);
+
+	if (state == NULL)
+		PG_RETURN_NULL();
+
+	PG_RETURN_FLOAT8(time_weight_area(state));
+}
@@ -24,6 +24,7 @@ SET timescaledb.disable_optimizations= 'off';
 SET timescaledb.disable_optimizations= 'on';
 DROP TABLE IF EXISTS btest cascade;
 DROP TABLE IF EXISTS btest_numeric cascade;
+DROP TABLE IF EXISTS skip_scan cascade;
 \ir :TEST_NAME
 \o
 RESET client_min_messages;
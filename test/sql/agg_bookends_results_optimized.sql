@@ -5,3 +5,27 @@
 SET timescaledb.disable_optimizations= 'off';
 \set PREFIX ''
 \ir include/agg_bookends.sql
+
+-- integer and date comparison elements, and fixed-width values passed by reference
+SELECT first(x, x::smallint) AS int2_first, last(x, x::smallint) AS int2_last,
+       first(x, x::bigint) AS int8_first, last(x, x::bigint) AS int8_last,
+       first(x, date '2019-01-01' + x) AS date_first, last(x, date '2019-01-01' + x) AS date_last,
+       first(x * interval '1 hour', x) AS interval_first, last(x * interval '1 hour', x) AS interval_last
+FROM (VALUES (3), (-1), (7), (5)) v(x);
+
+-- in window frames that move, first and last keep the rows that can become the result
+SELECT i, v, first(v, c) OVER w, last(v, c) OVER w
+FROM (VALUES (1, 'a', 5), (2, 'b', 3), (3, 'c', 4), (4, 'd', 3), (5, 'e', 6), (6, 'f', 1), (7, 'g', 6), (8, 'h', 2)) t(i, v, c)
+WINDOW w AS (ORDER BY i ROWS BETWEEN 2 PRECEDING AND CURRENT ROW)
+ORDER BY i;
+SELECT count(*)
+FROM (SELECT i, last(i::text, (i * 7919) % 1000 * interval '1 s') OVER (ORDER BY i ROWS BETWEEN 60 PRECEDING AND CURRENT ROW) AS moving
+      FROM generate_series(1, 1000) i) m
+WHERE moving IS DISTINCT FROM (SELECT last(j::text, (j * 7919) % 1000 * interval '1 s')
+                               FROM generate_series(greatest(m.i - 60, 1), m.i) j);
+-- rows with a NULL cmp element are ignored, also when they come first
+SELECT i, first(v, c) OVER w AS moving_first, last(v, c) OVER w AS moving_last,
+       first(v, c) OVER (ORDER BY i) AS first, last(v, c) OVER (ORDER BY i) AS last
+FROM (VALUES (1, 'a', NULL), (2, 'b', 2), (3, 'c', 1)) t(i, v, c)
+WINDOW w AS (ORDER BY i ROWS BETWEEN 1 PRECEDING AND CURRENT ROW)
+ORDER BY i;
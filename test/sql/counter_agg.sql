@@ -0,0 +1,72 @@
+-- This file and its contents are licensed under the Apache License 2.0.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-APACHE for a copy of the license.
+
+CREATE TABLE counter_test(time timestamptz, device int, value double precision);
+INSERT INTO counter_test VALUES
+  ('2019-01-01 00:00:30+00', 1, 40),
+  ('2019-01-01 00:00:00+00', 1, 10),
+  ('2019-01-01 00:01:00+00', 1, 5),
+  ('2019-01-01 00:02:00+00', 1, 55),
+  ('2019-01-01 00:01:30+00', 1, 25),
+  ('2019-01-01 00:00:15+00', 2, 100),
+  ('2019-01-01 00:01:15+00', 2, NULL),
+  ('2019-01-01 00:01:15+00', 2, 160),
+  ('2019-01-01 00:01:15+00', 3, 7);
+
+-- the counter of device 1 is reset between 00:00:30 and 00:01:00
+SELECT device,
+       counter_delta(counter_agg(value, time)) AS delta,
+       counter_rate(counter_agg(value, time)) AS rate,
+       counter_extrapolated_rate(counter_agg(value, time), '2019-01-01 00:00+00', '2019-01-01 00:03+00') AS extrapolated_rate
+FROM counter_test
+GROUP BY device
+ORDER BY device;
+
+-- rolling up the summaries of each minute gives the summary of all samples, with the resets
+-- between the minutes
+SELECT device, counter_agg_rollup(summary) = (SELECT counter_agg(value, time) FROM counter_test c WHERE c.device = s.device) AS equal
+FROM (SELECT device, date_trunc('minute', time) AS minute, counter_agg(value, time) AS summary
+      FROM counter_test
+      GROUP BY 1, 2) s
+GROUP BY device
+ORDER BY device;
+
+-- the same increase as computed with lag()
+CREATE TABLE counter_irregular AS
+SELECT '2019-01-01 00:00+00'::timestamptz + t * interval '1 minute' + (t * t % 97) * interval '1 second' AS time,
+       t % 3 AS device,
+       (t % 40) * 3::float8 AS value
+FROM generate_series(1, 1000) t;
+
+SELECT device, c.delta = l.delta AS delta_equal
+FROM (SELECT device, counter_delta(counter_agg(value, time)) AS delta
+      FROM counter_irregular
+      GROUP BY device) c
+JOIN (SELECT device, sum(CASE WHEN value >= prev_value THEN value - prev_value WHEN value < prev_value THEN value END) AS delta
+      FROM (SELECT device, value, lag(value) OVER (PARTITION BY device ORDER BY time) AS prev_value
+            FROM counter_irregular) s
+      GROUP BY device) l USING (device)
+ORDER BY device;
+
+-- the oldest samples are summarized as rows arrive, so rows may only arrive slightly out of
+-- time order, or before all others
+SELECT counter_delta(counter_agg(t % 100, to_timestamp(t))) AS in_order,
+       (SELECT counter_delta(counter_agg(t % 100, to_timestamp(t)))
+        FROM (SELECT t FROM generate_series(1, 1000) t ORDER BY t + t * 37 % 50) s) AS shuffled,
+       (SELECT counter_delta(counter_agg(t % 100, to_timestamp(t)))
+        FROM (SELECT t FROM generate_series(1, 1000) t ORDER BY t DESC) s) AS descending
+FROM generate_series(1, 1000) t;
+
+\set ON_ERROR_STOP 0
+SELECT counter_agg_rollup(summary)
+FROM (SELECT device, counter_agg(value, time) AS summary FROM counter_test GROUP BY device) s;
+SELECT counter_extrapolated_rate(counter_agg(value, time), '2019-01-01 00:01+00', '2019-01-01 00:03+00')
+FROM counter_test;
+SELECT counter_extrapolated_rate(counter_agg(value, time), '2019-01-01 00:03+00', '2019-01-01 00:00+00')
+FROM counter_test;
+SELECT counter_agg('NaN', '2019-01-01 00:00+00');
+SELECT counter_delta('\x00');
+SELECT counter_delta(counter_agg(t % 100, to_timestamp(t)))
+FROM (SELECT t FROM generate_series(1, 1000) t UNION ALL SELECT 500) s;
+\set ON_ERROR_STOP 1
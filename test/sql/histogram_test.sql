@@ -45,4 +45,28 @@ SELECT histogram(key, 1, 3, 1) FROM hitest1;
 -- standard 2 bucket
 SELECT qualify, histogram(score, 0, 10, 2) FROM hitest2 GROUP BY qualify;
 -- standard multi-bucket
-SELECT qualify, histogram(score, 0, 10, 5) FROM hitest2 GROUP BY qualify
+SELECT qualify, histogram(score, 0, 10, 5) FROM hitest2 GROUP BY qualify;
+
+-- NULL values are not counted
+SELECT histogram(NULL::float8, 0, 10, 2), histogram(CASE WHEN score > 5 THEN score END, 0, 10, 2) FROM hitest2;
+
+-- logarithmic buckets, with values on the bucket boundaries
+SELECT log_histogram(x, 1, 1000, 3) FROM generate_series(0, 1000) x;
+SELECT log_histogram(x / 10.0, 0.1, 1000, 4) FROM generate_series(0, 10000) x;
+SELECT qualify, log_histogram(score, 1, 16, 4) FROM hitest2 GROUP BY qualify ORDER BY qualify;
+
+-- in window frames that move, the values leaving the frame are subtracted
+SELECT x, histogram(x, 0, 10, 5) OVER (ORDER BY x ROWS BETWEEN 3 PRECEDING AND CURRENT ROW)
+FROM generate_series(-2, 12, 2) x;
+SELECT i, histogram(CASE WHEN i % 3 = 0 THEN i END, 0, 10, 2) OVER (ORDER BY i ROWS BETWEEN 1 PRECEDING AND CURRENT ROW)
+FROM generate_series(1, 7) i;
+SELECT x, log_histogram(x, 1, 100, 2) OVER (ORDER BY x ROWS BETWEEN 1 PRECEDING AND CURRENT ROW)
+FROM unnest(ARRAY[0.5, 1, 10, 100]::float8[]) x;
+
+\set ON_ERROR_STOP 0
+SELECT histogram(key, 3, 1, 2) FROM hitest1;
+SELECT histogram(key, 1, 1, 2) FROM hitest1;
+SELECT histogram(key, 0, 9, 0) FROM hitest1;
+SELECT histogram('NaN', 0, 9, 2) FROM hitest1;
+SELECT log_histogram(key, 0, 9, 2) FROM hitest1;
+\set ON_ERROR_STOP 1
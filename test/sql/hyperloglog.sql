@@ -0,0 +1,50 @@
+-- This file and its contents are licensed under the Apache License 2.0.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-APACHE for a copy of the license.
+
+CREATE TABLE hll_test(time int, device int, name text);
+INSERT INTO hll_test SELECT t, t % 1000, 'device ' || (t % 250) FROM generate_series(1, 100000) t;
+
+-- few distinct values are counted exactly
+SELECT approx_count_distinct(hyperloglog(device % 10)) FROM hll_test;
+
+-- the estimates are within 2% of the exact counts at the default precision, for sparse and
+-- dense sketches
+SELECT count(DISTINCT device) AS exact,
+       abs(approx_count_distinct(hyperloglog(device)) - count(DISTINCT device)) <= 0.02 * count(DISTINCT device) AS within_error
+FROM hll_test;
+SELECT count(DISTINCT name) AS exact,
+       abs(approx_count_distinct(hyperloglog(name)) - count(DISTINCT name)) <= 0.02 * count(DISTINCT name) AS within_error
+FROM hll_test;
+SELECT count(DISTINCT time) AS exact,
+       abs(approx_count_distinct(hyperloglog(time)) - count(DISTINCT time)) <= 0.02 * count(DISTINCT time) AS within_error
+FROM hll_test;
+
+-- and within 20% at a precision of 8
+SELECT abs(approx_count_distinct(hyperloglog(device, 8)) - 1000) <= 200 AS within_error,
+       abs(approx_count_distinct(hyperloglog(time, 8)) - 100000) <= 20000 AS within_error
+FROM hll_test;
+
+-- values are distinct by the equality of their type, like with count(DISTINCT)
+SELECT approx_count_distinct(hyperloglog(v)), count(DISTINCT v)
+FROM (VALUES (1.0::numeric), (1.00), (2)) v(v);
+
+-- the union of the sketches of the groups is the sketch of all values
+SELECT hyperloglog_union(sketch) = (SELECT hyperloglog(device) FROM hll_test)
+FROM (SELECT time % 7, hyperloglog(device) AS sketch FROM hll_test GROUP BY 1) s;
+SELECT hyperloglog_union(sketch) = (SELECT hyperloglog(time) FROM hll_test)
+FROM (SELECT time / 1000, hyperloglog(time) AS sketch FROM hll_test GROUP BY 1) s;
+
+-- NULL values are ignored
+SELECT hyperloglog(NULL::int) IS NULL FROM hll_test;
+SELECT approx_count_distinct(hyperloglog(CASE WHEN device < 10 THEN device END)) FROM hll_test;
+
+\set ON_ERROR_STOP 0
+SELECT hyperloglog(device, 2) FROM hll_test;
+SELECT hyperloglog(point(time, device)) FROM hll_test;
+SELECT hyperloglog_union(sketch)
+FROM (SELECT hyperloglog(device) AS sketch FROM hll_test
+      UNION ALL
+      SELECT hyperloglog(device, 8) FROM hll_test) s;
+SELECT approx_count_distinct('\x00');
+\set ON_ERROR_STOP 1
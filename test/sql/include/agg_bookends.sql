@@ -134,3 +134,24 @@ SET enable_seqscan=OFF;
 :PREFIX SELECT abs(last(temp, time)) FROM "btest" ORDER BY abs(last(temp,time));
 
 
+
+-- grouped FIRST/LAST with an index on (group, time) on every chunk
+CREATE TABLE skip_scan(time timestamp NOT NULL, dev int, val int);
+SELECT 1 AS hypertable_created FROM (SELECT create_hypertable('skip_scan', 'time', chunk_time_interval => interval '1 day')) t;
+INSERT INTO skip_scan
+SELECT t, d, d * 10000 + extract(epoch FROM t - '2019-01-01')::int / 60
+FROM generate_series('2019-01-01'::timestamp, '2019-01-03 23:59', '1 minute') t, generate_series(1, 5) d;
+INSERT INTO skip_scan
+SELECT t, 6, 60000 + extract(epoch FROM t - '2019-01-01')::int / 60
+FROM generate_series('2019-01-01'::timestamp, '2019-01-01 23:59', '1 minute') t;
+INSERT INTO skip_scan VALUES ('2019-01-02 12:00', NULL, -1), ('2019-01-03 12:00', NULL, -2);
+CREATE INDEX ON skip_scan(dev, time);
+ANALYZE skip_scan;
+
+-- should use a skip scan
+:PREFIX SELECT dev, last(val, time) FROM skip_scan GROUP BY dev ORDER BY dev;
+:PREFIX SELECT dev, first(val, time) FROM skip_scan GROUP BY dev ORDER BY dev;
+
+-- FIRST and LAST together can't use a single skip scan
+SELECT dev, first(val, time), last(val, time) FROM skip_scan GROUP BY dev ORDER BY dev;
+SELECT dev, last(val, time) FROM skip_scan WHERE dev > 3 AND time < '2019-01-02 06:00' GROUP BY dev ORDER BY dev;
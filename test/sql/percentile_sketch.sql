@@ -0,0 +1,57 @@
+-- This file and its contents are licensed under the Apache License 2.0.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-APACHE for a copy of the license.
+
+CREATE TABLE sketch_test(time int, device int, value double precision);
+INSERT INTO sketch_test SELECT t, t % 3, t * 0.5 - 100 FROM generate_series(1, 1000) t;
+
+-- every percentile is within 1% of the exact one
+WITH s AS (SELECT percentile_sketch(value) AS sketch FROM sketch_test)
+SELECT count(*)
+FROM s, generate_series(0, 100) p,
+     LATERAL (SELECT value FROM sketch_test ORDER BY value OFFSET floor(p * 9.99)::int LIMIT 1) exact
+WHERE abs(approx_percentile(p / 100.0, sketch) - exact.value) > 0.01 * abs(exact.value);
+
+WITH s AS (SELECT percentile_sketch(value) AS sketch FROM sketch_test)
+SELECT p, round(approx_percentile(p, sketch)::numeric, 2) AS percentile
+FROM s, unnest(ARRAY[0, 0.01, 0.25, 0.5, 0.75, 0.95, 0.99, 1]::float8[]) p;
+
+WITH s AS (SELECT percentile_sketch(value) AS sketch FROM sketch_test)
+SELECT v, round(approx_percentile_rank(v, sketch)::numeric, 3) AS rank
+FROM s, unnest(ARRAY[-200, -50, 0, 100, 399.5, 400, 500]::float8[]) v;
+
+-- a coarser relative error
+WITH s AS (SELECT percentile_sketch(value, 0.05) AS sketch FROM sketch_test)
+SELECT p, round(approx_percentile(p, sketch)::numeric, 2) AS percentile
+FROM s, unnest(ARRAY[0.25, 0.5, 0.75]::float8[]) p;
+
+-- rolling up the sketches of the groups gives the sketch of all values
+SELECT percentile_sketch_rollup(sketch) = (SELECT percentile_sketch(value) FROM sketch_test)
+FROM (SELECT device, percentile_sketch(value) AS sketch FROM sketch_test GROUP BY device) s;
+
+SELECT device, round(approx_percentile(0.5, percentile_sketch_rollup(sketch))::numeric, 2)
+FROM (SELECT device, time / 100 AS hour, percentile_sketch(value) AS sketch
+      FROM sketch_test
+      GROUP BY 1, 2) s
+GROUP BY device
+ORDER BY device;
+
+-- values too far apart for one store are collapsed the same way in any order
+SELECT percentile_sketch(v ORDER BY v) = percentile_sketch(v ORDER BY v DESC)
+FROM (SELECT power(10::float8, i / 10::float8) AS v FROM generate_series(-300, 300) i) s;
+
+-- NULL values are ignored
+SELECT percentile_sketch(NULL::float8) IS NULL FROM sketch_test;
+SELECT round(approx_percentile(0.5, percentile_sketch(CASE WHEN value > 0 THEN value END))::numeric, 2)
+FROM sketch_test;
+
+\set ON_ERROR_STOP 0
+SELECT percentile_sketch(value, 0.9) FROM sketch_test;
+SELECT percentile_sketch('NaN'::float8);
+SELECT percentile_sketch_rollup(sketch)
+FROM (SELECT percentile_sketch(value) AS sketch FROM sketch_test
+      UNION ALL
+      SELECT percentile_sketch(value, 0.05) FROM sketch_test) s;
+SELECT approx_percentile(1.5, percentile_sketch(value)) FROM sketch_test;
+SELECT approx_percentile(0.5, '\x00');
+\set ON_ERROR_STOP 1
@@ -0,0 +1,72 @@
+-- This file and its contents are licensed under the Apache License 2.0.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-APACHE for a copy of the license.
+
+CREATE TABLE tw_test(time timestamptz, device int, value double precision);
+INSERT INTO tw_test VALUES
+  ('2019-01-01 00:00:40+00', 1, 0),
+  ('2019-01-01 00:00:00+00', 1, 10),
+  ('2019-01-01 00:01:00+00', 1, 30),
+  ('2019-01-01 00:00:10+00', 1, 20),
+  ('2019-01-01 00:00:00+00', 2, 5),
+  ('2019-01-01 00:00:30+00', 2, NULL),
+  ('2019-01-01 00:01:00+00', 2, 15),
+  ('2019-01-01 00:00:30+00', 3, 7);
+
+-- the rows need not be in time order, and a single value covers no time
+SELECT device,
+       time_weighted_average(value, time) AS linear,
+       time_weighted_average(value, time, 'locf') AS locf,
+       time_weighted_integral(value, time) AS linear_integral,
+       time_weighted_integral(value, time, 'LOCF') AS locf_integral
+FROM tw_test
+GROUP BY device
+ORDER BY device;
+
+-- the same areas as computed with lag()
+CREATE TABLE tw_irregular AS
+SELECT '2019-01-01 00:00+00'::timestamptz + t * interval '1 minute' + (t * t % 97) * interval '1 second' AS time,
+       t % 3 AS device,
+       (t * 7 % 13) * 0.5::float8 AS value
+FROM generate_series(1, 1000) t;
+
+SELECT device, tw.linear = l.linear AS linear_equal, tw.locf = l.locf AS locf_equal
+FROM (SELECT device,
+             time_weighted_integral(value, time) AS linear,
+             time_weighted_integral(value, time, 'locf') AS locf
+      FROM tw_irregular
+      GROUP BY device) tw
+JOIN (SELECT device,
+             sum((value + prev_value) / 2 * extract(epoch FROM time - prev_time)) AS linear,
+             sum(prev_value * extract(epoch FROM time - prev_time)) AS locf
+      FROM (SELECT device, time, value, lag(value) OVER w AS prev_value, lag(time) OVER w AS prev_time
+            FROM tw_irregular
+            WINDOW w AS (PARTITION BY device ORDER BY time)) s
+      GROUP BY device) l USING (device)
+ORDER BY device;
+
+-- samples of the same time are ordered by value, so the order of the rows does not matter
+SELECT time_weighted_integral(value, to_timestamp(time), 'locf')
+FROM (VALUES (0, 0.0), (10, 1.0), (10, 5.0), (20, 0.0)) v(time, value);
+SELECT time_weighted_integral(value, to_timestamp(time), 'locf')
+FROM (VALUES (0, 0.0), (10, 5.0), (10, 1.0), (20, 0.0)) v(time, value);
+
+-- the oldest samples are summarized as rows arrive, so rows may only arrive slightly out of
+-- time order, or before all others
+SELECT time_weighted_integral(t % 7, to_timestamp(t)) AS in_order,
+       (SELECT time_weighted_integral(t % 7, to_timestamp(t))
+        FROM (SELECT t FROM generate_series(1, 1000) t ORDER BY t + t * 37 % 50) s) AS shuffled,
+       (SELECT time_weighted_integral(t % 7, to_timestamp(t))
+        FROM (SELECT t FROM generate_series(1, 1000) t ORDER BY t DESC) s) AS descending
+FROM generate_series(1, 1000) t;
+
+-- NULL values are ignored
+SELECT time_weighted_average(NULL::float8, time) IS NULL FROM tw_test;
+
+\set ON_ERROR_STOP 0
+SELECT time_weighted_average(value, time, 'cubic') FROM tw_test;
+SELECT time_weighted_average(value, time, NULL) FROM tw_test;
+SELECT time_weighted_integral(1, 'infinity');
+SELECT time_weighted_integral(t % 7, to_timestamp(t))
+FROM (SELECT t FROM generate_series(1, 1000) t UNION ALL SELECT 500) s;
+\set ON_ERROR_STOP 1
@@ -20,6 +20,7 @@
 #include <nodes/makefuncs.h>
 #include <nodes/nodeFuncs.h>
 #include <catalog/index.h>
+#include <catalog/namespace.h>
 #include <catalog/pg_type.h>
 #include <catalog/pg_aggregate.h>
 #include <catalog/toasting.h>
@@ -30,6 +31,7 @@
 #include <commands/tablespace.h>
 #include <commands/trigger.h>
 #include <commands/view.h>
+#include <access/heapam.h>
 #include <access/xact.h>
 #include <access/reloptions.h>
 #include <access/sysattr.h>
@@ -39,12 +41,19 @@
 #include <parser/parse_relation.h>
 #include <parser/parse_oper.h>
 #include <parser/analyze.h>
+#include <parser/parsetree.h>
 #include <optimizer/tlist.h>
 #include <optimizer/clauses.h>
+#include <rewrite/rewriteHandler.h>
+#include <rewrite/rewriteManip.h>
 #include <utils/builtins.h>
 #include <utils/catcache.h>
+#include <utils/date.h>
+#include <utils/lsyscache.h>
 #include <utils/ruleutils.h>
 #include <utils/syscache.h>
+#include <utils/timestamp.h>
+#include <utils/typcache.h>
 #include <utils/int8.h>
 
 #include "create.h"
@@ -57,18 +66,22 @@
 #include "hypertable_cache.h"
 #include "hypertable.h"
 #include "continuous_aggs/job.h"
+#include "continuous_aggs/planner.h"
 #include "dimension.h"
 #include "continuous_agg.h"
 #include "options.h"
 
 #define FINALFN "finalize_agg"
+#define COMBINEFN "combine_agg"
 #define PARTIALFN "partialize_agg"
+#define PARTIALFN_NATIVE "partialize_agg_native"
 #define TIMEBUCKETFN "time_bucket"
 #define CHUNKIDFROMRELID "chunk_id_from_relid"
 #define MATPARTCOLNM "time_partition_col"
 #define MATPARTCOL_INTERVAL_FACTOR 10
 #define HT_DEFAULT_CHUNKFN "calculate_chunk_interval"
 #define CAGG_INVALIDATION_TRIGGER "continuous_agg_invalidation_trigger"
+#define WATERMARKFN "cagg_watermark"
 
 #define DEFAULT_MAX_INTERVAL_MULTIPLIER 20
 #define DEFAULT_MAX_INTERVAL_MAX_BUCKET_WIDTH (PG_INT64_MAX / DEFAULT_MAX_INTERVAL_MULTIPLIER)
@@ -170,6 +183,7 @@ typedef struct AggPartCxt
 	struct MatTableColumnInfo *mattblinfo;
 	bool addcol;
 	Oid ignore_aggoid;
+	Oid ignore_native_aggoid;
 	int original_query_resno;
 } AggPartCxt;
 
@@ -682,6 +696,112 @@ cagg_agg_validate(Node *node, void *context)
 	return expression_tree_walker(node, cagg_agg_validate, context);
 }
 
+/*
+ * The combine functions of aggregates whose partials can only be combined if
+ * they cover disjoint time ranges
+ */
+static const char *const disjoint_partials_combinefns[] = {
+	"time_weight_combinefunc",
+	"counter_agg_combinefunc",
+};
+
+typedef struct DisjointPartialsAggContext
+{
+	List *combinefnoids;
+	Oid aggfnoid;
+} DisjointPartialsAggContext;
+
+static bool
+cagg_find_disjoint_partials_agg(Node *node, DisjointPartialsAggContext *context)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, Aggref))
+	{
+		Aggref *agg = (Aggref *) node;
+		HeapTuple aggtuple;
+		Oid combinefnoid;
+
+		aggtuple = SearchSysCache1(AGGFNOID, agg->aggfnoid);
+		if (!HeapTupleIsValid(aggtuple))
+			elog(ERROR, "cache lookup failed for aggregate %u", agg->aggfnoid);
+		combinefnoid = ((Form_pg_aggregate) GETSTRUCT(aggtuple))->aggcombinefn;
+		ReleaseSysCache(aggtuple);
+
+		if (list_member_oid(context->combinefnoids, combinefnoid))
+		{
+			context->aggfnoid = agg->aggfnoid;
+			return true;
+		}
+		return false;
+	}
+	return expression_tree_walker(node, cagg_find_disjoint_partials_agg, context);
+}
+
+static bool
+cagg_groups_by_column(Query *query, AttrNumber attno)
+{
+	ListCell *lc;
+
+	foreach (lc, query->groupClause)
+	{
+		SortGroupClause *sgc = (SortGroupClause *) lfirst(lc);
+		TargetEntry *tle = get_sortgroupclause_tle(sgc, query->targetList);
+
+		if (IsA(tle->expr, Var) && ((Var *) tle->expr)->varattno == attno)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * The chunks of different space partitions cover overlapping time ranges, so
+ * aggregates whose partials can only be combined for disjoint time ranges are
+ * only supported if every group is within a single space partition, i.e. the
+ * query groups by the space partitioning columns.
+ */
+static void
+cagg_validate_disjoint_partials(Query *query, Hypertable *ht)
+{
+	DisjointPartialsAggContext context = {
+		.combinefnoids = NIL,
+		.aggfnoid = InvalidOid,
+	};
+	Oid argtypes[] = { INTERNALOID, INTERNALOID };
+	int i;
+
+	for (i = 0; i < lengthof(disjoint_partials_combinefns); i++)
+	{
+		List *funcname = list_make2(makeString(INTERNAL_SCHEMA_NAME),
+									makeString((char *) disjoint_partials_combinefns[i]));
+		Oid combinefnoid = LookupFuncName(funcname, lengthof(argtypes), argtypes, true);
+
+		if (OidIsValid(combinefnoid))
+			context.combinefnoids = lappend_oid(context.combinefnoids, combinefnoid);
+	}
+
+	if (!cagg_find_disjoint_partials_agg((Node *) query->targetList, &context) &&
+		!cagg_find_disjoint_partials_agg(query->havingQual, &context))
+		return;
+
+	for (i = 0; i < ht->space->num_dimensions; i++)
+	{
+		Dimension *dim = &ht->space->dimensions[i];
+
+		if (IS_CLOSED_DIMENSION(dim) && !cagg_groups_by_column(query, dim->column_attno))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("%s is not supported in continuous aggregates of space-partitioned "
+							"hypertables",
+							get_func_name(context.aggfnoid)),
+					 errdetail("Its partials cannot be combined across space partitions, whose "
+							   "chunks cover overlapping time ranges."),
+					 errhint("Add the space partitioning column \"%s\" to the GROUP BY clause.",
+							 NameStr(dim->fd.column_name))));
+	}
+}
+
 static bool
 has_row_security(Oid relid)
 {
@@ -781,6 +901,7 @@ cagg_validate_query(Query *query)
 									part_dimension->column_attno,
 									part_dimension->fd.column_type,
 									part_dimension->fd.interval_length);
+			cagg_validate_disjoint_partials(query, ht);
 		}
 		ts_cache_release(hcache);
 	}
@@ -823,17 +944,23 @@ cagg_validate_query(Query *query)
  * the arguments are a list of targetentry
  */
 static Oid
-get_finalizefnoid()
+get_partials_aggfnoid(const char *aggname, Oid partial_type)
 {
 	Oid finalfnoid;
-	Oid finalfnargtypes[] = { TEXTOID,  NAMEOID,	  NAMEOID, get_array_type(NAMEOID),
-							  BYTEAOID, ANYELEMENTOID };
-	List *funcname = list_make2(makeString(INTERNAL_SCHEMA_NAME), makeString(FINALFN));
+	Oid finalfnargtypes[] = { TEXTOID,		NAMEOID,	  NAMEOID, get_array_type(NAMEOID),
+							  partial_type, ANYELEMENTOID };
+	List *funcname = list_make2(makeString(INTERNAL_SCHEMA_NAME), makeString(pstrdup(aggname)));
 	int nargs = sizeof(finalfnargtypes) / sizeof(finalfnargtypes[0]);
 	finalfnoid = LookupFuncName(funcname, nargs, finalfnargtypes, false);
 	return finalfnoid;
 }
 
+static Oid
+get_finalizefnoid(Oid partial_type)
+{
+	return get_partials_aggfnoid(FINALFN, partial_type);
+}
+
 /* Build a [N][2] array where N is number of arguments and the inner array is of [schema_name,
  * type_name] */
 static Datum
@@ -898,10 +1025,16 @@ get_input_types_array_datum(Aggref *original_aggregate)
  *                <partial-column-name> BYTEA,
  *                null::<return-type of sum(int)>
  *             )
- * here sum(int) is the input aggregate "inp" in the parameter-list
+ * here sum(int) is the input aggregate "inp" in the parameter-list.
+ * If combine is true, the combine-agg with the same arguments is used instead,
+ * which returns the combined partial of sum(int) as BYTEA.
+ * If the partial column stores native partials (see partialize_agg_native), it
+ * has the return type of the aggregate instead of BYTEA and the finalize-agg
+ * overload for native partials is used. Those cannot be combined into a BYTEA
+ * partial.
  */
 static Aggref *
-get_finalize_aggref(Aggref *inp, Var *partial_state_var)
+make_partials_aggref(Aggref *inp, Var *partial_state_var, bool combine)
 {
 	Aggref *aggref;
 	TargetEntry *te;
@@ -916,15 +1049,24 @@ get_finalize_aggref(Aggref *inp, Var *partial_state_var)
 	char *collation_name = NULL, *collation_schema_name = NULL;
 	Datum collation_name_datum = (Datum) 0;
 	Datum collation_schema_datum = (Datum) 0;
-	Oid finalfnoid = get_finalizefnoid();
+	Oid partial_type = partial_state_var->vartype;
+	Oid finalfnoid;
+
+	if (partial_type == BYTEAOID)
+		finalfnoid = combine ? get_partials_aggfnoid(COMBINEFN, BYTEAOID) :
+							   get_finalizefnoid(BYTEAOID);
+	else if (combine)
+		elog(ERROR, "cannot combine native partials of aggregate %u", inp->aggfnoid);
+	else
+		finalfnoid = get_finalizefnoid(ANYELEMENTOID);
 
-	argtypes = list_make5_oid(TEXTOID, NAMEOID, NAMEOID, name_array_type_oid, BYTEAOID);
+	argtypes = list_make5_oid(TEXTOID, NAMEOID, NAMEOID, name_array_type_oid, partial_type);
 	argtypes = lappend_oid(argtypes, inp->aggtype);
 
 	aggref = makeNode(Aggref);
 	aggref->aggfnoid = finalfnoid;
-	aggref->aggtype = inp->aggtype;
-	aggref->aggcollid = inp->aggcollid;
+	aggref->aggtype = combine ? BYTEAOID : inp->aggtype;
+	aggref->aggcollid = combine ? InvalidOid : inp->aggcollid;
 	aggref->inputcollid = inp->inputcollid;
 	aggref->aggtranstype = InvalidOid; /* will be set by planner */
 	aggref->aggargtypes = argtypes;
@@ -1014,24 +1156,65 @@ get_finalize_aggref(Aggref *inp, Var *partial_state_var)
 	return aggref;
 }
 
+Aggref *
+get_finalize_aggref(Aggref *inp, Var *partial_state_var)
+{
+	return make_partials_aggref(inp, partial_state_var, false);
+}
+
+/* creates the combine-agg counterpart of get_finalize_aggref, see make_partials_aggref */
+Aggref *
+get_combine_aggref(Aggref *inp, Var *partial_state_var)
+{
+	return make_partials_aggref(inp, partial_state_var, true);
+}
+
+/*
+ * Can the partial of the agg be stored natively, as its transition value? That
+ * is the case for aggregates without a final function and with a transition
+ * type we can store, e.g., count, sum of integers and floats, min and max. The
+ * transition type of those is also their return type.
+ */
+static bool
+agg_has_native_partial(Aggref *agg)
+{
+	HeapTuple tuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(agg->aggfnoid));
+	Form_pg_aggregate aggform;
+	bool native;
+
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for aggregate %u", agg->aggfnoid);
+
+	aggform = (Form_pg_aggregate) GETSTRUCT(tuple);
+	native = !OidIsValid(aggform->aggfinalfn) && OidIsValid(aggform->aggcombinefn) &&
+			 aggform->aggtranstype != INTERNALOID && !IsPolymorphicType(aggform->aggtranstype);
+	ReleaseSysCache(tuple);
+
+	return native;
+}
+
 /* creates a partialize expr for the passed in agg:
- * partialize_agg( agg)
+ * partialize_agg( agg), which returns the partial as BYTEA, or
+ * partialize_agg_native( agg), which returns it as the return type of agg
  */
 static FuncExpr *
 get_partialize_funcexpr(Aggref *agg)
 {
 	FuncExpr *partialize_fnexpr;
 	Oid partfnoid, partargtype;
+	bool native = agg_has_native_partial(agg);
+
 	partargtype = ANYELEMENTOID;
-	partfnoid = LookupFuncName(list_make2(makeString(INTERNAL_SCHEMA_NAME), makeString(PARTIALFN)),
+	partfnoid = LookupFuncName(list_make2(makeString(INTERNAL_SCHEMA_NAME),
+										  makeString(native ? PARTIALFN_NATIVE : PARTIALFN)),
 							   1,
 							   &partargtype,
 							   false);
 	partialize_fnexpr = makeFuncExpr(partfnoid,
-									 BYTEAOID,
+									 native ? agg->aggtype : BYTEAOID,
 									 list_make1(agg), /*args*/
-									 InvalidOid,
-									 InvalidOid,
+									 native ? agg->aggcollid : InvalidOid,
+									 native ? agg->aggcollid : InvalidOid,
 									 COERCE_EXPLICIT_CALL);
 	return partialize_fnexpr;
 }
@@ -1101,9 +1284,9 @@ mattablecolumninfo_addentry(MatTableColumnInfo *out, Node *input, int original_q
 			FuncExpr *fexpr = get_partialize_funcexpr((Aggref *) input);
 			PRINT_MATCOLNAME(colbuf, "agg", original_query_resno, matcolno);
 			colname = colbuf;
-			coltype = BYTEAOID;
+			coltype = fexpr->funcresulttype;
 			coltypmod = -1;
-			colcollation = InvalidOid;
+			colcollation = fexpr->funccollid;
 			col = makeColumnDef(colname, coltype, coltypmod, colcollation);
 			part_te = makeTargetEntry((Expr *) fexpr, matcolno, pstrdup(colname), false);
 		}
@@ -1251,7 +1434,8 @@ add_aggregate_partialize_mutator(Node *node, AggPartCxt *cxt)
 		Aggref *newagg;
 		Var *var;
 
-		if (cxt->ignore_aggoid == ((Aggref *) node)->aggfnoid)
+		if (cxt->ignore_aggoid == ((Aggref *) node)->aggfnoid ||
+			cxt->ignore_native_aggoid == ((Aggref *) node)->aggfnoid)
 			return node; /*don't process this further */
 
 		/* step 1: create partialize( aggref) column
@@ -1368,6 +1552,7 @@ finalizequery_init(FinalizeQueryInfo *inp, Query *orig_query, List *tlist_aliase
 	/* Set up the final_seltlist and final_havingqual entries */
 	cxt.mattblinfo = mattblinfo;
 	cxt.ignore_aggoid = InvalidOid;
+	cxt.ignore_native_aggoid = InvalidOid;
 
 	/* We want all the entries in the targetlist (resjunk or not)
 	 * in the materialization  table defintion so we include group-by/having clause etc.
@@ -1427,7 +1612,8 @@ finalizequery_init(FinalizeQueryInfo *inp, Query *orig_query, List *tlist_aliase
 	/* we might still have aggs in havingqual which don't appear in the targetlist , but don't
 	 * overwrite finalize_agg exprs that we have in the havingQual*/
 	cxt.addcol = false;
-	cxt.ignore_aggoid = get_finalizefnoid();
+	cxt.ignore_aggoid = get_finalizefnoid(BYTEAOID);
+	cxt.ignore_native_aggoid = get_finalizefnoid(ANYELEMENTOID);
 	cxt.original_query_resno = 0;
 	inp->final_havingqual =
 		expression_tree_mutator((Node *) newhavingQual, add_aggregate_partialize_mutator, &cxt);
@@ -1545,6 +1731,410 @@ fixup_userview_query_tlist(Query *userquery, List *tlist_aliases)
 	return ret_query;
 }
 
+/*
+ * Build an expression that returns the completed threshold of the
+ * materialization as a value of the time column's type, e.g.:
+ *
+ * COALESCE(_timescaledb_internal.to_timestamp(_timescaledb_internal.cagg_watermark(<id>)),
+ *          '-infinity')
+ *
+ * If nothing is materialized yet, the expression returns the lowest value of
+ * the type so that all data is read from the raw hypertable.
+ */
+static Node *
+build_watermark_expr(int32 mat_hypertable_id, Oid timetype)
+{
+	Oid argtype[] = { INT4OID };
+	Oid convtype[] = { INT8OID };
+	Oid watermark_fnoid =
+		LookupFuncName(list_make2(makeString(INTERNAL_SCHEMA_NAME), makeString(WATERMARKFN)),
+					   1,
+					   argtype,
+					   false);
+	Node *watermark = (Node *) makeFuncExpr(watermark_fnoid,
+											 INT8OID,
+											 list_make1(makeConst(INT4OID,
+																  -1,
+																  InvalidOid,
+																  sizeof(int32),
+																  Int32GetDatum(mat_hypertable_id),
+																  false,
+																  true)),
+											 InvalidOid,
+											 InvalidOid,
+											 COERCE_EXPLICIT_CALL);
+	CoalesceExpr *coalesce = makeNode(CoalesceExpr);
+	char *convfn = NULL;
+	Const *minval;
+
+	switch (timetype)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+			/* compared with the cross-type integer operators */
+			minval = makeConst(INT8OID,
+							   -1,
+							   InvalidOid,
+							   sizeof(int64),
+							   Int64GetDatum(PG_INT64_MIN),
+							   false,
+							   FLOAT8PASSBYVAL);
+			break;
+		case TIMESTAMPTZOID:
+			convfn = "to_timestamp";
+			minval = makeConst(TIMESTAMPTZOID,
+							   -1,
+							   InvalidOid,
+							   sizeof(TimestampTz),
+							   TimestampTzGetDatum(DT_NOBEGIN),
+							   false,
+							   FLOAT8PASSBYVAL);
+			break;
+		case TIMESTAMPOID:
+			convfn = "to_timestamp_without_timezone";
+			minval = makeConst(TIMESTAMPOID,
+							   -1,
+							   InvalidOid,
+							   sizeof(Timestamp),
+							   TimestampGetDatum(DT_NOBEGIN),
+							   false,
+							   FLOAT8PASSBYVAL);
+			break;
+		case DATEOID:
+			convfn = "to_date";
+			minval = makeConst(DATEOID,
+							   -1,
+							   InvalidOid,
+							   sizeof(DateADT),
+							   DateADTGetDatum(DATEVAL_NOBEGIN),
+							   false,
+							   true);
+			break;
+		default:
+			elog(ERROR, "unsupported time type for continuous aggregate");
+			pg_unreachable();
+	}
+
+	if (convfn != NULL)
+	{
+		Oid convfnoid =
+			LookupFuncName(list_make2(makeString(INTERNAL_SCHEMA_NAME), makeString(convfn)),
+						   1,
+						   convtype,
+						   false);
+		watermark = (Node *) makeFuncExpr(convfnoid,
+										  minval->consttype,
+										  list_make1(watermark),
+										  InvalidOid,
+										  InvalidOid,
+										  COERCE_EXPLICIT_CALL);
+	}
+
+	coalesce->coalescetype = minval->consttype;
+	coalesce->coalescecollid = InvalidOid;
+	coalesce->args = list_make2(watermark, minval);
+	coalesce->location = -1;
+
+	return (Node *) coalesce;
+}
+
+/*
+ * Build "<time column> <op> <watermark>" for the only relation in the range
+ * table of a real-time view leaf query.
+ */
+static Node *
+build_watermark_qual(Query *query, AttrNumber time_attno, int strategy, Node *watermark)
+{
+	RangeTblEntry *rte = linitial(query->rtable);
+	Oid type;
+	int32 typmod;
+	Oid collation;
+	TypeCacheEntry *tce;
+	Oid opno;
+	OpExpr *op;
+
+	Assert(list_length(query->rtable) == 1 && rte->rtekind == RTE_RELATION);
+
+	get_atttypetypmodcoll(rte->relid, time_attno, &type, &typmod, &collation);
+	tce = lookup_type_cache(type, TYPECACHE_BTREE_OPFAMILY);
+	opno = get_opfamily_member(tce->btree_opf, type, exprType(watermark), strategy);
+
+	if (!OidIsValid(opno))
+		elog(ERROR, "could not find btree operator for type %s", format_type_be(type));
+
+	op = (OpExpr *) make_opclause(opno,
+								  BOOLOID,
+								  false,
+								  (Expr *) makeVar(1, time_attno, type, typmod, collation, 0),
+								  (Expr *) watermark,
+								  InvalidOid,
+								  InvalidOid);
+	set_opfuncid(op);
+
+	return (Node *) op;
+}
+
+static RangeTblEntry *
+make_union_leaf_rte(Query *subquery, char *aliasname)
+{
+	RangeTblEntry *rte = makeNode(RangeTblEntry);
+	List *colnames = NIL;
+	ListCell *lc;
+
+	foreach (lc, subquery->targetList)
+	{
+		TargetEntry *tle = lfirst(lc);
+
+		if (!tle->resjunk)
+			colnames = lappend(colnames, makeString(pstrdup(tle->resname)));
+	}
+
+	rte->rtekind = RTE_SUBQUERY;
+	rte->subquery = subquery;
+	rte->alias = makeAlias(aliasname, NIL);
+	rte->eref = makeAlias(aliasname, colnames);
+	rte->inh = false;
+	rte->inFromCl = true;
+
+	return rte;
+}
+
+/*
+ * Build the query for a real-time continuous aggregate view:
+ *
+ * SELECT * FROM <finalize query> WHERE time_partition_col < <watermark>
+ * UNION ALL
+ * SELECT * FROM <direct query> WHERE <time column> >= <watermark>
+ *
+ * The aggregates below the completed threshold are read from the
+ * materialization, while the buckets above it are computed from the raw
+ * hypertable when the view is queried. The watermark is not a constant, so
+ * chunks of the raw hypertable below the threshold are excluded at executor
+ * startup.
+ */
+static Query *
+build_union_query(Query *final_query, Query *direct_query, int32 mat_hypertable_id,
+				  AttrNumber mat_time_attno, AttrNumber raw_time_attno, Oid timetype)
+{
+	Query *query;
+	SetOperationStmt *setop = makeNode(SetOperationStmt);
+	RangeTblRef *larg = makeNode(RangeTblRef);
+	RangeTblRef *rarg = makeNode(RangeTblRef);
+	Node *watermark = build_watermark_expr(mat_hypertable_id, timetype);
+	ListCell *lc_final, *lc_direct;
+
+	Assert(final_query->jointree->quals == NULL);
+	final_query->jointree->quals =
+		build_watermark_qual(final_query, mat_time_attno, BTLessStrategyNumber, watermark);
+	AddQual(direct_query,
+			build_watermark_qual(direct_query,
+								 raw_time_attno,
+								 BTGreaterEqualStrategyNumber,
+								 copyObject(watermark)));
+
+	query = makeNode(Query);
+	query->commandType = CMD_SELECT;
+	query->querySource = final_query->querySource;
+	query->canSetTag = final_query->canSetTag;
+	query->rtable = list_make2(make_union_leaf_rte(final_query, "materialized"),
+							   make_union_leaf_rte(direct_query, "raw"));
+	query->jointree = makeFromExpr(NIL, NULL);
+
+	larg->rtindex = 1;
+	rarg->rtindex = 2;
+	setop->op = SETOP_UNION;
+	setop->all = true;
+	setop->larg = (Node *) larg;
+	setop->rarg = (Node *) rarg;
+
+	/* junk columns come last in both target lists */
+	forboth (lc_final, final_query->targetList, lc_direct, direct_query->targetList)
+	{
+		TargetEntry *tle = lfirst(lc_final);
+		Node *final_expr = (Node *) tle->expr;
+		Node *direct_expr = (Node *) ((TargetEntry *) lfirst(lc_direct))->expr;
+		Oid type = exprType(final_expr);
+		int32 typmod = exprTypmod(final_expr);
+		Oid collation = exprCollation(final_expr);
+
+		if (tle->resjunk)
+			break;
+
+		Assert(type == exprType(direct_expr));
+		if (typmod != exprTypmod(direct_expr))
+			typmod = -1;
+
+		setop->colTypes = lappend_oid(setop->colTypes, type);
+		setop->colTypmods = lappend_int(setop->colTypmods, typmod);
+		setop->colCollations = lappend_oid(setop->colCollations, collation);
+		query->targetList =
+			lappend(query->targetList,
+					makeTargetEntry((Expr *) makeVar(1, tle->resno, type, typmod, collation, 0),
+									tle->resno,
+									pstrdup(tle->resname),
+									false));
+	}
+
+	query->setOperations = (Node *) setop;
+
+	return query;
+}
+
+/*
+ * Get a copy of a view's query without the OLD and NEW placeholder entries
+ * that StoreViewQuery adds to the range table.
+ */
+static Query *
+get_stored_view_query(Oid view_oid)
+{
+	Relation rel = heap_open(view_oid, AccessShareLock);
+	Query *query = copyObject(get_view_query(rel));
+
+	heap_close(rel, NoLock);
+
+	Assert(list_length(query->rtable) > 2);
+	query->rtable = list_copy_tail(query->rtable, 2);
+	OffsetVarNodes((Node *) query, -2, 0);
+
+	return query;
+}
+
+/*
+ * Switch the user view of a continuous aggregate between returning only
+ * materialized data and the real-time union with the raw hypertable.
+ */
+void
+cagg_update_materialized_only(ContinuousAgg *agg, bool materialized_only)
+{
+	Oid user_view_oid = get_relname_relid(NameStr(agg->data.user_view_name),
+										  get_namespace_oid(NameStr(agg->data.user_view_schema),
+															false));
+	Query *user_query = get_stored_view_query(user_view_oid);
+	Query *new_query;
+
+	if ((user_query->setOperations == NULL) == materialized_only)
+		return;
+
+	if (materialized_only)
+	{
+		SetOperationStmt *setop = (SetOperationStmt *) user_query->setOperations;
+		RangeTblEntry *rte = rt_fetch(((RangeTblRef *) setop->larg)->rtindex, user_query->rtable);
+
+		new_query = rte->subquery;
+		new_query->jointree->quals = NULL;
+	}
+	else
+	{
+		Oid direct_view_oid =
+			get_relname_relid(NameStr(agg->data.direct_view_name),
+							  get_namespace_oid(NameStr(agg->data.direct_view_schema), false));
+		Query *direct_query = get_stored_view_query(direct_view_oid);
+		RangeTblEntry *direct_rte = linitial(direct_query->rtable);
+		Cache *hcache = ts_hypertable_cache_pin();
+		/* the raw hypertable of a continuous aggregate materialized from another one is the
+		 * other's materialization table, so get the hypertable the direct view reads from */
+		Hypertable *raw_ht = ts_hypertable_cache_get_entry(hcache, direct_rte->relid);
+		Hypertable *mat_ht =
+			ts_hypertable_cache_get_entry_by_id(hcache, agg->data.mat_hypertable_id);
+		Dimension *raw_time_dim = hyperspace_get_open_dimension(raw_ht->space, 0);
+		Dimension *mat_time_dim = hyperspace_get_open_dimension(mat_ht->space, 0);
+
+		new_query = build_union_query(user_query,
+									  direct_query,
+									  agg->data.mat_hypertable_id,
+									  mat_time_dim->column_attno,
+									  raw_time_dim->column_attno,
+									  raw_time_dim->fd.column_type);
+		ts_cache_release(hcache);
+	}
+
+	StoreViewQuery(user_view_oid, new_query, true);
+	CommandCounterIncrement();
+}
+
+/*
+ * Get the continuous agg given by the materialize_from option, or NULL if the
+ * option is not set. A continuous agg can only be materialized from a
+ * continuous agg whose query reads from the same hypertable and whose bucket
+ * width divides its own.
+ */
+static ContinuousAgg *
+cagg_get_materialize_from(WithClauseResult *with_clause_options, CAggTimebucketInfo *origquery_ht)
+{
+	Oid view_oid;
+	Oid direct_view_oid;
+	char *view_schema;
+	char *view_name;
+	ContinuousAgg *source;
+	Query *direct_query;
+
+	if (with_clause_options[ContinuousViewOptionMaterializeFrom].is_default)
+		return NULL;
+
+	view_oid = DatumGetObjectId(with_clause_options[ContinuousViewOptionMaterializeFrom].parsed);
+	view_schema = get_namespace_name(get_rel_namespace(view_oid));
+	view_name = get_rel_name(view_oid);
+	source = ts_continuous_agg_find_by_view_name(view_schema, view_name);
+
+	if (source == NULL ||
+		ts_continuous_agg_view_type(&source->data, view_schema, view_name) !=
+			ContinuousAggUserView)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("\"%s\" is not a continuous aggregate", view_name)));
+
+	/* source might itself be materialized from another continuous agg, so check the hypertable
+	 * its query reads from */
+	direct_view_oid =
+		get_relname_relid(NameStr(source->data.direct_view_name),
+						  get_namespace_oid(NameStr(source->data.direct_view_schema), false));
+	direct_query = get_stored_view_query(direct_view_oid);
+
+	if (((RangeTblEntry *) linitial(direct_query->rtable))->relid != origquery_ht->htoid)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("continuous aggregate \"%s\" is not defined on the hypertable of the "
+						"query",
+						view_name)));
+
+	if (origquery_ht->bucket_width % source->data.bucket_width != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("time bucket width must be a multiple of the bucket width of continuous "
+						"aggregate \"%s\"",
+						view_name)));
+
+	return source;
+}
+
+/*
+ * Compute the partials of the partial view query from the partials stored by
+ * the continuous agg source.
+ */
+static Query *
+cagg_get_partial_query_from_source(Query *partial_selquery, CAggTimebucketInfo *origquery_ht,
+								   ContinuousAgg *source, const char *view_name)
+{
+	Cache *hcache = ts_hypertable_cache_pin();
+	Hypertable *raw_ht = ts_hypertable_cache_get_entry_by_id(hcache, origquery_ht->htid);
+	Query *query = continuous_agg_rewrite_partial_query(partial_selquery, raw_ht, source);
+
+	ts_cache_release(hcache);
+
+	if (query == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("continuous aggregate \"%s\" cannot be materialized from \"%s\"",
+						view_name,
+						NameStr(source->data.user_view_name)),
+				 errdetail("The query must have the same WHERE clause as \"%s\" and only use "
+						   "its grouping columns and aggregates.",
+						   NameStr(source->data.user_view_name))));
+
+	return query;
+}
+
 /* Modifies the passed in ViewStmt to do the following
  * a) Create a hypertable for the continuous agg materialization.
  * b) create a view that references the underlying
@@ -1578,10 +2168,17 @@ fixup_userview_query_tlist(Query *userquery, List *tlist_aliases)
  *
  * Notes: ViewStmt->query is the raw parse tree
  * panquery is the output of running parse_anlayze( ViewStmt->query)
+ *
+ * If source is set, the new continuous agg is materialized from the partials
+ * stored by the continuous agg source instead of the raw hypertable, see
+ * continuous_agg_rewrite_partial_query. The materialization table of source is
+ * then the raw hypertable of the new continuous agg: its invalidation trigger
+ * logs the changes made when source is materialized, and the materialization
+ * end point is computed from the materialized buckets of source.
  */
 static void
 cagg_create(ViewStmt *stmt, Query *panquery, CAggTimebucketInfo *origquery_ht,
-			WithClauseResult *with_clause_options)
+			WithClauseResult *with_clause_options, ContinuousAgg *source)
 {
 	ObjectAddress mataddress;
 	char relnamebuf[NAMEDATALEN];
@@ -1589,6 +2186,8 @@ cagg_create(ViewStmt *stmt, Query *panquery, CAggTimebucketInfo *origquery_ht,
 	FinalizeQueryInfo finalqinfo;
 	CatalogSecurityContext sec_ctx;
 	bool is_create_mattbl_index;
+	bool materialized_only =
+		DatumGetBool(with_clause_options[ContinuousViewOptionMaterializedOnly].parsed);
 
 	Query *final_selquery;
 	Query *partial_selquery;	/* query to populate the mattable*/
@@ -1600,6 +2199,12 @@ cagg_create(ViewStmt *stmt, Query *panquery, CAggTimebucketInfo *origquery_ht,
 	int32 job_id;
 	char trigarg[NAMEDATALEN];
 	int ret;
+	/* the hypertable the partials are computed from */
+	int32 raw_hypertable_id =
+		(source != NULL) ? source->data.mat_hypertable_id : origquery_ht->htid;
+	/* the invalidation trigger is shared by all the continuous aggregates on the hypertable */
+	bool has_invalidation_trigger =
+		(ts_continuous_agg_hypertable_status(raw_hypertable_id) & HypertableIsRawTable) != 0;
 	Interval *refresh_interval =
 		DatumGetIntervalP(with_clause_options[ContinuousViewOptionRefreshInterval].parsed);
 	int64 refresh_lag = get_refresh_lag(origquery_ht->htpartcoltype,
@@ -1637,15 +2242,31 @@ cagg_create(ViewStmt *stmt, Query *panquery, CAggTimebucketInfo *origquery_ht,
 													is_create_mattbl_index,
 													&mataddress);
 	/* Step 2: create view with select finalize from materialization
-	 * table
+	 * table. Unless the view returns only materialized data, it also reads the
+	 * raw hypertable above the completed threshold (see build_union_query).
 	 */
 	final_selquery =
 		finalizequery_get_select_query(&finalqinfo, mattblinfo.matcollist, &mataddress);
-	create_view_for_query(final_selquery, stmt->view);
+	orig_userview_query = fixup_userview_query_tlist(panquery, stmt->aliases);
+	if (materialized_only)
+		create_view_for_query(final_selquery, stmt->view);
+	else
+		create_view_for_query(build_union_query(final_selquery,
+												copyObject(orig_userview_query),
+												materialize_hypertable_id,
+												mattblinfo.matpartcolno + 1,
+												origquery_ht->htpartcolno,
+												origquery_ht->htpartcoltype),
+							  stmt->view);
 
 	/* Step 3: create the internal view with select partialize(..)
 	 */
 	partial_selquery = mattablecolumninfo_get_partial_select_query(&mattblinfo, panquery);
+	if (source != NULL)
+		partial_selquery = cagg_get_partial_query_from_source(partial_selquery,
+															  origquery_ht,
+															  source,
+															  stmt->view->relname);
 
 	PRINT_MATINTERNAL_NAME(relnamebuf, "_partial_view_%d", materialize_hypertable_id);
 	part_rel = makeRangeVar(pstrdup(INTERNAL_SCHEMA_NAME), pstrdup(relnamebuf), -1);
@@ -1655,19 +2276,18 @@ cagg_create(ViewStmt *stmt, Query *panquery, CAggTimebucketInfo *origquery_ht,
 	/* create a dummy view to store the user supplied view query. This is to get PG
 	 * to display the view correctly without having to replicate the PG source code for make_viewdef
 	 */
-	orig_userview_query = fixup_userview_query_tlist(panquery, stmt->aliases);
 	PRINT_MATINTERNAL_NAME(relnamebuf, "_direct_view_%d", materialize_hypertable_id);
 	dum_rel = makeRangeVar(pstrdup(INTERNAL_SCHEMA_NAME), pstrdup(relnamebuf), -1);
 	create_view_for_query(orig_userview_query, dum_rel);
 
 	/* register the BGW job to process continuous aggs*/
 	job_id =
-		ts_continuous_agg_job_add(origquery_ht->htid, origquery_ht->bucket_width, refresh_interval);
+		ts_continuous_agg_job_add(raw_hypertable_id, origquery_ht->bucket_width, refresh_interval);
 
 	/* Step 4 add catalog table entry for the objects we just created */
 	nspid = RangeVarGetCreationNamespace(stmt->view);
 	create_cagg_catlog_entry(materialize_hypertable_id,
-							 origquery_ht->htid,
+							 raw_hypertable_id,
 							 get_namespace_name(nspid), /*schema name for user view */
 							 stmt->view->relname,
 							 part_rel->schemaname,
@@ -1679,13 +2299,20 @@ cagg_create(ViewStmt *stmt, Query *panquery, CAggTimebucketInfo *origquery_ht,
 							 dum_rel->schemaname,
 							 dum_rel->relname);
 
-	/* Step 5 create trigger on raw hypertable -specified in the user view query*/
-	ret = snprintf(trigarg, NAMEDATALEN, "%d", origquery_ht->htid);
+	/* Step 5 create trigger on raw hypertable -specified in the user view query, or the
+	 * materialization table of source */
+	if (has_invalidation_trigger)
+		return;
+
+	ret = snprintf(trigarg, NAMEDATALEN, "%d", raw_hypertable_id);
 	if (ret < 0 || ret >= NAMEDATALEN)
 		ereport(ERROR,
 				(errcode(ERRCODE_INTERNAL_ERROR),
 				 errmsg("bad argument to continuous aggregate trigger")));
-	cagg_add_trigger_hypertable(origquery_ht->htoid, trigarg);
+	cagg_add_trigger_hypertable((source != NULL) ?
+									ts_hypertable_get_by_id(raw_hypertable_id)->main_table_relid :
+									origquery_ht->htoid,
+								trigarg);
 
 	return;
 }
@@ -1729,10 +2356,12 @@ tsl_process_continuous_agg_viewstmt(ViewStmt *stmt, const char *query_string, vo
 
 	timebucket_exprinfo = cagg_validate_query(query);
 
-	/* there can only be one continuous aggregate per table */
+	/* a hypertable can have any number of continuous aggregates, which share its invalidation
+	 * log and invalidation threshold */
 	switch (ts_continuous_agg_hypertable_status(timebucket_exprinfo.htid))
 	{
 		case HypertableIsMaterialization:
+		case HypertableIsMaterializationAndRaw:
 			ereport(ERROR,
 					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 					 errmsg("hypertable is a continuous aggregate materialization table"),
@@ -1740,19 +2369,16 @@ tsl_process_continuous_agg_viewstmt(ViewStmt *stmt, const char *query_string, vo
 							 "yet supported")));
 			return false;
 		case HypertableIsRawTable:
-		case HypertableIsMaterializationAndRaw:
-			ereport(ERROR,
-					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-					 errmsg("hypertable already has a continuous aggregate"),
-					 errhint("hypertables currently only support a single continuous aggregate. "
-							 "Drop the other continuous aggreagate to add a new one.")));
-			return false;
 		case HypertableIsNotContinuousAgg:
 			break;
 		default:
 			Assert(false && "unerachable");
 	}
 
-	cagg_create(stmt, query, &timebucket_exprinfo, with_clause_options);
+	cagg_create(stmt,
+				query,
+				&timebucket_exprinfo,
+				with_clause_options,
+				cagg_get_materialize_from(with_clause_options, &timebucket_exprinfo));
 	return true;
 }
@@ -7,12 +7,17 @@
 #define TIMESCALEDB_TSL_CONTINUOUS_AGGS_CAGG_CREATE_H
 #include <postgres.h>
 #include <nodes/parsenodes.h>
+#include <nodes/primnodes.h>
 
 #include "with_clause_parser.h"
+#include "continuous_agg.h"
 
 #define CONTINUOUS_AGG_CHUNK_ID_COL_NAME "chunk_id"
 
 bool tsl_process_continuous_agg_viewstmt(ViewStmt *stmt, const char *query_string, void *pstmt,
 										 WithClauseResult *with_clause_options);
+Aggref *get_finalize_aggref(Aggref *inp, Var *partial_state_var);
+Aggref *get_combine_aggref(Aggref *inp, Var *partial_state_var);
+void cagg_update_materialized_only(ContinuousAgg *agg, bool materialized_only);
 
 #endif /* TIMESCALEDB_TSL_CONTINUOUS_AGGS_CAGG_CREATE_H */
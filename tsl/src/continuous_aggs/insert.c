@@ -17,6 +17,7 @@
 #include <utils/rel.h>
 #include <utils/relcache.h>
 #include <access/xact.h>
+#include <storage/lmgr.h>
 
 #include <scanner.h>
 
@@ -24,32 +25,47 @@
 #include "dimension.h"
 #include "hypertable.h"
 #include "hypertable_cache.h"
+#include "invalidation_threshold_cache.h"
 #include "export.h"
 #include "partitioning.h"
 
 #include "utils.h"
 #include "time_bucket.h"
 
+#include "continuous_agg.h"
 #include "continuous_aggs/insert.h"
+#include "continuous_aggs/invalidation_set.h"
 
 /*
  * When tuples in a hypertable that has a continuous aggregate are modified, the
- * lowest modified value and the greatest modified value must be tracked over
- * the course of a transaction or statement. At the end of the statement these
- * values will be inserted into the proper cache invalidation log table for
- * their associated hypertable if they are below the speculative materialization
- * watermark (or, if in REPEATABLE_READ isolation level or higher, they will be
- * inserted no matter what as we cannot see if a materialization transaction has
- * started and moved the watermark during our transaction in that case).
+ * ranges of modified values must be tracked over the course of a transaction or
+ * statement. At the end of the statement the ranges will be inserted into the
+ * proper cache invalidation log table for their associated hypertable if they
+ * start below the speculative materialization watermark (or, if in
+ * REPEATABLE_READ isolation level or higher, they will be inserted no matter
+ * what as we cannot see if a materialization transaction has started and moved
+ * the watermark during our transaction in that case).
  *
  * We accomplish this at the transaction level by keeping a hash table of each
- * hypertable that has been modified in the transaction and the lowest and
- * greatest modified values. The hashtable will be updated via a trigger that
- * will be called for every row that is inserted, updated or deleted. We use a
- * hashtable because we need to keep track of this on a per hypertable basis and
- * multiple can have tuples modified during a single transaction. (And if we
- * move to per-chunk cache-invalidation it makes it even easier).
+ * hypertable that has been modified in the transaction and the set of modified
+ * ranges. The hashtable will be updated via a trigger that will be called for
+ * every row that is inserted, updated or deleted. We use a hashtable because we
+ * need to keep track of this on a per hypertable basis and multiple can have
+ * tuples modified during a single transaction. (And if we move to per-chunk
+ * cache-invalidation it makes it even easier).
  *
+ * Modifications are coalesced into one range per run of modified buckets of the
+ * continuous aggregates on the hypertable, so that a few late rows only
+ * invalidate the buckets they modify, instead of everything between them and
+ * the rest of the transaction's modifications. To bound the size of the log,
+ * the closest ranges are merged once a transaction modifies more than
+ * CA_CACHE_INVAL_MAX_RANGES of them.
+ *
+ * Inserts through the hypertable do not fire the trigger: the chunk dispatch
+ * tracks the range of time values it inserts into each chunk and records it via
+ * continuous_agg_invalidate when it is done with the chunk (see
+ * src/chunk_insert_state.c). The trigger still handles UPDATEs, DELETEs and
+ * INSERTs directly into chunks.
  */
 typedef struct ContinuousAggsCacheInvalEntry
 {
@@ -60,14 +76,15 @@ typedef struct ContinuousAggsCacheInvalEntry
 	Oid previous_chunk_relid;
 	AttrNumber previous_chunk_open_dimension;
 
-	int64 lowest_modified_value;
-	int64 greatest_modified_value;
+	InvalidationSet modified_ranges;
 } ContinuousAggsCacheInvalEntry;
 
-static void append_invalidation_entry(ContinuousAggsCacheInvalEntry *entry);
-static int64 get_lowest_invalidated_time_for_hypertable(Oid hypertable_relid);
+static void append_invalidation_entry(ContinuousAggsCacheInvalEntry *entry,
+									  int64 invalidation_threshold);
+static int64 get_lowest_invalidated_time_for_hypertable(int32 hypertable_id);
 
 #define CA_CACHE_INVAL_INIT_HTAB_SIZE 64
+#define CA_CACHE_INVAL_MAX_RANGES 64
 
 static HTAB *continuous_aggs_cache_inval_htab = NULL;
 static MemoryContext continuous_aggs_trigger_mctx = NULL;
@@ -123,9 +140,36 @@ tuple_get_time(Dimension *d, HeapTuple tuple, AttrNumber col, TupleDesc tupdesc)
 	return ts_time_value_to_internal(datum, dimtype);
 }
 
+/*
+ * Modifications are coalesced at the granularity of the smallest bucket of the
+ * continuous aggregates on the hypertable.
+ */
+static int64
+get_min_bucket_width(int32 hypertable_id)
+{
+	int64 min_bucket_width = PG_INT64_MAX;
+	ListCell *lc;
+
+	foreach (lc, ts_continuous_aggs_find_by_raw_table_id(hypertable_id))
+	{
+		ContinuousAgg *cagg = lfirst(lc);
+
+		if (cagg->data.bucket_width < min_bucket_width)
+			min_bucket_width = cagg->data.bucket_width;
+	}
+
+	/* without a continuous aggregate, only coalesce adjacent values */
+	if (min_bucket_width == PG_INT64_MAX)
+		return 1;
+
+	return min_bucket_width;
+}
+
 static inline void
 cache_inval_entry_init(ContinuousAggsCacheInvalEntry *cache_entry, int32 hypertable_id)
 {
+	MemoryContext old_ctx;
+	int64 bucket_width;
 	Cache *ht_cache = ts_hypertable_cache_pin();
 	/* NOTE: we can remove the id=>relid scan, if it becomes an issue, by getting the
 	 * hypertable_relid directly from the Chunk*/
@@ -140,8 +184,11 @@ cache_inval_entry_init(ContinuousAggsCacheInvalEntry *cache_entry, int32 hyperta
 		cache_entry->hypertable_open_dimension.partitioning = open_dim_part_info;
 	}
 	cache_entry->previous_chunk_relid = InvalidOid;
-	cache_entry->lowest_modified_value = PG_INT64_MAX;
-	cache_entry->greatest_modified_value = PG_INT64_MIN;
+
+	bucket_width = get_min_bucket_width(hypertable_id);
+	old_ctx = MemoryContextSwitchTo(continuous_aggs_trigger_mctx);
+	invalidation_set_init(&cache_entry->modified_ranges, bucket_width, CA_CACHE_INVAL_MAX_RANGES);
+	MemoryContextSwitchTo(old_ctx);
 	ts_cache_release(ht_cache);
 }
 
@@ -164,10 +211,42 @@ cache_entry_switch_to_chunk(ContinuousAggsCacheInvalEntry *cache_entry, Oid chun
 static inline void
 update_cache_entry(ContinuousAggsCacheInvalEntry *cache_entry, int64 timeval)
 {
-	if (timeval < cache_entry->lowest_modified_value)
-		cache_entry->lowest_modified_value = timeval;
-	if (timeval > cache_entry->greatest_modified_value)
-		cache_entry->greatest_modified_value = timeval;
+	invalidation_set_add(&cache_entry->modified_ranges, timeval, timeval);
+}
+
+static ContinuousAggsCacheInvalEntry *
+get_cache_inval_entry(int32 hypertable_id)
+{
+	ContinuousAggsCacheInvalEntry *cache_entry;
+	bool found;
+
+	/* On first call, init the mctx and hash table*/
+	if (!continuous_aggs_cache_inval_htab)
+		cache_inval_init();
+
+	cache_entry = (ContinuousAggsCacheInvalEntry *)
+		hash_search(continuous_aggs_cache_inval_htab, &hypertable_id, HASH_ENTER, &found);
+
+	if (!found)
+		cache_inval_entry_init(cache_entry, hypertable_id);
+
+	return cache_entry;
+}
+
+/*
+ * Record an invalidation of the range [lowest_modified_value, greatest_modified_value] of the
+ * hypertable in the current transaction. This is used by inserts through the hypertable, which
+ * track the inserted range themselves instead of firing the trigger below for every row.
+ */
+void
+continuous_agg_invalidate(int32 hypertable_id, int64 lowest_modified_value,
+						  int64 greatest_modified_value)
+{
+	ContinuousAggsCacheInvalEntry *cache_entry = get_cache_inval_entry(hypertable_id);
+
+	invalidation_set_add(&cache_entry->modified_ranges,
+						 lowest_modified_value,
+						 greatest_modified_value);
 }
 
 /*
@@ -188,7 +267,6 @@ continuous_agg_trigfn(PG_FUNCTION_ARGS)
 	char *hypertable_id_str;
 	int32 hypertable_id;
 	ContinuousAggsCacheInvalEntry *cache_entry;
-	bool found;
 	int64 timeval;
 	if (trigdata->tg_trigger->tgnargs < 0)
 		elog(ERROR, "must supply hypertable id");
@@ -201,15 +279,7 @@ continuous_agg_trigfn(PG_FUNCTION_ARGS)
 	if (!TRIGGER_FIRED_AFTER(trigdata->tg_event) || !TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
 		elog(ERROR, "continuous agg trigger function must be called in per row after trigger");
 
-	/* On first call, init the mctx and hash table*/
-	if (!continuous_aggs_cache_inval_htab)
-		cache_inval_init();
-
-	cache_entry = (ContinuousAggsCacheInvalEntry *)
-		hash_search(continuous_aggs_cache_inval_htab, &hypertable_id, HASH_ENTER, &found);
-
-	if (!found)
-		cache_inval_entry_init(cache_entry, hypertable_id);
+	cache_entry = get_cache_inval_entry(hypertable_id);
 
 	/* handle the case where we need to repopulate the cached chunk data */
 	if (cache_entry->previous_chunk_relid != trigdata->tg_relation->rd_id)
@@ -241,7 +311,6 @@ continuous_agg_trigfn(PG_FUNCTION_ARGS)
 static void
 cache_inval_entry_write(ContinuousAggsCacheInvalEntry *entry)
 {
-	int64 liv;
 	/* The materialization worker uses a READ COMMITTED isolation level by default. Therefore, if we
 	 * use a stronger isolation level, the isolation thereshold could update without us seeing the
 	 * new value. In order to prevent serialization errors, we always append invalidation entires in
@@ -251,13 +320,12 @@ cache_inval_entry_write(ContinuousAggsCacheInvalEntry *entry)
 	 */
 	if (IsolationUsesXactSnapshot())
 	{
-		append_invalidation_entry(entry);
+		append_invalidation_entry(entry, PG_INT64_MAX);
 		return;
 	}
 
-	liv = get_lowest_invalidated_time_for_hypertable(entry->hypertable_relid);
-	if (entry->lowest_modified_value < liv)
-		append_invalidation_entry(entry);
+	append_invalidation_entry(entry,
+							  get_lowest_invalidated_time_for_hypertable(entry->hypertable_id));
 };
 
 static void
@@ -328,19 +396,35 @@ invalidation_tuple_found(TupleInfo *ti, void *min)
 	return SCAN_CONTINUE;
 }
 
-int64
-get_lowest_invalidated_time_for_hypertable(Oid hypertable_relid)
+/*
+ * Get the invalidation threshold of the hypertable, from the cache in shared memory if possible.
+ *
+ * The materializer must not move the threshold before our invalidations are committed. Reading
+ * the cache registers us as reader until the end of the transaction, and the materializer waits
+ * for the readers once it moved the threshold. Reading the catalog, the invalidation threshold
+ * table stays locked until the end of the transaction, so the materializer, which updates the
+ * threshold under an AccessExclusiveLock, waits for us as well.
+ */
+static int64
+get_lowest_invalidated_time_for_hypertable(int32 hypertable_id)
 {
 	int64 min_val = PG_INT64_MAX;
+	uint32 generation;
 	Catalog *catalog = ts_catalog_get();
 	ScanKeyData scankey[1];
 	ScannerCtx scanctx;
 
+	if (ts_invalidation_threshold_cache_get(hypertable_id, &min_val, &generation))
+		return min_val;
+
+	LockRelationOid(catalog_get_table_id(catalog, CONTINUOUS_AGGS_INVALIDATION_THRESHOLD),
+					AccessShareLock);
+
 	ScanKeyInit(&scankey[0],
 				Anum_continuous_aggs_invalidation_threshold_pkey_hypertable_id,
 				BTEqualStrategyNumber,
 				F_INT4EQ,
-				Int32GetDatum(ts_hypertable_relid_to_id(hypertable_relid)));
+				Int32GetDatum(hypertable_id));
 	scanctx = (ScannerCtx){
 		.table = catalog_get_table_id(catalog, CONTINUOUS_AGGS_INVALIDATION_THRESHOLD),
 		.index = catalog_get_index(catalog,
@@ -362,40 +446,61 @@ get_lowest_invalidated_time_for_hypertable(Oid hypertable_relid)
 	 * invalidations are redundant.
 	 */
 	if (!ts_scanner_scan_one(&scanctx, false, "invalidation watermark"))
-		return PG_INT64_MIN;
+		min_val = PG_INT64_MIN;
+
+	ts_invalidation_threshold_cache_set(hypertable_id, min_val, generation);
 
 	return min_val;
 }
 
+/* log the modified ranges of the entry which start below the invalidation threshold */
 static void
-append_invalidation_entry(ContinuousAggsCacheInvalEntry *entry)
+append_invalidation_entry(ContinuousAggsCacheInvalEntry *entry, int64 invalidation_threshold)
 {
 	Catalog *catalog = ts_catalog_get();
 	Relation rel;
 	TupleDesc desc;
-	Datum values[Natts_continuous_aggs_hypertable_invalidation_log];
 	CatalogSecurityContext sec_ctx;
-	bool nulls[Natts_continuous_aggs_hypertable_invalidation_log] = { false };
-	int32 hypertable_id = ts_hypertable_relid_to_id(entry->hypertable_relid);
+	int32 hypertable_id;
+	int i;
 
-	Assert(entry->lowest_modified_value <= entry->greatest_modified_value);
+	/* the ranges are sorted, so there is nothing to log if the first one is not below the
+	 * threshold */
+	if (entry->modified_ranges.num_ranges == 0 ||
+		entry->modified_ranges.ranges[0].lowest_modified_value >= invalidation_threshold)
+		return;
 
+	hypertable_id = entry->hypertable_id;
 	rel = heap_open(catalog_get_table_id(catalog, CONTINUOUS_AGGS_HYPERTABLE_INVALIDATION_LOG),
 					RowExclusiveLock);
 	desc = RelationGetDescr(rel);
 
-	values[AttrNumberGetAttrOffset(
-		Anum_continuous_aggs_hypertable_invalidation_log_hypertable_id)] =
-		ObjectIdGetDatum(hypertable_id);
-	values[AttrNumberGetAttrOffset(
-		Anum_continuous_aggs_hypertable_invalidation_log_lowest_modified_value)] =
-		Int64GetDatum(entry->lowest_modified_value);
-	values[AttrNumberGetAttrOffset(
-		Anum_continuous_aggs_hypertable_invalidation_log_greatest_modified_value)] =
-		Int64GetDatum(entry->greatest_modified_value);
-
 	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
-	ts_catalog_insert_values(rel, desc, values, nulls);
+
+	for (i = 0; i < entry->modified_ranges.num_ranges; i++)
+	{
+		Invalidation *range = &entry->modified_ranges.ranges[i];
+		Datum values[Natts_continuous_aggs_hypertable_invalidation_log];
+		bool nulls[Natts_continuous_aggs_hypertable_invalidation_log] = { false };
+
+		Assert(range->lowest_modified_value <= range->greatest_modified_value);
+
+		if (range->lowest_modified_value >= invalidation_threshold)
+			break;
+
+		values[AttrNumberGetAttrOffset(
+			Anum_continuous_aggs_hypertable_invalidation_log_hypertable_id)] =
+			ObjectIdGetDatum(hypertable_id);
+		values[AttrNumberGetAttrOffset(
+			Anum_continuous_aggs_hypertable_invalidation_log_lowest_modified_value)] =
+			Int64GetDatum(range->lowest_modified_value);
+		values[AttrNumberGetAttrOffset(
+			Anum_continuous_aggs_hypertable_invalidation_log_greatest_modified_value)] =
+			Int64GetDatum(range->greatest_modified_value);
+
+		ts_catalog_insert_values(rel, desc, values, nulls);
+	}
+
 	ts_catalog_restore_user(&sec_ctx);
 
 	/* Lock will be released by the transaction end. Since this is called on the
@@ -10,6 +10,8 @@
 #include <fmgr.h>
 
 extern Datum continuous_agg_trigfn(PG_FUNCTION_ARGS);
+extern void continuous_agg_invalidate(int32 hypertable_id, int64 lowest_modified_value,
+									  int64 greatest_modified_value);
 
 extern void _continuous_aggs_cache_inval_init();
 extern void _continuous_aggs_cache_inval_fini();
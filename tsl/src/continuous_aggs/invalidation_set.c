@@ -0,0 +1,187 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+#include <postgres.h>
+
+#include "continuous_aggs/invalidation_set.h"
+
+#define INVALIDATION_SET_INITIAL_CAPACITY 8
+
+void
+invalidation_set_init(InvalidationSet *set, int64 bucket_width, int max_ranges)
+{
+	Assert(bucket_width > 0);
+	Assert(max_ranges >= 0);
+
+	*set = (InvalidationSet){
+		.bucket_width = bucket_width,
+		.max_ranges = max_ranges,
+		.num_ranges = 0,
+		.capacity = INVALIDATION_SET_INITIAL_CAPACITY,
+		.last_added = 0,
+		.ranges = palloc(sizeof(Invalidation) * INVALIDATION_SET_INITIAL_CAPACITY),
+	};
+}
+
+/*
+ * The start of the bucket of bucket_width containing value. This is only used to
+ * decide which invalidations to coalesce, so we do not need the origin of
+ * time_bucket, plain floor division is enough.
+ */
+static inline int64
+bucket_start(int64 bucket_width, int64 value)
+{
+	int64 offset;
+
+	if (bucket_width == 1)
+		return value;
+
+	if (value < PG_INT64_MIN + bucket_width)
+		return PG_INT64_MIN;
+
+	offset = value % bucket_width;
+	if (offset < 0)
+		offset += bucket_width;
+
+	return value - offset;
+}
+
+/*
+ * Does a range ending at lower_greatest touch a range starting at upper_lowest,
+ * that is, do they modify the same or neighbouring buckets?
+ */
+static inline bool
+ranges_touch(InvalidationSet *set, int64 lower_greatest, int64 upper_lowest)
+{
+	int64 lower_bucket = bucket_start(set->bucket_width, lower_greatest);
+	int64 upper_bucket = bucket_start(set->bucket_width, upper_lowest);
+
+	if (upper_bucket <= lower_bucket)
+		return true;
+
+	/* the difference cannot overflow as unsigned */
+	return (uint64) upper_bucket - (uint64) lower_bucket <= (uint64) set->bucket_width;
+}
+
+/* merge the two neighbouring ranges that are closest to each other */
+static void
+merge_closest_ranges(InvalidationSet *set)
+{
+	uint64 min_gap = PG_UINT64_MAX;
+	int merge_at = 0;
+	int i;
+
+	Assert(set->num_ranges >= 2);
+
+	for (i = 0; i + 1 < set->num_ranges; i++)
+	{
+		uint64 gap = (uint64) set->ranges[i + 1].lowest_modified_value -
+					 (uint64) set->ranges[i].greatest_modified_value;
+
+		if (gap < min_gap)
+		{
+			min_gap = gap;
+			merge_at = i;
+		}
+	}
+
+	set->ranges[merge_at].greatest_modified_value =
+		set->ranges[merge_at + 1].greatest_modified_value;
+	memmove(&set->ranges[merge_at + 1],
+			&set->ranges[merge_at + 2],
+			sizeof(Invalidation) * (set->num_ranges - merge_at - 2));
+	set->num_ranges--;
+	set->last_added = merge_at;
+}
+
+void
+invalidation_set_add(InvalidationSet *set, int64 lowest_modified_value,
+					 int64 greatest_modified_value)
+{
+	int low = 0;
+	int high = set->num_ranges;
+	int first;
+	int end;
+
+	Assert(lowest_modified_value <= greatest_modified_value);
+
+	/* Fast path: mutations tend to hit the same range over and over again */
+	if (set->num_ranges > 0)
+	{
+		Invalidation *last = &set->ranges[set->last_added];
+
+		if (last->lowest_modified_value <= lowest_modified_value &&
+			greatest_modified_value <= last->greatest_modified_value)
+			return;
+	}
+
+	/* find the first range that is not entirely below the new one */
+	while (low < high)
+	{
+		int mid = low + (high - low) / 2;
+
+		if (ranges_touch(set, set->ranges[mid].greatest_modified_value, lowest_modified_value))
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	first = low;
+
+	/* coalesce with all the ranges the new one touches */
+	for (end = first; end < set->num_ranges; end++)
+	{
+		Invalidation *range = &set->ranges[end];
+
+		if (!ranges_touch(set, greatest_modified_value, range->lowest_modified_value))
+			break;
+
+		lowest_modified_value = Min(lowest_modified_value, range->lowest_modified_value);
+		greatest_modified_value = Max(greatest_modified_value, range->greatest_modified_value);
+	}
+
+	if (end == first)
+	{
+		/* no range to coalesce with, make room for a new one */
+		if (set->num_ranges == set->capacity)
+		{
+			set->capacity *= 2;
+			set->ranges = repalloc(set->ranges, sizeof(Invalidation) * set->capacity);
+		}
+
+		memmove(&set->ranges[first + 1],
+				&set->ranges[first],
+				sizeof(Invalidation) * (set->num_ranges - first));
+		set->num_ranges++;
+	}
+	else if (end > first + 1)
+	{
+		memmove(&set->ranges[first + 1],
+				&set->ranges[end],
+				sizeof(Invalidation) * (set->num_ranges - end));
+		set->num_ranges -= end - first - 1;
+	}
+
+	set->ranges[first].lowest_modified_value = lowest_modified_value;
+	set->ranges[first].greatest_modified_value = greatest_modified_value;
+	set->last_added = first;
+
+	if (set->max_ranges > 0 && set->num_ranges > set->max_ranges)
+		merge_closest_ranges(set);
+}
+
+void
+invalidation_set_add_list(InvalidationSet *set, List *invalidations)
+{
+	ListCell *lc;
+
+	foreach (lc, invalidations)
+	{
+		Invalidation *invalidation = lfirst(lc);
+
+		invalidation_set_add(set,
+							 invalidation->lowest_modified_value,
+							 invalidation->greatest_modified_value);
+	}
+}
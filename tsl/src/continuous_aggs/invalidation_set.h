@@ -0,0 +1,43 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_TSL_CONTINUOUS_AGGS_INVALIDATION_SET_H
+#define TIMESCALEDB_TSL_CONTINUOUS_AGGS_INVALIDATION_SET_H
+
+#include <postgres.h>
+#include <nodes/pg_list.h>
+
+/* an inclusive range of modified time values, in our internal time representation */
+typedef struct Invalidation
+{
+	int64 lowest_modified_value;
+	int64 greatest_modified_value;
+} Invalidation;
+
+/*
+ * A set of disjoint invalidations, sorted by their lowest modified value.
+ *
+ * Invalidations are coalesced when they modify the same or neighbouring buckets
+ * of bucket_width, so that a set contains at most one invalidation per run of
+ * modified buckets. A bucket_width of 1 only coalesces overlapping and adjacent
+ * invalidations. If max_ranges is set, the closest invalidations are merged
+ * whenever the set grows beyond it, trading precision for a bounded size.
+ */
+typedef struct InvalidationSet
+{
+	int64 bucket_width;
+	int max_ranges;
+	int num_ranges;
+	int capacity;
+	int last_added;
+	Invalidation *ranges;
+} InvalidationSet;
+
+extern void invalidation_set_init(InvalidationSet *set, int64 bucket_width, int max_ranges);
+extern void invalidation_set_add(InvalidationSet *set, int64 lowest_modified_value,
+								 int64 greatest_modified_value);
+extern void invalidation_set_add_list(InvalidationSet *set, List *invalidations);
+
+#endif /* TIMESCALEDB_TSL_CONTINUOUS_AGGS_INVALIDATION_SET_H */
@@ -6,6 +6,8 @@
  */
 #include <postgres.h>
 
+#include <access/heapam.h>
+#include <access/htup_details.h>
 #include <access/tupconvert.h>
 #include <access/xact.h>
 #include <catalog/namespace.h>
@@ -15,23 +17,38 @@
 #include <fmgr.h>
 #include <lib/stringinfo.h>
 #include <miscadmin.h>
+#include <port/atomics.h>
+#include <postmaster/bgworker.h>
 #include <utils/hsearch.h>
+#include <storage/bufmgr.h>
+#include <storage/dsm.h>
 #include <storage/lmgr.h>
+#include <storage/shmem.h>
 #include <utils/builtins.h>
 #include <utils/rel.h>
 #include <utils/relcache.h>
 #include <utils/date.h>
+#include <utils/timestamp.h>
+#include <utils/resowner.h>
 #include <utils/snapmgr.h>
 
+#include <continuous_agg.h>
 #include <scanner.h>
 #include <compat.h>
 
+#include "bgw/job.h"
+#include "bgw/launcher_interface.h"
 #include "chunk.h"
 #include "dimension.h"
+#include "dimension_slice.h"
+#include "dimension_vector.h"
+#include "guc.h"
 #include "hypertable.h"
 #include "hypertable_cache.h"
+#include "invalidation_threshold_cache.h"
 #include "export.h"
 #include "partitioning.h"
+#include "scan_iterator.h"
 
 #include "utils.h"
 #include "time_bucket.h"
@@ -42,18 +59,40 @@
  * materialization job *
  ***********************/
 
+/* What a materialization did, recorded in the materialization statistics. The durations are in
+ * microseconds. */
+typedef struct MaterializationStats
+{
+	int32 invalidated_ranges;
+	int64 invalidated_buckets;
+	uint64 rows_deleted;
+	uint64 rows_inserted;
+	int64 delete_duration;
+	int64 insert_duration;
+} MaterializationStats;
+
 static Form_continuous_agg get_continuous_agg(int32 mat_hypertable_id);
 static int64 get_materialization_end_point_for_table(int32 raw_hypertable_id,
 													 int32 materialization_id, int64 refresh_lag,
 													 int64 bucket_width, int64 max_interval_per_job,
 													 bool *materializing_new_range,
-													 bool *truncated_materialization, bool verbose);
+													 bool *truncated_materialization,
+													 int64 *new_range_start, bool verbose);
 static int64 invalidation_threshold_get(int32 materialization_id);
-static void drain_invalidation_log(int32 raw_hypertable_id, List **invalidations_out);
+static void invalidation_log_fan_out(int32 raw_hypertable_id);
+static void drain_invalidation_log(int32 materialization_id, List **invalidations_out);
 static void invalidation_threshold_set(int32 raw_hypertable_id, int64 invalidation_threshold);
-static int64 continuous_aggs_completed_threshold_get(int32 materialization_id);
+static void materialize_range(int64 bucket_width, int32 hypertable_id, int32 materialization_id,
+							  SchemaAndName partial_view, List *invalidations,
+							  int64 materialization_end, MaterializationStats *stats);
 static Datum internal_to_time_value_or_infinite(int64 internal, Oid time_type,
 												bool *is_infinite_out);
+static void materialize_new_range_in_parallel(FormData_continuous_agg *cagg,
+											  int64 materialization_end,
+											  MaterializationStats *stats);
+static void materialization_stats_record(FormData_continuous_agg *cagg, TimestampTz start_time,
+										 int64 old_completed_threshold, int64 new_range_start,
+										 MaterializationStats *stats);
 
 /* must be called without a transaction started */
 bool
@@ -72,11 +111,15 @@ continuous_agg_materialize(int32 materialization_id, bool verbose)
 	LockRelId partial_view_lock_relid;
 	Form_continuous_agg cagg;
 	FormData_continuous_agg cagg_data;
-	int64 new_invalidation_threshold;
+	int64 materialization_end;
 	bool materializing_new_range = false;
 	bool truncated_materialization = false;
 	List *invalidations = NIL;
 	SchemaAndName partial_view;
+	TimestampTz start_time = GetCurrentTimestamp();
+	int64 old_completed_threshold;
+	int64 new_range_start = PG_INT64_MAX;
+	MaterializationStats stats = { 0 };
 
 	/*
 	 * Transaction 1: discover the new range in the raw table we will materialize
@@ -99,10 +142,12 @@ continuous_agg_materialize(int32 materialization_id, bool verbose)
 	 * materialization to ensure they're not alter in a way which would invalidate our work.
 	 * We need to lock:
 	 *     The raw table, to prevent it from being ALTERed too much
-	 *     The materialization table, to prevent concurrent materializations
-	 *     The partial_view, to prevent it from being renamed (we pass the names across
-	 * transactions) and to prevent the view definition from being altered We still wish to allow
-	 * SELECTs on all of these Continuous aggregate state should be locked in the order
+	 *     The materialization table, to prevent it from being ALTERed or dropped, while still
+	 * allowing the parallel materialization workers to write into it
+	 *     The partial_view, to prevent concurrent materializations, to prevent it from being
+	 * renamed (we pass the names across transactions) and to prevent the view definition from
+	 * being altered We still wish to allow SELECTs on all of these Continuous aggregate state
+	 * should be locked in the order
 	 *    raw hypertable / user view
 	 *    materialization table
 	 *    partial view
@@ -124,9 +169,9 @@ continuous_agg_materialize(int32 materialization_id, bool verbose)
 	materialization_table_oid = materialization_table->main_table_relid;
 
 	materialization_table_relation =
-		relation_open(materialization_table_oid, ShareRowExclusiveLock);
+		relation_open(materialization_table_oid, RowExclusiveLock);
 	materialization_lock_relid = materialization_table_relation->rd_lockInfo.lockRelId;
-	LockRelationIdForSession(&materialization_lock_relid, ShareRowExclusiveLock);
+	LockRelationIdForSession(&materialization_lock_relid, RowExclusiveLock);
 	relation_close(materialization_table_relation, NoLock);
 
 	partial_view_oid =
@@ -134,11 +179,13 @@ continuous_agg_materialize(int32 materialization_id, bool verbose)
 						  get_namespace_oid(NameStr(cagg_data.partial_view_schema), false));
 	Assert(OidIsValid(partial_view_oid));
 	partial_view_relation = relation_open(partial_view_oid, ShareRowExclusiveLock);
-	partial_view_lock_relid = materialization_table_relation->rd_lockInfo.lockRelId;
+	partial_view_lock_relid = partial_view_relation->rd_lockInfo.lockRelId;
 	LockRelationIdForSession(&partial_view_lock_relid, ShareRowExclusiveLock);
 	relation_close(partial_view_relation, NoLock);
 
-	new_invalidation_threshold =
+	old_completed_threshold = continuous_aggs_completed_threshold_get(materialization_id);
+
+	materialization_end =
 		get_materialization_end_point_for_table(cagg_data.raw_hypertable_id,
 												materialization_id,
 												cagg_data.refresh_lag,
@@ -146,6 +193,7 @@ continuous_agg_materialize(int32 materialization_id, bool verbose)
 												cagg_data.max_interval_per_job,
 												&materializing_new_range,
 												&truncated_materialization,
+												&new_range_start,
 												verbose);
 
 	if (verbose)
@@ -155,7 +203,7 @@ continuous_agg_materialize(int32 materialization_id, bool verbose)
 				 "materializing continuous aggregate %s.%s: new range up to " INT64_FORMAT,
 				 NameStr(cagg_data.user_view_schema),
 				 NameStr(cagg_data.user_view_name),
-				 new_invalidation_threshold);
+				 materialization_end);
 		else
 			elog(INFO,
 				 "materializing continuous aggregate %s.%s: no new range to materialize",
@@ -163,23 +211,43 @@ continuous_agg_materialize(int32 materialization_id, bool verbose)
 				 NameStr(cagg_data.user_view_name));
 	}
 
+	/* Other continuous aggregates on the hypertable may already have moved the invalidation
+	 * threshold past our end point, in which case it is left as is */
 	if (materializing_new_range)
-		invalidation_threshold_set(cagg_data.raw_hypertable_id, new_invalidation_threshold);
+		invalidation_threshold_set(cagg_data.raw_hypertable_id, materialization_end);
 
 	PopActiveSnapshot();
 	CommitTransactionCommand();
 
+	/* the committers which read the old threshold from the cache must not have invalidations
+	 * left to log in the new range */
+	if (materializing_new_range)
+		ts_invalidation_threshold_cache_wait_for_readers();
+
+	/*
+	 * Optionally, materialize the new range with background workers, each slice in a transaction
+	 * of its own, and move the completed threshold past what they materialized. Whatever is left
+	 * is materialized in transaction 2.
+	 */
+	if (materializing_new_range && ts_guc_max_parallel_materialization_workers > 0)
+		materialize_new_range_in_parallel(&cagg_data, materialization_end, &stats);
+
 	/*
-	 * Transaction 2: get the values from the invalidation table,
+	 * Transaction 2: move the invalidations of the hypertable into the logs of all its
+	 *                continuous aggregates, get the values from our own log,
 	 *                run the materialization, and update completed_threshold
-	 * (eventually this will only read per-cagg log, and a different worker will
-	 *  move from the hypertable log to the per-cagg log)
 	 */
 	StartTransactionCommand();
-	/* we need a snapshot for the SPI commands within continuous_agg_execute_materialization */
+	/* we need a snapshot for the SPI commands within materialize_range */
 	PushActiveSnapshot(GetTransactionSnapshot());
 
-	drain_invalidation_log(cagg_data.raw_hypertable_id, &invalidations);
+	invalidation_log_fan_out(cagg_data.raw_hypertable_id);
+	drain_invalidation_log(materialization_id, &invalidations);
+
+	/* invalidations fanned out by the other continuous aggregates on the hypertable are
+	 * irrelevant until something was materialized */
+	if (materialization_end == PG_INT64_MIN)
+		invalidations = NIL;
 
 	/* if there's nothing to materialize, don't bother with the rest */
 	if (!materializing_new_range && list_length(invalidations) == 0)
@@ -198,15 +266,25 @@ continuous_agg_materialize(int32 materialization_id, bool verbose)
 		.name = &cagg_data.partial_view_name,
 	};
 
-	continuous_agg_execute_materialization(cagg_data.bucket_width,
-										   cagg_data.raw_hypertable_id,
-										   cagg_data.mat_hypertable_id,
-										   partial_view,
-										   invalidations);
+	materialize_range(cagg_data.bucket_width,
+					  cagg_data.raw_hypertable_id,
+					  cagg_data.mat_hypertable_id,
+					  partial_view,
+					  invalidations,
+					  materialization_end,
+					  &stats);
+
+	/* runs which exit early materialize nothing, so they are not recorded */
+	if (ts_guc_materialization_stats_history > 0)
+		materialization_stats_record(&cagg_data,
+									 start_time,
+									 old_completed_threshold,
+									 new_range_start,
+									 &stats);
 
 finish:
 	UnlockRelationIdForSession(&partial_view_lock_relid, ShareRowExclusiveLock);
-	UnlockRelationIdForSession(&materialization_lock_relid, ShareRowExclusiveLock);
+	UnlockRelationIdForSession(&materialization_lock_relid, RowExclusiveLock);
 	UnlockRelationIdForSession(&raw_lock_relid, AccessShareLock);
 	PopActiveSnapshot();
 	CommitTransactionCommand();
@@ -249,15 +327,15 @@ get_continuous_agg(int32 mat_hypertable_id)
 	return cagg;
 }
 
-static bool hypertable_get_min_and_max(SchemaAndName hypertable, Name time_column,
-									   int64 search_start, Oid time_type, int64 *min_out,
+static bool hypertable_get_min_and_max(Hypertable *ht, int64 search_start, int64 *min_out,
 									   int64 *max_out);
 
 static int64
 get_materialization_end_point_for_table(int32 raw_hypertable_id, int32 materialization_id,
 										int64 refresh_lag, int64 bucket_width,
 										int64 max_interval_per_job, bool *materializing_new_range,
-										bool *truncated_materialization, bool verbose)
+										bool *truncated_materialization, int64 *new_range_start,
+										bool verbose)
 {
 	int64 start_time = PG_INT64_MIN;
 	int64 end_time = PG_INT64_MIN;
@@ -272,12 +350,8 @@ get_materialization_end_point_for_table(int32 raw_hypertable_id, int32 materiali
 	Oid time_column_type = time_column->fd.column_type;
 	bool found_new_tuples = false;
 
-	found_new_tuples = hypertable_get_min_and_max(hypertable,
-												  &time_column_name,
-												  old_completed_threshold,
-												  time_column_type,
-												  &start_time,
-												  &end_time);
+	found_new_tuples =
+		hypertable_get_min_and_max(raw_table, old_completed_threshold, &start_time, &end_time);
 
 	if (!found_new_tuples)
 	{
@@ -366,20 +440,129 @@ get_materialization_end_point_for_table(int32 raw_hypertable_id, int32 materiali
 	Assert(end_time > old_completed_threshold);
 	Assert(end_time >= start_time);
 
+	*new_range_start = ts_time_bucket_by_type(bucket_width, start_time, time_column_type);
 	*materializing_new_range = true;
 	return end_time;
 }
 
+/*
+ * Cheap check for chunks without any rows, so that we do not have to probe them. A chunk can
+ * still be non-empty if it only contains dead rows.
+ */
+static bool
+chunk_is_empty(Chunk *chunk)
+{
+	Relation rel = try_relation_open(chunk->table_id, AccessShareLock);
+	bool empty;
+
+	/* dropped concurrently */
+	if (rel == NULL)
+		return true;
+
+	empty = RelationGetNumberOfBlocks(rel) == 0;
+	relation_close(rel, NoLock);
+	return empty;
+}
+
+/*
+ * Get the first or last value of the time column in a chunk, only considering values at or after
+ * search_start unless it is NULL. With the default index on the time column this is a single
+ * index probe.
+ */
 static bool
-hypertable_get_min_and_max(SchemaAndName hypertable, Name time_column, int64 search_start,
-						   Oid time_type, int64 *min_out, int64 *max_out)
+chunk_get_time_value(Chunk *chunk, Name time_column, Oid time_type, const char *search_start,
+					 bool last, int64 *value_out)
 {
-	Datum last_time_value;
-	Datum first_time_value;
+	StringInfo command = makeStringInfo();
+	Datum value;
 	bool val_is_null;
+	int res;
+
+	appendStringInfo(command,
+					 "SELECT %s(%s) FROM ONLY %s.%s",
+					 last ? "max" : "min",
+					 quote_identifier(NameStr(*time_column)),
+					 quote_identifier(NameStr(chunk->fd.schema_name)),
+					 quote_identifier(NameStr(chunk->fd.table_name)));
+	if (search_start != NULL)
+		appendStringInfo(command,
+						 " WHERE %s >= %s",
+						 quote_identifier(NameStr(*time_column)),
+						 quote_literal_cstr(search_start));
+
+	res = SPI_execute_with_args(command->data,
+								0 /*=nargs*/,
+								NULL,
+								NULL,
+								NULL /*=Nulls*/,
+								true /*=read_only*/,
+								0 /*count*/);
+	if (res < 0)
+		elog(ERROR, "could not find new invalidation threshold");
+
+	Assert(SPI_gettypeid(SPI_tuptable->tupdesc, 1) == time_type);
+
+	value = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &val_is_null);
+	if (val_is_null)
+		return false;
+
+	*value_out = ts_time_value_to_internal(value, time_type);
+	return true;
+}
+
+/* Get the first or last value of the time column in the chunks of a time slice */
+static bool
+slice_get_time_value(DimensionSlice *slice, Name time_column, Oid time_type, int64 search_start,
+					 const char *search_start_str, bool last, int64 *value_out)
+{
+	List *chunk_ids = NIL;
+	ListCell *lc;
+	bool found = false;
+
+	/* only chunks containing search_start need to be filtered */
+	if (slice->fd.range_start >= search_start)
+		search_start_str = NULL;
+
+	/* with space partitioning, there is a chunk per space partition */
+	ts_chunk_constraint_scan_by_dimension_slice_to_list(slice, &chunk_ids, CurrentMemoryContext);
+
+	foreach (lc, chunk_ids)
+	{
+		Chunk *chunk = ts_chunk_get_by_id(lfirst_int(lc), 0, false);
+		int64 value;
+
+		if (chunk == NULL || chunk_is_empty(chunk))
+			continue;
+
+		if (!chunk_get_time_value(chunk, time_column, time_type, search_start_str, last, &value))
+			continue;
+
+		if (!found || (last ? value > *value_out : value < *value_out))
+			*value_out = value;
+		found = true;
+	}
+
+	return found;
+}
+
+/*
+ * Find the first and last value of the time column at or after search_start. Instead of querying
+ * the whole hypertable, we get the time slices ending after search_start from the catalog, and
+ * only probe the chunks of the newest and oldest of them containing such values. If no chunk
+ * ends after search_start, there can be no new values, and the data is not touched at all.
+ */
+static bool
+hypertable_get_min_and_max(Hypertable *ht, int64 search_start, int64 *min_out, int64 *max_out)
+{
+	Dimension *time_dimension = hyperspace_get_open_dimension(ht->space, 0);
+	Name time_column = &time_dimension->fd.column_name;
+	Oid time_type = time_dimension->fd.column_type;
 	bool search_start_is_infinite = false;
+	char *search_start_str = NULL;
 	bool found_new_tuples = false;
-	StringInfo command = makeStringInfo();
+	DimensionVec *slices;
+	int last_slice;
+	int i;
 	int res;
 
 	Datum search_start_val =
@@ -391,75 +574,62 @@ hypertable_get_min_and_max(SchemaAndName hypertable, Name time_column, int64 sea
 		return false;
 	}
 
-	res = SPI_connect();
-	if (res != SPI_OK_CONNECT)
-		elog(ERROR, "could not connect to SPI while search for new tuples");
+	/* range_end is exclusive, so this gets the slices with range_end > search_start, sorted by
+	 * range_start */
+	slices =
+		ts_dimension_slice_scan_range_limit(time_dimension->fd.id,
+											InvalidStrategy,
+											0,
+											search_start_is_infinite ? InvalidStrategy :
+																	   BTGreaterEqualStrategyNumber,
+											search_start,
+											0);
+
+	if (slices->num_slices == 0)
+		return false;
 
-	/* We always SELECT both max and min in the following queries. There are two cases
-	 * 1. there is no index on time: then we want to perform only one seqscan.
-	 * 2. there is a btree index on time: then postgres will transform the query
-	 *    into two index-only scans, which should add very little extra work
-	 *    compared to the materialization.
-	 * Ordered append append also fires, so we never scan beyond the first and last chunks
-	 */
-	if (search_start_is_infinite)
-	{
-		/* previous completed time is -infinity, or does not exist, so we must scan from the
-		 * beginning */
-		appendStringInfo(command,
-						 "SELECT max(%s), min(%s) FROM %s.%s",
-						 quote_identifier(NameStr(*time_column)),
-						 quote_identifier(NameStr(*time_column)),
-						 quote_identifier(NameStr(*hypertable.schema)),
-						 quote_identifier(NameStr(*hypertable.name)));
-	}
-	else
+	if (!search_start_is_infinite)
 	{
 		Oid out_fn;
 		bool type_is_varlena;
-		char *search_start_str;
 
 		getTypeOutputInfo(time_type, &out_fn, &type_is_varlena);
-
 		search_start_str = OidOutputFunctionCall(out_fn, search_start_val);
-
-		*min_out = search_start;
-		/* normal case, add a WHERE to take advantage of chunk constraints */
-		/*We handled the +infinity case above*/
-		Assert(!search_start_is_infinite);
-		appendStringInfo(command,
-						 "SELECT max(%s), min(%s) FROM %s.%s WHERE %s >= %s",
-						 quote_identifier(NameStr(*time_column)),
-						 quote_identifier(NameStr(*time_column)),
-						 quote_identifier(NameStr(*hypertable.schema)),
-						 quote_identifier(NameStr(*hypertable.name)),
-						 quote_identifier(NameStr(*time_column)),
-						 quote_literal_cstr(search_start_str));
 	}
 
-	res = SPI_execute_with_args(command->data,
-								0 /*=nargs*/,
-								NULL,
-								NULL,
-								NULL /*=Nulls*/,
-								true /*=read_only*/,
-								0 /*count*/);
-	if (res < 0)
-		elog(ERROR, "could not find new invalidation threshold");
-
-	Assert(SPI_gettypeid(SPI_tuptable->tupdesc, 1) == time_type);
-	Assert(SPI_gettypeid(SPI_tuptable->tupdesc, 2) == time_type);
+	res = SPI_connect();
+	if (res != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI while search for new tuples");
 
-	first_time_value = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 2, &val_is_null);
-	last_time_value = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &val_is_null);
+	/* the last value is in the newest slice with a chunk containing new values ... */
+	for (last_slice = slices->num_slices - 1; last_slice >= 0; last_slice--)
+	{
+		found_new_tuples = slice_get_time_value(slices->slices[last_slice],
+												time_column,
+												time_type,
+												search_start,
+												search_start_str,
+												true,
+												max_out);
+		if (found_new_tuples)
+			break;
+	}
 
-	if (!val_is_null)
+	/* ... and the first value in the oldest one, which cannot be newer */
+	for (i = 0; found_new_tuples && i <= last_slice; i++)
 	{
-		*min_out = ts_time_value_to_internal(first_time_value, time_type);
-		*max_out = ts_time_value_to_internal(last_time_value, time_type);
-		found_new_tuples = true;
+		if (slice_get_time_value(slices->slices[i],
+								 time_column,
+								 time_type,
+								 search_start,
+								 search_start_str,
+								 false,
+								 min_out))
+			break;
 	}
 
+	Assert(!found_new_tuples || i <= last_slice);
+
 	res = SPI_finish();
 	Assert(res == SPI_OK_FINISH);
 	return found_new_tuples;
@@ -471,18 +641,15 @@ typedef struct InvalidationScanState
 	MemoryContext mctx;
 } InvalidationScanState;
 
-static ScanTupleResult
-scan_take_invalidation_tuple(TupleInfo *ti, void *data)
+static void
+take_invalidation(TupleInfo *ti, InvalidationScanState *scan_state, int64 lowest_modified_value,
+				  int64 greatest_modified_value)
 {
-	InvalidationScanState *scan_state = (InvalidationScanState *) data;
-
 	MemoryContext old_ctx = MemoryContextSwitchTo(scan_state->mctx);
-	Form_continuous_aggs_hypertable_invalidation_log invalidation_form =
-		((Form_continuous_aggs_hypertable_invalidation_log) GETSTRUCT(ti->tuple));
 	Invalidation *invalidation = palloc(sizeof(*invalidation));
 
-	invalidation->lowest_modified_value = invalidation_form->lowest_modified_value;
-	invalidation->greatest_modified_value = invalidation_form->greatest_modified_value;
+	invalidation->lowest_modified_value = lowest_modified_value;
+	invalidation->greatest_modified_value = greatest_modified_value;
 
 	Assert(invalidation->lowest_modified_value <= invalidation->greatest_modified_value);
 
@@ -491,18 +658,58 @@ scan_take_invalidation_tuple(TupleInfo *ti, void *data)
 	MemoryContextSwitchTo(old_ctx);
 
 	ts_catalog_delete(ti->scanrel, ti->tuple);
+}
+
+static ScanTupleResult
+scan_take_hypertable_invalidation_tuple(TupleInfo *ti, void *data)
+{
+	Form_continuous_aggs_hypertable_invalidation_log invalidation_form =
+		((Form_continuous_aggs_hypertable_invalidation_log) GETSTRUCT(ti->tuple));
+
+	take_invalidation(ti,
+					  (InvalidationScanState *) data,
+					  invalidation_form->lowest_modified_value,
+					  invalidation_form->greatest_modified_value);
+
+	return SCAN_CONTINUE;
+}
+
+static ScanTupleResult
+scan_take_materialization_invalidation_tuple(TupleInfo *ti, void *data)
+{
+	Form_continuous_aggs_materialization_invalidation_log invalidation_form =
+		((Form_continuous_aggs_materialization_invalidation_log) GETSTRUCT(ti->tuple));
+
+	take_invalidation(ti,
+					  (InvalidationScanState *) data,
+					  invalidation_form->lowest_modified_value,
+					  invalidation_form->greatest_modified_value);
 
 	return SCAN_CONTINUE;
 }
 
+/*
+ * Move the invalidations in the hypertable's invalidation log, which is shared by all the
+ * continuous aggregates on the hypertable, to the invalidation logs of each of them. Every
+ * continuous aggregate re-materializes the invalidated ranges independently, based on its own
+ * completed threshold. Overlapping and adjacent invalidations are coalesced on the way, so that
+ * repeated modifications of the same range are only logged once per continuous aggregate.
+ */
 static void
-drain_invalidation_log(int32 raw_hypertable_id, List **invalidations_out)
+invalidation_log_fan_out(int32 raw_hypertable_id)
 {
+	List *invalidations = NIL;
 	InvalidationScanState scan_state = {
-		.invalidations = invalidations_out,
+		.invalidations = &invalidations,
 		.mctx = CurrentMemoryContext,
 	};
 	ScanKeyData scankey[1];
+	CatalogSecurityContext sec_ctx;
+	Relation rel;
+	TupleDesc desc;
+	InvalidationSet invalidation_set;
+	List *caggs;
+	ListCell *lc_cagg;
 
 	ScanKeyInit(&scankey[0],
 				Anum_continuous_aggs_hypertable_invalidation_log_idx_hypertable_id,
@@ -510,12 +717,80 @@ drain_invalidation_log(int32 raw_hypertable_id, List **invalidations_out)
 				F_INT4EQ,
 				Int32GetDatum(raw_hypertable_id));
 
+	/* ShareUpdateExclusiveLock serializes concurrent fan-outs of the same log, which would
+	 * otherwise try to delete the same tuples, while not blocking the RowExclusiveLock of the
+	 * mutating transactions that add to the log */
 	ts_catalog_scan_all(CONTINUOUS_AGGS_HYPERTABLE_INVALIDATION_LOG /*=table*/,
-						CONTINUOUS_AGGS_HYPERTABLE_INVALIDATION_LOG_IDX /*=indexid*/
-						,
+						CONTINUOUS_AGGS_HYPERTABLE_INVALIDATION_LOG_IDX /*=indexid*/,
 						scankey /*=scankey*/,
 						1 /*=num_keys*/,
-						scan_take_invalidation_tuple /*=tuple_found*/,
+						scan_take_hypertable_invalidation_tuple /*=tuple_found*/,
+						ShareUpdateExclusiveLock /*=lockmode*/,
+						&scan_state /*=data*/);
+
+	if (invalidations == NIL)
+		return;
+
+	invalidation_set_init(&invalidation_set, 1, 0);
+	invalidation_set_add_list(&invalidation_set, invalidations);
+
+	caggs = ts_continuous_aggs_find_by_raw_table_id(raw_hypertable_id);
+
+	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
+	rel = heap_open(catalog_get_table_id(ts_catalog_get(),
+										 CONTINUOUS_AGGS_MATERIALIZATION_INVALIDATION_LOG),
+					RowExclusiveLock);
+	desc = RelationGetDescr(rel);
+
+	foreach (lc_cagg, caggs)
+	{
+		ContinuousAgg *cagg = lfirst(lc_cagg);
+		int i;
+
+		for (i = 0; i < invalidation_set.num_ranges; i++)
+		{
+			Invalidation *invalidation = &invalidation_set.ranges[i];
+			Datum values[Natts_continuous_aggs_materialization_invalidation_log];
+			bool nulls[Natts_continuous_aggs_materialization_invalidation_log] = { false };
+
+			values[AttrNumberGetAttrOffset(
+				Anum_continuous_aggs_materialization_invalidation_log_materialization_id)] =
+				Int32GetDatum(cagg->data.mat_hypertable_id);
+			values[AttrNumberGetAttrOffset(
+				Anum_continuous_aggs_materialization_invalidation_log_lowest_modified_value)] =
+				Int64GetDatum(invalidation->lowest_modified_value);
+			values[AttrNumberGetAttrOffset(
+				Anum_continuous_aggs_materialization_invalidation_log_greatest_modified_value)] =
+				Int64GetDatum(invalidation->greatest_modified_value);
+
+			ts_catalog_insert_values(rel, desc, values, nulls);
+		}
+	}
+
+	relation_close(rel, NoLock);
+	ts_catalog_restore_user(&sec_ctx);
+}
+
+static void
+drain_invalidation_log(int32 materialization_id, List **invalidations_out)
+{
+	InvalidationScanState scan_state = {
+		.invalidations = invalidations_out,
+		.mctx = CurrentMemoryContext,
+	};
+	ScanKeyData scankey[1];
+
+	ScanKeyInit(&scankey[0],
+				Anum_continuous_aggs_materialization_invalidation_log_idx_materialization_id,
+				BTEqualStrategyNumber,
+				F_INT4EQ,
+				Int32GetDatum(materialization_id));
+
+	ts_catalog_scan_all(CONTINUOUS_AGGS_MATERIALIZATION_INVALIDATION_LOG /*=table*/,
+						CONTINUOUS_AGGS_MATERIALIZATION_INVALIDATION_LOG_IDX /*=indexid*/,
+						scankey /*=scankey*/,
+						1 /*=num_keys*/,
+						scan_take_materialization_invalidation_tuple /*=tuple_found*/,
 						RowExclusiveLock /*=lockmode*/,
 						&scan_state /*=data*/);
 }
@@ -524,6 +799,10 @@ drain_invalidation_log(int32 raw_hypertable_id, List **invalidations_out)
  * materialization support *
  ***************************/
 
+/* The maximum number of separate ranges materialized at once, beyond which the closest
+ * invalidated ranges are merged to bound the number of statements we run */
+#define MATERIALIZATION_MAX_RANGES 64
+
 typedef struct InternalTimeRange
 {
 	Oid type;
@@ -543,26 +822,26 @@ static int64 completed_threshold_get(int32 materialization_id);
 static void update_materializations(SchemaAndName partial_view, SchemaAndName materialization_table,
 									Name time_column_name,
 									InternalTimeRange new_materialization_range, int64 bucket_width,
-									List *invalidations);
+									List *invalidations, MaterializationStats *stats);
 static void spi_update_materializations(SchemaAndName partial_view,
 										SchemaAndName materialization_table, Name time_column_name,
-										TimeRange invalidation_range);
+										TimeRange invalidation_range, MaterializationStats *stats);
+static void spi_merge_materializations(SchemaAndName partial_view,
+									   SchemaAndName materialization_table, Name time_column_name,
+									   TimeRange invalidation_range, MaterializationStats *stats);
 static void spi_delete_materializations(SchemaAndName materialization_table, Name time_column_name,
-										TimeRange invalidation_range);
+										TimeRange invalidation_range, MaterializationStats *stats);
 static void spi_insert_materializations(SchemaAndName partial_view,
 										SchemaAndName materialization_table, Name time_column_name,
-										TimeRange materialization_range);
+										TimeRange materialization_range,
+										MaterializationStats *stats);
 static void continuous_aggs_completed_threshold_set(int32 materialization_id,
 													int64 old_completed_threshold);
-static bool get_invalidation_range(List *invalidations, InternalTimeRange *invalidation_range);
 static void time_bucket_range(InternalTimeRange *range, int64 bucket_width);
-static bool ranges_overlap(InternalTimeRange invalidation_range,
-						   InternalTimeRange new_materialization_range);
 static TimeRange internal_time_range_to_time_range(InternalTimeRange internal);
 
 /* execute the materialization for the continuous aggregate materialization_id
- * we will re-materialize all values within
- *     [lowest_invalidated_value, greatest_invalidated_value]
+ * we will re-materialize all the buckets containing an invalidated value
  * and materialize for the first time all rows within
  *     [completed threshold, invalidation threshold]
  * thus the materialization worker should update the invalidation threshold before
@@ -582,12 +861,31 @@ void
 continuous_agg_execute_materialization(int64 bucket_width, int32 hypertable_id,
 									   int32 materialization_id, SchemaAndName partial_view,
 									   List *invalidations)
+{
+	MaterializationStats stats = { 0 };
+
+	materialize_range(bucket_width,
+					  hypertable_id,
+					  materialization_id,
+					  partial_view,
+					  invalidations,
+					  invalidation_threshold_get(hypertable_id),
+					  &stats);
+}
+
+/* materialize the new range [completed threshold, materialization_end) and re-materialize the
+ * invalidated ranges below materialization_end. Each continuous aggregate on a hypertable has its
+ * own end point, which is at most the hypertable's invalidation threshold. */
+static void
+materialize_range(int64 bucket_width, int32 hypertable_id, int32 materialization_id,
+				  SchemaAndName partial_view, List *invalidations, int64 materialization_end,
+				  MaterializationStats *stats)
 {
 	CatalogSecurityContext sec_ctx;
 	SchemaAndName materialization_table_name;
 	InternalTimeRange new_materialization_range = {
 		.start = completed_threshold_get(materialization_id),
-		.end = invalidation_threshold_get(hypertable_id),
+		.end = materialization_end,
 	};
 	Cache *hcache = ts_hypertable_cache_pin();
 	Hypertable *raw_table = ts_hypertable_cache_get_entry_by_id(hcache, hypertable_id);
@@ -645,7 +943,8 @@ continuous_agg_execute_materialization(int64 bucket_width, int32 hypertable_id,
 							&time_column_name,
 							new_materialization_range,
 							bucket_width,
-							invalidations);
+							invalidations,
+							stats);
 
 	/* update the completed watermark */
 	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
@@ -664,8 +963,12 @@ scan_update_invalidation_threshold(TupleInfo *ti, void *data)
 	HeapTuple new_tuple = heap_copytuple(ti->tuple);
 	Form_continuous_aggs_invalidation_threshold form =
 		(Form_continuous_aggs_invalidation_threshold) GETSTRUCT(new_tuple);
-	if (form->watermark > new_threshold)
-		elog(ERROR, "Internal Error: new invalidation threshold must not be less than the old one");
+
+	/* the threshold is shared by all the continuous aggregates on the hypertable, and never
+	 * moves backwards */
+	if (form->watermark >= new_threshold)
+		return SCAN_DONE;
+
 	form->watermark = new_threshold;
 	ts_catalog_update(ti->scanrel, new_tuple);
 	return SCAN_DONE;
@@ -690,7 +993,8 @@ invalidation_threshold_set(int32 raw_hypertable_id, int64 invalidation_threshold
 	 * the value; if we used a RowExclusiveLock we could race such a transaction and update the
 	 * threshold between the time it is read but before the other transaction commits. This would
 	 * cause us to lose the updates. The AccessExclusiveLock ensures no one else can possibly be
-	 * reading the threshold.
+	 * reading the threshold from the catalog. The transactions reading it from the cache in shared
+	 * memory take no lock, and are waited for once the new threshold is committed.
 	 */
 	updated_threshold =
 		ts_catalog_scan_one(CONTINUOUS_AGGS_INVALIDATION_THRESHOLD /*=table*/,
@@ -723,6 +1027,10 @@ invalidation_threshold_set(int32 raw_hypertable_id, int64 invalidation_threshold
 		ts_catalog_insert_values(rel, desc, values, nulls);
 		relation_close(rel, NoLock);
 	}
+
+	/* the cached threshold is reset once we commit, and the committers which read it from the
+	 * cache before are waited for before materializing */
+	ts_invalidation_threshold_cache_reset(raw_hypertable_id);
 }
 
 static ScanTupleResult
@@ -733,10 +1041,9 @@ invalidation_threshold_tuple_found(TupleInfo *ti, void *data)
 	return SCAN_CONTINUE;
 }
 
-static int64
-invalidation_threshold_get(int32 hypertable_id)
+static bool
+invalidation_threshold_lookup(int32 hypertable_id, int64 *threshold)
 {
-	int64 threshold = 0;
 	ScanKeyData scankey[1];
 
 	ScanKeyInit(&scankey[0],
@@ -745,14 +1052,22 @@ invalidation_threshold_get(int32 hypertable_id)
 				F_INT4EQ,
 				Int32GetDatum(hypertable_id));
 
-	if (!ts_catalog_scan_one(CONTINUOUS_AGGS_INVALIDATION_THRESHOLD /*=table*/,
-							 CONTINUOUS_AGGS_INVALIDATION_THRESHOLD_PKEY /*=indexid*/,
-							 scankey /*=scankey*/,
-							 1 /*=num_keys*/,
-							 invalidation_threshold_tuple_found /*=tuple_found*/,
-							 AccessShareLock /*=lockmode*/,
-							 CONTINUOUS_AGGS_INVALIDATION_THRESHOLD_TABLE_NAME /*=table_name*/,
-							 &threshold /*=data*/))
+	return ts_catalog_scan_one(CONTINUOUS_AGGS_INVALIDATION_THRESHOLD /*=table*/,
+							   CONTINUOUS_AGGS_INVALIDATION_THRESHOLD_PKEY /*=indexid*/,
+							   scankey /*=scankey*/,
+							   1 /*=num_keys*/,
+							   invalidation_threshold_tuple_found /*=tuple_found*/,
+							   AccessShareLock /*=lockmode*/,
+							   CONTINUOUS_AGGS_INVALIDATION_THRESHOLD_TABLE_NAME /*=table_name*/,
+							   threshold /*=data*/);
+}
+
+static int64
+invalidation_threshold_get(int32 hypertable_id)
+{
+	int64 threshold = 0;
+
+	if (!invalidation_threshold_lookup(hypertable_id, &threshold))
 		elog(ERROR, "could not find invalidation threshold for hypertable %d", hypertable_id);
 
 	return threshold;
@@ -794,15 +1109,11 @@ completed_threshold_get(int32 materialization_id)
 void
 update_materializations(SchemaAndName partial_view, SchemaAndName materialization_table,
 						Name time_column_name, InternalTimeRange new_materialization_range,
-						int64 bucket_width, List *invalidations)
+						int64 bucket_width, List *invalidations, MaterializationStats *stats)
 {
-	InternalTimeRange invalidation_range = {
-		.type = new_materialization_range.type,
-	};
-	InternalTimeRange combined_materialization_range = new_materialization_range;
-
-	bool needs_invalidation = get_invalidation_range(invalidations, &invalidation_range);
-	bool materialize_invalidations_separately = needs_invalidation;
+	InvalidationSet materialization_ranges;
+	ListCell *lc;
+	int i;
 	int res = SPI_connect();
 	if (res != SPI_OK_CONNECT)
 		elog(ERROR, "could not connect to SPI in materializer");
@@ -813,52 +1124,73 @@ update_materializations(SchemaAndName partial_view, SchemaAndName materializatio
 	if (new_materialization_range.start > new_materialization_range.end)
 		new_materialization_range.start = new_materialization_range.end;
 
-	if (needs_invalidation)
+	/* Collect the ranges to materialize. Each invalidation is aligned to the bucket width, and
+	 * the invalidations of the same or adjacent buckets are coalesced with each other and with
+	 * the new materialization range, so that we only re-materialize the invalidated buckets, and
+	 * never materialize the same bucket twice.
+	 */
+	invalidation_set_init(&materialization_ranges, 1, MATERIALIZATION_MAX_RANGES);
+
+	foreach (lc, invalidations)
 	{
+		Invalidation *invalidation = lfirst(lc);
+		InternalTimeRange invalidation_range = {
+			.type = new_materialization_range.type,
+			.start = invalidation->lowest_modified_value,
+			.end = invalidation->greatest_modified_value,
+		};
+
 		Assert(invalidation_range.start <= invalidation_range.end);
-		/* Align all invalidations to the bucket width */
 		time_bucket_range(&invalidation_range, bucket_width);
 
 		/* we never materialize beyond the new materialization range */
-		invalidation_range.start =
-			int64_min(invalidation_range.start, new_materialization_range.start);
 		invalidation_range.end = int64_min(invalidation_range.end, new_materialization_range.end);
 
-		/* If the invalidation and new materialization ranges overlap, materialize in one go */
-		materialize_invalidations_separately =
-			!ranges_overlap(invalidation_range, new_materialization_range);
-
-		combined_materialization_range.start =
-			int64_min(invalidation_range.start, new_materialization_range.start);
+		if (invalidation_range.start < invalidation_range.end)
+			invalidation_set_add(&materialization_ranges,
+								 invalidation_range.start,
+								 invalidation_range.end - 1);
 	}
 
-	/* Then insert the materializations.
-	 * We insert them in two groups:
-	 * [lowest_invalidated, greatest_invalidated] and
-	 * [start_of_new_materialization, end_of_new_materialization]
-	 * eventually, we may want more precise deletions and insertions for the invalidated ranges.
-	 * if greatest_invalidated == end_of_new_materialization then we only perform 1 insertion.
-	 * to prevent values from being inserted multiple times.
-	 */
-	if (!needs_invalidation || !materialize_invalidations_separately)
-	{
-		spi_update_materializations(partial_view,
-									materialization_table,
-									time_column_name,
-									internal_time_range_to_time_range(
-										combined_materialization_range));
-	}
-	else
-	{
-		spi_update_materializations(partial_view,
-									materialization_table,
-									time_column_name,
-									internal_time_range_to_time_range(invalidation_range));
+	if (new_materialization_range.start < new_materialization_range.end)
+		invalidation_set_add(&materialization_ranges,
+							 new_materialization_range.start,
+							 new_materialization_range.end - 1);
 
-		spi_update_materializations(partial_view,
-									materialization_table,
-									time_column_name,
-									internal_time_range_to_time_range(new_materialization_range));
+	for (i = 0; i < materialization_ranges.num_ranges; i++)
+	{
+		InternalTimeRange range = {
+			.type = new_materialization_range.type,
+			.start = materialization_ranges.ranges[i].lowest_modified_value,
+			.end = materialization_ranges.ranges[i].greatest_modified_value + 1,
+		};
+		/* the part of the range below the completed threshold was materialized before */
+		InternalTimeRange materialized_range = {
+			.type = range.type,
+			.start = range.start,
+			.end = int64_min(range.end, new_materialization_range.start),
+		};
+
+		if (materialized_range.start < materialized_range.end)
+		{
+			stats->invalidated_ranges++;
+			stats->invalidated_buckets +=
+				((uint64) materialized_range.end - (uint64) materialized_range.start) /
+				bucket_width;
+			spi_merge_materializations(partial_view,
+									   materialization_table,
+									   time_column_name,
+									   internal_time_range_to_time_range(materialized_range),
+									   stats);
+			range.start = materialized_range.end;
+		}
+
+		if (range.start < range.end)
+			spi_update_materializations(partial_view,
+										materialization_table,
+										time_column_name,
+										internal_time_range_to_time_range(range),
+										stats);
 	}
 
 	res = SPI_finish();
@@ -866,29 +1198,6 @@ update_materializations(SchemaAndName partial_view, SchemaAndName materializatio
 	return;
 }
 
-static bool
-get_invalidation_range(List *invalidations, InternalTimeRange *invalidation_range)
-{
-	bool has_invalidations = false;
-	ListCell *lc;
-
-	invalidation_range->start = PG_INT64_MAX;
-	invalidation_range->end = PG_INT64_MIN;
-	foreach (lc, invalidations)
-	{
-		Invalidation *i = (Invalidation *) lfirst(lc);
-		Assert(i->lowest_modified_value <= i->greatest_modified_value);
-		if (i->lowest_modified_value < invalidation_range->start)
-			invalidation_range->start = i->lowest_modified_value;
-		if (i->greatest_modified_value > invalidation_range->end)
-			invalidation_range->end = i->greatest_modified_value;
-
-		has_invalidations = true;
-	}
-
-	return has_invalidations;
-}
-
 static void
 time_bucket_range(InternalTimeRange *range, int64 bucket_width)
 {
@@ -902,15 +1211,6 @@ time_bucket_range(InternalTimeRange *range, int64 bucket_width)
 		range->start = range->end;
 }
 
-static bool
-ranges_overlap(InternalTimeRange invalidation_range, InternalTimeRange new_materialization_range)
-{
-	Assert(invalidation_range.start <= invalidation_range.end);
-	Assert(new_materialization_range.start <= new_materialization_range.end);
-	return !(invalidation_range.end < new_materialization_range.start ||
-			 new_materialization_range.end < invalidation_range.start);
-}
-
 static Datum
 time_range_internal_to_min_time_value(Oid type)
 {
@@ -984,19 +1284,114 @@ internal_time_range_to_time_range(InternalTimeRange internal)
 
 static void
 spi_update_materializations(SchemaAndName partial_view, SchemaAndName materialization_table,
-							Name time_column_name, TimeRange invalidation_range)
+							Name time_column_name, TimeRange invalidation_range,
+							MaterializationStats *stats)
 {
-	spi_delete_materializations(materialization_table, time_column_name, invalidation_range);
+	spi_delete_materializations(materialization_table,
+								time_column_name,
+								invalidation_range,
+								stats);
 	spi_insert_materializations(partial_view,
 								materialization_table,
 								time_column_name,
-								invalidation_range);
+								invalidation_range,
+								stats);
+}
+
+/*
+ * Re-materialize a range which was materialized before. Most of the buckets of an invalidated
+ * range usually still have the same partials, so instead of replacing all the materialized rows
+ * in the range, we only delete the rows which are not part of the new partials, and insert the
+ * new partials which are not materialized yet. This way unchanged rows are not turned into dead
+ * tuples, and the invalidation trigger of a continuous aggregate materialized from this one only
+ * sees the buckets that actually changed. Rows are compared as a whole, with NULL fields
+ * considered equal.
+ *
+ * The partial view is evaluated once, and the delete and the insert are part of the same
+ * statement, so both see the same snapshot: a raw insert committed in between would otherwise
+ * keep the old partial of a bucket and add its new one next to it. The comparison also matches
+ * the time column, which lets the planner hash the anti-joins, since records cannot be hashed.
+ * The statement is accounted as insert duration.
+ */
+static void
+spi_merge_materializations(SchemaAndName partial_view, SchemaAndName materialization_table,
+						   Name time_column_name, TimeRange invalidation_range,
+						   MaterializationStats *stats)
+{
+	TimestampTz start;
+	int res;
+	bool isnull;
+	StringInfo command = makeStringInfo();
+	Oid out_fn;
+	bool type_is_varlena;
+	char *invalidation_start;
+	char *invalidation_end;
+	const char *materialization_schema = quote_identifier(NameStr(*materialization_table.schema));
+	const char *materialization_name = quote_identifier(NameStr(*materialization_table.name));
+	const char *time_column = quote_identifier(NameStr(*time_column_name));
+
+	getTypeOutputInfo(invalidation_range.type, &out_fn, &type_is_varlena);
+
+	invalidation_start =
+		quote_literal_cstr(OidOutputFunctionCall(out_fn, invalidation_range.start));
+	invalidation_end = quote_literal_cstr(OidOutputFunctionCall(out_fn, invalidation_range.end));
+
+	appendStringInfo(command,
+					 "WITH I AS (SELECT * FROM %s.%s AS P WHERE P.%s >= %s AND P.%s < %s), "
+					 "deleted AS (DELETE FROM %s.%s AS D WHERE D.%s >= %s AND D.%s < %s AND "
+					 "NOT EXISTS (SELECT 1 FROM I WHERE I.%s = D.%s AND D = I) RETURNING 1), "
+					 "inserted AS (INSERT INTO %s.%s SELECT * FROM I WHERE NOT EXISTS ("
+					 "SELECT 1 FROM %s.%s AS D WHERE D.%s >= %s AND D.%s < %s AND "
+					 "D.%s = I.%s AND D = I) RETURNING 1) "
+					 "SELECT (SELECT count(*) FROM deleted), (SELECT count(*) FROM inserted);",
+					 quote_identifier(NameStr(*partial_view.schema)),
+					 quote_identifier(NameStr(*partial_view.name)),
+					 time_column,
+					 invalidation_start,
+					 time_column,
+					 invalidation_end,
+					 materialization_schema,
+					 materialization_name,
+					 time_column,
+					 invalidation_start,
+					 time_column,
+					 invalidation_end,
+					 time_column,
+					 time_column,
+					 materialization_schema,
+					 materialization_name,
+					 materialization_schema,
+					 materialization_name,
+					 time_column,
+					 invalidation_start,
+					 time_column,
+					 invalidation_end,
+					 time_column,
+					 time_column);
+
+	start = GetCurrentTimestamp();
+	res = SPI_execute_with_args(command->data,
+								0 /*=nargs*/,
+								NULL /*=argtypes*/,
+								NULL /*=Values*/,
+								NULL /*=Nulls*/,
+								false /*=read_only*/,
+								0 /*count*/);
+	if (res != SPI_OK_SELECT || SPI_processed != 1)
+		elog(ERROR, "could not merge values into the materialization table");
+
+	stats->rows_deleted +=
+		DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull));
+	stats->rows_inserted +=
+		DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 2, &isnull));
+	stats->insert_duration += GetCurrentTimestamp() - start;
 }
 
 static void
 spi_delete_materializations(SchemaAndName materialization_table, Name time_column_name,
-							TimeRange invalidation_range)
+							TimeRange invalidation_range, MaterializationStats *stats)
 {
+	TimestampTz start;
 	int res;
 	StringInfo command = makeStringInfo();
 	Oid out_fn;
@@ -1019,6 +1414,7 @@ spi_delete_materializations(SchemaAndName materialization_table, Name time_colum
 					 quote_identifier(NameStr(*time_column_name)),
 					 quote_literal_cstr(invalidation_end));
 
+	start = GetCurrentTimestamp();
 	res = SPI_execute_with_args(command->data,
 								0 /*=nargs*/,
 								NULL,
@@ -1028,12 +1424,17 @@ spi_delete_materializations(SchemaAndName materialization_table, Name time_colum
 								0 /*count*/);
 	if (res < 0)
 		elog(ERROR, "could not delete old values from materialization table");
+
+	stats->rows_deleted += SPI_processed;
+	stats->delete_duration += GetCurrentTimestamp() - start;
 }
 
 static void
 spi_insert_materializations(SchemaAndName partial_view, SchemaAndName materialization_table,
-							Name time_column_name, TimeRange materialization_range)
+							Name time_column_name, TimeRange materialization_range,
+							MaterializationStats *stats)
 {
+	TimestampTz start;
 	int res;
 	StringInfo command = makeStringInfo();
 	Oid out_fn;
@@ -1058,6 +1459,7 @@ spi_insert_materializations(SchemaAndName partial_view, SchemaAndName materializ
 					 quote_identifier(NameStr(*time_column_name)),
 					 quote_literal_cstr(materialization_end));
 
+	start = GetCurrentTimestamp();
 	res = SPI_execute_with_args(command->data,
 								0 /*=nargs*/,
 								NULL /*=argtypes*/,
@@ -1068,6 +1470,9 @@ spi_insert_materializations(SchemaAndName partial_view, SchemaAndName materializ
 	);
 	if (res < 0)
 		elog(ERROR, "could materialize values into the materialization table");
+
+	stats->rows_inserted += SPI_processed;
+	stats->insert_duration += GetCurrentTimestamp() - start;
 }
 
 static ScanTupleResult
@@ -1126,7 +1531,7 @@ continuous_aggs_completed_threshold_set(int32 materialization_id, int64 complete
 	}
 }
 
-static int64
+int64
 continuous_aggs_completed_threshold_get(int32 materialization_id)
 {
 	int64 threshold = 0;
@@ -1150,3 +1555,475 @@ continuous_aggs_completed_threshold_get(int32 materialization_id)
 
 	return threshold;
 }
+
+/******************************
+ * materialization statistics *
+ ******************************/
+
+static Datum
+duration_get_datum(int64 usecs)
+{
+	Interval *interval = palloc0(sizeof(*interval));
+
+	interval->time = usecs;
+	return IntervalPGetDatum(interval);
+}
+
+/*
+ * Record a run of the materialization of cagg in the materialization statistics, and delete the
+ * oldest runs so that at most timescaledb.materialization_stats_history of them are kept. The new
+ * buckets are the buckets between the first new value and the new completed threshold, which
+ * were materialized for the first time.
+ */
+static void
+materialization_stats_record(FormData_continuous_agg *cagg, TimestampTz start_time,
+							 int64 old_completed_threshold, int64 new_range_start,
+							 MaterializationStats *stats)
+{
+	CatalogSecurityContext sec_ctx;
+	ScanIterator iterator;
+	Relation rel;
+	Datum values[Natts_continuous_aggs_materialization_stats];
+	bool nulls[Natts_continuous_aggs_materialization_stats] = { false };
+	int64 new_completed_threshold = completed_threshold_get(cagg->mat_hypertable_id);
+	int64 invalidation_threshold = PG_INT64_MIN;
+	int64 new_buckets = 0;
+	int64 run_id = 1;
+	int num_runs = 0;
+
+	invalidation_threshold_lookup(cagg->raw_hypertable_id, &invalidation_threshold);
+
+	if (new_completed_threshold > old_completed_threshold)
+	{
+		int64 start = Max(old_completed_threshold, new_range_start);
+
+		if (new_completed_threshold > start)
+			new_buckets = ((uint64) new_completed_threshold - (uint64) start) / cagg->bucket_width;
+	}
+
+	ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
+
+	/* the runs are scanned newest first, to number the new one and delete the oldest ones */
+	iterator = ts_scan_iterator_create(CONTINUOUS_AGGS_MATERIALIZATION_STATS,
+									   RowExclusiveLock,
+									   CurrentMemoryContext);
+	iterator.ctx.index = catalog_get_index(ts_catalog_get(),
+										   CONTINUOUS_AGGS_MATERIALIZATION_STATS,
+										   CONTINUOUS_AGGS_MATERIALIZATION_STATS_PKEY);
+	iterator.ctx.scandirection = BackwardScanDirection;
+	ts_scan_iterator_scan_key_init(
+		&iterator,
+		Anum_continuous_aggs_materialization_stats_pkey_materialization_id,
+		BTEqualStrategyNumber,
+		F_INT4EQ,
+		Int32GetDatum(cagg->mat_hypertable_id));
+
+	ts_scanner_foreach(&iterator)
+	{
+		TupleInfo *ti = ts_scan_iterator_tuple_info(&iterator);
+
+		if (num_runs == 0)
+		{
+			bool isnull;
+			Datum last_run_id = heap_getattr(ti->tuple,
+											 Anum_continuous_aggs_materialization_stats_run_id,
+											 ti->desc,
+											 &isnull);
+
+			Assert(!isnull);
+			run_id = DatumGetInt64(last_run_id) + 1;
+		}
+
+		/* the new run takes up one entry of the history */
+		if (++num_runs >= ts_guc_materialization_stats_history)
+			ts_catalog_delete(ti->scanrel, ti->tuple);
+	}
+
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_materialization_id)] =
+		Int32GetDatum(cagg->mat_hypertable_id);
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_run_id)] =
+		Int64GetDatum(run_id);
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_start_time)] =
+		TimestampTzGetDatum(start_time);
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_finish_time)] =
+		TimestampTzGetDatum(GetCurrentTimestamp());
+	values[AttrNumberGetAttrOffset(
+		Anum_continuous_aggs_materialization_stats_old_completed_threshold)] =
+		Int64GetDatum(old_completed_threshold);
+	nulls[AttrNumberGetAttrOffset(
+		Anum_continuous_aggs_materialization_stats_old_completed_threshold)] =
+		(old_completed_threshold == PG_INT64_MIN);
+	values[AttrNumberGetAttrOffset(
+		Anum_continuous_aggs_materialization_stats_new_completed_threshold)] =
+		Int64GetDatum(new_completed_threshold);
+	nulls[AttrNumberGetAttrOffset(
+		Anum_continuous_aggs_materialization_stats_new_completed_threshold)] =
+		(new_completed_threshold == PG_INT64_MIN);
+	values[AttrNumberGetAttrOffset(
+		Anum_continuous_aggs_materialization_stats_invalidation_threshold)] =
+		Int64GetDatum(invalidation_threshold);
+	nulls[AttrNumberGetAttrOffset(
+		Anum_continuous_aggs_materialization_stats_invalidation_threshold)] =
+		(invalidation_threshold == PG_INT64_MIN);
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_invalidated_ranges)] =
+		Int32GetDatum(stats->invalidated_ranges);
+	values[AttrNumberGetAttrOffset(
+		Anum_continuous_aggs_materialization_stats_invalidated_buckets)] =
+		Int64GetDatum(stats->invalidated_buckets);
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_new_buckets)] =
+		Int64GetDatum(new_buckets);
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_rows_deleted)] =
+		Int64GetDatum(stats->rows_deleted);
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_rows_inserted)] =
+		Int64GetDatum(stats->rows_inserted);
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_delete_duration)] =
+		duration_get_datum(stats->delete_duration);
+	values[AttrNumberGetAttrOffset(Anum_continuous_aggs_materialization_stats_insert_duration)] =
+		duration_get_datum(stats->insert_duration);
+
+	rel = heap_open(catalog_get_table_id(ts_catalog_get(), CONTINUOUS_AGGS_MATERIALIZATION_STATS),
+					RowExclusiveLock);
+	ts_catalog_insert_values(rel, RelationGetDescr(rel), values, nulls);
+	relation_close(rel, NoLock);
+
+	ts_catalog_restore_user(&sec_ctx);
+}
+
+/****************************
+ * parallel materialization *
+ ****************************/
+
+#define MATERIALIZATION_WORKER_ENTRYPOINT "ts_bgw_materialization_worker_entrypoint"
+#define MATERIALIZATION_WORKER_NAME "TimescaleDB Materialization Worker"
+
+typedef struct MaterializationSlice
+{
+	int64 start;
+	int64 end;
+	bool done;
+	MaterializationStats stats;
+} MaterializationSlice;
+
+/* The work shared with the materialization workers, in dynamic shared memory. The workers take
+ * the slices in order, and mark each one done once it is committed. */
+typedef struct ParallelMaterialization
+{
+	NameData partial_view_schema;
+	NameData partial_view_name;
+	NameData materialization_table_schema;
+	NameData materialization_table_name;
+	NameData time_column_name;
+	Oid time_type;
+	pg_atomic_uint32 next_slice;
+	uint32 num_slices;
+	MaterializationSlice slices[FLEXIBLE_ARRAY_MEMBER];
+} ParallelMaterialization;
+
+/*
+ * The end of the slice starting at slice_start, which contains value: the start of the bucket
+ * containing the end of the raw chunk containing value, so that the slices follow the chunks of
+ * the raw hypertable as closely as the buckets allow. Every slice holds at least one bucket.
+ */
+static int64
+materialization_slice_end(int64 slice_start, int64 value, int64 end, int64 chunk_interval,
+						  int64 bucket_width, Oid time_type)
+{
+	int64 chunk_end;
+	int64 slice_end;
+
+	if (value < PG_INT64_MIN + chunk_interval)
+		chunk_end = PG_INT64_MIN + chunk_interval;
+	else
+	{
+		int64 offset = value % chunk_interval;
+
+		if (offset < 0)
+			offset += chunk_interval;
+
+		if (value - offset >= end - chunk_interval)
+			return end;
+
+		chunk_end = value - offset + chunk_interval;
+	}
+
+	if (chunk_end >= end)
+		return end;
+
+	slice_end = ts_time_bucket_by_type(bucket_width, chunk_end, time_type);
+
+	if (slice_end <= slice_start)
+	{
+		if (slice_start > PG_INT64_MAX - bucket_width || slice_start + bucket_width >= end)
+			return end;
+
+		slice_end = slice_start + bucket_width;
+	}
+
+	return slice_end;
+}
+
+/*
+ * Materialize the new range [completed threshold, materialization_end) with background workers.
+ *
+ * The range is split into bucket-aligned slices following the chunks of the raw hypertable, and
+ * up to max_parallel_materialization_workers workers take the slices in order, materializing
+ * and committing each of them in a transaction of its own. Once the workers exit, the completed
+ * threshold is moved to the end of the slices materialized without a gap, so it only ever moves
+ * forward, and never past a bucket which was not materialized. The invalidation threshold was
+ * already moved to materialization_end, so any mutation of a slice after it was materialized is
+ * logged, and re-materialized by the next materialization.
+ *
+ * Slices a worker failed on, and everything after them, are left to the serial materialization
+ * in the second transaction, which also deletes any rows materialized there in the meantime.
+ * The same goes for the whole range if no worker could be started.
+ */
+static void
+materialize_new_range_in_parallel(FormData_continuous_agg *cagg, int64 materialization_end,
+								  MaterializationStats *stats)
+{
+	Cache *hcache;
+	Hypertable *raw_table;
+	Hypertable *materialization_table;
+	Dimension *time_dimension;
+	Oid time_type;
+	int64 chunk_interval;
+	int64 start;
+	int64 value = PG_INT64_MIN;
+	int64 max_value = PG_INT64_MIN;
+	int64 slice_start;
+	List *slices = NIL;
+	ListCell *lc;
+	dsm_segment *seg;
+	ParallelMaterialization *pm;
+	BackgroundWorkerHandle **handles;
+	char extra[BGW_EXTRALEN];
+	int num_workers;
+	int num_started;
+	uint32 num_done;
+	int i;
+
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	start = completed_threshold_get(cagg->mat_hypertable_id);
+
+	hcache = ts_hypertable_cache_pin();
+	raw_table = ts_hypertable_cache_get_entry_by_id(hcache, cagg->raw_hypertable_id);
+	materialization_table = ts_hypertable_cache_get_entry_by_id(hcache, cagg->mat_hypertable_id);
+
+	if (raw_table == NULL)
+		elog(ERROR, "can only materialize continuous aggregates on a hypertable");
+
+	if (materialization_table == NULL)
+		elog(ERROR, "can only materialize continuous aggregates to a hypertable");
+
+	time_dimension = hyperspace_get_open_dimension(raw_table->space, 0);
+	time_type = time_dimension->fd.column_type;
+
+	/* the last bucket is never materialized, see materialize_range */
+	if (materialization_end == PG_INT64_MAX)
+		materialization_end =
+			ts_time_bucket_by_type(cagg->bucket_width, materialization_end, time_type);
+
+	chunk_interval = time_dimension->fd.interval_length;
+
+	/* the first slice starts at the completed threshold, but follows the chunk of the first
+	 * new value */
+	if (start < materialization_end && chunk_interval > 0 &&
+		hypertable_get_min_and_max(raw_table, start, &value, &max_value))
+	{
+		for (slice_start = start; slice_start < materialization_end;)
+		{
+			MaterializationSlice *slice = palloc0(sizeof(*slice));
+
+			slice->start = slice_start;
+			slice->end = materialization_slice_end(slice_start,
+												   Max(value, slice_start),
+												   materialization_end,
+												   chunk_interval,
+												   cagg->bucket_width,
+												   time_type);
+			slices = lappend(slices, slice);
+			slice_start = slice->end;
+		}
+	}
+
+	/* a single slice is materialized just as well by the serial materialization */
+	if (list_length(slices) < 2)
+	{
+		ts_cache_release(hcache);
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+		return;
+	}
+
+	seg = dsm_create(add_size(offsetof(ParallelMaterialization, slices),
+							  mul_size(list_length(slices), sizeof(MaterializationSlice))),
+					 0);
+	pm = dsm_segment_address(seg);
+	pm->partial_view_schema = cagg->partial_view_schema;
+	pm->partial_view_name = cagg->partial_view_name;
+	pm->materialization_table_schema = materialization_table->fd.schema_name;
+	pm->materialization_table_name = materialization_table->fd.table_name;
+	pm->time_column_name =
+		hyperspace_get_open_dimension(materialization_table->space, 0)->fd.column_name;
+	pm->time_type = time_type;
+	pg_atomic_init_u32(&pm->next_slice, 0);
+	pm->num_slices = 0;
+	foreach (lc, slices)
+		pm->slices[pm->num_slices++] = *(MaterializationSlice *) lfirst(lc);
+
+	ts_cache_release(hcache);
+
+	/* do not hold back the xmin horizon while waiting for the workers */
+	PopActiveSnapshot();
+
+	num_workers = Min(ts_guc_max_parallel_materialization_workers, (int) pm->num_slices);
+	handles = palloc(sizeof(*handles) * num_workers);
+	snprintf(extra, sizeof(extra), "%u %u", dsm_segment_handle(seg), GetUserId());
+
+	for (num_started = 0; num_started < num_workers; num_started++)
+	{
+		if (!ts_bgw_worker_reserve())
+			break;
+
+		handles[num_started] = ts_bgw_start_worker(MATERIALIZATION_WORKER_ENTRYPOINT,
+												   MATERIALIZATION_WORKER_NAME,
+												   extra);
+		if (handles[num_started] == NULL)
+		{
+			ts_bgw_worker_release();
+			break;
+		}
+	}
+
+	PG_TRY();
+	{
+		for (i = 0; i < num_started; i++)
+		{
+			if (WaitForBackgroundWorkerShutdown(handles[i]) == BGWH_POSTMASTER_DIED)
+				ereport(FATAL,
+						(errcode(ERRCODE_ADMIN_SHUTDOWN),
+						 errmsg("postmaster exited while waiting for materialization workers")));
+		}
+	}
+	PG_CATCH();
+	{
+		for (i = 0; i < num_started; i++)
+		{
+			TerminateBackgroundWorker(handles[i]);
+			ts_bgw_worker_release();
+		}
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	for (i = 0; i < num_started; i++)
+		ts_bgw_worker_release();
+
+	/* the slices materialized after a gap are materialized again in transaction 2, but they
+	 * were materialized all the same */
+	for (i = 0; i < (int) pm->num_slices; i++)
+	{
+		MaterializationStats *slice_stats = &pm->slices[i].stats;
+
+		if (!pm->slices[i].done)
+			continue;
+
+		stats->rows_deleted += slice_stats->rows_deleted;
+		stats->rows_inserted += slice_stats->rows_inserted;
+		stats->delete_duration += slice_stats->delete_duration;
+		stats->insert_duration += slice_stats->insert_duration;
+	}
+
+	for (num_done = 0; num_done < pm->num_slices; num_done++)
+	{
+		if (!pm->slices[num_done].done)
+			break;
+	}
+
+	elog(DEBUG1,
+		 "materialized %u of %u slices of continuous aggregate %s.%s with %d workers",
+		 num_done,
+		 pm->num_slices,
+		 NameStr(cagg->user_view_schema),
+		 NameStr(cagg->user_view_name),
+		 num_started);
+
+	if (num_done > 0)
+	{
+		CatalogSecurityContext sec_ctx;
+
+		PushActiveSnapshot(GetTransactionSnapshot());
+		ts_catalog_database_info_become_owner(ts_catalog_database_info_get(), &sec_ctx);
+		continuous_aggs_completed_threshold_set(cagg->mat_hypertable_id,
+												pm->slices[num_done - 1].end);
+		ts_catalog_restore_user(&sec_ctx);
+		PopActiveSnapshot();
+	}
+
+	dsm_detach(seg);
+	CommitTransactionCommand();
+}
+
+/* Main function of the materialization workers started by materialize_new_range_in_parallel */
+void
+continuous_agg_materialize_worker(dsm_handle handle)
+{
+	dsm_segment *seg;
+	ParallelMaterialization *pm;
+	SchemaAndName partial_view;
+	SchemaAndName materialization_table;
+	uint32 slice;
+
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, MATERIALIZATION_WORKER_NAME);
+
+	seg = dsm_attach(handle);
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+
+	pm = dsm_segment_address(seg);
+	partial_view = (SchemaAndName){
+		.schema = &pm->partial_view_schema,
+		.name = &pm->partial_view_name,
+	};
+	materialization_table = (SchemaAndName){
+		.schema = &pm->materialization_table_schema,
+		.name = &pm->materialization_table_name,
+	};
+
+	while ((slice = pg_atomic_fetch_add_u32(&pm->next_slice, 1)) < pm->num_slices)
+	{
+		InternalTimeRange range = {
+			.type = pm->time_type,
+			.start = pm->slices[slice].start,
+			.end = pm->slices[slice].end,
+		};
+		int res;
+
+		StartTransactionCommand();
+		PushActiveSnapshot(GetTransactionSnapshot());
+
+		res = SPI_connect();
+		if (res != SPI_OK_CONNECT)
+			elog(ERROR, "could not connect to SPI in materialization worker");
+
+		spi_update_materializations(partial_view,
+									materialization_table,
+									&pm->time_column_name,
+									internal_time_range_to_time_range(range),
+									&pm->slices[slice].stats);
+
+		res = SPI_finish();
+		Assert(res == SPI_OK_FINISH);
+
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+
+		pm->slices[slice].done = true;
+	}
+
+	dsm_detach(seg);
+}
@@ -9,6 +9,9 @@
 #include <postgres.h>
 #include <fmgr.h>
 #include <nodes/pg_list.h>
+#include <storage/dsm.h>
+
+#include "continuous_aggs/invalidation_set.h"
 
 typedef struct SchemaAndName
 {
@@ -16,15 +19,11 @@ typedef struct SchemaAndName
 	Name name;
 } SchemaAndName;
 
-typedef struct Invalidation
-{
-	int64 lowest_modified_value;
-	int64 greatest_modified_value;
-} Invalidation;
-
 bool continuous_agg_materialize(int32 materialization_id, bool verbose);
+void continuous_agg_materialize_worker(dsm_handle handle);
 void continuous_agg_execute_materialization(int64 bucket_width, int32 hypertable_id,
 											int32 materialization_id, SchemaAndName partial_view,
 											List *invalidations);
+int64 continuous_aggs_completed_threshold_get(int32 materialization_id);
 
 #endif /* TIMESCALEDB_TSL_CONTINUOUS_AGGS_MATERIALIZE_H */
@@ -9,6 +9,7 @@
 
 #include "options.h"
 #include "continuous_agg.h"
+#include "create.h"
 #include "hypertable_cache.h"
 #include "cache.h"
 #include "scan_iterator.h"
@@ -202,4 +203,14 @@ continuous_agg_update_options(ContinuousAgg *agg, WithClauseResult *with_clause_
 	{
 		elog(ERROR, "cannot alter create_group_indexes option for continuous aggregates");
 	}
+	if (!with_clause_options[ContinuousViewOptionMaterializedOnly].is_default)
+	{
+		bool materialized_only =
+			DatumGetBool(with_clause_options[ContinuousViewOptionMaterializedOnly].parsed);
+		cagg_update_materialized_only(agg, materialized_only);
+	}
+	if (!with_clause_options[ContinuousViewOptionMaterializeFrom].is_default)
+	{
+		elog(ERROR, "cannot alter materialize_from option for continuous aggregates");
+	}
 }
@@ -0,0 +1,877 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+/*
+ * Rewrite aggregate queries on a hypertable to read from a matching
+ * continuous aggregate.
+ *
+ * A query like
+ *
+ *   SELECT time_bucket('1 day', time), device, avg(temp)
+ *   FROM conditions
+ *   GROUP BY 1, 2;
+ *
+ * can be answered from a continuous aggregate on conditions whose direct
+ * view groups by time_bucket('1 hour', time) and device and computes
+ * avg(temp), because every 1 hour bucket lies completely inside a 1 day
+ * bucket. The rewritten query finalizes the partials stored in the
+ * materialization table below the completed threshold and partializes the
+ * raw rows at or above it on the fly:
+ *
+ *   SELECT time_bucket('1 day', time_partition_col), device,
+ *          finalize_agg(..., agg_3_3, ...)
+ *   FROM (SELECT * FROM <materialization table>
+ *         WHERE time_partition_col < <completed threshold>
+ *         UNION ALL
+ *         SELECT * FROM <partial view query>
+ *         WHERE time >= <completed threshold>) cagg
+ *   GROUP BY 1, 2;
+ *
+ * Both branches of the UNION ALL produce rows of the materialization table's
+ * row type, so a bucket of the query that straddles the completed threshold
+ * is still combined into a single group by finalize_agg. Modifications of
+ * already materialized data are only visible after the next materialization.
+ *
+ * We only rewrite queries we can prove equivalent:
+ *   - a single hypertable in the FROM clause, no sublinks, window functions,
+ *     grouping sets, CTEs or set operations,
+ *   - every aggregate equals an aggregate of the continuous aggregate,
+ *   - every other reference to the hypertable is a grouping expression of the
+ *     continuous aggregate or a time_bucket on the time column whose width is
+ *     a multiple of the continuous aggregate's bucket width,
+ *   - the WHERE clause is either identical to the one of the continuous
+ *     aggregate or only references its grouping expressions.
+ *
+ * The same matching is used to compute the partials of a hierarchical
+ * continuous aggregate from the materialization of the continuous aggregate
+ * it is materialized from, see continuous_agg_rewrite_partial_query.
+ */
+#include <postgres.h>
+#include <access/heapam.h>
+#include <access/stratnum.h>
+#include <access/sysattr.h>
+#include <catalog/namespace.h>
+#include <catalog/pg_class.h>
+#include <catalog/pg_type.h>
+#include <miscadmin.h>
+#include <nodes/makefuncs.h>
+#include <nodes/nodeFuncs.h>
+#include <optimizer/clauses.h>
+#include <optimizer/var.h>
+#include <parser/parse_func.h>
+#include <parser/parsetree.h>
+#include <rewrite/rewriteHandler.h>
+#include <rewrite/rewriteManip.h>
+#include <utils/acl.h>
+#include <utils/builtins.h>
+#include <utils/lsyscache.h>
+#include <utils/rel.h>
+#include <utils/rls.h>
+#include <utils/timestamp.h>
+#include <utils/typcache.h>
+
+#include "continuous_aggs/planner.h"
+#include "continuous_aggs/create.h"
+#include "continuous_aggs/materialize.h"
+#include "compat.h"
+#include "continuous_agg.h"
+#include "dimension.h"
+#include "extension_constants.h"
+#include "hypertable.h"
+#include "hypertable_cache.h"
+#include "utils.h"
+
+#define CAGG_REWRITE_ALIAS "cagg"
+#define PARTIALIZE_FN_NAME "partialize_agg"
+#define PARTIALIZE_NATIVE_FN_NAME "partialize_agg_native"
+
+/* Information about a continuous aggregate needed to match a query against it */
+typedef struct CaggRewriteInfo
+{
+	ContinuousAgg *cagg;
+	Oid mat_relid;
+	TupleDesc mat_desc;
+	Query *partial_query;		/* query of the partial view */
+	Index partial_rtindex;		/* range table index of the raw hypertable in partial_query */
+	AttrNumber time_attno;		/* time column of the raw hypertable */
+	FuncExpr *bucket;			/* time_bucket expression of the direct view */
+	AttrNumber bucket_attno;	/* materialization column holding the bucket */
+	List *group_exprs;			/* grouping expressions of the direct view */
+	List *group_attnos;			/* materialization columns holding group_exprs */
+	List *aggrefs;				/* aggregates of the direct view */
+	List *agg_attnos;			/* materialization columns holding the partials */
+	Node *quals;				/* WHERE clause of the direct view */
+} CaggRewriteInfo;
+
+typedef struct CaggRewriteContext
+{
+	CaggRewriteInfo *info;
+	Oid partialize_fnoid; /* set if partialize_agg calls are replaced by combine_agg */
+	Oid partialize_native_fnoid; /* and partialize_agg_native calls by finalize_agg */
+	bool failed;
+} CaggRewriteContext;
+
+/*
+ * Get a copy of the query of a view. Returns NULL if the view does not exist.
+ * rtindex is set to the range table index of the only relation in the FROM
+ * clause, or 0 if the FROM clause has some other shape.
+ */
+static Query *
+get_view_query_by_name(Name schema, Name name, Index *rtindex)
+{
+	Oid nspid = get_namespace_oid(NameStr(*schema), true);
+	Oid relid;
+	Relation rel;
+	Query *query;
+
+	if (!OidIsValid(nspid))
+		return NULL;
+
+	relid = get_relname_relid(NameStr(*name), nspid);
+	if (!OidIsValid(relid))
+		return NULL;
+
+	rel = heap_open(relid, AccessShareLock);
+	query = copyObject(get_view_query(rel));
+	heap_close(rel, NoLock);
+
+	/* the finalize query of a real-time view is the first branch of its union */
+	if (query->setOperations != NULL)
+	{
+		SetOperationStmt *setop = (SetOperationStmt *) query->setOperations;
+
+		if (!IsA(setop->larg, RangeTblRef))
+			return NULL;
+
+		query = rt_fetch(((RangeTblRef *) setop->larg)->rtindex, query->rtable)->subquery;
+	}
+
+	*rtindex = 0;
+	if (list_length(query->jointree->fromlist) == 1 &&
+		IsA(linitial(query->jointree->fromlist), RangeTblRef))
+		*rtindex = ((RangeTblRef *) linitial(query->jointree->fromlist))->rtindex;
+
+	return query;
+}
+
+static bool
+collect_aggrefs_walker(Node *node, List **aggrefs)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, Aggref))
+	{
+		*aggrefs = lappend(*aggrefs, node);
+		return false;
+	}
+
+	return expression_tree_walker(node, collect_aggrefs_walker, aggrefs);
+}
+
+static Var *
+mat_var(CaggRewriteInfo *info, Index varno, AttrNumber attno)
+{
+	Form_pg_attribute attr = TupleDescAttr(info->mat_desc, AttrNumberGetAttrOffset(attno));
+
+	return makeVar(varno, attno, attr->atttypid, attr->atttypmod, attr->attcollation, 0);
+}
+
+/*
+ * Map the target list of the direct view onto the columns of the
+ * materialization table.
+ *
+ * The user view is created by finalizequery_init from the direct view query
+ * and has the same target list entries in the same order: grouping entries
+ * are replaced by a Var on their materialization column and every aggregate
+ * is replaced by a finalize_agg call whose fifth argument is the Var on the
+ * materialization column holding its partial state.
+ */
+static bool
+cagg_rewrite_info_init(CaggRewriteInfo *info, Hypertable *raw_ht, ContinuousAgg *cagg,
+					   Cache *hcache)
+{
+	Hypertable *mat_ht = ts_hypertable_cache_get_entry_by_id(hcache, cagg->data.mat_hypertable_id);
+	Query *direct_query;
+	Query *user_query;
+	Index direct_rtindex;
+	Index user_rtindex;
+	AttrNumber mat_time_attno;
+	Relation mat_rel;
+	ListCell *lc_direct, *lc_user;
+	int i;
+
+	memset(info, 0, sizeof(*info));
+	info->cagg = cagg;
+
+	if (mat_ht == NULL)
+		return false;
+
+	info->mat_relid = mat_ht->main_table_relid;
+
+	if (pg_class_aclcheck(info->mat_relid, GetUserId(), ACL_SELECT) != ACLCHECK_OK)
+		return false;
+
+	direct_query = get_view_query_by_name(&cagg->data.direct_view_schema,
+										  &cagg->data.direct_view_name,
+										  &direct_rtindex);
+	user_query = get_view_query_by_name(&cagg->data.user_view_schema,
+										&cagg->data.user_view_name,
+										&user_rtindex);
+	info->partial_query = get_view_query_by_name(&cagg->data.partial_view_schema,
+												 &cagg->data.partial_view_name,
+												 &info->partial_rtindex);
+
+	if (direct_query == NULL || user_query == NULL || info->partial_query == NULL ||
+		direct_rtindex == 0 || user_rtindex == 0 || info->partial_rtindex == 0 ||
+		list_length(direct_query->targetList) != list_length(user_query->targetList))
+		return false;
+
+	/* a hierarchical continuous aggregate is not computed from its raw hypertable directly */
+	if (rt_fetch(direct_rtindex, direct_query->rtable)->relid != raw_ht->main_table_relid)
+		return false;
+
+	mat_rel = heap_open(info->mat_relid, AccessShareLock);
+	info->mat_desc = CreateTupleDescCopy(RelationGetDescr(mat_rel));
+	heap_close(mat_rel, NoLock);
+
+	for (i = 0; i < info->mat_desc->natts; i++)
+	{
+		if (TupleDescAttr(info->mat_desc, i)->attisdropped)
+			return false;
+	}
+
+	/* the partial view has to produce rows of the materialization table's row type */
+	if (list_length(info->partial_query->targetList) != info->mat_desc->natts)
+		return false;
+
+	foreach (lc_direct, info->partial_query->targetList)
+	{
+		if (((TargetEntry *) lfirst(lc_direct))->resjunk)
+			return false;
+	}
+
+	info->time_attno = hyperspace_get_open_dimension(raw_ht->space, 0)->column_attno;
+	mat_time_attno = hyperspace_get_open_dimension(mat_ht->space, 0)->column_attno;
+
+	forboth (lc_direct, direct_query->targetList, lc_user, user_query->targetList)
+	{
+		TargetEntry *direct_tle = lfirst(lc_direct);
+		TargetEntry *user_tle = lfirst(lc_user);
+		Node *expr = copyObject((Node *) direct_tle->expr);
+		List *aggrefs = NIL;
+		List *finalize_aggrefs = NIL;
+		ListCell *lc_agg, *lc_final;
+
+		/* make the expression reference the query's only range table entry */
+		ChangeVarNodes(expr, direct_rtindex, 1, 0);
+
+		if (IsA(user_tle->expr, Var))
+		{
+			Var *var = (Var *) user_tle->expr;
+
+			if (var->varattno == mat_time_attno)
+			{
+				if (!IsA(expr, FuncExpr) || list_length(((FuncExpr *) expr)->args) != 2)
+					return false;
+				info->bucket = (FuncExpr *) expr;
+				info->bucket_attno = var->varattno;
+			}
+
+			/* constants must not be matched against arbitrary expressions */
+			if (contain_var_clause(expr))
+			{
+				info->group_exprs = lappend(info->group_exprs, expr);
+				info->group_attnos = lappend_int(info->group_attnos, var->varattno);
+			}
+			continue;
+		}
+
+		collect_aggrefs_walker(expr, &aggrefs);
+		collect_aggrefs_walker((Node *) user_tle->expr, &finalize_aggrefs);
+
+		if (list_length(aggrefs) != list_length(finalize_aggrefs))
+			return false;
+
+		forboth (lc_agg, aggrefs, lc_final, finalize_aggrefs)
+		{
+			Aggref *finalize = lfirst(lc_final);
+			TargetEntry *partial_tle;
+
+			if (list_length(finalize->args) != 6)
+				return false;
+
+			partial_tle = list_nth(finalize->args, 4);
+
+			if (!IsA(partial_tle->expr, Var))
+				return false;
+
+			info->aggrefs = lappend(info->aggrefs, lfirst(lc_agg));
+			info->agg_attnos =
+				lappend_int(info->agg_attnos, ((Var *) partial_tle->expr)->varattno);
+		}
+	}
+
+	if (info->bucket == NULL)
+		return false;
+
+	if (direct_query->jointree->quals != NULL)
+	{
+		info->quals = direct_query->jointree->quals;
+		ChangeVarNodes(info->quals, direct_rtindex, 1, 0);
+	}
+
+	return true;
+}
+
+/*
+ * time_bucket(width, time) with a width that is a multiple of the continuous
+ * aggregate's bucket width can be computed from the materialized buckets:
+ * time_bucket(width, time_bucket(bucket_width, time)) = time_bucket(width, time)
+ */
+static Node *
+rebucket_time_bucket(FuncExpr *fe, CaggRewriteInfo *info)
+{
+	FuncExpr *bucket = info->bucket;
+	FuncExpr *rebucketed;
+	Const *width;
+	int64 bucket_width;
+
+	if (fe->funcid != bucket->funcid || list_length(fe->args) != 2 ||
+		!IsA(linitial(fe->args), Const) || !equal(lsecond(fe->args), lsecond(bucket->args)))
+		return NULL;
+
+	width = (Const *) linitial(fe->args);
+
+	if (width->constisnull)
+		return NULL;
+
+	if (width->consttype == INTERVALOID && DatumGetIntervalP(width->constvalue)->month != 0)
+		return NULL;
+
+	bucket_width = ts_interval_value_to_internal(width->constvalue, width->consttype);
+
+	if (bucket_width <= 0 || bucket_width % info->cagg->data.bucket_width != 0)
+		return NULL;
+
+	rebucketed = copyObject(fe);
+	lsecond(rebucketed->args) = mat_var(info, 1, info->bucket_attno);
+
+	return (Node *) rebucketed;
+}
+
+/*
+ * Replace references to the raw hypertable with references to the columns of
+ * the materialization table. Sets failed if the expression references the
+ * hypertable in a way we cannot answer from the continuous aggregate.
+ */
+static Node *
+cagg_rewrite_mutator(Node *node, CaggRewriteContext *ctx)
+{
+	CaggRewriteInfo *info = ctx->info;
+	ListCell *lc_expr, *lc_attno;
+
+	if (node == NULL || ctx->failed)
+		return node;
+
+	/*
+	 * partialize_agg(agg) becomes combine_agg(<materialized partial of agg>). A
+	 * native partial is the transition value of an aggregate without a final
+	 * function, so partialize_agg_native(agg) becomes finalize_agg(...) instead,
+	 * whether the source stores the partial natively or not.
+	 */
+	if (OidIsValid(ctx->partialize_fnoid) && IsA(node, FuncExpr) &&
+		(((FuncExpr *) node)->funcid == ctx->partialize_fnoid ||
+		 ((FuncExpr *) node)->funcid == ctx->partialize_native_fnoid))
+	{
+		Node *arg = linitial(((FuncExpr *) node)->args);
+		bool native = ((FuncExpr *) node)->funcid == ctx->partialize_native_fnoid;
+
+		if (IsA(arg, Aggref))
+		{
+			forboth (lc_expr, info->aggrefs, lc_attno, info->agg_attnos)
+			{
+				Var *partial_var;
+
+				if (!equal(arg, lfirst(lc_expr)))
+					continue;
+
+				partial_var = mat_var(info, 1, lfirst_int(lc_attno));
+
+				if (native)
+					return (Node *) get_finalize_aggref((Aggref *) arg, partial_var);
+
+				/* an aggregate stored natively by source is stored natively here as well */
+				if (partial_var->vartype != BYTEAOID)
+					break;
+
+				return (Node *) get_combine_aggref((Aggref *) arg, partial_var);
+			}
+		}
+
+		ctx->failed = true;
+		return node;
+	}
+
+	if (IsA(node, Aggref))
+	{
+		forboth (lc_expr, info->aggrefs, lc_attno, info->agg_attnos)
+		{
+			if (equal(node, lfirst(lc_expr)))
+				return (Node *) get_finalize_aggref((Aggref *) node,
+													mat_var(info, 1, lfirst_int(lc_attno)));
+		}
+
+		ctx->failed = true;
+		return node;
+	}
+
+	forboth (lc_expr, info->group_exprs, lc_attno, info->group_attnos)
+	{
+		if (equal(node, lfirst(lc_expr)))
+			return (Node *) mat_var(info, 1, lfirst_int(lc_attno));
+	}
+
+	if (IsA(node, FuncExpr))
+	{
+		Node *rebucketed = rebucket_time_bucket((FuncExpr *) node, info);
+
+		if (rebucketed != NULL)
+			return rebucketed;
+	}
+
+	if (IsA(node, Var))
+	{
+		/* the chunk id of a partial refers to the chunks of the relation it is computed from */
+		if (OidIsValid(ctx->partialize_fnoid) &&
+			((Var *) node)->varattno == TableOidAttributeNumber)
+			return copyObject(node);
+
+		ctx->failed = true;
+		return node;
+	}
+
+	return expression_tree_mutator(node, cagg_rewrite_mutator, ctx);
+}
+
+static Const *
+make_time_const(Oid time_type, int64 value)
+{
+	int16 typlen;
+	bool typbyval;
+
+	get_typlenbyval(time_type, &typlen, &typbyval);
+
+	return makeConst(time_type,
+					 -1,
+					 InvalidOid,
+					 typlen,
+					 ts_internal_to_time_value(value, time_type),
+					 false,
+					 typbyval);
+}
+
+/* Create "<column> <strategy operator> <value>" for a time column of a relation */
+static Node *
+make_time_qual(Oid relid, Index varno, AttrNumber attno, int strategy, Const *value)
+{
+	Oid type;
+	int32 typmod;
+	Oid collation;
+	TypeCacheEntry *tce;
+	Oid opno;
+	OpExpr *op;
+
+	get_atttypetypmodcoll(relid, attno, &type, &typmod, &collation);
+	tce = lookup_type_cache(type, TYPECACHE_BTREE_OPFAMILY);
+	opno = get_opfamily_member(tce->btree_opf, type, type, strategy);
+
+	if (!OidIsValid(opno))
+		elog(ERROR, "could not find btree operator for type %s", format_type_be(type));
+
+	op = (OpExpr *) make_opclause(opno,
+								  BOOLOID,
+								  false,
+								  (Expr *) makeVar(varno, attno, type, typmod, collation, 0),
+								  (Expr *) value,
+								  InvalidOid,
+								  InvalidOid);
+	set_opfuncid(op);
+
+	return (Node *) op;
+}
+
+static List *
+mat_column_names(CaggRewriteInfo *info)
+{
+	List *colnames = NIL;
+	int i;
+
+	for (i = 0; i < info->mat_desc->natts; i++)
+		colnames = lappend(colnames,
+						   makeString(pstrdup(NameStr(TupleDescAttr(info->mat_desc, i)->attname))));
+
+	return colnames;
+}
+
+static RangeTblEntry *
+make_subquery_rte(Query *subquery, const char *aliasname, List *colnames)
+{
+	RangeTblEntry *rte = makeNode(RangeTblEntry);
+
+	rte->rtekind = RTE_SUBQUERY;
+	rte->subquery = subquery;
+	rte->alias = makeAlias(aliasname, NIL);
+	rte->eref = makeAlias(aliasname, colnames);
+	rte->inh = false;
+	rte->inFromCl = true;
+
+	return rte;
+}
+
+static Query *
+make_select_query(void)
+{
+	Query *query = makeNode(Query);
+
+	query->commandType = CMD_SELECT;
+	query->querySource = QSRC_ORIGINAL;
+	query->canSetTag = true;
+
+	return query;
+}
+
+/* Range table entry reading all columns of the materialization table */
+static RangeTblEntry *
+make_materialization_rte(CaggRewriteInfo *info)
+{
+	RangeTblEntry *rte = makeNode(RangeTblEntry);
+	AttrNumber attno;
+
+	rte->rtekind = RTE_RELATION;
+	rte->relid = info->mat_relid;
+	rte->relkind = RELKIND_RELATION;
+	rte->eref = makeAlias(get_rel_name(info->mat_relid), mat_column_names(info));
+	rte->inh = true;
+	rte->inFromCl = true;
+	rte->requiredPerms = ACL_SELECT;
+
+	for (attno = 1; attno <= info->mat_desc->natts; attno++)
+		rte->selectedCols =
+			bms_add_member(rte->selectedCols, attno - FirstLowInvalidHeapAttributeNumber);
+
+	return rte;
+}
+
+/* SELECT * FROM <materialization table> WHERE time_partition_col < threshold */
+static Query *
+make_materialized_query(CaggRewriteInfo *info, Const *threshold)
+{
+	Query *query = make_select_query();
+	RangeTblEntry *rte = make_materialization_rte(info);
+	RangeTblRef *rtr = makeNode(RangeTblRef);
+	AttrNumber attno;
+
+	for (attno = 1; attno <= info->mat_desc->natts; attno++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(info->mat_desc, AttrNumberGetAttrOffset(attno));
+
+		query->targetList = lappend(query->targetList,
+									makeTargetEntry((Expr *) mat_var(info, 1, attno),
+													attno,
+													pstrdup(NameStr(attr->attname)),
+													false));
+	}
+
+	rtr->rtindex = 1;
+	query->rtable = list_make1(rte);
+	query->jointree = makeFromExpr(list_make1(rtr),
+								   make_time_qual(info->mat_relid,
+												  1,
+												  info->bucket_attno,
+												  BTLessStrategyNumber,
+												  threshold));
+
+	return query;
+}
+
+/* <partial view query> WHERE time >= threshold */
+static Query *
+make_raw_query(CaggRewriteInfo *info, Const *threshold)
+{
+	Query *query = info->partial_query;
+	RangeTblEntry *rte = rt_fetch(info->partial_rtindex, query->rtable);
+
+	AddQual(query,
+			make_time_qual(rte->relid,
+						   info->partial_rtindex,
+						   info->time_attno,
+						   BTGreaterEqualStrategyNumber,
+						   threshold));
+
+	return query;
+}
+
+/* The UNION ALL of materialized and not yet materialized partials */
+static Query *
+make_partials_query(CaggRewriteInfo *info, int64 completed_threshold)
+{
+	Query *query = make_select_query();
+	SetOperationStmt *setop = makeNode(SetOperationStmt);
+	RangeTblRef *larg = makeNode(RangeTblRef);
+	RangeTblRef *rarg = makeNode(RangeTblRef);
+	List *colnames = mat_column_names(info);
+	Const *threshold = make_time_const(exprType((Node *) info->bucket), completed_threshold);
+	Query *materialized = make_materialized_query(info, threshold);
+	Query *raw = make_raw_query(info, copyObject(threshold));
+	AttrNumber attno;
+
+	query->rtable = list_make2(make_subquery_rte(materialized, "materialized", colnames),
+							   make_subquery_rte(raw, "raw", colnames));
+	query->jointree = makeFromExpr(NIL, NULL);
+
+	larg->rtindex = 1;
+	rarg->rtindex = 2;
+	setop->op = SETOP_UNION;
+	setop->all = true;
+	setop->larg = (Node *) larg;
+	setop->rarg = (Node *) rarg;
+
+	for (attno = 1; attno <= info->mat_desc->natts; attno++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(info->mat_desc, AttrNumberGetAttrOffset(attno));
+
+		setop->colTypes = lappend_oid(setop->colTypes, attr->atttypid);
+		setop->colTypmods = lappend_int(setop->colTypmods, attr->atttypmod);
+		setop->colCollations = lappend_oid(setop->colCollations, attr->attcollation);
+		query->targetList = lappend(query->targetList,
+									makeTargetEntry((Expr *) mat_var(info, 1, attno),
+													attno,
+													pstrdup(NameStr(attr->attname)),
+													false));
+	}
+
+	query->setOperations = (Node *) setop;
+
+	return query;
+}
+
+/*
+ * Make the WHERE clause, target list and HAVING clause of the query reference
+ * the materialization table instead of the raw hypertable. Returns false if
+ * the query cannot be answered from the continuous aggregate.
+ */
+static bool
+cagg_rewrite_query_exprs(Query *query, CaggRewriteContext *ctx)
+{
+	ListCell *lc;
+
+	/*
+	 * The materialization only contains rows passing the continuous
+	 * aggregate's WHERE clause, so the query's WHERE clause must either be the
+	 * same or only reference columns we can get from the materialization.
+	 */
+	if (ctx->info->quals != NULL)
+	{
+		if (!equal(query->jointree->quals, ctx->info->quals))
+			return false;
+		query->jointree->quals = NULL;
+	}
+	else
+		query->jointree->quals = cagg_rewrite_mutator(query->jointree->quals, ctx);
+
+	foreach (lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst(lc);
+
+		tle->expr = (Expr *) cagg_rewrite_mutator((Node *) tle->expr, ctx);
+	}
+
+	query->havingQual = cagg_rewrite_mutator(query->havingQual, ctx);
+
+	return !ctx->failed;
+}
+
+/*
+ * Try to answer the query from the given continuous aggregate. Returns the
+ * rewritten query or NULL if the continuous aggregate does not match.
+ */
+static Query *
+cagg_rewrite(Query *parse, Hypertable *raw_ht, ContinuousAgg *cagg, Cache *hcache)
+{
+	int64 completed_threshold =
+		continuous_aggs_completed_threshold_get(cagg->data.mat_hypertable_id);
+	CaggRewriteInfo info;
+	CaggRewriteContext ctx = {
+		.info = &info,
+		.failed = false,
+	};
+	Query *rewritten;
+	Query *partials;
+	ListCell *lc;
+
+	/* nothing materialized yet, so reading the raw data is cheaper */
+	if (completed_threshold == PG_INT64_MIN)
+		return NULL;
+
+	if (!cagg_rewrite_info_init(&info, raw_ht, cagg, hcache))
+		return NULL;
+
+	rewritten = copyObject(parse);
+
+	if (!cagg_rewrite_query_exprs(rewritten, &ctx))
+		return NULL;
+
+	partials = make_partials_query(&info, completed_threshold);
+	rewritten->rtable =
+		list_make1(make_subquery_rte(partials, CAGG_REWRITE_ALIAS, mat_column_names(&info)));
+
+	return rewritten;
+}
+
+/*
+ * Rewrite the partial view query of a new continuous aggregate on raw_ht to
+ * compute its partials from the materialization of the continuous aggregate
+ * source, by combining the materialized partials of source instead of
+ * aggregating the raw rows:
+ *
+ *   SELECT time_bucket('1 day', time_partition_col), device,
+ *          combine_agg(..., agg_3_3, ...), chunk_id_from_relid(tableoid)
+ *   FROM <materialization table of source>
+ *   GROUP BY ...
+ *
+ * Returns NULL if the partials cannot be computed from source.
+ */
+Query *
+continuous_agg_rewrite_partial_query(Query *partial_query, Hypertable *raw_ht,
+									 ContinuousAgg *source)
+{
+	Oid partialize_argtype = ANYELEMENTOID;
+	Cache *hcache = ts_hypertable_cache_pin();
+	CaggRewriteInfo info;
+	CaggRewriteContext ctx = {
+		.info = &info,
+		.partialize_fnoid = LookupFuncName(list_make2(makeString(INTERNAL_SCHEMA_NAME),
+													  makeString(PARTIALIZE_FN_NAME)),
+										   1,
+										   &partialize_argtype,
+										   false),
+		.partialize_native_fnoid = LookupFuncName(list_make2(makeString(INTERNAL_SCHEMA_NAME),
+															 makeString(PARTIALIZE_NATIVE_FN_NAME)),
+												  1,
+												  &partialize_argtype,
+												  false),
+		.failed = false,
+	};
+	Query *rewritten = NULL;
+	RangeTblRef *rtr = makeNode(RangeTblRef);
+
+	if (!cagg_rewrite_info_init(&info, raw_ht, source, hcache))
+		goto done;
+
+	/* the partial view query only reads from the raw hypertable */
+	Assert(list_length(partial_query->rtable) == 1);
+
+	rewritten = copyObject(partial_query);
+
+	if (!cagg_rewrite_query_exprs(rewritten, &ctx))
+	{
+		rewritten = NULL;
+		goto done;
+	}
+
+	rtr->rtindex = 1;
+	rewritten->rtable = list_make1(make_materialization_rte(&info));
+	rewritten->jointree = makeFromExpr(list_make1(rtr), rewritten->jointree->quals);
+
+done:
+	ts_cache_release(hcache);
+	return rewritten;
+}
+
+static bool
+query_is_rewrite_candidate(Query *parse)
+{
+	RangeTblEntry *rte;
+
+	if (parse->commandType != CMD_SELECT || parse->utilityStmt != NULL || !parse->hasAggs ||
+		parse->groupClause == NIL || parse->groupingSets != NIL || parse->hasWindowFuncs ||
+		parse->hasTargetSRFs || parse->hasSubLinks || parse->hasForUpdate ||
+		parse->hasRowSecurity || parse->cteList != NIL || parse->setOperations != NULL ||
+		parse->rowMarks != NIL || list_length(parse->rtable) != 1 ||
+		list_length(parse->jointree->fromlist) != 1 ||
+		!IsA(linitial(parse->jointree->fromlist), RangeTblRef))
+		return false;
+
+	rte = linitial(parse->rtable);
+
+	/* the continuous aggregate covers the hypertable including all chunks */
+	if (rte->rtekind != RTE_RELATION || !rte->inh || rte->tablesample != NULL)
+		return false;
+
+	/*
+	 * The rewritten query reads columns the query might not reference, so we
+	 * need table level privileges and no row level security.
+	 */
+	return pg_class_aclcheck(rte->relid, GetUserId(), ACL_SELECT) == ACLCHECK_OK &&
+		   check_enable_rls(rte->relid, InvalidOid, true) != RLS_ENABLED;
+}
+
+/*
+ * Rewrite the query, and any subqueries in its range table, to read from
+ * continuous aggregates where possible. If several continuous aggregates
+ * match, the one with the widest buckets is used since it has the fewest
+ * rows to finalize.
+ */
+Query *
+continuous_agg_rewrite_query(Query *parse)
+{
+	Query *result = parse;
+	Cache *hcache;
+	Hypertable *ht;
+	ListCell *lc;
+
+	foreach (lc, parse->rtable)
+	{
+		RangeTblEntry *rte = lfirst(lc);
+
+		if (rte->rtekind == RTE_SUBQUERY)
+			rte->subquery = continuous_agg_rewrite_query(rte->subquery);
+	}
+
+	if (!query_is_rewrite_candidate(parse))
+		return parse;
+
+	hcache = ts_hypertable_cache_pin();
+	ht = ts_hypertable_cache_get_entry(hcache, ((RangeTblEntry *) linitial(parse->rtable))->relid);
+
+	if (ht != NULL && (ts_continuous_agg_hypertable_status(ht->fd.id) & HypertableIsRawTable))
+	{
+		List *caggs = ts_continuous_aggs_find_by_raw_table_id(ht->fd.id);
+		int64 best_width = 0;
+
+		foreach (lc, caggs)
+		{
+			ContinuousAgg *cagg = lfirst(lc);
+			Query *rewritten;
+
+			if (cagg->data.bucket_width <= best_width)
+				continue;
+
+			rewritten = cagg_rewrite(parse, ht, cagg, hcache);
+
+			if (rewritten != NULL)
+			{
+				result = rewritten;
+				best_width = cagg->data.bucket_width;
+			}
+		}
+	}
+
+	ts_cache_release(hcache);
+
+	return result;
+}
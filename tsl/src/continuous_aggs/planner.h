@@ -0,0 +1,19 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_TSL_CONTINUOUS_AGGS_PLANNER_H
+#define TIMESCALEDB_TSL_CONTINUOUS_AGGS_PLANNER_H
+
+#include <postgres.h>
+#include <nodes/parsenodes.h>
+
+#include "continuous_agg.h"
+#include "hypertable.h"
+
+Query *continuous_agg_rewrite_query(Query *parse);
+Query *continuous_agg_rewrite_partial_query(Query *partial_query, Hypertable *raw_ht,
+											ContinuousAgg *source);
+
+#endif /* TIMESCALEDB_TSL_CONTINUOUS_AGGS_PLANNER_H */
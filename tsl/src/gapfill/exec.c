@@ -10,6 +10,7 @@
 #include <access/htup_details.h>
 #include <catalog/pg_cast.h>
 #include <catalog/pg_type.h>
+#include <commands/explain.h>
 #include <nodes/extensible.h>
 #include <nodes/makefuncs.h>
 #include <nodes/nodeFuncs.h>
@@ -28,6 +29,7 @@
 #include "gapfill/gapfill.h"
 #include "gapfill/locf.h"
 #include "gapfill/interpolate.h"
+#include "gapfill/hash.h"
 #include "gapfill/exec.h"
 #include "time_bucket.h"
 
@@ -55,6 +57,7 @@ static void gapfill_begin(CustomScanState *node, EState *estate, int eflags);
 static void gapfill_end(CustomScanState *node);
 static void gapfill_rescan(CustomScanState *node);
 static TupleTableSlot *gapfill_exec(CustomScanState *node);
+static void gapfill_explain(CustomScanState *node, List *ancestors, ExplainState *es);
 
 static void gapfill_state_reset_group(GapFillState *state, TupleTableSlot *slot);
 static TupleTableSlot *gapfill_state_gaptuple_create(GapFillState *state, int64 time);
@@ -62,7 +65,6 @@ static bool gapfill_state_is_new_group(GapFillState *state, TupleTableSlot *slot
 static void gapfill_state_set_next(GapFillState *state, TupleTableSlot *subslot);
 static TupleTableSlot *gapfill_state_return_subplan_slot(GapFillState *state);
 static TupleTableSlot *gapfill_fetch_next_tuple(GapFillState *state);
-static TupleTableSlot *fetch_subplan_tuple(CustomScanState *node);
 static void gapfill_state_initialize_columns(GapFillState *state);
 static GapFillColumnState *gapfill_column_state_create(GapFillColumnType ctype, Oid typeid);
 static bool gapfill_is_group_column(GapFillState *state, TargetEntry *tle);
@@ -73,6 +75,7 @@ static CustomExecMethods gapfill_state_methods = {
 	.ExecCustomScan = gapfill_exec,
 	.EndCustomScan = gapfill_end,
 	.ReScanCustomScan = gapfill_rescan,
+	.ExplainCustomScan = gapfill_explain,
 };
 
 /*
@@ -510,6 +513,7 @@ gapfill_begin(CustomScanState *node, EState *estate, int eflags)
 	int i;
 
 	state->gapfill_typid = func->funcresulttype;
+	state->hashed = intVal(list_nth(cscan->custom_private, 4));
 	state->state = FETCHED_NONE;
 	state->subslot = NULL;
 	state->scanslot = MakeSingleTupleTableSlot(tupledesc);
@@ -579,6 +583,9 @@ gapfill_begin(CustomScanState *node, EState *estate, int eflags)
 
 	gapfill_state_initialize_columns(state);
 
+	if (state->hashed)
+		gapfill_hash_initialize(state);
+
 	/*
 	 * Build ProjectionInfo that will be used for gap filled tuples only.
 	 *
@@ -696,6 +703,11 @@ gapfill_exec(CustomScanState *node)
 static void
 gapfill_end(CustomScanState *node)
 {
+	GapFillState *state = (GapFillState *) node;
+
+	if (state->hashed)
+		gapfill_hash_reset(state);
+
 	if (node->custom_ps != NIL)
 	{
 		ExecEndNode(linitial(node->custom_ps));
@@ -705,15 +717,28 @@ gapfill_end(CustomScanState *node)
 static void
 gapfill_rescan(CustomScanState *node)
 {
+	GapFillState *state = (GapFillState *) node;
+
 #if PG96
 	node->ss.ps.ps_TupFromTlist = false;
 #endif
+	if (state->hashed)
+		gapfill_hash_reset(state);
 	if (node->custom_ps != NIL)
 	{
 		ExecReScan(linitial(node->custom_ps));
 	}
 }
 
+static void
+gapfill_explain(CustomScanState *node, List *ancestors, ExplainState *es)
+{
+	GapFillState *state = (GapFillState *) node;
+
+	if (state->hashed)
+		ExplainPropertyText("Strategy", "Hashed", es);
+}
+
 static void
 gapfill_state_reset_group(GapFillState *state, TupleTableSlot *slot)
 {
@@ -936,7 +961,8 @@ gapfill_fetch_next_tuple(GapFillState *state)
 {
 	Datum time_value;
 	bool isnull;
-	TupleTableSlot *subslot = fetch_subplan_tuple((CustomScanState *) state);
+	TupleTableSlot *subslot = state->hashed ? gapfill_hash_next_tuple(state) :
+											  gapfill_fetch_subplan_tuple(&state->csstate);
 
 	if (!subslot)
 		return NULL;
@@ -956,8 +982,8 @@ gapfill_fetch_next_tuple(GapFillState *state)
 /*
  * Fetch tuple from subplan
  */
-static TupleTableSlot *
-fetch_subplan_tuple(CustomScanState *node)
+TupleTableSlot *
+gapfill_fetch_subplan_tuple(CustomScanState *node)
 {
 	TupleTableSlot *subslot;
 	ExprContext *econtext = node->ss.ps.ps_ExprContext;
@@ -1178,7 +1204,17 @@ gapfill_aggref_mutator(Node *node, void *context)
 Datum
 gapfill_exec_expr(GapFillState *state, Expr *expr, bool *isnull)
 {
-	ExprState *exprstate = ExecInitExpr(expr, &state->csstate.ss.ps);
+	return gapfill_exec_exprstate(state, ExecInitExpr(expr, &state->csstate.ss.ps), isnull);
+}
+
+/*
+ * Execute an expression prepared with ExecInitExpr, this is used for
+ * expressions evaluated once per group so they are not initialized again
+ * for every evaluation
+ */
+Datum
+gapfill_exec_exprstate(GapFillState *state, ExprState *exprstate, bool *isnull)
+{
 	ExprContext *exprcontext = GetPerTupleExprContext(state->csstate.ss.ps.state);
 
 	exprcontext->ecxt_scantuple = state->scanslot;
@@ -111,11 +111,16 @@ typedef struct GapFillState
 	ProjectionInfo *pi;
 	TupleTableSlot *scanslot;
 	GapFillFetchState state;
+
+	bool hashed; /* subplan tuples are gathered per group instead of being sorted */
+	struct GapFillHashState *hash;
 } GapFillState;
 
 Node *gapfill_state_create(CustomScan *);
 Expr *gapfill_adjust_varnos(GapFillState *state, Expr *expr);
 Datum gapfill_exec_expr(GapFillState *state, Expr *expr, bool *isnull);
+Datum gapfill_exec_exprstate(GapFillState *state, ExprState *exprstate, bool *isnull);
 int64 gapfill_datum_get_internal(Datum, Oid);
+TupleTableSlot *gapfill_fetch_subplan_tuple(CustomScanState *node);
 
 #endif /* TIMESCALEDB_GAPFILL_EXEC_H */
@@ -0,0 +1,385 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+
+#include <postgres.h>
+#include <access/hash.h>
+#include <access/htup_details.h>
+#include <executor/executor.h>
+#include <miscadmin.h>
+#include <utils/datum.h>
+#include <utils/memutils.h>
+
+#include "gapfill/hash.h"
+#include "gapfill/exec.h"
+
+#define GAPFILL_HASH_INITIAL_GROUPS 64
+#define GAPFILL_HASH_INITIAL_TUPLES 16
+
+typedef struct GapFillHashTuple
+{
+	int64 time;
+	MinimalTuple tuple;
+} GapFillHashTuple;
+
+struct GapFillHashGroup
+{
+	GapFillHashGroup *next; /* next group with the same hash */
+	Datum *values;			/* group column values, indexed like the gapfill columns */
+	bool *isnull;
+	GapFillHashTuple *tuples;
+	int ntuples;
+	int maxtuples;
+};
+
+typedef struct GapFillHashEntry
+{
+	uint32 hash; /* hash key, must be first */
+	GapFillHashGroup *groups;
+} GapFillHashEntry;
+
+/*
+ * gapfill_hash_initialize gets called when the plan is initialized with the hashed strategy
+ */
+void
+gapfill_hash_initialize(GapFillState *state)
+{
+	GapFillHashState *hash = palloc0(sizeof(GapFillHashState));
+
+	hash->context =
+		AllocSetContextCreate(CurrentMemoryContext, "GapFill hash", ALLOCSET_DEFAULT_SIZES);
+	state->hash = hash;
+}
+
+/*
+ * Groups are told apart with datumIsEqual like in the sorted strategy, so the
+ * binary representation of the group columns is hashed.
+ */
+static uint32
+gapfill_hash_group_hash(GapFillState *state, TupleTableSlot *slot)
+{
+	uint32 hashkey = 0;
+	Datum value;
+	bool isnull;
+	int i;
+
+	for (i = 0; i < state->ncolumns; i++)
+	{
+		GapFillColumnState *column = state->columns[i];
+
+		if (column->ctype != GROUP_COLUMN)
+			continue;
+
+		/* rotate hashkey left 1 bit at each step */
+		hashkey = (hashkey << 1) | ((hashkey & 0x80000000) ? 1 : 0);
+
+		value = slot_getattr(slot, AttrOffsetGetAttrNumber(i), &isnull);
+		if (isnull)
+			continue;
+
+		if (column->typbyval)
+			hashkey ^= DatumGetUInt32(hash_any((unsigned char *) &value, sizeof(Datum)));
+		else
+			hashkey ^= DatumGetUInt32(hash_any((unsigned char *) DatumGetPointer(value),
+											   datumGetSize(value, false, column->typlen)));
+	}
+
+	return hashkey;
+}
+
+static bool
+gapfill_hash_group_matches(GapFillState *state, GapFillHashGroup *group, TupleTableSlot *slot)
+{
+	Datum value;
+	bool isnull;
+	int i;
+
+	for (i = 0; i < state->ncolumns; i++)
+	{
+		GapFillColumnState *column = state->columns[i];
+
+		if (column->ctype != GROUP_COLUMN)
+			continue;
+
+		value = slot_getattr(slot, AttrOffsetGetAttrNumber(i), &isnull);
+		if (isnull != group->isnull[i])
+			return false;
+		if (!isnull && !datumIsEqual(value, group->values[i], column->typbyval, column->typlen))
+			return false;
+	}
+
+	return true;
+}
+
+static GapFillHashGroup *
+gapfill_hash_group_create(GapFillState *state, TupleTableSlot *slot)
+{
+	GapFillHashState *hash = state->hash;
+	GapFillHashGroup *group = palloc0(sizeof(GapFillHashGroup));
+	Datum value;
+	bool isnull;
+	int i;
+
+	group->values = palloc0(state->ncolumns * sizeof(Datum));
+	group->isnull = palloc0(state->ncolumns * sizeof(bool));
+	group->maxtuples = GAPFILL_HASH_INITIAL_TUPLES;
+	group->tuples = palloc(group->maxtuples * sizeof(GapFillHashTuple));
+	hash->memory += sizeof(GapFillHashGroup) + state->ncolumns * (sizeof(Datum) + sizeof(bool)) +
+					group->maxtuples * sizeof(GapFillHashTuple);
+
+	for (i = 0; i < state->ncolumns; i++)
+	{
+		GapFillColumnState *column = state->columns[i];
+
+		if (column->ctype != GROUP_COLUMN)
+			continue;
+
+		value = slot_getattr(slot, AttrOffsetGetAttrNumber(i), &isnull);
+		group->isnull[i] = isnull;
+		if (!isnull)
+		{
+			group->values[i] = datumCopy(value, column->typbyval, column->typlen);
+			if (!column->typbyval)
+				hash->memory += GetMemoryChunkSpace(DatumGetPointer(group->values[i]));
+		}
+	}
+
+	if (hash->ngroups == hash->maxgroups)
+	{
+		hash->maxgroups *= 2;
+		hash->groups = repalloc(hash->groups, hash->maxgroups * sizeof(GapFillHashGroup *));
+	}
+	hash->groups[hash->ngroups++] = group;
+
+	return group;
+}
+
+static void
+gapfill_hash_spill(GapFillState *state, TupleTableSlot *slot)
+{
+	GapFillHashState *hash = state->hash;
+
+	if (hash->spill == NULL)
+	{
+		MemoryContext old = MemoryContextSwitchTo(state->csstate.ss.ps.state->es_query_cxt);
+
+		hash->spill = tuplestore_begin_heap(false, false, work_mem);
+		MemoryContextSwitchTo(old);
+	}
+
+	tuplestore_puttupleslot(hash->spill, slot);
+}
+
+static void
+gapfill_hash_add_tuple(GapFillState *state, TupleTableSlot *slot)
+{
+	GapFillHashState *hash = state->hash;
+	uint32 hashkey = gapfill_hash_group_hash(state, slot);
+	GapFillHashEntry *entry = hash_search(hash->htab, &hashkey, HASH_FIND, NULL);
+	GapFillHashGroup *group = NULL;
+	GapFillHashTuple *tuple;
+	MemoryContext old;
+	Datum time_value;
+	bool isnull;
+	bool found;
+
+	if (entry != NULL)
+	{
+		for (group = entry->groups; group != NULL; group = group->next)
+		{
+			if (gapfill_hash_group_matches(state, group, slot))
+				break;
+		}
+	}
+
+	if (group == NULL)
+	{
+		/*
+		 * Once the groups use up work_mem the tuples of new groups are deferred
+		 * to the next pass. Tuples of groups already in memory are always added,
+		 * so every group is complete when it is returned.
+		 */
+		if (hash->ngroups > 0 && hash->memory > work_mem * 1024L)
+		{
+			gapfill_hash_spill(state, slot);
+			return;
+		}
+
+		old = MemoryContextSwitchTo(hash->context);
+		if (entry == NULL)
+		{
+			entry = hash_search(hash->htab, &hashkey, HASH_ENTER, &found);
+			entry->groups = NULL;
+		}
+		group = gapfill_hash_group_create(state, slot);
+		group->next = entry->groups;
+		entry->groups = group;
+		MemoryContextSwitchTo(old);
+	}
+
+	time_value = slot_getattr(slot, AttrOffsetGetAttrNumber(state->time_index), &isnull);
+	if (isnull)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid time_bucket_gapfill argument: ts cannot be NULL")));
+
+	if (group->ntuples == group->maxtuples)
+	{
+		hash->memory += group->maxtuples * sizeof(GapFillHashTuple);
+		group->maxtuples *= 2;
+		group->tuples = repalloc(group->tuples, group->maxtuples * sizeof(GapFillHashTuple));
+	}
+
+	old = MemoryContextSwitchTo(hash->context);
+	tuple = &group->tuples[group->ntuples++];
+	tuple->time = gapfill_datum_get_internal(time_value, state->gapfill_typid);
+	tuple->tuple = ExecCopySlotMinimalTuple(slot);
+	hash->memory += GetMemoryChunkSpace(tuple->tuple);
+	MemoryContextSwitchTo(old);
+}
+
+/*
+ * Gather the tuples of a pass, which reads the subplan in the first pass and
+ * the tuples deferred by the previous pass afterwards.
+ */
+static void
+gapfill_hash_build(GapFillState *state)
+{
+	GapFillHashState *hash = state->hash;
+	Tuplestorestate *input = hash->spill;
+	TupleTableSlot *slot;
+	HASHCTL ctl;
+
+	if (hash->slot != NULL)
+		ExecClearTuple(hash->slot);
+	MemoryContextReset(hash->context);
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(uint32);
+	ctl.entrysize = sizeof(GapFillHashEntry);
+	ctl.hcxt = hash->context;
+	hash->htab = hash_create("GapFill groups",
+							 GAPFILL_HASH_INITIAL_GROUPS,
+							 &ctl,
+							 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	hash->maxgroups = GAPFILL_HASH_INITIAL_GROUPS;
+	hash->groups =
+		MemoryContextAlloc(hash->context, hash->maxgroups * sizeof(GapFillHashGroup *));
+	hash->ngroups = 0;
+	hash->memory = 0;
+	hash->next_group = 0;
+	hash->next_tuple = 0;
+	hash->spill = NULL;
+
+	while (true)
+	{
+		if (input == NULL)
+			slot = gapfill_fetch_subplan_tuple(&state->csstate);
+		else if (tuplestore_gettupleslot(input, true, false, hash->spillslot))
+			slot = hash->spillslot;
+		else
+			slot = NULL;
+
+		if (slot == NULL)
+			break;
+
+		if (hash->slot == NULL)
+		{
+			MemoryContext old = MemoryContextSwitchTo(state->csstate.ss.ps.state->es_query_cxt);
+
+			hash->slot = MakeSingleTupleTableSlot(slot->tts_tupleDescriptor);
+			hash->spillslot = MakeSingleTupleTableSlot(slot->tts_tupleDescriptor);
+			MemoryContextSwitchTo(old);
+		}
+
+		gapfill_hash_add_tuple(state, slot);
+	}
+
+	if (input != NULL)
+		tuplestore_end(input);
+
+	hash->built = true;
+}
+
+static int
+gapfill_hash_tuple_cmp(const void *a, const void *b)
+{
+	int64 time_a = ((const GapFillHashTuple *) a)->time;
+	int64 time_b = ((const GapFillHashTuple *) b)->time;
+
+	if (time_a < time_b)
+		return -1;
+	if (time_a > time_b)
+		return 1;
+	return 0;
+}
+
+/*
+ * gapfill_hash_next_tuple returns the tuples in the order of a sorted subplan,
+ * with all tuples of a group together and ordered by time
+ */
+TupleTableSlot *
+gapfill_hash_next_tuple(GapFillState *state)
+{
+	GapFillHashState *hash = state->hash;
+	GapFillHashGroup *group;
+
+	while (true)
+	{
+		if (!hash->built)
+			gapfill_hash_build(state);
+
+		if (hash->next_group >= hash->ngroups)
+		{
+			/* all groups of this pass are done, continue with the deferred tuples */
+			if (hash->spill == NULL)
+				return NULL;
+
+			hash->built = false;
+			continue;
+		}
+
+		group = hash->groups[hash->next_group];
+
+		if (hash->next_tuple == 0)
+			qsort(group->tuples, group->ntuples, sizeof(GapFillHashTuple), gapfill_hash_tuple_cmp);
+
+		if (hash->next_tuple < group->ntuples)
+			return ExecStoreMinimalTuple(group->tuples[hash->next_tuple++].tuple,
+										 hash->slot,
+										 false);
+
+		hash->next_group++;
+		hash->next_tuple = 0;
+	}
+}
+
+/*
+ * gapfill_hash_reset gets called on rescan and when the node is shut down
+ */
+void
+gapfill_hash_reset(GapFillState *state)
+{
+	GapFillHashState *hash = state->hash;
+
+	if (hash->spill != NULL)
+	{
+		tuplestore_end(hash->spill);
+		hash->spill = NULL;
+	}
+
+	if (hash->slot != NULL)
+		ExecClearTuple(hash->slot);
+
+	MemoryContextReset(hash->context);
+	hash->htab = NULL;
+	hash->groups = NULL;
+	hash->ngroups = 0;
+	hash->maxgroups = 0;
+	hash->next_group = 0;
+	hash->next_tuple = 0;
+	hash->built = false;
+}
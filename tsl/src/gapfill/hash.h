@@ -0,0 +1,48 @@
+/*
+ * This file and its contents are licensed under the Timescale License.
+ * Please see the included NOTICE for copyright information and
+ * LICENSE-TIMESCALE for a copy of the license.
+ */
+#ifndef TIMESCALEDB_GAPFILL_HASH_H
+#define TIMESCALEDB_GAPFILL_HASH_H
+
+#include <postgres.h>
+#include <executor/tuptable.h>
+#include <utils/hsearch.h>
+#include <utils/tuplestore.h>
+
+#include "gapfill/exec.h"
+
+typedef struct GapFillHashGroup GapFillHashGroup;
+
+/*
+ * State of the hashed gapfill strategy.
+ *
+ * The tuples of the subplan are gathered per group, identified by the GROUP BY
+ * columns besides the time column, so the subplan does not need to sort them.
+ * Once the input is exhausted the groups are returned one after the other, each
+ * with its tuples ordered by time, which is the order the gapfill state machine
+ * expects. Tuples of new groups that do not fit into work_mem anymore are written
+ * to a tuplestore and gathered in another pass.
+ */
+typedef struct GapFillHashState
+{
+	MemoryContext context;	 /* groups and tuples of the current pass */
+	HTAB *htab;				   /* groups by the hash of their group columns */
+	GapFillHashGroup **groups; /* groups in the order they were first seen */
+	int ngroups;
+	int maxgroups;
+	Size memory; /* memory used by the groups of the current pass */
+	bool built;
+	int next_group;
+	int next_tuple;
+	Tuplestorestate *spill;	/* tuples deferred to the next pass */
+	TupleTableSlot *slot;	  /* slot for the returned tuples */
+	TupleTableSlot *spillslot; /* slot for the tuples read back from spill */
+} GapFillHashState;
+
+void gapfill_hash_initialize(GapFillState *state);
+TupleTableSlot *gapfill_hash_next_tuple(GapFillState *state);
+void gapfill_hash_reset(GapFillState *state);
+
+#endif /* TIMESCALEDB_GAPFILL_HASH_H */
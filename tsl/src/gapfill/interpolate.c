@@ -7,6 +7,7 @@
 #include <postgres.h>
 #include <access/htup_details.h>
 #include <catalog/pg_type.h>
+#include <executor/executor.h>
 #include <utils/builtins.h>
 #include <utils/datum.h>
 #include <utils/typcache.h>
@@ -27,11 +28,13 @@ gapfill_interpolate_initialize(GapFillInterpolateColumnState *interpolate, GapFi
 	interpolate->prev.isnull = true;
 	interpolate->next.isnull = true;
 	if (list_length(((FuncExpr *) function)->args) > 1)
-		interpolate->lookup_before =
-			gapfill_adjust_varnos(state, lsecond(((FuncExpr *) function)->args));
+		interpolate->lookup_before.exprstate =
+			ExecInitExpr(gapfill_adjust_varnos(state, lsecond(((FuncExpr *) function)->args)),
+						 &state->csstate.ss.ps);
 	if (list_length(((FuncExpr *) function)->args) > 2)
-		interpolate->lookup_after =
-			gapfill_adjust_varnos(state, lthird(((FuncExpr *) function)->args));
+		interpolate->lookup_after.exprstate =
+			ExecInitExpr(gapfill_adjust_varnos(state, lthird(((FuncExpr *) function)->args)),
+						 &state->csstate.ss.ps);
 }
 
 /*
@@ -86,14 +89,13 @@ gapfill_interpolate_tuple_returned(GapFillInterpolateColumnState *column, int64
  */
 static void
 gapfill_fetch_sample(GapFillState *state, GapFillInterpolateColumnState *column,
-					 GapFillInterpolateSample *sample, Expr *lookup)
+					 GapFillInterpolateSample *sample, GapFillInterpolateLookup *lookup)
 {
 	HeapTupleHeader th;
 	HeapTupleData tuple;
-	TupleDesc tupdesc;
 	Datum value;
 	bool isnull;
-	Datum datum = gapfill_exec_expr(state, lookup, &isnull);
+	Datum datum = gapfill_exec_exprstate(state, lookup->exprstate, &isnull);
 
 	if (isnull)
 	{
@@ -107,9 +109,36 @@ gapfill_fetch_sample(GapFillState *state, GapFillInterpolateColumnState *column,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("interpolate RECORD arguments must have 2 elements")));
 
-	/* Extract type information from the tuple itself */
+	/*
+	 * Extract type information from the tuple itself, the lookup usually
+	 * returns the same row type for every group so the type checks are only
+	 * done when it changes
+	 */
 	Assert(RECORDOID == HeapTupleHeaderGetTypeId(th));
-	tupdesc = lookup_rowtype_tupdesc(HeapTupleHeaderGetTypeId(th), HeapTupleHeaderGetTypMod(th));
+	if (lookup->tupdesc == NULL || lookup->tupdesc->tdtypeid != HeapTupleHeaderGetTypeId(th) ||
+		lookup->tupdesc->tdtypmod != HeapTupleHeaderGetTypMod(th))
+	{
+		TupleDesc tupdesc = lookup_rowtype_tupdesc_copy(HeapTupleHeaderGetTypeId(th),
+														HeapTupleHeaderGetTypMod(th));
+
+		/* check first element in record matches timestamp datatype */
+		if (TupleDescAttr(tupdesc, 0)->atttypid != state->columns[state->time_index]->typid)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("first argument of interpolate returned record must match used "
+							"timestamp datatype")));
+
+		/* check second element in record matches interpolate datatype */
+		if (TupleDescAttr(tupdesc, 1)->atttypid != column->base.typid)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("second argument of interpolate returned record must match used "
+							"interpolate datatype")));
+
+		if (lookup->tupdesc != NULL)
+			FreeTupleDesc(lookup->tupdesc);
+		lookup->tupdesc = tupdesc;
+	}
 
 	/* Build a temporary HeapTuple control structure */
 	tuple.t_len = HeapTupleHeaderGetDatumLength(th);
@@ -117,31 +146,15 @@ gapfill_fetch_sample(GapFillState *state, GapFillInterpolateColumnState *column,
 	tuple.t_tableOid = InvalidOid;
 	tuple.t_data = th;
 
-	/* check first element in record matches timestamp datatype */
-	if (TupleDescAttr(tupdesc, 0)->atttypid != state->columns[state->time_index]->typid)
-		ereport(ERROR,
-				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-				 errmsg("first argument of interpolate returned record must match used timestamp "
-						"datatype")));
-
-	/* check second element in record matches interpolate datatype */
-	if (TupleDescAttr(tupdesc, 1)->atttypid != column->base.typid)
-		ereport(ERROR,
-				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-				 errmsg("second argument of interpolate returned record must match used "
-						"interpolate datatype")));
-
-	value = heap_getattr(&tuple, 1, tupdesc, &sample->isnull);
+	value = heap_getattr(&tuple, 1, lookup->tupdesc, &sample->isnull);
 	if (!sample->isnull)
 	{
 		sample->time = gapfill_datum_get_internal(value, state->gapfill_typid);
 
-		value = heap_getattr(&tuple, 2, tupdesc, &sample->isnull);
+		value = heap_getattr(&tuple, 2, lookup->tupdesc, &sample->isnull);
 		if (!sample->isnull)
 			sample->value = datumCopy(value, column->base.typbyval, column->base.typlen);
 	}
-
-	DecrTupleDescRefCount(tupdesc);
 }
 
 /*
@@ -158,12 +171,12 @@ gapfill_interpolate_calculate(GapFillInterpolateColumnState *column, GapFillStat
 	Datum y0, y1;
 
 	/* only evaluate expr for first tuple */
-	if (column->prev.isnull && column->lookup_before && time == state->gapfill_start)
-		gapfill_fetch_sample(state, column, &column->prev, column->lookup_before);
+	if (column->prev.isnull && column->lookup_before.exprstate && time == state->gapfill_start)
+		gapfill_fetch_sample(state, column, &column->prev, &column->lookup_before);
 
-	if (column->next.isnull && column->lookup_after &&
+	if (column->next.isnull && column->lookup_after.exprstate &&
 		(FETCHED_LAST == state->state || FETCHED_NEXT_GROUP == state->state))
-		gapfill_fetch_sample(state, column, &column->next, column->lookup_after);
+		gapfill_fetch_sample(state, column, &column->next, &column->lookup_after);
 
 	*isnull = column->prev.isnull || column->next.isnull;
 	if (*isnull)
@@ -15,11 +15,21 @@ typedef struct GapFillInterpolateSample
 	bool isnull;
 } GapFillInterpolateSample;
 
+/*
+ * Out of bounds lookup for interpolate. The expression is prepared once and
+ * the row type of its result is only checked when it changes.
+ */
+typedef struct GapFillInterpolateLookup
+{
+	ExprState *exprstate;
+	TupleDesc tupdesc; /* row type of the last checked result */
+} GapFillInterpolateLookup;
+
 typedef struct GapFillInterpolateColumnState
 {
 	GapFillColumnState base;
-	Expr *lookup_before;
-	Expr *lookup_after;
+	GapFillInterpolateLookup lookup_before;
+	GapFillInterpolateLookup lookup_after;
 	GapFillInterpolateSample prev;
 	GapFillInterpolateSample next;
 } GapFillInterpolateColumnState;
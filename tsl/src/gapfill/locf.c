@@ -6,6 +6,7 @@
 
 #include <postgres.h>
 #include <catalog/pg_type.h>
+#include <executor/executor.h>
 #include <utils/datum.h>
 
 #include "gapfill/exec.h"
@@ -21,7 +22,9 @@ gapfill_locf_initialize(GapFillLocfColumnState *locf, GapFillState *state, FuncE
 
 	/* check if out of boundary lookup expression was supplied */
 	if (list_length(function->args) > 1)
-		locf->lookup_last = gapfill_adjust_varnos(state, lsecond(function->args));
+		locf->lookup_last =
+			ExecInitExpr(gapfill_adjust_varnos(state, lsecond(function->args)),
+						 &state->csstate.ss.ps);
 
 	/* check if treat_null_as_missing was supplied */
 	if (list_length(function->args) > 2)
@@ -66,7 +69,12 @@ gapfill_locf_calculate(GapFillLocfColumnState *locf, GapFillState *state, int64
 {
 	/* only evaluate expr for first tuple */
 	if (locf->isnull && locf->lookup_last && time == state->gapfill_start)
-		locf->value = gapfill_exec_expr(state, locf->lookup_last, &locf->isnull);
+	{
+		Datum lookup = gapfill_exec_exprstate(state, locf->lookup_last, &locf->isnull);
+
+		if (!locf->isnull)
+			locf->value = datumCopy(lookup, locf->base.typbyval, locf->base.typlen);
+	}
 
 	*value = locf->value;
 	*isnull = locf->isnull;
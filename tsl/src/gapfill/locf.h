@@ -15,7 +15,7 @@
 typedef struct GapFillLocfColumnState
 {
 	GapFillColumnState base;
-	Expr *lookup_last;
+	ExprState *lookup_last;
 	Datum value;
 	bool isnull;
 	bool treat_null_as_missing;
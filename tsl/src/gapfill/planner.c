@@ -5,19 +5,27 @@
  */
 
 #include <postgres.h>
+#include <access/htup_details.h>
+#include <access/stratnum.h>
+#include <catalog/pg_type.h>
+#include <miscadmin.h>
 #include <nodes/execnodes.h>
 #include <nodes/extensible.h>
 #include <nodes/nodeFuncs.h>
 #include <optimizer/clauses.h>
+#include <optimizer/cost.h>
 #include <optimizer/pathnode.h>
 #include <optimizer/paths.h>
 #include <optimizer/planner.h>
 #include <optimizer/tlist.h>
 #include <optimizer/var.h>
 #include <utils/lsyscache.h>
+#include <utils/typcache.h>
 #include <parser/parse_func.h>
+#include <rewrite/rewriteManip.h>
 
 #include "license.h"
+#include "guc.h"
 #include "gapfill/gapfill.h"
 #include "gapfill/planner.h"
 #include "gapfill/exec.h"
@@ -177,6 +185,7 @@ gapfill_plan_create(PlannerInfo *root, RelOptInfo *rel, struct CustomPath *path,
 
 	cscan->custom_private =
 		list_make4(gfpath->func, root->parse->groupClause, root->parse->jointree, args);
+	cscan->custom_private = lappend(cscan->custom_private, makeInteger(gfpath->hashed));
 
 	/* remove start and end argument from time_bucket call */
 	gfpath->func->args = list_make2(linitial(gfpath->func->args), lsecond(gfpath->func->args));
@@ -310,15 +319,40 @@ gapfill_build_pathtarget(PathTarget *pt_upper, PathTarget *pt_path, PathTarget *
 	}
 }
 
+/*
+ * The hashed gapfill node reads all its input before returning the first
+ * tuple. Every tuple is hashed by its group columns and copied, and the
+ * tuples that do not fit into work_mem are written to disk and read back.
+ * The tuples of a group are sorted by time, but groups are usually small
+ * compared to the input, so that is not costed.
+ */
+static void
+gapfill_hashed_cost(PlannerInfo *root, GapFillPath *path, Path *subpath)
+{
+	double tuples = subpath->rows;
+	int ngroupcols = list_length(root->parse->groupClause) - 1;
+	double bytes = tuples * (MAXALIGN(subpath->pathtarget->width) +
+							 MAXALIGN(SizeofMinimalTupleHeader) + 2 * sizeof(void *));
+	Cost run_cost = (cpu_operator_cost * ngroupcols + cpu_tuple_cost) * tuples;
+
+	if (bytes > work_mem * 1024L)
+		run_cost += 2 * seq_page_cost * (bytes - work_mem * 1024L) / BLCKSZ;
+
+	path->cpath.path.startup_cost = subpath->total_cost + run_cost;
+	path->cpath.path.total_cost = path->cpath.path.startup_cost + cpu_tuple_cost * tuples;
+	path->cpath.path.pathkeys = NIL;
+}
+
 /*
  * Create a Gapfill Path node.
  *
  * The gap fill node needs rows to be sorted by time ASC
  * so we insert sort pathes if the query order does not match
- * that
+ * that, unless the node gathers the rows per group itself
+ * with the hashed strategy
  */
 static Path *
-gapfill_path_create(PlannerInfo *root, Path *subpath, FuncExpr *func)
+gapfill_path_create(PlannerInfo *root, Path *subpath, FuncExpr *func, bool hashed)
 {
 	GapFillPath *path;
 
@@ -343,7 +377,7 @@ gapfill_path_create(PlannerInfo *root, Path *subpath, FuncExpr *func)
 							 path->cpath.path.pathtarget,
 							 subpath->pathtarget);
 
-	if (!gapfill_correct_order(root, subpath, func))
+	if (!hashed && !gapfill_correct_order(root, subpath, func))
 	{
 		List *new_order = NIL;
 		ListCell *lc;
@@ -385,6 +419,10 @@ gapfill_path_create(PlannerInfo *root, Path *subpath, FuncExpr *func)
 	path->cpath.path.pathkeys = subpath->pathkeys;
 	path->cpath.custom_paths = list_make1(subpath);
 	path->func = func;
+	path->hashed = hashed;
+
+	if (hashed)
+		gapfill_hashed_cost(root, path, subpath);
 
 	return &path->cpath.path;
 }
@@ -446,7 +484,18 @@ plan_add_gapfill(PlannerInfo *root, RelOptInfo *group_rel)
 
 		foreach (lc, copy)
 		{
-			add_path(group_rel, gapfill_path_create(root, lfirst(lc), context.call.func));
+			Path *subpath = lfirst(lc);
+
+			add_path(group_rel, gapfill_path_create(root, subpath, context.call.func, false));
+
+			/*
+			 * gathering the rows per group can only be cheaper than sorting
+			 * them when there are groups besides the time bucket and the
+			 * subpath is not sorted already
+			 */
+			if (ts_guc_enable_gapfill_hash && list_length(parse->groupClause) > 1 &&
+				!gapfill_correct_order(root, subpath, context.call.func))
+				add_path(group_rel, gapfill_path_create(root, subpath, context.call.func, true));
 		}
 		list_free(copy);
 	}
@@ -569,3 +618,173 @@ gapfill_adjust_window_targetlist(PlannerInfo *root, RelOptInfo *input_rel, RelOp
 		}
 	}
 }
+
+/*
+ * The bound can be used as restriction if it can be evaluated before the scan
+ */
+static bool
+gapfill_is_restriction_bound(Node *bound, Oid typid)
+{
+	return bound != NULL && !(IsA(bound, Const) && castNode(Const, bound)->constisnull) &&
+		   exprType(bound) == typid && !contain_var_clause(bound) &&
+		   !contain_volatile_functions(bound) && !contain_agg_clause(bound) &&
+		   !contain_window_function(bound) && !checkExprHasSubLink(bound);
+}
+
+/*
+ * A restriction in the WHERE clause only applies to the relation of the time
+ * column if the relation is not on the nullable side of an outer join
+ */
+static bool
+gapfill_is_restrictable_rel(Node *jtnode, Index varno)
+{
+	ListCell *lc;
+
+	if (jtnode == NULL)
+		return false;
+
+	if (IsA(jtnode, RangeTblRef))
+		return castNode(RangeTblRef, jtnode)->rtindex == (int) varno;
+
+	if (IsA(jtnode, FromExpr))
+	{
+		foreach (lc, castNode(FromExpr, jtnode)->fromlist)
+		{
+			if (gapfill_is_restrictable_rel(lfirst(lc), varno))
+				return true;
+		}
+		return false;
+	}
+
+	if (IsA(jtnode, JoinExpr))
+	{
+		JoinExpr *join = castNode(JoinExpr, jtnode);
+
+		switch (join->jointype)
+		{
+			case JOIN_INNER:
+				return gapfill_is_restrictable_rel(join->larg, varno) ||
+					   gapfill_is_restrictable_rel(join->rarg, varno);
+			case JOIN_LEFT:
+				return gapfill_is_restrictable_rel(join->larg, varno);
+			case JOIN_RIGHT:
+				return gapfill_is_restrictable_rel(join->rarg, varno);
+			default:
+				return false;
+		}
+	}
+
+	return false;
+}
+
+static void
+gapfill_add_restriction(Query *query, Var *var, Node *bound, int16 strategy)
+{
+	TypeCacheEntry *tce = lookup_type_cache(var->vartype, TYPECACHE_BTREE_OPFAMILY);
+	Oid opno;
+	Expr *qual;
+
+	if (!OidIsValid(tce->btree_opf))
+		return;
+
+	opno = get_opfamily_member(tce->btree_opf, var->vartype, var->vartype, strategy);
+	if (!OidIsValid(opno))
+		return;
+
+	qual = make_opclause(opno,
+						 BOOLOID,
+						 false,
+						 copyObject(var),
+						 copyObject(bound),
+						 InvalidOid,
+						 InvalidOid);
+	query->jointree->quals = make_and_qual(query->jointree->quals, (Node *) qual);
+}
+
+static void
+gapfill_restrict_query_level(Query *query)
+{
+	gapfill_walker_context context = { .call.node = NULL, .count = 0 };
+	Node *ts = NULL;
+	Node *start = NULL;
+	Node *finish = NULL;
+	ListCell *lc;
+	int argno = 0;
+	Var *var;
+
+	if (CMD_SELECT != query->commandType || query->groupClause == NIL || query->jointree == NULL)
+		return;
+
+	gapfill_function_walker((Node *) query->targetList, &context);
+
+	/* multiple calls are rejected later on by the planner */
+	if (context.count != 1)
+		return;
+
+	/* default arguments are not expanded yet and arguments may be named */
+	foreach (lc, context.call.func->args)
+	{
+		Node *arg = lfirst(lc);
+		int position = argno++;
+
+		if (IsA(arg, NamedArgExpr))
+		{
+			position = castNode(NamedArgExpr, arg)->argnumber;
+			arg = (Node *) castNode(NamedArgExpr, arg)->arg;
+		}
+
+		switch (position)
+		{
+			case 1:
+				ts = arg;
+				break;
+			case 2:
+				start = arg;
+				break;
+			case 3:
+				finish = arg;
+				break;
+		}
+	}
+
+	if (ts == NULL || !IsA(ts, Var))
+		return;
+
+	var = castNode(Var, ts);
+	if (var->varlevelsup != 0 ||
+		!gapfill_is_restrictable_rel((Node *) query->jointree, var->varno))
+		return;
+
+	if (gapfill_is_restriction_bound(start, var->vartype))
+		gapfill_add_restriction(query, var, start, BTGreaterEqualStrategyNumber);
+
+	if (gapfill_is_restriction_bound(finish, var->vartype))
+		gapfill_add_restriction(query, var, finish, BTLessStrategyNumber);
+}
+
+static bool
+gapfill_restrict_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, Query))
+	{
+		gapfill_restrict_query_level(castNode(Query, node));
+		return query_tree_walker(castNode(Query, node), gapfill_restrict_walker, context, 0);
+	}
+
+	return expression_tree_walker(node, gapfill_restrict_walker, context);
+}
+
+/*
+ * Add the explicit start and finish arguments of time_bucket_gapfill as
+ * restrictions on the time column. This makes the arguments behave like the
+ * same bounds in the WHERE clause and lets chunk exclusion skip the chunks
+ * outside of the gapfill range.
+ */
+void
+gapfill_restrict_query(Query *parse)
+{
+	gapfill_restrict_walker((Node *) parse, NULL);
+}
@@ -12,11 +12,13 @@
 void plan_add_gapfill(PlannerInfo *, RelOptInfo *);
 void gapfill_adjust_window_targetlist(PlannerInfo *root, RelOptInfo *input_rel,
 									  RelOptInfo *output_rel);
+void gapfill_restrict_query(Query *parse);
 
 typedef struct GapFillPath
 {
 	CustomPath cpath;
 	FuncExpr *func; /* time_bucket_gapfill function call */
+	bool hashed;	/* gather subpath tuples per group instead of sorting them */
 } GapFillPath;
 
 #endif /* TIMESCALEDB_GAPFILL_PLANNER_H */
@@ -12,6 +12,7 @@
 
 #include "planner.h"
 #include "gapfill/gapfill.h"
+#include "gapfill/planner.h"
 #include "partialize_finalize.h"
 
 #include "license.h"
@@ -25,6 +26,7 @@
 #include "continuous_aggs/insert.h"
 #include "continuous_aggs/materialize.h"
 #include "continuous_aggs/options.h"
+#include "continuous_aggs/planner.h"
 #include "process_utility.h"
 
 #ifdef PG_MODULE_MAGIC
@@ -61,6 +63,7 @@ CrossModuleFunctions tsl_cm_functions = {
 	.add_tsl_license_info_telemetry = tsl_telemetry_add_license_info,
 	.bgw_policy_job_execute = tsl_bgw_policy_job_execute,
 	.continuous_agg_materialize = continuous_agg_materialize,
+	.continuous_agg_materialize_worker = continuous_agg_materialize_worker,
 	.add_drop_chunks_policy = drop_chunks_add_policy,
 	.add_reorder_policy = reorder_add_policy,
 	.remove_drop_chunks_policy = drop_chunks_remove_policy,
@@ -78,10 +81,14 @@ CrossModuleFunctions tsl_cm_functions = {
 	.partialize_agg = tsl_partialize_agg,
 	.finalize_agg_sfunc = tsl_finalize_agg_sfunc,
 	.finalize_agg_ffunc = tsl_finalize_agg_ffunc,
+	.combine_agg_ffunc = tsl_combine_agg_ffunc,
 	.process_cagg_viewstmt = tsl_process_continuous_agg_viewstmt,
 	.continuous_agg_drop_chunks_by_chunk_id = ts_continuous_agg_drop_chunks_by_chunk_id,
 	.continuous_agg_trigfn = continuous_agg_trigfn,
+	.continuous_agg_invalidate = continuous_agg_invalidate,
 	.continuous_agg_update_options = continuous_agg_update_options,
+	.continuous_agg_rewrite_query = continuous_agg_rewrite_query,
+	.gapfill_restrict_query = gapfill_restrict_query,
 };
 
 TS_FUNCTION_INFO_V1(ts_module_init);
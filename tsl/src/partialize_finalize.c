@@ -4,12 +4,16 @@
  * LICENSE-TIMESCALE for a copy of the license.
  */
 #include <postgres.h>
+#include <math.h>
 #include <fmgr.h>
 #include <catalog/pg_aggregate.h>
 #include <catalog/pg_type.h>
 #include <utils/syscache.h>
 #include <utils/datum.h>
 #include <utils/builtins.h>
+#include <utils/date.h>
+#include <utils/array.h>
+#include <utils/timestamp.h>
 #include <access/htup_details.h>
 #include <catalog/namespace.h>
 #include <catalog/pg_collation.h>
@@ -18,8 +22,13 @@
 #include "compat.h"
 #include "partialize_finalize.h"
 
+#if PG96
+#include <utils/int8.h>
+#endif
+
 TS_FUNCTION_INFO_V1(tsl_finalize_agg_sfunc);
 TS_FUNCTION_INFO_V1(tsl_finalize_agg_ffunc);
+TS_FUNCTION_INFO_V1(tsl_combine_agg_ffunc);
 TS_FUNCTION_INFO_V1(tsl_partialize_agg);
 
 /*
@@ -52,6 +61,12 @@ TS_FUNCTION_INFO_V1(tsl_partialize_agg);
  * as a wrapper, it takes the transition state of the inner aggregate as its
  * input, calls the combine function of the inner aggregate as its transition
  * function and the finalfunc of the inner aggregate.
+ *
+ * The combine aggregate shares the transition function of the finalize
+ * aggregate, but instead of applying the finalfunc of the inner agg it
+ * serializes the combined state again. Its output is a partial of the inner agg
+ * covering all the partials it combined, which allows building a continuous agg
+ * with wider buckets from the partials of another continuous agg.
  */
 
 /*
@@ -68,8 +83,73 @@ TS_FUNCTION_INFO_V1(tsl_partialize_agg);
  *
  * tsl_finalize_agg_sfunc is the state transition function
  * tsl_finalize_agg_ffunc is the finalize function
+ * tsl_combine_agg_ffunc is the final function of the combine aggregate
+ *
+ * Finalizing is dominated by deserializing the partials and calling the
+ * combine function through fmgr for every row, which is far more expensive
+ * than the combine itself for the most common built-in aggregates. For those
+ * we have fast paths: their partials are the output of the send function of a
+ * fixed-width transition type, or of a small array of one, so we decode the
+ * partial bytes directly and combine them into native per group state, which
+ * is only turned into a transition value for the final or serialize function.
  */
 
+/*
+ * The fast paths, by the combine function of the inner aggregate. Each one
+ * implements exactly the semantics of that function, including its overflow
+ * checks, so it does not matter which aggregate uses it.
+ */
+typedef enum FAFastPathKind
+{
+	FA_FAST_PATH_NONE = 0,
+	FA_FAST_PATH_INT_SUM,	/* int8pl: count, sum(int2), sum(int4) */
+	FA_FAST_PATH_FLOAT4_SUM, /* float4pl: sum(float4) */
+	FA_FAST_PATH_FLOAT8_SUM, /* float8pl: sum(float8) */
+	FA_FAST_PATH_INT_MIN,	/* min of int2, int4, int8, date, timestamp and timestamptz */
+	FA_FAST_PATH_INT_MAX,	/* max of the same */
+	FA_FAST_PATH_FLOAT_MIN,  /* min of float4 and float8 */
+	FA_FAST_PATH_FLOAT_MAX,  /* max of float4 and float8 */
+	FA_FAST_PATH_INT_AVG,	/* int4_avg_combine: avg(int2), avg(int4) */
+	FA_FAST_PATH_FLOAT_AVG,  /* float8_combine: avg, stddev and variance of floats */
+} FAFastPathKind;
+
+typedef struct FAFastPath
+{
+	PGFunction combinefn;
+	/* the transition type, or its element type for array transition types */
+	Oid transtype;
+	bool is_array;
+	FAFastPathKind kind;
+} FAFastPath;
+
+static const FAFastPath fa_fast_paths[] = {
+	{ int8pl, INT8OID, false, FA_FAST_PATH_INT_SUM },
+	{ float4pl, FLOAT4OID, false, FA_FAST_PATH_FLOAT4_SUM },
+	{ float8pl, FLOAT8OID, false, FA_FAST_PATH_FLOAT8_SUM },
+	{ int2smaller, INT2OID, false, FA_FAST_PATH_INT_MIN },
+	{ int2larger, INT2OID, false, FA_FAST_PATH_INT_MAX },
+	{ int4smaller, INT4OID, false, FA_FAST_PATH_INT_MIN },
+	{ int4larger, INT4OID, false, FA_FAST_PATH_INT_MAX },
+	{ int8smaller, INT8OID, false, FA_FAST_PATH_INT_MIN },
+	{ int8larger, INT8OID, false, FA_FAST_PATH_INT_MAX },
+	{ date_smaller, DATEOID, false, FA_FAST_PATH_INT_MIN },
+	{ date_larger, DATEOID, false, FA_FAST_PATH_INT_MAX },
+	/* timestamptz_smaller and timestamptz_larger are the same C functions */
+	{ timestamp_smaller, TIMESTAMPOID, false, FA_FAST_PATH_INT_MIN },
+	{ timestamp_larger, TIMESTAMPOID, false, FA_FAST_PATH_INT_MAX },
+	{ timestamp_smaller, TIMESTAMPTZOID, false, FA_FAST_PATH_INT_MIN },
+	{ timestamp_larger, TIMESTAMPTZOID, false, FA_FAST_PATH_INT_MAX },
+	{ float4smaller, FLOAT4OID, false, FA_FAST_PATH_FLOAT_MIN },
+	{ float4larger, FLOAT4OID, false, FA_FAST_PATH_FLOAT_MAX },
+	{ float8smaller, FLOAT8OID, false, FA_FAST_PATH_FLOAT_MIN },
+	{ float8larger, FLOAT8OID, false, FA_FAST_PATH_FLOAT_MAX },
+	{ int4_avg_combine, INT8OID, true, FA_FAST_PATH_INT_AVG },
+#if PG96 || PG10 || PG11
+	/* later versions combine the sums of squares differently */
+	{ float8_combine, FLOAT8OID, true, FA_FAST_PATH_FLOAT_AVG },
+#endif
+};
+
 /* State for calling the combine + deserialize functions of the inner aggregate */
 typedef struct FACombineFnMeta
 {
@@ -88,6 +168,17 @@ typedef struct FACombineFnMeta
 
 } FACombineFnMeta;
 
+/* State for calling the serialize function of the inner aggregate */
+typedef struct FASerializeFnMeta
+{
+	Oid serialfnoid;
+	Oid send_fn;
+	FmgrInfo serialfn;
+	FmgrInfo internal_serialfn;
+	/* only valid if serialfnoid is valid, internal_serialfn is called directly */
+	FunctionCallInfoData serialfn_fcinfo;
+} FASerializeFnMeta;
+
 /* State for calling the final function of the inner aggregate */
 typedef struct FAFinalFnMeta
 {
@@ -96,6 +187,14 @@ typedef struct FAFinalFnMeta
 	FunctionCallInfoData finalfn_fcinfo;
 } FAFinalFnMeta;
 
+/* Native per group state of the fast paths, only valid once trans_value_initialized is set */
+typedef struct FAFastPathState
+{
+	int64 ints[2];		 /* sum, min or max, or the count and sum of avg */
+	float4 float4_sum;   /* sum of float4 */
+	float8 floats[3];	/* sum, min or max, or N, sum(X) and sum(X*X) of avg */
+} FAFastPathState;
+
 /*
  * Per group state of the finalize aggregate. Note that if we have a strict combine
  * function, both arg values have to be non-null (like min/max). When we see
@@ -107,13 +206,21 @@ typedef struct FAPerGroupState
 	Datum trans_value;
 	bool trans_value_isnull;
 	bool trans_value_initialized;
+	FAFastPathState fast_path_state;
 } FAPerGroupState;
 
 /* metadata information that is common for the entire query */
 typedef struct FAPerQueryState
 {
 	FACombineFnMeta combine_meta;
+	FASerializeFnMeta serialize_meta;
 	FAFinalFnMeta final_meta;
+	FAFastPathKind fast_path;
+	/* the length of the transition type, for the fast paths of scalar transition types */
+	int16 fast_path_typlen;
+	/* for native partials, see partialize_agg_native */
+	int16 transtyplen;
+	bool transtypbyval;
 } FAPerQueryState;
 
 typedef struct FATransitionState
@@ -260,6 +367,353 @@ get_input_types(ArrayType *input_types, size_t *number_types)
 	return type_oids;
 };
 
+/*
+ * Pick the fast path for the combine function of the inner aggregate, if it has
+ * one. Aggregates with a deserialize function have internal transition types
+ * whose partials we do not know how to read.
+ */
+static void
+fa_fast_path_init(FAPerQueryState *qstate)
+{
+	FACombineFnMeta *combine_meta = &qstate->combine_meta;
+	Oid element_type = get_element_type(combine_meta->transtype);
+	int i;
+
+	qstate->fast_path = FA_FAST_PATH_NONE;
+	qstate->fast_path_typlen = 0;
+
+	if (OidIsValid(combine_meta->deserialfnoid))
+		return;
+
+	for (i = 0; i < lengthof(fa_fast_paths); i++)
+	{
+		const FAFastPath *fast_path = &fa_fast_paths[i];
+
+		if (fast_path->combinefn != combine_meta->combinefn.fn_addr)
+			continue;
+
+		if (fast_path->is_array ? fast_path->transtype == element_type :
+								  fast_path->transtype == combine_meta->transtype)
+		{
+			qstate->fast_path = fast_path->kind;
+			qstate->fast_path_typlen = get_typlen(combine_meta->transtype);
+			return;
+		}
+	}
+}
+
+static void
+fa_invalid_partial(void)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+			 errmsg("invalid partial aggregate state")));
+}
+
+/* read a big-endian unsigned integer of len bytes, as written by the send functions */
+static inline uint64
+fa_read_uint(const unsigned char *bytes, int len)
+{
+	uint64 value = 0;
+	int i;
+
+	for (i = 0; i < len; i++)
+		value = (value << 8) | bytes[i];
+
+	return value;
+}
+
+static inline int64
+fa_read_int(const unsigned char *bytes, int len)
+{
+	uint64 value = fa_read_uint(bytes, len);
+
+	/* sign extend the shorter integers */
+	if (len < (int) sizeof(int64) && (value & (UINT64CONST(1) << (len * 8 - 1))) != 0)
+		value |= ~UINT64CONST(0) << (len * 8);
+
+	return (int64) value;
+}
+
+static inline float4
+fa_read_float4(const unsigned char *bytes)
+{
+	union
+	{
+		uint32 i;
+		float4 f;
+	} swap;
+
+	swap.i = (uint32) fa_read_uint(bytes, sizeof(float4));
+	return swap.f;
+}
+
+static inline float8
+fa_read_float8(const unsigned char *bytes)
+{
+	union
+	{
+		uint64 i;
+		float8 f;
+	} swap;
+
+	swap.i = fa_read_uint(bytes, sizeof(float8));
+	return swap.f;
+}
+
+/*
+ * Get the elements of the partial of a one-dimensional array of nelems non-null
+ * 8 byte elements, as written by array_send: a header of the number of
+ * dimensions, the null flag and the element type, then the length and lower
+ * bound of the dimension, then each element prefixed by its length.
+ */
+#define FA_ARRAY_HEADER_SIZE ((int) (5 * sizeof(int32)))
+#define FA_ARRAY_ELEMENT_SIZE ((int) (sizeof(int32) + sizeof(int64)))
+
+static inline const unsigned char *
+fa_read_array(const unsigned char *bytes, int len, Oid element_type, int nelems)
+{
+	int i;
+
+	if (len != FA_ARRAY_HEADER_SIZE + nelems * FA_ARRAY_ELEMENT_SIZE ||
+		fa_read_uint(bytes, sizeof(int32)) != 1 ||
+		fa_read_uint(bytes + sizeof(int32), sizeof(int32)) != 0 ||
+		fa_read_uint(bytes + 2 * sizeof(int32), sizeof(Oid)) != element_type ||
+		fa_read_uint(bytes + 3 * sizeof(int32), sizeof(int32)) != nelems)
+		fa_invalid_partial();
+
+	bytes += FA_ARRAY_HEADER_SIZE;
+	for (i = 0; i < nelems; i++)
+		if (fa_read_uint(bytes + i * FA_ARRAY_ELEMENT_SIZE, sizeof(int32)) != sizeof(int64))
+			fa_invalid_partial();
+
+	return bytes + sizeof(int32);
+}
+
+#define FA_ARRAY_ELEMENT(elements, i) ((elements) + (i) * FA_ARRAY_ELEMENT_SIZE)
+
+/* the same overflow check as int8pl */
+static inline int64
+fa_int64_add(int64 a, int64 b)
+{
+	int64 result = (int64)((uint64) a + (uint64) b);
+
+	if ((a >= 0) == (b >= 0) && (result >= 0) != (a >= 0))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE), errmsg("bigint out of range")));
+
+	return result;
+}
+
+/* the same overflow check as float8pl, an infinite result needs an infinite input */
+static inline void
+fa_check_float_overflow(bool result_isinf, bool inputs_isinf)
+{
+	if (result_isinf && !inputs_isinf)
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("value out of range: overflow")));
+}
+
+/*
+ * Combine a non-null partial into the native state of the group, or initialize
+ * the state with it if it is the first one, like a strict combine function.
+ */
+static void
+fa_fast_path_advance(FAPerQueryState *qstate, FAPerGroupState *gstate, bytea *partial)
+{
+	FAFastPathState *state = &gstate->fast_path_state;
+	const unsigned char *bytes = (const unsigned char *) VARDATA_ANY(partial);
+	int len = VARSIZE_ANY_EXHDR(partial);
+	bool first = !gstate->trans_value_initialized;
+
+	switch (qstate->fast_path)
+	{
+		case FA_FAST_PATH_INT_SUM:
+		{
+			int64 value;
+
+			if (len != sizeof(int64))
+				fa_invalid_partial();
+			value = fa_read_int(bytes, sizeof(int64));
+			state->ints[0] = first ? value : fa_int64_add(state->ints[0], value);
+			break;
+		}
+		case FA_FAST_PATH_FLOAT4_SUM:
+		{
+			float4 value;
+			float4 result;
+
+			if (len != sizeof(float4))
+				fa_invalid_partial();
+			value = fa_read_float4(bytes);
+			if (first)
+				result = value;
+			else
+			{
+				result = state->float4_sum + value;
+				fa_check_float_overflow(isinf(result), isinf(state->float4_sum) || isinf(value));
+			}
+			state->float4_sum = result;
+			break;
+		}
+		case FA_FAST_PATH_FLOAT8_SUM:
+		{
+			float8 value;
+			float8 result;
+
+			if (len != sizeof(float8))
+				fa_invalid_partial();
+			value = fa_read_float8(bytes);
+			if (first)
+				result = value;
+			else
+			{
+				result = state->floats[0] + value;
+				fa_check_float_overflow(isinf(result), isinf(state->floats[0]) || isinf(value));
+			}
+			state->floats[0] = result;
+			break;
+		}
+		case FA_FAST_PATH_INT_MIN:
+		case FA_FAST_PATH_INT_MAX:
+		{
+			int64 value;
+
+			if (len != qstate->fast_path_typlen)
+				fa_invalid_partial();
+			value = fa_read_int(bytes, len);
+			if (first || (qstate->fast_path == FA_FAST_PATH_INT_MIN ? value < state->ints[0] :
+																	  value > state->ints[0]))
+				state->ints[0] = value;
+			break;
+		}
+		case FA_FAST_PATH_FLOAT_MIN:
+		case FA_FAST_PATH_FLOAT_MAX:
+		{
+			float8 value;
+			int cmp;
+
+			if (len != qstate->fast_path_typlen)
+				fa_invalid_partial();
+			/* widening keeps the order of float4 values, including NaN and -0 */
+			value = len == sizeof(float4) ? fa_read_float4(bytes) : fa_read_float8(bytes);
+			if (first)
+			{
+				state->floats[0] = value;
+				break;
+			}
+			/* like float8smaller and float8larger, only keep the current value if it wins */
+			cmp = float8_cmp_internal(state->floats[0], value);
+			if (qstate->fast_path == FA_FAST_PATH_FLOAT_MIN ? cmp >= 0 : cmp <= 0)
+				state->floats[0] = value;
+			break;
+		}
+		case FA_FAST_PATH_INT_AVG:
+		{
+			const unsigned char *elements = fa_read_array(bytes, len, INT8OID, 2);
+			int i;
+
+			/* the count and the sum, int4_avg_combine does not check them for overflow */
+			for (i = 0; i < 2; i++)
+			{
+				int64 value = fa_read_int(FA_ARRAY_ELEMENT(elements, i), sizeof(int64));
+
+				state->ints[i] = first ? value : (int64)((uint64) state->ints[i] + (uint64) value);
+			}
+			break;
+		}
+		case FA_FAST_PATH_FLOAT_AVG:
+		{
+			const unsigned char *elements = fa_read_array(bytes, len, FLOAT8OID, 3);
+			int i;
+
+			/* N, sum(X) and sum(X*X), float8_combine only checks the sums for overflow */
+			for (i = 0; i < 3; i++)
+			{
+				float8 value = fa_read_float8(FA_ARRAY_ELEMENT(elements, i));
+				float8 result;
+
+				if (first)
+					result = value;
+				else
+				{
+					result = state->floats[i] + value;
+					if (i > 0)
+						fa_check_float_overflow(isinf(result),
+												isinf(state->floats[i]) || isinf(value));
+				}
+				state->floats[i] = result;
+			}
+			break;
+		}
+		case FA_FAST_PATH_NONE:
+			elog(ERROR, "no fast path for the combine function");
+	}
+
+	gstate->trans_value_initialized = true;
+	gstate->trans_value_isnull = false;
+}
+
+/*
+ * Turn the native state of the group into the transition value of the inner
+ * aggregate, before it is finalized or serialized.
+ */
+static void
+fa_fast_path_flush(FAPerQueryState *qstate, FAPerGroupState *gstate)
+{
+	FAFastPathState *state = &gstate->fast_path_state;
+	Datum elements[3];
+	int i;
+
+	if (qstate->fast_path == FA_FAST_PATH_NONE || !gstate->trans_value_initialized)
+		return;
+
+	switch (qstate->fast_path)
+	{
+		case FA_FAST_PATH_INT_SUM:
+			gstate->trans_value = Int64GetDatum(state->ints[0]);
+			break;
+		case FA_FAST_PATH_FLOAT4_SUM:
+			gstate->trans_value = Float4GetDatum(state->float4_sum);
+			break;
+		case FA_FAST_PATH_FLOAT8_SUM:
+			gstate->trans_value = Float8GetDatum(state->floats[0]);
+			break;
+		case FA_FAST_PATH_INT_MIN:
+		case FA_FAST_PATH_INT_MAX:
+			if (qstate->fast_path_typlen == sizeof(int16))
+				gstate->trans_value = Int16GetDatum((int16) state->ints[0]);
+			else if (qstate->fast_path_typlen == sizeof(int32))
+				gstate->trans_value = Int32GetDatum((int32) state->ints[0]);
+			else
+				gstate->trans_value = Int64GetDatum(state->ints[0]);
+			break;
+		case FA_FAST_PATH_FLOAT_MIN:
+		case FA_FAST_PATH_FLOAT_MAX:
+			if (qstate->fast_path_typlen == sizeof(float4))
+				gstate->trans_value = Float4GetDatum((float4) state->floats[0]);
+			else
+				gstate->trans_value = Float8GetDatum(state->floats[0]);
+			break;
+		case FA_FAST_PATH_INT_AVG:
+			for (i = 0; i < 2; i++)
+				elements[i] = Int64GetDatum(state->ints[i]);
+			gstate->trans_value = PointerGetDatum(
+				construct_array(elements, 2, INT8OID, sizeof(int64), FLOAT8PASSBYVAL, 'd'));
+			break;
+		case FA_FAST_PATH_FLOAT_AVG:
+			for (i = 0; i < 3; i++)
+				elements[i] = Float8GetDatum(state->floats[i]);
+			gstate->trans_value = PointerGetDatum(
+				construct_array(elements, 3, FLOAT8OID, sizeof(float8), FLOAT8PASSBYVAL, 'd'));
+			break;
+		case FA_FAST_PATH_NONE:
+			break;
+	}
+	gstate->trans_value_isnull = false;
+}
+
 static FATransitionState *
 fa_transition_state_init(MemoryContext *fa_context, FAPerQueryState *qstate, AggState *fa_aggstate)
 {
@@ -307,6 +761,7 @@ fa_perquery_state_init(FunctionCallInfo fcinfo)
 	tstate->combine_meta.combinefnoid = inner_agg_form->aggcombinefn;
 	tstate->combine_meta.deserialfnoid = inner_agg_form->aggdeserialfn;
 	tstate->combine_meta.transtype = inner_agg_form->aggtranstype;
+	tstate->serialize_meta.serialfnoid = inner_agg_form->aggserialfn;
 	ReleaseSysCache(inner_agg_tuple);
 
 	/* initialize combine specific state, both the deserialize function and combine function */
@@ -315,6 +770,29 @@ fa_perquery_state_init(FunctionCallInfo fcinfo)
 			 "no valid combine function for the aggregate specified in Timescale finalize call");
 
 	fmgr_info_cxt(tstate->combine_meta.combinefnoid, &tstate->combine_meta.combinefn, qcontext);
+
+	/*
+	 * Native partials are transition values, so they are only valid for
+	 * aggregates whose transition type is the result type, that is, for
+	 * aggregates without a final function. They never need the fast paths,
+	 * which decode serialized partials.
+	 */
+	if (get_fn_expr_argtype(fcinfo->flinfo, 5) != BYTEAOID)
+	{
+		if (OidIsValid(tstate->final_meta.finalfnoid) ||
+			get_fn_expr_argtype(fcinfo->flinfo, 5) != tstate->combine_meta.transtype)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATATYPE_MISMATCH),
+					 errmsg("partial of type %s is not a transition value of the aggregate",
+							format_type_be(get_fn_expr_argtype(fcinfo->flinfo, 5)))));
+		get_typlenbyval(tstate->combine_meta.transtype,
+						&tstate->transtyplen,
+						&tstate->transtypbyval);
+		tstate->fast_path = FA_FAST_PATH_NONE;
+		tstate->fast_path_typlen = 0;
+	}
+	else
+		fa_fast_path_init(tstate);
 	InitFunctionCallInfoData(tstate->combine_meta.combfn_fcinfo,
 							 &tstate->combine_meta.combinefn,
 							 2, /* combine fn always has two args */
@@ -352,6 +830,30 @@ fa_perquery_state_init(FunctionCallInfo fcinfo)
 								 NULL,
 								 NULL);
 	}
+	/* initialize serialize specific state, mirroring the deserialization above */
+	if (OidIsValid(tstate->serialize_meta.serialfnoid))
+	{
+		fmgr_info_cxt(tstate->serialize_meta.serialfnoid,
+					  &tstate->serialize_meta.serialfn,
+					  qcontext);
+		InitFunctionCallInfoData(tstate->serialize_meta.serialfn_fcinfo,
+								 &tstate->serialize_meta.serialfn,
+								 1, /* serialize always has 1 arg */
+								 collation,
+								 (void *) fa_aggstate,
+								 NULL);
+	}
+	else
+	{
+		bool type_is_varlena;
+
+		getTypeBinaryOutputInfo(tstate->combine_meta.transtype,
+								&tstate->serialize_meta.send_fn,
+								&type_is_varlena);
+		fmgr_info_cxt(tstate->serialize_meta.send_fn,
+					  &tstate->serialize_meta.internal_serialfn,
+					  qcontext);
+	}
 	/* initialize finalfn specific state */
 	if (OidIsValid(tstate->final_meta.finalfnoid))
 	{
@@ -416,6 +918,53 @@ group_state_advance(FAPerGroupState *per_group_state, FACombineFnMeta *combine_m
 	per_group_state->trans_value = FunctionCallInvoke(&combine_meta->combfn_fcinfo);
 	per_group_state->trans_value_isnull = combine_meta->combfn_fcinfo.isnull;
 };
+
+/*
+ * Combine a native partial, which is a transition value of the inner aggregate
+ * that lives in per tuple memory, into the group state. Like
+ * advance_transition_function, we copy every pass-by-reference transition
+ * value that is not already ours into the aggregate context, which is the
+ * current memory context.
+ */
+static void
+group_state_advance_native(FAPerQueryState *qstate, FAPerGroupState *per_group_state,
+						   Datum partial, bool partial_isnull)
+{
+	Datum old_value = per_group_state->trans_value;
+	bool old_isnull = per_group_state->trans_value_isnull;
+
+	if (qstate->combine_meta.combinefn.fn_strict)
+	{
+		if (partial_isnull)
+			return;
+
+		if (!per_group_state->trans_value_initialized)
+		{
+			per_group_state->trans_value =
+				datumCopy(partial, qstate->transtypbyval, qstate->transtyplen);
+			per_group_state->trans_value_isnull = false;
+			per_group_state->trans_value_initialized = true;
+			return;
+		}
+
+		if (per_group_state->trans_value_isnull)
+			return;
+	}
+
+	group_state_advance(per_group_state, &qstate->combine_meta, partial, partial_isnull);
+	per_group_state->trans_value_initialized = true;
+
+	if (!qstate->transtypbyval &&
+		DatumGetPointer(per_group_state->trans_value) != DatumGetPointer(old_value))
+	{
+		if (!per_group_state->trans_value_isnull)
+			per_group_state->trans_value = datumCopy(per_group_state->trans_value,
+													 qstate->transtypbyval,
+													 qstate->transtyplen);
+		if (!old_isnull)
+			pfree(DatumGetPointer(old_value));
+	}
+}
 /*
  * The parameters for tsl_finalize_agg_sfunc (see util_aggregates.sql sql input names)
  * tstate The internal state of the aggregate
@@ -437,7 +986,9 @@ Datum
 tsl_finalize_agg_sfunc(PG_FUNCTION_ARGS)
 {
 	FATransitionState *tstate = PG_ARGISNULL(0) ? NULL : (FATransitionState *) PG_GETARG_POINTER(0);
-	bytea *inner_agg_serialized_state = PG_ARGISNULL(5) ? NULL : PG_GETARG_BYTEA_P(5);
+	bool native_partial = get_fn_expr_argtype(fcinfo->flinfo, 5) != BYTEAOID;
+	bytea *inner_agg_serialized_state =
+		(PG_ARGISNULL(5) || native_partial) ? NULL : PG_GETARG_BYTEA_PP(5);
 	bool inner_agg_serialized_state_isnull = PG_ARGISNULL(5) ? true : false;
 	Datum inner_agg_deserialized_state;
 	MemoryContext fa_context, old_context;
@@ -460,16 +1011,29 @@ tsl_finalize_agg_sfunc(PG_FUNCTION_ARGS)
 			Assert(fcinfo->flinfo->fn_extra != NULL);
 		}
 		tstate = fa_transition_state_init(&fa_context, qstate, (AggState *) fcinfo->context);
-		/* initial trans_value = the partial state of the inner agg from first invocation */
-		tstate->per_group_state->trans_value =
-			inner_agg_deserialize(&tstate->per_query_state->combine_meta,
-								  inner_agg_serialized_state,
-								  inner_agg_serialized_state_isnull,
-								  &tstate->per_group_state->trans_value_isnull);
-		tstate->per_group_state->trans_value_initialized =
-			!(tstate->per_group_state->trans_value_isnull);
+		if (native_partial)
+			group_state_advance_native(qstate,
+									   tstate->per_group_state,
+									   PG_GETARG_DATUM(5),
+									   inner_agg_serialized_state_isnull);
+		else if (qstate->fast_path == FA_FAST_PATH_NONE)
+		{
+			/* initial trans_value = the partial state of the inner agg from first invocation */
+			tstate->per_group_state->trans_value =
+				inner_agg_deserialize(&tstate->per_query_state->combine_meta,
+									  inner_agg_serialized_state,
+									  inner_agg_serialized_state_isnull,
+									  &tstate->per_group_state->trans_value_isnull);
+			tstate->per_group_state->trans_value_initialized =
+				!(tstate->per_group_state->trans_value_isnull);
+		}
 	}
-	else
+	else if (native_partial)
+		group_state_advance_native(tstate->per_query_state,
+								   tstate->per_group_state,
+								   PG_GETARG_DATUM(5),
+								   inner_agg_serialized_state_isnull);
+	else if (tstate->per_query_state->fast_path == FA_FAST_PATH_NONE)
 	{
 		bool deser_isnull;
 		bool call_combine;
@@ -503,6 +1067,13 @@ tsl_finalize_agg_sfunc(PG_FUNCTION_ARGS)
 								inner_agg_deserialized_state,
 								deser_isnull);
 	}
+
+	/* all the combine functions with fast paths are strict, so skip null partials */
+	if (tstate->per_query_state->fast_path != FA_FAST_PATH_NONE &&
+		!inner_agg_serialized_state_isnull)
+		fa_fast_path_advance(tstate->per_query_state,
+							 tstate->per_group_state,
+							 inner_agg_serialized_state);
 	MemoryContextSwitchTo(old_context);
 
 	PG_RETURN_POINTER(tstate);
@@ -523,6 +1094,7 @@ tsl_finalize_agg_ffunc(PG_FUNCTION_ARGS)
 		elog(ERROR, "finalize_agg_ffunc called in non-aggregate context");
 	}
 	old_context = MemoryContextSwitchTo(fa_context);
+	fa_fast_path_flush(tstate->per_query_state, tstate->per_group_state);
 	if (OidIsValid(tstate->per_query_state->final_meta.finalfnoid))
 	{
 		/* don't execute if strict and the trans value is NULL or there are extra args (all extra
@@ -550,6 +1122,49 @@ tsl_finalize_agg_ffunc(PG_FUNCTION_ARGS)
 		PG_RETURN_DATUM(tstate->per_group_state->trans_value);
 }
 
+/* tsl_combine_agg_ffunc:
+ * serialize the state we have accumulated, so that it can be stored and
+ * combined or finalized like the partials it was built from
+ */
+Datum
+tsl_combine_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	FATransitionState *tstate = PG_ARGISNULL(0) ? NULL : (FATransitionState *) PG_GETARG_POINTER(0);
+	FASerializeFnMeta *serialize_meta;
+	MemoryContext fa_context, old_context;
+	Datum serialized;
+	bool serialized_isnull = false;
+
+	if (!AggCheckCallContext(fcinfo, &fa_context))
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "combine_agg_ffunc called in non-aggregate context");
+	}
+	if (tstate == NULL || tstate->per_group_state->trans_value_isnull)
+		PG_RETURN_NULL();
+
+	serialize_meta = &tstate->per_query_state->serialize_meta;
+	old_context = MemoryContextSwitchTo(fa_context);
+	fa_fast_path_flush(tstate->per_query_state, tstate->per_group_state);
+	if (OidIsValid(serialize_meta->serialfnoid))
+	{
+		serialize_meta->serialfn_fcinfo.arg[0] = tstate->per_group_state->trans_value;
+		serialize_meta->serialfn_fcinfo.argnull[0] = false;
+		serialize_meta->serialfn_fcinfo.isnull = false;
+		serialized = FunctionCallInvoke(&serialize_meta->serialfn_fcinfo);
+		serialized_isnull = serialize_meta->serialfn_fcinfo.isnull;
+	}
+	else
+		serialized = PointerGetDatum(SendFunctionCall(&serialize_meta->internal_serialfn,
+													  tstate->per_group_state->trans_value));
+	MemoryContextSwitchTo(old_context);
+
+	if (serialized_isnull)
+		PG_RETURN_NULL();
+	else
+		PG_RETURN_DATUM(serialized);
+}
+
 /*
  * the partialize_agg function mainly serves as a marker that the aggregate called
  * within should return a partial instead of a result. Most of the actual work
@@ -561,6 +1176,7 @@ tsl_partialize_agg(PG_FUNCTION_ARGS)
 {
 	Datum arg;
 	Oid arg_type;
+	Oid ret_type;
 	Oid send_fn;
 	bool type_is_varlena;
 
@@ -569,6 +1185,21 @@ tsl_partialize_agg(PG_FUNCTION_ARGS)
 
 	arg = PG_GETARG_DATUM(0);
 	arg_type = get_fn_expr_argtype(fcinfo->flinfo, 0);
+	ret_type = get_fn_expr_rettype(fcinfo->flinfo);
+
+	/*
+	 * partialize_agg_native returns the transition value itself, which only has
+	 * the return type of the aggregate if the aggregate has no final function
+	 */
+	if (ret_type != BYTEAOID)
+	{
+		if (arg_type != ret_type)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("aggregate does not have native partials"),
+					 errhint("Use partialize_agg instead.")));
+		PG_RETURN_DATUM(arg);
+	}
 
 	if (arg_type == BYTEAOID)
 		PG_RETURN_DATUM(arg);
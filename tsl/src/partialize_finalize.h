@@ -14,6 +14,7 @@
 
 extern TSDLLEXPORT Datum tsl_finalize_agg_sfunc(PG_FUNCTION_ARGS);
 extern TSDLLEXPORT Datum tsl_finalize_agg_ffunc(PG_FUNCTION_ARGS);
+extern TSDLLEXPORT Datum tsl_combine_agg_ffunc(PG_FUNCTION_ARGS);
 extern TSDLLEXPORT Datum tsl_partialize_agg(PG_FUNCTION_ARGS);
 
 #endif
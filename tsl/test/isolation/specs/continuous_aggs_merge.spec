@@ -0,0 +1,50 @@
+# re-materializing an invalidated range deletes the changed partials and inserts
+# the new ones under a single snapshot, so a raw insert committed while the merge
+# runs cannot leave two partials for the same bucket
+setup
+{
+    SELECT _timescaledb_internal.stop_background_workers();
+    CREATE TABLE ts_continuous_test(time INTEGER, location INTEGER);
+    SELECT create_hypertable('ts_continuous_test', 'time', chunk_time_interval => 10);
+    INSERT INTO ts_continuous_test SELECT i, i FROM
+        (SELECT generate_series(0, 29) AS i) AS i;
+    CREATE VIEW continuous_view
+        WITH ( timescaledb.continuous, timescaledb.refresh_interval='72 hours')
+        AS SELECT time_bucket('5', time), COUNT(location)
+            FROM ts_continuous_test
+            GROUP BY 1;
+    DO $$
+    BEGIN
+        EXECUTE format('CREATE VIEW materialization AS SELECT * FROM %I.%I',
+            (SELECT h.schema_name FROM _timescaledb_catalog.continuous_agg ca
+             JOIN _timescaledb_catalog.hypertable h ON h.id = ca.mat_hypertable_id
+             WHERE ca.user_view_name = 'continuous_view'),
+            (SELECT h.table_name FROM _timescaledb_catalog.continuous_agg ca
+             JOIN _timescaledb_catalog.hypertable h ON h.id = ca.mat_hypertable_id
+             WHERE ca.user_view_name = 'continuous_view'));
+    END
+    $$;
+}
+
+teardown {
+    DROP VIEW materialization;
+    DROP TABLE ts_continuous_test CASCADE;
+}
+
+# invalidates the buckets 0 and 5, only the partial of bucket 0 changes
+session "I"
+step "Invalidate"	{ INSERT INTO ts_continuous_test VALUES (1, 1), (7, 100); DELETE FROM ts_continuous_test WHERE location = 100; }
+step "I1"	{ INSERT INTO ts_continuous_test VALUES (6, 100); }
+
+session "R"
+step "Refresh"	{ REFRESH MATERIALIZED VIEW continuous_view; }
+
+# holding the old partial of bucket 0 blocks the merge after it took its snapshot
+session "L"
+step "LockRow"	{ BEGIN; SELECT time_partition_col FROM materialization WHERE time_partition_col = 0 FOR UPDATE; }
+step "UnlockRow"	{ ROLLBACK; }
+
+session "S"
+step "Partials"	{ SELECT time_partition_col, count(*) FROM materialization GROUP BY 1 ORDER BY 1; }
+
+permutation "Refresh" "Invalidate" "LockRow" "Refresh" "I1" "UnlockRow" "Partials"
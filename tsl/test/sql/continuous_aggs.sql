@@ -56,7 +56,7 @@ WHERE user_view_name = 'mat_m1'
 \gset
 
 insert into :"MAT_SCHEMA_NAME".:"MAT_TABLE_NAME"
-select a, _timescaledb_internal.partialize_agg(count(b)),
+select a, _timescaledb_internal.partialize_agg_native(count(b)),
 time_bucket(1, a)
 ,1
 from foo
@@ -114,7 +114,7 @@ WHERE user_view_name = 'mat_m1'
 \c :TEST_DBNAME :ROLE_SUPERUSER
 insert into  :"MAT_SCHEMA_NAME".:"MAT_TABLE_NAME"
 select
- time_bucket('1day', timec), _timescaledb_internal.partialize_agg( min(location)), _timescaledb_internal.partialize_agg( sum(temperature)) , _timescaledb_internal.partialize_agg( sum(humidity))
+ time_bucket('1day', timec), _timescaledb_internal.partialize_agg_native( min(location)), _timescaledb_internal.partialize_agg_native( sum(temperature)) , _timescaledb_internal.partialize_agg_native( sum(humidity))
 ,1
 from conditions
 group by time_bucket('1day', timec) ;
@@ -176,7 +176,7 @@ WHERE user_view_name = 'mat_m1'
 \c :TEST_DBNAME :ROLE_SUPERUSER
 insert into  :"MAT_SCHEMA_NAME".:"MAT_TABLE_NAME"
 select
- time_bucket('1week', timec),  _timescaledb_internal.partialize_agg( min(location)), _timescaledb_internal.partialize_agg( sum(temperature)) , _timescaledb_internal.partialize_agg( sum(humidity)), _timescaledb_internal.partialize_agg(stddev(humidity))
+ time_bucket('1week', timec),  _timescaledb_internal.partialize_agg_native( min(location)), _timescaledb_internal.partialize_agg_native( sum(temperature)) , _timescaledb_internal.partialize_agg_native( sum(humidity)), _timescaledb_internal.partialize_agg(stddev(humidity))
 ,1
 from conditions
 group by time_bucket('1week', timec) ;
@@ -223,7 +223,7 @@ WHERE user_view_name = 'mat_m1'
 \c :TEST_DBNAME :ROLE_SUPERUSER
 insert into  :"MAT_SCHEMA_NAME".:"MAT_TABLE_NAME"
 select
- time_bucket('1week', timec),  _timescaledb_internal.partialize_agg( min(location)), _timescaledb_internal.partialize_agg( sum(temperature)) , _timescaledb_internal.partialize_agg( sum(humidity)), _timescaledb_internal.partialize_agg(stddev(humidity))
+ time_bucket('1week', timec),  _timescaledb_internal.partialize_agg_native( min(location)), _timescaledb_internal.partialize_agg_native( sum(temperature)) , _timescaledb_internal.partialize_agg_native( sum(humidity)), _timescaledb_internal.partialize_agg(stddev(humidity))
 ,1
 from conditions
 where location = 'NYC'
@@ -269,7 +269,7 @@ WHERE user_view_name = 'mat_m1'
 \c :TEST_DBNAME :ROLE_SUPERUSER
 insert into  :"MAT_SCHEMA_NAME".:"MAT_TABLE_NAME"
 select
- time_bucket('1week', timec),  _timescaledb_internal.partialize_agg( min(location)), _timescaledb_internal.partialize_agg( sum(temperature)) , _timescaledb_internal.partialize_agg( sum(humidity)), _timescaledb_internal.partialize_agg(stddev(humidity))
+ time_bucket('1week', timec),  _timescaledb_internal.partialize_agg_native( min(location)), _timescaledb_internal.partialize_agg_native( sum(temperature)) , _timescaledb_internal.partialize_agg_native( sum(humidity)), _timescaledb_internal.partialize_agg(stddev(humidity))
 ,1
 from conditions
 group by time_bucket('1week', timec) ;
@@ -338,7 +338,7 @@ order by attnum, attname;
 \c :TEST_DBNAME :ROLE_SUPERUSER
 insert into  :"MAT_SCHEMA_NAME".:"MAT_TABLE_NAME"
 select
- time_bucket('1week', timec),  _timescaledb_internal.partialize_agg( min(location)), _timescaledb_internal.partialize_agg( sum(temperature)) , _timescaledb_internal.partialize_agg( sum(humidity)), _timescaledb_internal.partialize_agg(stddev(humidity))
+ time_bucket('1week', timec),  _timescaledb_internal.partialize_agg_native( min(location)), _timescaledb_internal.partialize_agg_native( sum(temperature)) , _timescaledb_internal.partialize_agg_native( sum(humidity)), _timescaledb_internal.partialize_agg(stddev(humidity))
 ,_timescaledb_internal.partialize_agg( avg(temperature))
 ,1
 from conditions
@@ -753,3 +753,141 @@ group by time_bucket(100, timec);
 REFRESH MATERIALIZED VIEW mat_ffunc_test;
 
 SELECT * FROM mat_ffunc_test;
+
+-- the end point of a materialization is found by probing the newest chunk
+-- with rows after the completed threshold
+CREATE TABLE end_point(time INT NOT NULL, value INT);
+SELECT table_name FROM create_hypertable('end_point', 'time', chunk_time_interval => 10);
+CREATE VIEW end_point_view
+WITH (timescaledb.continuous, timescaledb.refresh_lag = '0')
+AS SELECT time_bucket(5, time), count(value)
+   FROM end_point
+   GROUP BY 1;
+INSERT INTO end_point VALUES (1, 1), (12, 1), (25, 1), (36, 1);
+-- the newest chunk has no rows left
+DELETE FROM end_point WHERE time = 36;
+REFRESH MATERIALIZED VIEW end_point_view;
+SELECT * FROM end_point_view ORDER BY 1;
+-- no new rows past the completed threshold
+REFRESH MATERIALIZED VIEW end_point_view;
+
+-- every run of the materialization which materialized something is recorded in the statistics
+INSERT INTO end_point VALUES (3, 1), (27, 1), (31, 1);
+REFRESH MATERIALIZED VIEW end_point_view;
+SELECT run_id, old_completed_threshold, new_completed_threshold, invalidation_threshold,
+       invalidated_ranges, invalidated_buckets, new_buckets, rows_deleted, rows_inserted
+FROM timescaledb_information.materialization_stats
+WHERE view_name = 'end_point_view'::regclass
+ORDER BY run_id;
+SELECT count(*) FROM timescaledb_information.materialization_stats
+WHERE view_name = 'end_point_view'::regclass
+      AND duration >= '0' AND delete_duration >= '0' AND insert_duration >= '0';
+-- only the most recent runs are kept
+\c :TEST_DBNAME :ROLE_SUPERUSER
+SET timescaledb.materialization_stats_history = 2;
+INSERT INTO end_point VALUES (8, 1);
+REFRESH MATERIALIZED VIEW end_point_view;
+SELECT run_id FROM timescaledb_information.materialization_stats
+WHERE view_name = 'end_point_view'::regclass
+ORDER BY run_id;
+\c :TEST_DBNAME :ROLE_DEFAULT_PERM_USER
+
+-- aggregates with a combine function are materialized as partials, one for every chunk of a
+-- bucket, which are combined when the view is queried
+CREATE TABLE agg_cagg(time INT NOT NULL, value DOUBLE PRECISION, counter DOUBLE PRECISION, device INT);
+SELECT table_name FROM create_hypertable('agg_cagg', 'time', chunk_time_interval => 50);
+CREATE VIEW agg_cagg_view
+WITH (timescaledb.continuous, timescaledb.refresh_lag = '-100')
+AS SELECT time_bucket(100, time),
+          percentile_sketch(value),
+          time_weighted_average(value, to_timestamp(time)) AS linear,
+          time_weighted_average(value, to_timestamp(time), 'locf') AS locf,
+          counter_agg(counter, to_timestamp(time)),
+          hyperloglog(device),
+          hyperloglog(device, 8) AS hyperloglog_8
+   FROM agg_cagg
+   GROUP BY 1;
+INSERT INTO agg_cagg SELECT t, t * 0.5 - 100, t % 150 + 1, (t * 7) % 300 FROM generate_series(1, 999) t;
+REFRESH MATERIALIZED VIEW agg_cagg_view;
+
+-- the percentile sketches of the buckets roll up into the sketch of all values
+SELECT count(*),
+       percentile_sketch_rollup(percentile_sketch) = (SELECT percentile_sketch(value) FROM agg_cagg)
+FROM agg_cagg_view;
+SELECT round(approx_percentile(0.5, percentile_sketch_rollup(percentile_sketch))::numeric, 2) AS p50,
+       round(approx_percentile(0.9, percentile_sketch_rollup(percentile_sketch))::numeric, 2) AS p90
+FROM agg_cagg_view;
+
+-- the time-weighted partials of a bucket are combined with the area between them
+SELECT time_bucket, linear, locf FROM agg_cagg_view ORDER BY time_bucket LIMIT 3;
+SELECT count(*)
+FROM agg_cagg_view v
+JOIN (SELECT time_bucket(100, time),
+             time_weighted_average(value, to_timestamp(time)) AS linear,
+             time_weighted_average(value, to_timestamp(time), 'locf') AS locf
+      FROM agg_cagg
+      GROUP BY 1) r USING (time_bucket)
+WHERE v.linear = r.linear AND v.locf = r.locf;
+
+-- the partials of overlapping time ranges, like those of the chunks of different space
+-- partitions, cannot be combined, so the groups must be within a space partition
+CREATE TABLE tw_overlap(time INT NOT NULL, device INT NOT NULL, value DOUBLE PRECISION);
+SELECT table_name FROM create_hypertable('tw_overlap', 'time', 'device', 2, chunk_time_interval => 100);
+\set ON_ERROR_STOP 0
+CREATE VIEW tw_overlap_view
+WITH (timescaledb.continuous, timescaledb.refresh_lag = '-100')
+AS SELECT time_bucket(100, time), time_weighted_average(value, to_timestamp(time))
+   FROM tw_overlap
+   GROUP BY 1;
+CREATE VIEW counter_overlap_view
+WITH (timescaledb.continuous, timescaledb.refresh_lag = '-100')
+AS SELECT time_bucket(100, time), counter_agg(value, to_timestamp(time))
+   FROM tw_overlap
+   GROUP BY 1;
+\set ON_ERROR_STOP 1
+CREATE VIEW tw_overlap_view
+WITH (timescaledb.continuous, timescaledb.refresh_lag = '-100')
+AS SELECT time_bucket(100, time), device, time_weighted_average(value, to_timestamp(time))
+   FROM tw_overlap
+   GROUP BY 1, 2;
+INSERT INTO tw_overlap SELECT t, t % 2, t FROM generate_series(1, 999) t;
+REFRESH MATERIALIZED VIEW tw_overlap_view;
+SELECT * FROM tw_overlap_view ORDER BY 1, 2 LIMIT 4;
+
+-- the counter is reset within the bucket at 100, where the partials of its chunks meet, and
+-- between the buckets at 200 and 300, which only shows once they are rolled up
+SELECT time_bucket,
+       counter_delta(counter_agg),
+       counter_rate(counter_agg),
+       counter_extrapolated_rate(counter_agg, to_timestamp(time_bucket), to_timestamp(time_bucket + 100))
+FROM agg_cagg_view ORDER BY time_bucket LIMIT 4;
+SELECT sum(counter_delta(counter_agg)) AS sum_of_deltas,
+       counter_delta(counter_agg_rollup(counter_agg)) AS rollup_delta
+FROM agg_cagg_view WHERE time_bucket IN (200, 300);
+SELECT counter_delta(counter_agg_rollup(counter_agg)) =
+       (SELECT counter_delta(counter_agg(counter, to_timestamp(time))) FROM agg_cagg)
+FROM agg_cagg_view;
+
+-- the distinct count sketches of the buckets are unioned into the sketch of all values
+SELECT count(*)
+FROM agg_cagg_view v
+JOIN (SELECT time_bucket(100, time), count(DISTINCT device) AS exact
+      FROM agg_cagg
+      GROUP BY 1) r USING (time_bucket)
+WHERE abs(approx_count_distinct(v.hyperloglog) - r.exact) <= 2;
+SELECT hyperloglog_union(hyperloglog) = (SELECT hyperloglog(device) FROM agg_cagg),
+       abs(approx_count_distinct(hyperloglog_union(hyperloglog)) - 300) <= 6 AS within_error
+FROM agg_cagg_view;
+
+-- at a precision of 8, the sketches of the chunks are sparse, and become dense when the two
+-- partials of a bucket are combined
+SELECT count(*) AS chunks, count(*) FILTER (WHERE get_byte(sketch, 2) = 0) AS sparse
+FROM (SELECT hyperloglog(device, 8) AS sketch FROM agg_cagg GROUP BY time_bucket(50, time)) c;
+SELECT count(*) AS buckets, count(*) FILTER (WHERE get_byte(hyperloglog_8, 2) = 1) AS dense
+FROM agg_cagg_view;
+SELECT count(*)
+FROM agg_cagg_view v
+JOIN (SELECT time_bucket(100, time), hyperloglog(device, 8) AS hyperloglog_8
+      FROM agg_cagg
+      GROUP BY 1) r USING (time_bucket)
+WHERE v.hyperloglog_8 = r.hyperloglog_8;
@@ -0,0 +1,138 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+\c :TEST_DBNAME :ROLE_SUPERUSER
+SELECT _timescaledb_internal.stop_background_workers();
+\c :TEST_DBNAME :ROLE_DEFAULT_PERM_USER
+
+CREATE TABLE metrics(time int NOT NULL, device int NOT NULL, value int NOT NULL);
+SELECT table_name FROM create_hypertable('metrics', 'time', chunk_time_interval => 10);
+
+INSERT INTO metrics SELECT t, d, t * d FROM generate_series(0, 59) t, generate_series(1, 2) d;
+
+SET client_min_messages TO error;
+CREATE VIEW metrics_5 WITH (timescaledb.continuous, timescaledb.refresh_lag = '0') AS
+SELECT time_bucket(5, time) AS bucket, device, sum(value), max(value), count(*)
+FROM metrics
+GROUP BY 1, 2;
+
+-- materialized by combining the partials of metrics_5 instead of reading the
+-- raw hypertable
+CREATE VIEW metrics_20
+WITH (timescaledb.continuous, timescaledb.refresh_lag = '0',
+      timescaledb.materialize_from = 'metrics_5') AS
+SELECT time_bucket(20, time) AS bucket, device, sum(value), count(*)
+FROM metrics
+GROUP BY 1, 2;
+RESET client_min_messages;
+
+-- the materialization table of metrics_5 is the raw hypertable of metrics_20
+SELECT ca.user_view_name, h.table_name AS raw_table
+FROM _timescaledb_catalog.continuous_agg ca
+JOIN _timescaledb_catalog.hypertable h ON h.id = ca.raw_hypertable_id
+ORDER BY 1;
+
+SELECT h.table_name
+FROM pg_trigger t
+JOIN _timescaledb_catalog.hypertable h
+     ON format('%I.%I', h.schema_name, h.table_name)::regclass = t.tgrelid
+WHERE t.tgname = 'ts_cagg_invalidation_trigger'
+ORDER BY h.id;
+
+CREATE VIEW invalidations AS
+SELECT h.table_name, l.lowest_modified_value, l.greatest_modified_value
+FROM _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log l
+JOIN _timescaledb_catalog.hypertable h ON h.id = l.hypertable_id
+ORDER BY 1, 2;
+
+-- metrics_20 can only be materialized up to what metrics_5 materialized
+REFRESH MATERIALIZED VIEW metrics_20;
+REFRESH MATERIALIZED VIEW metrics_5;
+REFRESH MATERIALIZED VIEW metrics_20;
+SELECT * FROM metrics_20 ORDER BY 1, 2;
+
+-- re-materializing metrics_5 invalidates the buckets of metrics_20 it rewrote
+INSERT INTO metrics VALUES (2, 1, 100);
+SELECT * FROM invalidations;
+REFRESH MATERIALIZED VIEW metrics_20;
+REFRESH MATERIALIZED VIEW metrics_5;
+SELECT * FROM invalidations;
+SELECT * FROM metrics_5 WHERE bucket = 0 ORDER BY 1, 2;
+SELECT * FROM metrics_20 WHERE bucket = 0 ORDER BY 1, 2;
+REFRESH MATERIALIZED VIEW metrics_20;
+SELECT * FROM invalidations;
+SELECT * FROM metrics_20 WHERE bucket = 0 ORDER BY 1, 2;
+
+-- new data reaches metrics_20 through metrics_5
+INSERT INTO metrics SELECT t, d, t * d FROM generate_series(60, 99) t, generate_series(1, 2) d;
+REFRESH MATERIALIZED VIEW metrics_20;
+REFRESH MATERIALIZED VIEW metrics_5;
+REFRESH MATERIALIZED VIEW metrics_20;
+SELECT * FROM invalidations;
+SELECT * FROM metrics_20 ORDER BY 1, 2;
+
+-- same result as aggregating the raw data
+SELECT count(*) AS mismatches
+FROM ((TABLE metrics_20
+       EXCEPT ALL
+       SELECT time_bucket(20, time), device, sum(value), count(*)
+       FROM metrics WHERE time < 80 GROUP BY 1, 2)
+      UNION ALL
+      (SELECT time_bucket(20, time), device, sum(value), count(*)
+       FROM metrics WHERE time < 80 GROUP BY 1, 2
+       EXCEPT ALL
+       TABLE metrics_20)) AS d;
+
+-- late rows only invalidate the buckets they modify, on both levels
+INSERT INTO metrics VALUES (3, 1, 1), (67, 1, 1);
+SELECT * FROM invalidations;
+REFRESH MATERIALIZED VIEW metrics_5;
+SELECT * FROM invalidations;
+REFRESH MATERIALIZED VIEW metrics_20;
+SELECT * FROM metrics_20 WHERE device = 1 ORDER BY 1;
+
+-- re-materializing buckets whose partials did not change does not rewrite them,
+-- so nothing is invalidated in metrics_20
+INSERT INTO metrics VALUES (4, 1, 1);
+DELETE FROM metrics WHERE time = 4 AND value = 1;
+SELECT * FROM invalidations;
+REFRESH MATERIALIZED VIEW metrics_5;
+SELECT * FROM invalidations;
+
+\set ON_ERROR_STOP 0
+ALTER VIEW metrics_20 SET (timescaledb.materialize_from = 'metrics_5');
+
+SET client_min_messages TO error;
+CREATE VIEW metrics_bad WITH (timescaledb.continuous, timescaledb.materialize_from = 'metrics') AS
+SELECT time_bucket(20, time) AS bucket, device, sum(value)
+FROM metrics
+GROUP BY 1, 2;
+
+-- the bucket width has to be a multiple of the one of metrics_5
+CREATE VIEW metrics_bad WITH (timescaledb.continuous, timescaledb.materialize_from = 'metrics_5') AS
+SELECT time_bucket(12, time) AS bucket, device, sum(value)
+FROM metrics
+GROUP BY 1, 2;
+
+-- min is not an aggregate of metrics_5
+CREATE VIEW metrics_bad WITH (timescaledb.continuous, timescaledb.materialize_from = 'metrics_5') AS
+SELECT time_bucket(20, time) AS bucket, device, min(value)
+FROM metrics
+GROUP BY 1, 2;
+
+-- grouping by value is not possible from the buckets of metrics_5
+CREATE VIEW metrics_bad WITH (timescaledb.continuous, timescaledb.materialize_from = 'metrics_5') AS
+SELECT time_bucket(20, time) AS bucket, value, count(*)
+FROM metrics
+GROUP BY 1, 2;
+RESET client_min_messages;
+\set ON_ERROR_STOP 1
+
+-- dropping metrics_5 drops metrics_20 as well
+SET client_min_messages TO error;
+DROP VIEW metrics_5 CASCADE;
+RESET client_min_messages;
+SELECT count(*) FROM _timescaledb_catalog.continuous_agg;
+SELECT * FROM invalidations;
+SELECT count(*) FROM pg_trigger WHERE tgname = 'ts_cagg_invalidation_trigger';
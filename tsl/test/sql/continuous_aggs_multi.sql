@@ -0,0 +1,178 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+\c :TEST_DBNAME :ROLE_SUPERUSER
+SELECT _timescaledb_internal.stop_background_workers();
+\c :TEST_DBNAME :ROLE_DEFAULT_PERM_USER
+
+CREATE TABLE metrics(time int NOT NULL, value int NOT NULL);
+SELECT table_name FROM create_hypertable('metrics', 'time', chunk_time_interval => 10);
+
+INSERT INTO metrics SELECT t, 1 FROM generate_series(0, 49) t;
+
+-- two continuous aggregates with different bucket widths and lags on the
+-- same hypertable
+SET client_min_messages TO error;
+CREATE VIEW metrics_5 WITH (timescaledb.continuous) AS
+SELECT time_bucket(5, time) AS bucket, count(*), sum(value)
+FROM metrics
+GROUP BY 1;
+
+CREATE VIEW metrics_20 WITH (timescaledb.continuous, timescaledb.refresh_lag = '0') AS
+SELECT time_bucket(20, time) AS bucket, count(*), sum(value)
+FROM metrics
+GROUP BY 1;
+RESET client_min_messages;
+
+-- they share the invalidation trigger
+SELECT count(*) FROM pg_trigger
+WHERE tgrelid = 'metrics'::regclass AND tgname = 'ts_cagg_invalidation_trigger';
+
+CREATE VIEW thresholds AS
+SELECT ca.user_view_name, ct.watermark AS completed_threshold,
+       it.watermark AS invalidation_threshold
+FROM _timescaledb_catalog.continuous_agg ca
+LEFT JOIN _timescaledb_catalog.continuous_aggs_completed_threshold ct
+     ON ct.materialization_id = ca.mat_hypertable_id
+LEFT JOIN _timescaledb_catalog.continuous_aggs_invalidation_threshold it
+     ON it.hypertable_id = ca.raw_hypertable_id
+ORDER BY 1;
+
+CREATE VIEW invalidations AS
+SELECT NULL::name AS user_view_name, lowest_modified_value, greatest_modified_value
+FROM _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log
+UNION ALL
+SELECT ca.user_view_name, l.lowest_modified_value, l.greatest_modified_value
+FROM _timescaledb_catalog.continuous_aggs_materialization_invalidation_log l
+JOIN _timescaledb_catalog.continuous_agg ca ON ca.mat_hypertable_id = l.materialization_id
+ORDER BY 1 NULLS FIRST;
+
+-- each continuous aggregate has its own completed threshold, while the
+-- invalidation threshold of the hypertable never moves backwards
+REFRESH MATERIALIZED VIEW metrics_20;
+REFRESH MATERIALIZED VIEW metrics_5;
+SELECT * FROM thresholds;
+
+SELECT * FROM metrics_5 ORDER BY 1;
+SELECT * FROM metrics_20 ORDER BY 1;
+
+-- mutations below the invalidation threshold are logged once for the
+-- hypertable
+INSERT INTO metrics VALUES (2, 10), (37, 10);
+SELECT * FROM invalidations;
+
+-- and moved to the logs of all its continuous aggregates by the first
+-- materialization, which only consumes its own copy
+REFRESH MATERIALIZED VIEW metrics_5;
+SELECT * FROM invalidations;
+SELECT * FROM metrics_5 ORDER BY 1;
+SELECT * FROM metrics_20 ORDER BY 1;
+
+REFRESH MATERIALIZED VIEW metrics_20;
+SELECT * FROM invalidations;
+SELECT * FROM metrics_20 ORDER BY 1;
+
+-- invalidations of a dropped continuous aggregate are dropped with it, the
+-- trigger and invalidation threshold only with the last one
+INSERT INTO metrics VALUES (3, 1);
+REFRESH MATERIALIZED VIEW metrics_20;
+SELECT * FROM invalidations;
+SET client_min_messages TO error;
+DROP VIEW metrics_5 CASCADE;
+RESET client_min_messages;
+SELECT * FROM invalidations;
+SELECT * FROM thresholds;
+SELECT count(*) FROM pg_trigger
+WHERE tgrelid = 'metrics'::regclass AND tgname = 'ts_cagg_invalidation_trigger';
+
+SET client_min_messages TO error;
+DROP VIEW metrics_20 CASCADE;
+RESET client_min_messages;
+SELECT * FROM invalidations;
+SELECT count(*) FROM _timescaledb_catalog.continuous_aggs_invalidation_threshold;
+SELECT count(*) FROM pg_trigger
+WHERE tgrelid = 'metrics'::regclass AND tgname = 'ts_cagg_invalidation_trigger';
+
+-- the new range can be materialized by several background workers, in slices
+-- following the chunks of the raw hypertable, with the same result
+CREATE TABLE backfill(time int NOT NULL, value int NOT NULL);
+SELECT table_name FROM create_hypertable('backfill', 'time', chunk_time_interval => 10);
+INSERT INTO backfill SELECT t, t FROM generate_series(0, 99) t;
+
+SET client_min_messages TO error;
+CREATE VIEW backfill_5
+WITH (timescaledb.continuous, timescaledb.refresh_lag = '0',
+      timescaledb.max_interval_per_job = '1000') AS
+SELECT time_bucket(5, time) AS bucket, count(*), sum(value)
+FROM backfill
+GROUP BY 1;
+RESET client_min_messages;
+
+SET timescaledb.max_parallel_materialization_workers TO 4;
+REFRESH MATERIALIZED VIEW backfill_5;
+RESET timescaledb.max_parallel_materialization_workers;
+SELECT * FROM thresholds;
+
+SELECT count(*) AS mismatches
+FROM ((TABLE backfill_5
+       EXCEPT ALL
+       SELECT time_bucket(5, time), count(*), sum(value)
+       FROM backfill WHERE time < 95 GROUP BY 1)
+      UNION ALL
+      (SELECT time_bucket(5, time), count(*), sum(value)
+       FROM backfill WHERE time < 95 GROUP BY 1
+       EXCEPT ALL
+       TABLE backfill_5)) AS d;
+
+-- the workers commit each slice in a transaction of its own
+SELECT format('%I.%I', h.schema_name, h.table_name) AS mat_table
+FROM _timescaledb_catalog.continuous_agg ca
+JOIN _timescaledb_catalog.hypertable h ON h.id = ca.mat_hypertable_id
+WHERE ca.user_view_name = 'backfill_5' \gset
+SELECT min(time_partition_col) AS slice_start, max(time_partition_col) + 5 AS slice_end
+FROM :mat_table GROUP BY xmin::text ORDER BY 1;
+
+-- a worker failing on a slice leaves it, and the slices after it, to the
+-- serial materialization, while the other workers carry on
+SET client_min_messages TO error;
+CREATE VIEW backfill_5_fail
+WITH (timescaledb.continuous, timescaledb.refresh_lag = '0',
+      timescaledb.max_interval_per_job = '1000') AS
+SELECT time_bucket(5, time) AS bucket, count(*), sum(value)
+FROM backfill
+GROUP BY 1;
+RESET client_min_messages;
+
+SELECT format('%I.%I', h.schema_name, h.table_name) AS mat_table
+FROM _timescaledb_catalog.continuous_agg ca
+JOIN _timescaledb_catalog.hypertable h ON h.id = ca.mat_hypertable_id
+WHERE ca.user_view_name = 'backfill_5_fail' \gset
+CREATE FUNCTION fail_in_worker() RETURNS trigger LANGUAGE plpgsql AS $$
+BEGIN
+  IF NEW.time_partition_col = 50 AND current_setting('test.in_leader', true) IS NULL THEN
+    RAISE EXCEPTION 'materialization worker failed';
+  END IF;
+  RETURN NEW;
+END
+$$;
+CREATE TRIGGER fail_in_worker BEFORE INSERT ON :mat_table
+FOR EACH ROW EXECUTE PROCEDURE fail_in_worker();
+
+SET test.in_leader TO on;
+SET timescaledb.max_parallel_materialization_workers TO 4;
+REFRESH MATERIALIZED VIEW backfill_5_fail;
+RESET timescaledb.max_parallel_materialization_workers;
+RESET test.in_leader;
+SELECT * FROM thresholds;
+SELECT min(time_partition_col) AS slice_start, max(time_partition_col) + 5 AS slice_end
+FROM :mat_table GROUP BY xmin::text ORDER BY 1;
+SELECT count(*) AS mismatches
+FROM ((TABLE backfill_5_fail EXCEPT ALL TABLE backfill_5)
+      UNION ALL
+      (TABLE backfill_5 EXCEPT ALL TABLE backfill_5_fail)) AS d;
+
+SET client_min_messages TO error;
+DROP TABLE backfill CASCADE;
+RESET client_min_messages;
+DROP FUNCTION fail_in_worker();
@@ -0,0 +1,70 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+\c :TEST_DBNAME :ROLE_SUPERUSER
+SELECT _timescaledb_internal.stop_background_workers();
+\c :TEST_DBNAME :ROLE_DEFAULT_PERM_USER
+
+CREATE TABLE metrics(time int NOT NULL, device int NOT NULL, value int NOT NULL);
+SELECT table_name FROM create_hypertable('metrics', 'time', chunk_time_interval => 10);
+
+INSERT INTO metrics SELECT t, d, t * d FROM generate_series(0, 49) t, generate_series(1, 2) d;
+
+SET client_min_messages TO error;
+CREATE VIEW metrics_summary
+WITH (timescaledb.continuous, timescaledb.materialized_only = false) AS
+SELECT time_bucket(10, time) AS bucket, device, sum(value), count(*)
+FROM metrics
+GROUP BY 1, 2;
+RESET client_min_messages;
+
+-- nothing is materialized yet, so everything is read from the hypertable
+SELECT _timescaledb_internal.cagg_watermark(mat_hypertable_id) IS NULL AS no_watermark
+FROM _timescaledb_catalog.continuous_agg WHERE user_view_name = 'metrics_summary';
+SELECT * FROM metrics_summary ORDER BY 1, 2;
+
+REFRESH MATERIALIZED VIEW metrics_summary;
+SELECT _timescaledb_internal.cagg_watermark(mat_hypertable_id)
+FROM _timescaledb_catalog.continuous_agg WHERE user_view_name = 'metrics_summary';
+
+-- buckets below the watermark come from the materialization, the rest
+-- from the hypertable
+SELECT * FROM metrics_summary ORDER BY 1, 2;
+
+-- new data above the watermark is visible right away, while changes
+-- below it are only visible after the next materialization
+INSERT INTO metrics VALUES (5, 1, 1000), (55, 1, 55);
+SELECT * FROM metrics_summary WHERE bucket IN (0, 50) ORDER BY 1, 2;
+
+-- only return materialized data
+ALTER VIEW metrics_summary SET (timescaledb.materialized_only = true);
+SELECT * FROM metrics_summary WHERE bucket IN (0, 50) ORDER BY 1, 2;
+ALTER VIEW metrics_summary SET (timescaledb.materialized_only = false);
+SELECT * FROM metrics_summary WHERE bucket IN (0, 50) ORDER BY 1, 2;
+
+REFRESH MATERIALIZED VIEW metrics_summary;
+SELECT * FROM metrics_summary WHERE bucket IN (0, 50) ORDER BY 1, 2;
+
+-- timestamp time column
+CREATE TABLE conditions(time timestamptz NOT NULL, temp int NOT NULL);
+SELECT table_name FROM create_hypertable('conditions', 'time');
+
+INSERT INTO conditions
+SELECT t, 1
+FROM generate_series('2019-01-01 00:00+00'::timestamptz, '2019-01-10 00:00+00', '1 hour') t;
+
+SET client_min_messages TO error;
+CREATE VIEW cond_daily
+WITH (timescaledb.continuous, timescaledb.materialized_only = false) AS
+SELECT time_bucket('1 day', time) AS day, count(*)
+FROM conditions
+GROUP BY 1;
+RESET client_min_messages;
+
+SELECT count(*) AS days, sum(count) FROM cond_daily;
+REFRESH MATERIALIZED VIEW cond_daily;
+SELECT count(*) AS days, sum(count) FROM cond_daily;
+
+ALTER VIEW cond_daily SET (timescaledb.materialized_only = true);
+SELECT count(*) AS days, sum(count) FROM cond_daily;
@@ -0,0 +1,105 @@
+-- This file and its contents are licensed under the Timescale License.
+-- Please see the included NOTICE for copyright information and
+-- LICENSE-TIMESCALE for a copy of the license.
+
+\c :TEST_DBNAME :ROLE_SUPERUSER
+SELECT _timescaledb_internal.stop_background_workers();
+\c :TEST_DBNAME :ROLE_DEFAULT_PERM_USER
+
+-- Run a query with and without the continuous aggregate rewrite and
+-- report whether the rewrite happened and whether the results differ
+CREATE OR REPLACE FUNCTION check_rewrite(query text)
+RETURNS TABLE(rewritten boolean, num_rows bigint, mismatches bigint)
+LANGUAGE plpgsql AS
+$BODY$
+DECLARE
+  line text;
+BEGIN
+  rewritten := false;
+  PERFORM set_config('timescaledb.enable_cagg_rewrite', 'off', true);
+  EXECUTE format('CREATE TEMP TABLE expected ON COMMIT DROP AS %s', query);
+  PERFORM set_config('timescaledb.enable_cagg_rewrite', 'on', true);
+  EXECUTE format('CREATE TEMP TABLE actual ON COMMIT DROP AS %s', query);
+  FOR line IN EXECUTE format('EXPLAIN (verbose, costs off) %s', query) LOOP
+    IF line LIKE '%finalize_agg%' THEN
+      rewritten := true;
+    END IF;
+  END LOOP;
+  EXECUTE 'SELECT count(*) FROM expected' INTO num_rows;
+  EXECUTE 'SELECT count(*) FROM ((TABLE expected EXCEPT ALL TABLE actual) UNION ALL
+                                 (TABLE actual EXCEPT ALL TABLE expected)) AS d' INTO mismatches;
+  RETURN NEXT;
+END
+$BODY$;
+
+CREATE TABLE conditions(time timestamptz NOT NULL, device int NOT NULL, temp int NOT NULL);
+SELECT table_name FROM create_hypertable('conditions', 'time');
+
+INSERT INTO conditions
+SELECT t, d, (extract(epoch FROM t)::bigint / 600 % 50)::int + d
+FROM generate_series('2019-01-01 00:00+00'::timestamptz, '2019-01-05 23:50+00', '10 min') t,
+     generate_series(1, 3) d;
+
+SET client_min_messages TO error;
+CREATE VIEW cond_hourly WITH (timescaledb.continuous) AS
+SELECT time_bucket('1 hour', time) AS bucket, device, avg(temp), max(temp), count(*)
+FROM conditions
+GROUP BY 1, 2;
+ALTER VIEW cond_hourly SET (timescaledb.max_interval_per_job = '100 days');
+REFRESH MATERIALIZED VIEW cond_hourly;
+RESET client_min_messages;
+
+-- data above the completed threshold is read from the hypertable
+INSERT INTO conditions
+SELECT t, d, (extract(epoch FROM t)::bigint / 600 % 50)::int + d
+FROM generate_series('2019-01-06 00:00+00'::timestamptz, '2019-01-06 23:50+00', '10 min') t,
+     generate_series(1, 3) d;
+
+-- the rewrite is off by default
+SHOW timescaledb.enable_cagg_rewrite;
+
+-- same query as the continuous aggregate
+SELECT * FROM check_rewrite($$
+  SELECT time_bucket('1 hour', time), device, avg(temp), max(temp), count(*)
+  FROM conditions GROUP BY 1, 2 $$);
+
+-- wider buckets and fewer grouping columns
+SELECT * FROM check_rewrite($$
+  SELECT time_bucket('1 day', time), max(temp), count(*)
+  FROM conditions GROUP BY 1 $$);
+
+-- aggregates in expressions without a time bucket
+SELECT * FROM check_rewrite($$
+  SELECT device, max(temp) - avg(temp)
+  FROM conditions GROUP BY device $$);
+
+-- WHERE on a grouping column and HAVING
+SELECT * FROM check_rewrite($$
+  SELECT time_bucket('1 day', time) AS day, device, avg(temp)
+  FROM conditions WHERE device = 2 GROUP BY 1, 2 HAVING count(*) > 0 $$);
+
+-- aggregate query in a subquery
+SELECT * FROM check_rewrite($$
+  SELECT * FROM (SELECT time_bucket('1 day', time) AS day, avg(temp)
+                 FROM conditions GROUP BY 1) d
+  WHERE d.avg > 0 $$);
+
+-- bucket width is not a multiple of the continuous aggregate's
+SELECT * FROM check_rewrite($$
+  SELECT time_bucket('90 minutes', time), max(temp)
+  FROM conditions GROUP BY 1 $$);
+
+-- aggregate not in the continuous aggregate
+SELECT * FROM check_rewrite($$
+  SELECT time_bucket('1 hour', time), min(temp)
+  FROM conditions GROUP BY 1 $$);
+
+-- WHERE on the time column cannot be answered from the buckets
+SELECT * FROM check_rewrite($$
+  SELECT time_bucket('1 day', time), device, count(*)
+  FROM conditions WHERE time < '2019-01-03 00:00+00' GROUP BY 1, 2 $$);
+
+-- ONLY excludes the chunks the continuous aggregate is computed from
+SELECT * FROM check_rewrite($$
+  SELECT time_bucket('1 hour', time), max(temp)
+  FROM ONLY conditions GROUP BY 1 $$);
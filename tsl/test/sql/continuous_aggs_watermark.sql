@@ -140,6 +140,13 @@ UPDATE ca_inval_test SET time = 17 WHERE time = 19;
 SELECT * FROM _timescaledb_catalog.continuous_aggs_invalidation_threshold;
 SELECT * from _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log;
 
+-- inserts through the hypertable record the range they insert into each chunk
+-- without the trigger, while inserts directly into a chunk still use it
+SELECT chunk AS ca_inval_chunk FROM show_chunks('ca_inval_test') chunk ORDER BY 1 LIMIT 1 \gset
+INSERT INTO ca_inval_test VALUES (1), (3);
+INSERT INTO :ca_inval_chunk VALUES (2);
+SELECT * from _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log;
+
 DROP TABLE ca_inval_test CASCADE;
 \c :TEST_DBNAME :ROLE_SUPERUSER
 TRUNCATE _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log;
@@ -183,3 +190,35 @@ DROP TABLE ts_continuous_test CASCADE;
 TRUNCATE _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log;
 TRUNCATE _timescaledb_catalog.continuous_aggs_invalidation_threshold;
 \c :TEST_DBNAME :ROLE_DEFAULT_PERM_USER
+
+-- the invalidation threshold is cached, and the cache is reset whenever the threshold changes
+CREATE TABLE threshold_cache_test(time int NOT NULL, value int);
+SELECT table_name FROM create_hypertable('threshold_cache_test', 'time', chunk_time_interval => 10);
+CREATE VIEW threshold_cache_view
+    WITH ( timescaledb.continuous, timescaledb.refresh_lag = '0', timescaledb.refresh_interval='72 hours')
+    AS SELECT time_bucket('5', time), COUNT(value)
+        FROM threshold_cache_test
+        GROUP BY 1;
+INSERT INTO threshold_cache_test VALUES (1, 1), (12, 1);
+REFRESH MATERIALIZED VIEW threshold_cache_view;
+-- these are read with the threshold of 10 from the catalog, and then from the cache
+INSERT INTO threshold_cache_test VALUES (3, 1);
+INSERT INTO threshold_cache_test VALUES (25, 1);
+SELECT lowest_modified_value, greatest_modified_value
+    FROM _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log;
+-- moving the threshold resets the cache
+REFRESH MATERIALIZED VIEW threshold_cache_view;
+INSERT INTO threshold_cache_test VALUES (15, 1);
+SELECT lowest_modified_value, greatest_modified_value
+    FROM _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log;
+-- so does modifying the catalog with SQL
+\c :TEST_DBNAME :ROLE_SUPERUSER
+UPDATE _timescaledb_catalog.continuous_aggs_invalidation_threshold SET watermark = 5;
+\c :TEST_DBNAME :ROLE_DEFAULT_PERM_USER
+INSERT INTO threshold_cache_test VALUES (7, 1);
+SELECT lowest_modified_value, greatest_modified_value
+    FROM _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log;
+DROP TABLE threshold_cache_test CASCADE;
+\c :TEST_DBNAME :ROLE_SUPERUSER
+TRUNCATE _timescaledb_catalog.continuous_aggs_hypertable_invalidation_log;
+TRUNCATE _timescaledb_catalog.continuous_aggs_invalidation_threshold;
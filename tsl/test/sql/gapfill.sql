@@ -682,6 +682,41 @@ FROM metrics_int m1
 WHERE time >= 0 AND time < 10
 GROUP BY 1,2,3 ORDER BY 2,3,1;
 
+-- test locf and interpolate lookups returning by-reference values for several groups
+CREATE TABLE gapfill_lookup(time int, device int, value numeric, label text, reading float);
+INSERT INTO gapfill_lookup VALUES
+  (-10,1,1.5,'one before',10),
+  (-5,2,2.25,'two before',20),
+  (-5,3,NULL,NULL,30),
+  (5,1,3.5,'one',40),
+  (5,2,4.25,'two',50),
+  (5,3,5.125,'three',60),
+  (20,1,7.5,'one after',80),
+  (25,2,8.25,'two after',100);
+
+SELECT
+  time_bucket_gapfill(5,time,0,15) AS time,
+  device,
+  locf(min(value),(SELECT l.value FROM gapfill_lookup l WHERE l.time<0 AND l.device=m.device ORDER BY l.time DESC LIMIT 1)) AS value,
+  locf(min(label),(SELECT l.label FROM gapfill_lookup l WHERE l.time<0 AND l.device=m.device ORDER BY l.time DESC LIMIT 1)) AS label
+FROM gapfill_lookup m
+WHERE time >= 0 AND time < 15
+GROUP BY 1,2 ORDER BY 2,1;
+
+SELECT
+  time_bucket_gapfill(5,time,0,15) AS time,
+  device,
+  interpolate(
+    min(reading),
+    prev=>(SELECT (l.time,l.reading) FROM gapfill_lookup l WHERE l.time<0 AND l.device=m.device ORDER BY l.time DESC LIMIT 1),
+    next=>(SELECT (l.time,l.reading) FROM gapfill_lookup l WHERE l.time>=15 AND l.device=m.device ORDER BY l.time LIMIT 1)
+  ) AS reading
+FROM gapfill_lookup m
+WHERE time >= 0 AND time < 15
+GROUP BY 1,2 ORDER BY 2,1;
+
+DROP TABLE gapfill_lookup;
+
 -- test cte with gap filling in outer query
 WITH data AS (
   SELECT * FROM (VALUES (1,1,1),(2,2,2)) v(time,id,value)
@@ -1371,5 +1406,83 @@ SELECT
 FROM (VALUES (1,1),(2,2)) v(time,device_id)
 GROUP BY 1,device_id;
 
+-- test hashed gapfill
+SET timescaledb.enable_gapfill_hash TO true;
+CREATE TABLE metrics_hash(time int, device_id int, value float);
+INSERT INTO metrics_hash SELECT t, d, t * 10.0 FROM generate_series(0,3) t, generate_series(1,3) d WHERE (t + d) % 2 = 0;
+INSERT INTO metrics_hash VALUES (2, NULL, 20.0);
 
+-- sorting the few input rows would be cheaper, so rule that out
+SET enable_sort TO false;
+EXPLAIN (costs off) SELECT
+  time_bucket_gapfill(1,time,0,4) AS time,
+  device_id,
+  min(value) AS value,
+  locf(min(value)) AS locf,
+  interpolate(min(value)) AS interpolate
+FROM metrics_hash
+GROUP BY 1,2;
+SELECT * FROM (
+  SELECT
+    time_bucket_gapfill(1,time,0,4) AS time,
+    device_id,
+    min(value) AS value,
+    locf(min(value)) AS locf,
+    interpolate(min(value)) AS interpolate
+  FROM metrics_hash
+  GROUP BY 1,2
+) g ORDER BY device_id, time;
+RESET enable_sort;
+
+-- test hashed gapfill with groups spilled to disk
+CREATE TABLE metrics_hash_spill AS SELECT t AS time, d AS device_id FROM generate_series(0,99,13) t, generate_series(1,2000) d;
+ANALYZE metrics_hash_spill;
+SET work_mem TO '64kB';
+EXPLAIN (costs off) SELECT
+  time_bucket_gapfill(10,time,0,100) AS time,
+  device_id,
+  min(time) AS value,
+  locf(min(time)) AS locf
+FROM metrics_hash_spill
+GROUP BY 1,2;
+CREATE TABLE gapfill_hashed AS SELECT
+  time_bucket_gapfill(10,time,0,100) AS time,
+  device_id,
+  min(time) AS value,
+  locf(min(time)) AS locf
+FROM metrics_hash_spill
+GROUP BY 1,2;
+SELECT count(*) AS rows, count(DISTINCT device_id) AS devices, count(value) AS nonnull, sum(locf) AS locf_sum FROM gapfill_hashed;
+
+-- the hashed strategy returns the same rows as the sorted one
+RESET timescaledb.enable_gapfill_hash;
+CREATE TABLE gapfill_sorted AS SELECT
+  time_bucket_gapfill(10,time,0,100) AS time,
+  device_id,
+  min(time) AS value,
+  locf(min(time)) AS locf
+FROM metrics_hash_spill
+GROUP BY 1,2;
+SELECT count(*) AS differences FROM (
+  (SELECT * FROM gapfill_hashed EXCEPT ALL SELECT * FROM gapfill_sorted)
+  UNION ALL
+  (SELECT * FROM gapfill_sorted EXCEPT ALL SELECT * FROM gapfill_hashed)
+) d;
+RESET work_mem;
+DROP TABLE gapfill_hashed, gapfill_sorted, metrics_hash, metrics_hash_spill;
+
+-- test restricting the query to the gapfill range
+SET timescaledb.enable_gapfill_restriction TO true;
+SELECT
+  time_bucket_gapfill(1,time,0,5),
+  min(time)
+FROM (VALUES (-1),(1),(3),(6)) v(time)
+GROUP BY 1 ORDER BY 1;
 
+-- rows before an unaligned start are excluded like with a WHERE clause
+SELECT
+  time_bucket_gapfill(2,time,finish=>6,start=>1),
+  min(time)
+FROM (VALUES (0),(1),(2),(5),(6)) v(time)
+GROUP BY 1 ORDER BY 1;
+RESET timescaledb.enable_gapfill_restriction;
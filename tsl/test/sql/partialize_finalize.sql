@@ -250,3 +250,116 @@ select _timescaledb_internal.finalize_agg( 'aggregate_to_test_ffunc_extra(int, a
 
 with cte as (SELECT  _timescaledb_internal.partialize_agg(aggregate_to_test_ffunc_extra(8, 1::bigint)) as part)
 select _timescaledb_internal.finalize_agg( 'aggregate_to_test_ffunc_extra(int, anyelement)', null, null, array[array['pg_catalog'::name, 'int4'::name], array['pg_catalog', 'int8']], part, null::text) is null from cte;
+
+-- TEST fast paths of built-in aggregates, which combine the partials without
+-- deserializing them. The float values are exact so the order in which they
+-- are summed does not matter.
+create table fast (a int, b int, i2 int2, i4 int4, i8 int8, f4 float4, f8 float8, d date, ts timestamptz);
+insert into fast
+select i % 3, i % 4, i - 15, i * 1000, i * 1000000000::int8, i / 4.0, i / 8.0 - 2,
+       '2019-01-01'::date + i, '2019-01-01'::timestamptz + i * interval '1 hour'
+from generate_series(1, 30) i;
+insert into fast values (2, 0, NULL, NULL, NULL, 'NaN', 'NaN', NULL, NULL);
+insert into fast values (3, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+insert into fast values (3, 1, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+create table fast_partials as
+select a,
+       _timescaledb_internal.partialize_agg(count(*)) count,
+       _timescaledb_internal.partialize_agg(sum(i4)) sum_i4,
+       _timescaledb_internal.partialize_agg(sum(f4)) sum_f4,
+       _timescaledb_internal.partialize_agg(sum(f8)) sum_f8,
+       _timescaledb_internal.partialize_agg(min(i2)) min_i2,
+       _timescaledb_internal.partialize_agg(max(i8)) max_i8,
+       _timescaledb_internal.partialize_agg(min(f8)) min_f8,
+       _timescaledb_internal.partialize_agg(max(f4)) max_f4,
+       _timescaledb_internal.partialize_agg(min(d)) min_d,
+       _timescaledb_internal.partialize_agg(max(ts)) max_ts,
+       _timescaledb_internal.partialize_agg(avg(i4)) avg_i4,
+       _timescaledb_internal.partialize_agg(avg(f8)) avg_f8,
+       _timescaledb_internal.partialize_agg(stddev(f8)) stddev_f8
+from fast group by a, b;
+
+create view fast_finalized as
+select a,
+       _timescaledb_internal.finalize_agg('count()', null, null, null, count, null::int8) count,
+       _timescaledb_internal.finalize_agg('sum(integer)', null, null, null, sum_i4, null::int8) sum_i4,
+       _timescaledb_internal.finalize_agg('sum(real)', null, null, null, sum_f4, null::float4) sum_f4,
+       _timescaledb_internal.finalize_agg('sum(double precision)', null, null, null, sum_f8, null::float8) sum_f8,
+       _timescaledb_internal.finalize_agg('min(smallint)', null, null, null, min_i2, null::int2) min_i2,
+       _timescaledb_internal.finalize_agg('max(bigint)', null, null, null, max_i8, null::int8) max_i8,
+       _timescaledb_internal.finalize_agg('min(double precision)', null, null, null, min_f8, null::float8) min_f8,
+       _timescaledb_internal.finalize_agg('max(real)', null, null, null, max_f4, null::float4) max_f4,
+       _timescaledb_internal.finalize_agg('min(date)', null, null, null, min_d, null::date) min_d,
+       _timescaledb_internal.finalize_agg('max(timestamp with time zone)', null, null, null, max_ts, null::timestamptz) max_ts,
+       _timescaledb_internal.finalize_agg('avg(integer)', null, null, null, avg_i4, null::numeric) avg_i4,
+       _timescaledb_internal.finalize_agg('avg(double precision)', null, null, null, avg_f8, null::float8) avg_f8,
+       _timescaledb_internal.finalize_agg('stddev(double precision)', null, null, null, stddev_f8, null::float8) stddev_f8
+from fast_partials group by a;
+
+create view fast_aggregated as
+select a, count(*), sum(i4), sum(f4), sum(f8), min(i2), max(i8), min(f8), max(f4),
+       min(d), max(ts), avg(i4), avg(f8), stddev(f8)
+from fast group by a;
+
+select a, count, sum_i4, sum_f4, sum_f8, min_i2, max_i8, min_f8, max_f4, min_d
+from fast_finalized order by a;
+
+select count(*) as mismatches
+from ((table fast_finalized except all table fast_aggregated)
+      union all
+      (table fast_aggregated except all table fast_finalized)) as d;
+
+\set ON_ERROR_STOP 0
+-- the same overflow checks as the combine functions
+select _timescaledb_internal.finalize_agg('count()', null, null, null, partial, null::int8)
+from (values (int8send(9223372036854775807)), (int8send(1))) as v(partial);
+select _timescaledb_internal.finalize_agg('sum(double precision)', null, null, null, partial, null::float8)
+from (values (float8send(1e308)), (float8send(1e308))) as v(partial);
+-- partials of the wrong size
+select _timescaledb_internal.finalize_agg('count()', null, null, null, partial, null::int8)
+from (values (int4send(1))) as v(partial);
+select _timescaledb_internal.finalize_agg('avg(integer)', null, null, null, partial, null::numeric)
+from (values (int8send(1))) as v(partial);
+\set ON_ERROR_STOP 1
+
+-- TEST native partials, the transition values of aggregates without a final
+-- function, which are stored in columns of the return type of the aggregate
+create table native_partials as
+select a,
+       _timescaledb_internal.partialize_agg_native(count(*)) count,
+       _timescaledb_internal.partialize_agg_native(sum(i4)) sum_i4,
+       _timescaledb_internal.partialize_agg_native(max(f4)) max_f4,
+       _timescaledb_internal.partialize_agg_native(min(d)) min_d,
+       _timescaledb_internal.partialize_agg(avg(i4)) avg_i4
+from fast group by a, b;
+
+select pg_typeof(count), pg_typeof(sum_i4), pg_typeof(max_f4), pg_typeof(min_d), pg_typeof(avg_i4)
+from native_partials limit 1;
+
+create view native_finalized as
+select a,
+       _timescaledb_internal.finalize_agg('count()', null, null, null, count, null::int8) count,
+       _timescaledb_internal.finalize_agg('sum(integer)', null, null, null, sum_i4, null::int8) sum_i4,
+       _timescaledb_internal.finalize_agg('max(real)', null, null, null, max_f4, null::float4) max_f4,
+       _timescaledb_internal.finalize_agg('min(date)', null, null, null, min_d, null::date) min_d,
+       _timescaledb_internal.finalize_agg('avg(integer)', null, null, null, avg_i4, null::numeric) avg_i4
+from native_partials group by a;
+
+select count(*) as mismatches
+from ((table native_finalized
+       except all
+       select a, count(*), sum(i4), max(f4), min(d), avg(i4) from fast group by a)
+      union all
+      (select a, count(*), sum(i4), max(f4), min(d), avg(i4) from fast group by a
+       except all
+       table native_finalized)) as d;
+
+\set ON_ERROR_STOP 0
+-- the transition value of avg is not its result
+select _timescaledb_internal.partialize_agg_native(avg(i4)) from fast;
+select _timescaledb_internal.finalize_agg('avg(integer)', null, null, null, partial, null::numeric)
+from (values (1::numeric)) as v(partial);
+select _timescaledb_internal.finalize_agg('sum(integer)', null, null, null, partial, null::int4)
+from (values (1)) as v(partial);
+\set ON_ERROR_STOP 1